@@ -99,6 +99,25 @@ peekiFQ (FQ *q, int i)
 	return (q->nq > 0 ? q->q[q->head - q->nq + i] : NULL);
 }
 
+/* remove and return ith element from head of the given FQ, or NULL if there
+ * is no such element. the elements behind it each move up one.
+ */
+void *
+rmiFQ (FQ *q, int i)
+{
+	int at;
+	void *e;
+
+	if (i < 0 || i >= q->nq)
+	    return (NULL);
+	at = q->head - q->nq + i;
+	e = q->q[at];
+	memmove (&q->q[at], &q->q[at+1], (q->head - at - 1) * sizeof(void*));
+	q->head--;
+	q->nq--;
+	return (e);
+}
+
 /* return the number of elements in the given FQ */
 int
 nFQ (FQ *q)
@@ -22,6 +22,9 @@ extern void *peekFQ (FQ *q);
 /* see the ith element from the head of the queue */
 extern void *peekiFQ (FQ *q, int i);
 
+/* remove the ith element from the head of the queue */
+extern void *rmiFQ (FQ *q, int i);
+
 /* return the number of items on a queue */
 extern int nFQ (FQ *q);
 
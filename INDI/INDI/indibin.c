@@ -0,0 +1,314 @@
+/* read the binary frames described in indibin.h and convert them to XML.
+ * licensed under GNU Lesser Public License version 2.1 or later.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "indibin.h"
+
+/* XML being built into a caller's buffer. n keeps counting past max so the
+ * caller can learn how much room it needs.
+ */
+typedef struct {
+    char *p;				/* caller's buffer */
+    int max;				/* bytes at p, including room for nul */
+    int n;				/* bytes needed so far */
+} Out;
+
+static const char *pstates[] = {"Idle", "Ok", "Busy", "Alert"};
+static const char *lstates[] = {"Idle", "Ok", "Busy", "Alert"};
+static const char *sstates[] = {"Off", "On"};
+
+static void outn (Out *op, const char *s, int l);
+static void outs (Out *op, const char *s);
+static void outSafe (Out *op, const char *s, int l);
+static void outIso8601 (Out *op, int64_t secs, int32_t usecs);
+
+/* length of the frame at buf[n] if its header is complete and sane,
+ * 0 if more bytes are needed, -1 if it is not a frame.
+ */
+int
+ibfFrameLen (const unsigned char *buf, int n)
+{
+	uint32_t len;
+
+	if (n < 1)
+	    return (0);
+	if (buf[0] != IBF_MAGIC)
+	    return (-1);
+	if (n < IBF_HDRLEN)
+	    return (0);
+	if (buf[1] != IBF_DEF && buf[1] != IBF_SET)
+	    return (-1);
+	memcpy (&len, buf+4, 4);
+	if (len < (uint32_t)(buf[1] == IBF_DEF ? IBF_DEFLEN : IBF_SETLEN) || len > IBF_MAXLEN)
+	    return (-1);
+	return ((int)len);
+}
+
+/* id of a DEF or SET frame */
+unsigned
+ibfId (const unsigned char *frame)
+{
+	uint32_t id;
+
+	memcpy (&id, frame+8, 4);
+	return (id);
+}
+
+/* fill dp from the DEF frame[len]. return 0 if ok, -1 if malformed.
+ * free with ibfFreeDef().
+ */
+int
+ibfReadDef (const unsigned char *frame, int len, IBFDef *dp)
+{
+	uint16_t nelem;
+	int i, nnames = 0;
+	char *s, *end;
+
+	memset (dp, 0, sizeof(*dp));
+	if (len < IBF_DEFLEN || frame[1] != IBF_DEF || ibfId(frame) > IBF_MAXID)
+	    return (-1);
+	switch (frame[12]) {
+	case IBF_NUMBER: case IBF_SWITCH: case IBF_LIGHT: case IBF_TEXT:
+	    break;
+	default:
+	    return (-1);
+	}
+	memcpy (&nelem, frame+2, 2);
+
+	/* copy the names and insure the last is terminated */
+	dp->buf = (char *) malloc (len - IBF_DEFLEN + 1);
+	dp->el = (char **) malloc ((nelem+1)*sizeof(char*));
+	if (!dp->buf || !dp->el) {
+	    ibfFreeDef (dp);
+	    return (-1);
+	}
+	memcpy (dp->buf, frame + IBF_DEFLEN, len - IBF_DEFLEN);
+	dp->buf[len - IBF_DEFLEN] = '\0';
+
+	/* dev, name then each element */
+	end = dp->buf + (len - IBF_DEFLEN);
+	for (s = dp->buf; s < end && nnames < nelem+2; s += strlen(s)+1) {
+	    if (nnames == 0)
+		dp->dev = s;
+	    else if (nnames == 1)
+		dp->name = s;
+	    else
+		dp->el[nnames-2] = s;
+	    nnames++;
+	}
+	if (nnames != nelem+2 || !dp->dev[0] || !dp->name[0]) {
+	    ibfFreeDef (dp);
+	    return (-1);
+	}
+	for (i = 0; i < nelem; i++)
+	    if (!dp->el[i][0]) {
+		ibfFreeDef (dp);
+		return (-1);
+	    }
+
+	dp->type = frame[12];
+	dp->nelem = nelem;
+	return (0);
+}
+
+/* free the memory of a def filled by ibfReadDef() */
+void
+ibfFreeDef (IBFDef *dp)
+{
+	free (dp->buf);
+	free (dp->el);
+	memset (dp, 0, sizeof(*dp));
+}
+
+/* write the XML for the SET frame[len] of property dp into xml[xmll].
+ * the result is the same as IndiXmlWriter::appendSetProperty in libcommon.
+ * return the length the XML needs, without the final nul, even if it is
+ * more than xmll-1 and so was not all written, or -1 if frame is malformed.
+ */
+int
+ibfSetXML (const IBFDef *dp, const unsigned char *frame, int len, char *xml, int xmll)
+{
+	const char *tag, *eltag;
+	const unsigned char *vp, *end;
+	uint16_t nelem;
+	int64_t secs;
+	int32_t usecs;
+	Out out;
+	int i;
+
+	if (len < IBF_SETLEN || frame[1] != IBF_SET)
+	    return (-1);
+	memcpy (&nelem, frame+2, 2);
+	if (nelem != dp->nelem)
+	    return (-1);
+
+	switch (dp->type) {
+	case IBF_NUMBER: tag = "setNumberVector"; eltag = "oneNumber"; break;
+	case IBF_SWITCH: tag = "setSwitchVector"; eltag = "oneSwitch"; break;
+	case IBF_LIGHT:  tag = "setLightVector";  eltag = "oneLight";  break;
+	case IBF_TEXT:   tag = "setTextVector";   eltag = "oneText";   break;
+	default: return (-1);
+	}
+
+	out.p = xml;
+	out.max = xmll;
+	out.n = 0;
+
+	outs (&out, "<");
+	outs (&out, tag);
+	outs (&out, " device=\"");
+	outs (&out, dp->dev);
+	outs (&out, "\" name=\"");
+	outs (&out, dp->name);
+	outs (&out, "\"");
+	if (frame[12] != IBF_NOSTATE) {
+	    if (frame[12] > 3)
+		return (-1);
+	    outs (&out, " state=\"");
+	    outs (&out, pstates[frame[12]]);
+	    outs (&out, "\"");
+	}
+	if (dp->type != IBF_LIGHT && (frame[13] & IBF_HASTIMEOUT)) {
+	    char buf[32];
+	    double timeout;
+	    memcpy (&timeout, frame+32, 8);
+	    outs (&out, " timeout=\"");
+	    outn (&out, buf, snprintf (buf, sizeof(buf), "%g", timeout));
+	    outs (&out, "\"");
+	}
+	memcpy (&secs, frame+16, 8);
+	memcpy (&usecs, frame+24, 4);
+	outs (&out, " timestamp=\"");
+	outIso8601 (&out, secs, usecs);
+	outs (&out, "\">\r\n");
+
+	vp = frame + IBF_SETLEN;
+	end = frame + len;
+	for (i = 0; i < nelem; i++) {
+	    outs (&out, "\t<");
+	    outs (&out, eltag);
+	    outs (&out, " name=\"");
+	    outs (&out, dp->el[i]);
+	    outs (&out, "\">\r\n");
+
+	    if (vp >= end)
+		return (-1);
+	    switch (*vp++) {
+	    case IBF_VDOUBLE: {
+		char buf[32];
+		double v;
+		if (end - vp < 8 || dp->type != IBF_NUMBER)
+		    return (-1);
+		memcpy (&v, vp, 8);
+		vp += 8;
+		outn (&out, buf, snprintf (buf, sizeof(buf), "%.15g", v));
+		break;
+		}
+	    case IBF_VSTATE:
+		if (end - vp < 1)
+		    return (-1);
+		if (dp->type == IBF_SWITCH && *vp < 2)
+		    outs (&out, sstates[*vp]);
+		else if (dp->type == IBF_LIGHT && *vp < 4)
+		    outs (&out, lstates[*vp]);
+		else
+		    return (-1);
+		vp++;
+		break;
+	    case IBF_VTEXT: {
+		uint32_t l;
+		if (end - vp < 4)
+		    return (-1);
+		memcpy (&l, vp, 4);
+		vp += 4;
+		if ((uint32_t)(end - vp) < l)
+		    return (-1);
+		if (dp->type == IBF_TEXT)
+		    outSafe (&out, (const char *)vp, l);
+		else
+		    outn (&out, (const char *)vp, l);
+		vp += l;
+		break;
+		}
+	    default:
+		return (-1);
+	    }
+
+	    outs (&out, "\r\n\t</");
+	    outs (&out, eltag);
+	    outs (&out, ">\r\n");
+	}
+	if (vp != end)
+	    return (-1);
+
+	outs (&out, "</");
+	outs (&out, tag);
+	outs (&out, ">\r\n");
+
+	if (out.n < out.max)
+	    out.p[out.n] = '\0';
+	return (out.n);
+}
+
+/* add s[l] to op if it fits, always count it */
+static void
+outn (Out *op, const char *s, int l)
+{
+	if (op->n + l < op->max)
+	    memcpy (op->p + op->n, s, l);
+	op->n += l;
+}
+
+/* add string s to op */
+static void
+outs (Out *op, const char *s)
+{
+	outn (op, s, strlen(s));
+}
+
+/* add s[l] to op with each XML special character replaced by its entity */
+static void
+outSafe (Out *op, const char *s, int l)
+{
+	const char *end = s + l;
+
+	while (s < end) {
+	    const char *run = s;
+	    while (s < end && !strchr ("&<>'\"", *s))
+		s++;
+	    outn (op, run, s - run);
+	    if (s == end)
+		break;
+	    switch (*s++) {
+	    case '&':  outs (op, "&amp;");  break;
+	    case '<':  outs (op, "&lt;");   break;
+	    case '>':  outs (op, "&gt;");   break;
+	    case '\'': outs (op, "&apos;"); break;
+	    case '"':  outs (op, "&quot;"); break;
+	    default:   outn (op, s-1, 1);   break;	/* embedded nul */
+	    }
+	}
+}
+
+/* add the time as 2009-12-30T12:34:56.123456Z */
+static void
+outIso8601 (Out *op, int64_t secs, int32_t usecs)
+{
+	time_t t = (time_t) secs;
+	struct tm tm;
+	char buf[64];
+
+	if (!gmtime_r (&t, &tm)) {
+	    outs (op, "0000-00-00T00:00:00.000000Z");
+	    return;
+	}
+	outn (op, buf, snprintf (buf, sizeof(buf), "%04d-%02d-%02dT%02d:%02d:%02d.%06dZ",
+		1900 + tm.tm_year, 1 + tm.tm_mon, tm.tm_mday,
+		tm.tm_hour, tm.tm_min, tm.tm_sec, (int)usecs));
+}
@@ -0,0 +1,104 @@
+/* binary framing of set*Vector messages from a local driver to indiserver.
+ *
+ * A driver may send a set*Vector as a binary frame rather than XML text. The
+ * frames are mixed with ordinary XML on the same stream, each one starting,
+ * between XML messages, with IBF_MAGIC which can never start XML. Before the
+ * first SET frame for a property the driver sends a DEF frame which gives the
+ * property an id and lists its device, name, type and element names. SET
+ * frames then carry just the id, the state, timestamp, timeout and the element
+ * values in the order of the DEF. indiserver converts a SET to the same XML
+ * the driver would have written, but only if someone wants it.
+ *
+ * All integers and doubles are in host byte order since the driver and
+ * indiserver are always on the same machine. Every frame starts with:
+ *   0      IBF_MAGIC
+ *   1      IBF_DEF or IBF_SET
+ *   2-3    uint16 number of elements
+ *   4-7    uint32 total frame length, including this header
+ * DEF, which (re)assigns an id:
+ *   8-11   uint32 id, at most IBF_MAXID
+ *   12     property type, IBF_NUMBER, IBF_SWITCH, IBF_LIGHT or IBF_TEXT
+ *   13-15  unused
+ *   16-    device, name and each element name, each nul terminated
+ * SET:
+ *   8-11   uint32 id
+ *   12     state, 0 Idle 1 Ok 2 Busy 3 Alert, or IBF_NOSTATE
+ *   13     flags, IBF_HASTIMEOUT
+ *   14-15  unused
+ *   16-23  int64 timestamp, seconds since the epoch
+ *   24-27  int32 timestamp, microseconds
+ *   28-31  unused
+ *   32-39  double timeout, iff IBF_HASTIMEOUT
+ *   40-    each element value: one kind byte then
+ *            IBF_VDOUBLE  a double, written as %.15g
+ *            IBF_VSTATE   one byte, an index into the switch or light states
+ *            IBF_VTEXT    uint32 length then that many bytes of text
+ * A set*Vector with a message attribute is always sent as XML.
+ */
+
+#ifndef INDIBIN_H
+#define INDIBIN_H
+
+#define	IBF_MAGIC	0x01		/* first byte of each frame */
+#define	IBF_DEF		'D'		/* frame defines an id */
+#define	IBF_SET		'S'		/* frame sets the values of an id */
+#define	IBF_HDRLEN	8		/* bytes in the common header */
+#define	IBF_DEFLEN	16		/* bytes before the names of a DEF */
+#define	IBF_SETLEN	40		/* bytes before the values of a SET */
+#define	IBF_MAXLEN	(1<<20)		/* longest frame accepted */
+#define	IBF_MAXID	65535		/* largest id */
+
+#define	IBF_NUMBER	'n'		/* property types, in a DEF */
+#define	IBF_SWITCH	's'
+#define	IBF_LIGHT	'l'
+#define	IBF_TEXT	't'
+
+#define	IBF_VDOUBLE	'd'		/* element value kinds, in a SET */
+#define	IBF_VSTATE	'e'
+#define	IBF_VTEXT	't'
+
+#define	IBF_NOSTATE	0xff		/* no state attribute */
+#define	IBF_HASTIMEOUT	0x01		/* timeout is valid */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* one property as given by a DEF */
+typedef struct {
+    int type;				/* IBF_NUMBER etc */
+    int nelem;				/* n element names */
+    char *dev;				/* device, in buf */
+    char *name;				/* property name, in buf */
+    char **el;				/* malloced list of element names, in buf */
+    char *buf;				/* malloced copy of all the names */
+} IBFDef;
+
+/* length of the frame at buf[n] if its header is complete and sane,
+ * 0 if more bytes are needed, -1 if it is not a frame.
+ */
+extern int ibfFrameLen (const unsigned char *buf, int n);
+
+/* id of a DEF or SET frame */
+extern unsigned ibfId (const unsigned char *frame);
+
+/* fill dp from the DEF frame[len]. return 0 if ok, -1 if malformed.
+ * free with ibfFreeDef().
+ */
+extern int ibfReadDef (const unsigned char *frame, int len, IBFDef *dp);
+
+/* free the memory of a def filled by ibfReadDef() */
+extern void ibfFreeDef (IBFDef *dp);
+
+/* write the XML for the SET frame[len] of property dp into xml[xmll].
+ * return the length the XML needs, without the final nul, even if it is
+ * more than xmll-1 and so was not all written, or -1 if frame is malformed.
+ */
+extern int ibfSetXML (const IBFDef *dp, const unsigned char *frame, int len,
+    char *xml, int xmll);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INDIBIN_H */
@@ -39,6 +39,14 @@
  * copied or reformated from the parsed XML. Clients or drivers that get more
  * than maxqsiz bytes behind are forcibly shut down.
  *
+ * Before that, once a client is more than softqsiz bytes behind, each set*Vector
+ * queued to it replaces the previous set for the same device.property still
+ * waiting on its queue, so a slow client gets the latest values rather than
+ * every intermediate one. The newer set goes on the end of the queue as usual
+ * so def, del and message traffic keep their order. Sets carrying a message
+ * are never replaced. Each client has a small table of its newest queued set
+ * per property so this does not search the queue.
+ *
  * Mutexes:
  *  [] The overall list of clients is guarded by a rwlock as clients come and go.
  *  [] Each client structure contains a mutex to guard its queue of messages.
@@ -49,6 +57,27 @@
  *  [] Each message contains a mutex to guard its usage count.
  *  [] The log file is marshalled by a mutex.
  *
+ * Event loop mode (-e):
+ *
+ * Instead of the threads above, one thread waits on an epoll set holding the listen
+ * socket, each client socket and each driver's stdout, stderr and, while it has
+ * output waiting, stdin. All are non-blocking. Readers route messages as above
+ * except pushMsg only appends to the queue and marks the writer dirty. After each
+ * batch of events every dirty queue is written with writev(2), several messages
+ * per call. The usage count needs no mutex since only one thread touches it.
+ * Routing uses hash tables keyed by device instead of scanning every client and
+ * driver: one for what each client wants, one for what each driver snoops and one
+ * for the device served by each driver. Drivers that die are restarted from the
+ * loop using a timer rather than a sleeping thread.
+ *
+ * Binary frames:
+ *
+ * A local driver may send set*Vectors as the binary frames described in indibin.h,
+ * mixed with its XML. These are routed by the device and name of their id without
+ * parsing any XML. The frame is kept in its Msg until the first pushMsg of it, which
+ * replaces it with the same XML the driver would have sent, so nothing is converted
+ * if no client or snooping driver wants it and it is converted only once for all.
+ *
  */
 
 #include <stdio.h>
@@ -68,6 +97,8 @@
 #include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <netdb.h>
@@ -75,6 +106,7 @@
 
 #include "lilxml.h"
 #include "indiapi.h"
+#include "indibin.h"
 #include "fq.h"
 
 #define INDIPORT        7624            /* default TCP/IP port to listen */
@@ -85,36 +117,55 @@
 #define	RDRTIME		2		/* remote driver retry delay, secs */
 #define EXITEXFAIL	98		/* driver execlp failed */
 #define	RESTARTDT	10		/* don't restart a driver sooner than this, seconds */
+#define	EVMAXEVENTS	64		/* max epoll events handled per wait */
+#define	EVMAXIOV	64		/* max Msgs per writev, event loop mode */
+#define	EVHASHSIZ	1024		/* buckets in each routing table, power of 2 */
+#define	EVMAXFREE	64		/* max unused Msgs kept for reuse, event loop mode */
+#define	EVREAPMS	100		/* ms between checks for exited drivers, event loop mode */
+#define	DEFSOFTQSIZ	1		/* default q behind before coalescing sets, MB */
+#define	COALSIZ		256		/* slots in each client's table of queued sets, power of 2 */
 static char lockout_fn[] = "/tmp/noindi";	/* do not restart local driver if this exists */
 
+/* device + property name */
+typedef struct {
+    char dev[MAXINDIDEVICE];
+    char name[MAXINDINAME];
+} Property;
+
 /* associate a usage count with a single message queued to potentially multiple
  * drivers or clients.
  */
 typedef struct {
-    pthread_mutex_t count_lock;		/* lock whenever changing count */
+    pthread_mutex_t count_lock;		/* lock whenever changing count, unless evloop */
     int count;				/* number of consumers left */
     int total;				/* total space at cp[] */
     int used;				/* cp[] space actually in use */
     int next;				/* processing index into cp[] */
     char *cp;				/* content: buf at first then malloced for more */
+    Property set;			/* dev and name iff from a driver's set*Vector */
+    unsigned sethash;			/* setHash() of set, iff set.dev[0] */
+    int replaceable;			/* 1 if a newer set may replace this on a client q */
+    const IBFDef *bdef;			/* iff cp[bfrom..used) is a binary SET, not yet XML */
+    int bfrom;				/* start of binary SET in cp[], iff bdef */
     char buf[MAXRBUF];			/* local fast buf for most messages */
 } Msg;
 
 /* BLOB handling, NEVER is the default */
 typedef enum {B_NEVER=0, B_ALSO, B_ONLY} BLOBHandling;
 
-/* device + property name */
-typedef struct {
-    char dev[MAXINDIDEVICE];
-    char name[MAXINDINAME];
-} Property;
-
 /* record of each snooped property */
 typedef struct {
     Property prop;
     BLOBHandling blob;			/* when to snoop BLOBs */
 } Snoopee;
 
+/* what an epoll event refers to, event loop mode only */
+typedef enum {EV_LISTEN, EV_CLIENT, EV_DVRRD, EV_DVRWR, EV_DVRERR} EvKind;
+typedef struct {
+    EvKind kind;			/* which fd of owner */
+    void *owner;			/* ClInfo or DvrInfo, NULL for EV_LISTEN */
+} EvSource;
+
 /* info for each connected client.
  * clinfo is a list of pointers to ClInfo pointers so they don't move when list grows.
  * list never shrinks, but entries are reused via active.
@@ -135,6 +186,15 @@ typedef struct {
     FQ *msgq;				/* outbound Msg queue  -- guard with q_lock */
     pthread_cond_t go_cond;		/* tell writer thread to send next msqq */
     pthread_mutex_t q_lock;		/* guard access to msqg and go_cond */
+    EvSource ev;			/* epoll handle for s, iff evloop */
+    int qbytes;				/* bytes on msgq not yet written */
+    int coalescing;			/* 1 from more than softqsiz behind until caught up */
+    int ncoalesced;			/* n queued sets replaced by newer ones */
+    Msg *latest[COALSIZ];		/* newest replaceable set on msgq, by sethash */
+    int nsent;				/* bytes of head of msgq written, iff evloop */
+    int pollout;			/* 1 while waiting for s to be writable, iff evloop */
+    int dirty;				/* 1 while on evdirty list, iff evloop */
+    unsigned evgen;			/* evgen when last routed to, iff evloop */
 } ClInfo;
 static ClInfo **clinfo;			/* malloced pool of ptrs to malloced ClInfos */
 static int nclinfo;			/* n entries in clinfo */
@@ -161,11 +221,28 @@ typedef struct {
     time_t start;			/* time this driver was started */
     int restarts;			/* n times this process has been restarted */
     LilXML *lp;				/* XML parsing context */
+    int inxml;				/* 1 while part way through an XML message */
+    IBFDef *bdefs;			/* malloced binary frame defs, by id */
+    int nbdefs;				/* n entries in bdefs */
+    int askdefs;			/* 1 once asked again for defs after an unknown id */
     Msg *mp;				/* new incoming message */
     FQ *msgq;				/* outbound Msg queue  -- guard with q_lock */
     pthread_cond_t go_cond;		/* tell writer thread to send next msqq */
     pthread_mutex_t q_lock;		/* guard access to msqg and go_cond */
     pthread_rwlock_t restart_lock;	/* lock out this device while restarting */
+    int efd;				/* driver's stderr read pipe fd, iff local and evloop */
+    char *ebuf;				/* partial stderr line, iff evloop */
+    int nebuf;				/* n chars in ebuf */
+    EvSource evrd, evwr, everr;		/* epoll handles for rfd, wfd, efd, iff evloop */
+    int qbytes;				/* bytes on msgq not yet written, iff evloop */
+    int nsent;				/* bytes of head of msgq written, iff evloop */
+    int pollout;			/* 1 while waiting for wfd to be writable, iff evloop */
+    int dirty;				/* 1 while on evdirty list, iff evloop */
+    unsigned evgen;			/* evgen when last routed to, iff evloop */
+    int running;			/* 1 from start until error, iff evloop */
+    int devknown;			/* 1 once dev is in evdvtab, iff evloop */
+    int retry;				/* 1 if last start must be retried, iff evloop */
+    time_t restart_at;			/* when to try starting again, else 0, iff evloop */
 } DvrInfo;
 static DvrInfo *dvrinfo;		/* malloced array of DvrInfo */
 static int ndvrinfo;			/* n total */
@@ -179,8 +256,46 @@ static int lsocket;			/* master listen() socket */
 static char *ldir;			/* log directory f -l */
 static pthread_mutex_t log_lock;	/* lock when writing to our error log */
 static int maxqsiz = (DEFMAXQSIZ*1024*1024); /* kill if these many bytes behind */
+static int softqsiz = (DEFSOFTQSIZ*1024*1024); /* coalesce sets to clients these many bytes behind */
 static int ignore_lockout;              /* whether to honor lockout_fn */
 
+/* one routing entry in event loop mode: client cp wants dev.name, driver dp
+ * snoops dev.name via sp, or driver dp serves dev. Entries live in the bucket
+ * for dev, in the order they were added.
+ */
+typedef struct _EvSub {
+    struct _EvSub *next;		/* next in same bucket */
+    Property prop;			/* dev and name, either may be "" */
+    int isblob;				/* from cp->blobs[] rather than cp->props[] */
+    ClInfo *cp;				/* interested client, or */
+    DvrInfo *dp;			/* snooping or serving driver */
+    Snoopee *sp;			/* dp's snoop record, iff snooping */
+} EvSub;
+
+/* event loop mode variables */
+static int evloop;			/* 1 to use evLoop() rather than threads */
+static int epfd;			/* epoll set */
+static EvSource evlisten;		/* epoll handle for lsocket */
+static EvSource **evdirty;		/* malloced list of writers with new output or errors */
+static int nevdirty, mevdirty;		/* n used and n malloced in evdirty */
+static unsigned evgen;			/* incremented for each routed message */
+static EvSub *evcltab[EVHASHSIZ];	/* what clients want, by dev */
+static EvSub *evsntab[EVHASHSIZ];	/* what drivers snoop, by dev */
+static EvSub *evdvtab[EVHASHSIZ];	/* which driver serves each dev */
+static int evnodev;			/* n drivers whose dev is not yet known */
+static int evnrestart;			/* n drivers with restart_at set */
+static Msg *evfree[EVMAXFREE];		/* unused Msgs kept for reuse */
+static int nevfree;			/* n entries in evfree */
+
+/* a stopped local driver process not yet reaped, event loop mode */
+typedef struct {
+    DvrInfo *dp;			/* driver, for its name */
+    int pid;				/* process to reap */
+    time_t kill_at;			/* when to SIGKILL, 0 once sent */
+} EvReap;
+static EvReap *evreap;			/* malloced list of processes to reap */
+static int nevreap, mevreap;		/* n used and n malloced in evreap */
+
 /* local prototypes */
 static void logDrivers (int ac, char *av[]);
 static void usage (void);
@@ -193,11 +308,14 @@ static void shutdownClient (ClInfo *cp);
 static void initDvr (DvrInfo *dp, char *name);
 static void startDvr (DvrInfo *dp);
 static void *startDvrThread (void *dp);
-static void startLocalDvr (DvrInfo *dp);
-static void startRemoteDvr (DvrInfo *dp);
+static int startLocalDvr (DvrInfo *dp);
+static int startRemoteDvr (DvrInfo *dp);
 static int openRemoteConnection (char host[], int port);
 static void restartDvr (DvrInfo *dp);
+static void closeDvr (DvrInfo *dp);
+static void logDvrExit (DvrInfo *dp, int status);
 static void q2Drivers (char *dev, Msg *mp, char *roottag);
+static void q2Dvr (DvrInfo *dp, Msg *mp, int isggp);
 static void q2SnoopingDrivers (int isblob, char *dev, char *name, Msg *mp);
 static void q2Clients (ClInfo *notme, int isblob, char *dev, char *name, Msg *mp);
 static void addSnoopDevice (DvrInfo *dp, char *dev, char *name);;
@@ -206,6 +324,11 @@ static void addClDevice (ClInfo *cp, int isblob, char *dev, char *name);
 static void rmClDevice (ClInfo *cp, int isblob, char *dev, char *name);
 static int findClDevice (ClInfo *cp, int isblob, char *dev, char *name);
 static void logMsg (const char *label, DvrInfo *dp, ClInfo *cp, Msg *mp);
+static ClInfo *newClInfo (int s);
+static int readClient (ClInfo *cp);
+static int readDriver (DvrInfo *dp);
+static int readDvrFrame (DvrInfo *dp);
+static void binMsgXML (Msg *mp);
 static void *driverStdoutReaderThread (void *);
 static void *driverStderrReaderThread (void *);
 static void *driverWriterThread (void *);
@@ -215,6 +338,9 @@ static void onDriverError (DvrInfo *dp);
 static void onClientError (ClInfo *cp);
 static int pushMsg (DvrInfo *dp, ClInfo *cp, Msg *mp);
 static int msgQSize (FQ *q);
+static void coalesceMsg (ClInfo *cp, Msg *mp);
+static void clMsgSent (ClInfo *cp, Msg *mp);
+static unsigned setHash (const char *dev, const char *name);
 static void decMsg (Msg *mp);
 static void minMsg (Msg *mp, int add);
 static Msg *splitMsg (Msg *mp, int keep);
@@ -230,6 +356,32 @@ static void logMessage (const char *fmt, ...);
 static char *strncpyz (char *dst, const char *src, int n);
 static void ssleep (int ms);
 static void Bye(const char *fmt, ...);
+static void evInit (void);
+static void evLoop (void);
+static int evTimeout (void);
+static void evRestarts (void);
+static void evAddReap (DvrInfo *dp);
+static void evReap (void);
+static void evNewClients (void);
+static void evAddDvr (DvrInfo *dp, int efd);
+static void evStartDvr (DvrInfo *dp);
+static void evStopDvr (DvrInfo *dp);
+static void evSchedule (DvrInfo *dp, time_t when);
+static void evSetDvrDev (DvrInfo *dp);
+static void evReadStderr (DvrInfo *dp);
+static void evMarkDirty (EvSource *ep);
+static void evFlush (void);
+static int evWriteQ (DvrInfo *dp, ClInfo *cp);
+static void evPollOut (DvrInfo *dp, ClInfo *cp, int on);
+static void evNonBlock (int fd);
+static void evQ2Drivers (char *dev, Msg *mp, int isggp);
+static void evQ2SnoopingDrivers (int isblob, char *dev, char *name, Msg *mp);
+static void evQ2Clients (ClInfo *notme, int isblob, char *dev, char *name, Msg *mp);
+static unsigned evHash (const char *dev);
+static void evAddSub (EvSub **tab, const char *dev, const char *name, int isblob,
+	ClInfo *cp, DvrInfo *dp, Snoopee *sp);
+static void evRmSub (EvSub **tab, const char *dev, const char *name, int isblob,
+	ClInfo *cp, DvrInfo *dp);
 
 int
 main (int ac, char *av[])
@@ -242,6 +394,17 @@ main (int ac, char *av[])
 	    char *s;
 	    for (s = av[0]+1; *s != '\0'; s++)
 		switch (*s) {
+		case 'c':
+		    if (ac < 2) {
+			fprintf (stderr, "-c requires MB behind\n");
+			usage();
+		    }
+		    softqsiz = (int)(1024*1024*atof(*++av));
+		    ac--;
+		    break;
+		case 'e':
+		    evloop++;
+		    break;
 		case 'l':
 		    if (ac < 2) {
 			fprintf (stderr, "-l requires log directory\n");
@@ -306,12 +469,21 @@ main (int ac, char *av[])
 	/* announce we are online before starting remote drivers */
 	indiListen();
 
+	/* prepare the epoll set, if using it */
+	if (evloop)
+	    evInit();
+
 	/* start each driver */
 	ndvrinfo = ac;
 	dvrinfo = (DvrInfo *) calloc (ndvrinfo, sizeof(DvrInfo));
+	evnodev = ndvrinfo;
 	while (ac-- > 0)
 	    initDvr (&dvrinfo[ac], *av++);
 
+	/* handle everything from one thread forever */
+	if (evloop)
+	    evLoop();
+
 	/* handle new clients forever */
 	while (1)
 	    newClient();
@@ -342,6 +514,8 @@ usage(void)
 	fprintf (stderr,"Purpose: server for local and remote INDI drivers\n");
 	fprintf (stderr,"Code %s. Protocol %g.\n", "$Revision: 1.18 $", INDIV);
 	fprintf (stderr,"Options:\n");
+	fprintf (stderr," -c c  : coalesce sets to client more than this many MB behind, 0 never, default %d\n", DEFSOFTQSIZ);
+	fprintf (stderr," -e    : use one epoll event loop rather than threads per client and driver\n");
 	fprintf (stderr," -l d  : log messages to <d>/YYYY-MM-DD.islog, else stderr\n");
 	fprintf (stderr," -m m  : kill client if gets more than this many MB behind, default %d\n", DEFMAXQSIZ);
 	fprintf (stderr," -n    : ignore %s\n", lockout_fn);
@@ -387,12 +561,19 @@ initDvr (DvrInfo *dp, char *name)
 	pthread_attr_t attr;
 	pthread_t thr;
 
-	/* save name */
+	/* save name, no stderr fd except in evloop mode */
 	dp->name = name;
+	dp->efd = -1;
 
 	/* init this thread's restart lock */
 	pthread_rwlock_init (&dp->restart_lock, NULL);
 
+	/* event loop starts it directly, or later if it must */
+	if (evloop) {
+	    evStartDvr (dp);
+	    return;
+	}
+
 	/* new thread will be detached so we need no join */
 	if (pthread_attr_init (&attr))
 	    Bye ("Driver %s attr init: %s\n", dp->name, strerror(errno));
@@ -438,16 +619,16 @@ startDvr (DvrInfo *dp)
 	dp->start = time(NULL);
 
 	if (strchr (dp->name, '@'))
-	    startRemoteDvr (dp);
+	    (void) startRemoteDvr (dp);
 	else
-	    startLocalDvr (dp);
+	    (void) startLocalDvr (dp);
 }
 
 /* start the given local INDI driver process.
- * exit if trouble.
+ * exit if trouble. return 0 if started, -1 if evloop must try again later.
  * N.B. we assume restart_lock is already write-locked.
  */
-static void
+static int
 startLocalDvr (DvrInfo *dp)
 {
 	pthread_attr_t attr;
@@ -462,6 +643,8 @@ startLocalDvr (DvrInfo *dp)
 	while (!ignore_lockout && (fp = fopen (lockout_fn, "r")) != NULL) {
 	    fclose (fp);
 	    logMessage ("Sleeping %d secs because %s exists\n", RDRTIME, lockout_fn);
+	    if (evloop)
+		return (-1);
 	    ssleep (RDRTIME*1000);
 	}
 
@@ -503,9 +686,10 @@ startLocalDvr (DvrInfo *dp)
 	dp->pid = pid;
 	dp->rfd = rp[0];
 	dp->wfd = wp[1];
-	dp->efp = fdopen (ep[0], "r");
+	dp->efp = evloop ? NULL : fdopen (ep[0], "r");
 	dp->err = 0;
 	dp->lp = newLilXML();
+	dp->inxml = 0;
 	dp->mp = newMsg();
 	dp->msgq = newFQ(1);
 	pthread_mutex_init (&dp->q_lock, NULL);
@@ -520,20 +704,24 @@ startLocalDvr (DvrInfo *dp)
 	    logMessage ("Driver %s: pid=%d rfd=%d wfd=%d efd=%d\n",
 			    dp->name, dp->pid, dp->rfd, dp->wfd, ep[0]);
 
-	/* start detached threads */
-	if (pthread_attr_init (&attr))
-	    Bye ("Driver %s attr init: %s\n", dp->name, strerror(errno));
-	if (pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED))
-	    Bye ("Driver %s setdetacthed: %s\n", dp->name, strerror(errno));
-	(void) pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
-	if (pthread_create (&thr, &attr, driverStdoutReaderThread, dp))
-	    Bye ("Driver %s stdout thread: %s\n", dp->name, strerror(errno));
-	if (pthread_create (&dp->stderr_thr, &attr, driverStderrReaderThread, dp))
-	    Bye ("Driver %s stderr thread: %s\n", dp->name, strerror(errno));
-	if (pthread_create (&thr, &attr, driverWriterThread, dp))
-	    Bye ("Driver %s stdin thread: %s\n", dp->name, strerror(errno));
-	if (pthread_attr_destroy (&attr))
-	    Bye ("Driver %s attr destroy: %s\n", dp->name, strerror(errno));
+	/* add to epoll set, or start detached threads */
+	if (evloop)
+	    evAddDvr (dp, ep[0]);
+	else {
+	    if (pthread_attr_init (&attr))
+		Bye ("Driver %s attr init: %s\n", dp->name, strerror(errno));
+	    if (pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED))
+		Bye ("Driver %s setdetacthed: %s\n", dp->name, strerror(errno));
+	    (void) pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
+	    if (pthread_create (&thr, &attr, driverStdoutReaderThread, dp))
+		Bye ("Driver %s stdout thread: %s\n", dp->name, strerror(errno));
+	    if (pthread_create (&dp->stderr_thr, &attr, driverStderrReaderThread, dp))
+		Bye ("Driver %s stderr thread: %s\n", dp->name, strerror(errno));
+	    if (pthread_create (&thr, &attr, driverWriterThread, dp))
+		Bye ("Driver %s stdin thread: %s\n", dp->name, strerror(errno));
+	    if (pthread_attr_destroy (&attr))
+		Bye ("Driver %s attr destroy: %s\n", dp->name, strerror(errno));
+	}
 
 	/* first message primes driver to report its properties -- dev already
 	 * known if just restarting
@@ -546,13 +734,16 @@ startLocalDvr (DvrInfo *dp)
 	addMsg (mp, buf, l);
 	(void) pushMsg (dp, NULL, mp);
 	decMsg (mp);
+
+	return (0);
 }
 
 /* start the given remote INDI driver connection.
  * repeat until socket opens ok, loop only blocks this thread.
+ * in evloop mode just try once: return 0 if started, -1 to try again later.
  * N.B. we assume restart_lock is already write-locked.
  */
-static void
+static int
 startRemoteDvr (DvrInfo *dp)
 {
 	pthread_attr_t attr;
@@ -575,6 +766,8 @@ startRemoteDvr (DvrInfo *dp)
 	    sockfd = openRemoteConnection (host, port);
 	    if (sockfd < 0) {
 	        logMessage ("Sleeping %d secs to retry %s\n", RDRTIME, dp->name);
+		if (evloop)
+		    return (-1);
 		ssleep (RDRTIME*1000);
 	    } else
 		break;
@@ -589,6 +782,7 @@ startRemoteDvr (DvrInfo *dp)
 	dp->wfd = sockfd;
 	dp->err = 0;
 	dp->lp = newLilXML();
+	dp->inxml = 0;
 	dp->mp = newMsg();
 	dp->msgq = newFQ(1);
 	pthread_mutex_init (&dp->q_lock, NULL);
@@ -606,18 +800,23 @@ startRemoteDvr (DvrInfo *dp)
 
 	logMessage ("Driver %s at %s now connected on socket=%d\n", dp->name, dp->addrname, sockfd);
 
-	/* start detached threads */
-	if (pthread_attr_init (&attr))
-	    Bye ("Driver %s attr init: %s\n", dp->name, strerror(errno));
-	if (pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED))
-	    Bye ("Driver %s setdetacthed: %s\n", dp->name, strerror(errno));
-	(void) pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
-	if (pthread_create (&thr, &attr, driverStdoutReaderThread, dp))
-	    Bye ("Driver %s stdout thread: %s\n", dp->name, strerror(errno));
-	if (pthread_create (&thr, &attr, driverWriterThread, dp))
-	    Bye ("Driver %s stdin thread: %s\n", dp->name, strerror(errno));
-	if (pthread_attr_destroy (&attr))
-	    Bye ("Driver %s attr destroy: %s\n", dp->name, strerror(errno));
+	/* add to epoll set, or start detached threads */
+	if (evloop) {
+	    evSetDvrDev (dp);
+	    evAddDvr (dp, -1);
+	} else {
+	    if (pthread_attr_init (&attr))
+		Bye ("Driver %s attr init: %s\n", dp->name, strerror(errno));
+	    if (pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED))
+		Bye ("Driver %s setdetacthed: %s\n", dp->name, strerror(errno));
+	    (void) pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
+	    if (pthread_create (&thr, &attr, driverStdoutReaderThread, dp))
+		Bye ("Driver %s stdout thread: %s\n", dp->name, strerror(errno));
+	    if (pthread_create (&thr, &attr, driverWriterThread, dp))
+		Bye ("Driver %s stdin thread: %s\n", dp->name, strerror(errno));
+	    if (pthread_attr_destroy (&attr))
+		Bye ("Driver %s attr destroy: %s\n", dp->name, strerror(errno));
+	}
 
 	/* Sending getProperties with device lets remote server limit its
 	 * outbound (and our inbound) traffic on this socket to this device.
@@ -636,6 +835,8 @@ startRemoteDvr (DvrInfo *dp)
 	addMsg (mp, buf, l);
 	(void) pushMsg (dp, NULL, mp);
 	decMsg(mp);
+
+	return (0);
 }
 
 /* connect to a remote driver, probably an indiserver but could be a socket-based driver,
@@ -756,12 +957,34 @@ newClient()
 {
 	pthread_attr_t attr;
 	pthread_t thr;
+	ClInfo *cp;
+
+	/* assign new socket and clinfo entry */
+	cp = newClInfo (newClSocket ());
+
+	/* start detached threads */
+	if (pthread_attr_init (&attr))
+	    Bye ("Client attr init: %s\n", strerror(errno));
+	if (pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED))
+	    Bye ("Client setdetacthed: %s\n", strerror(errno));
+	(void) pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
+	if (pthread_create (&thr, &attr, clientReaderThread, cp))
+	    Bye ("Client read thread: %s\n", strerror(errno));
+	if (pthread_create (&thr, &attr, clientWriterThread, cp))
+	    Bye ("Client write thread: %s\n", strerror(errno));
+	if (pthread_attr_destroy (&attr))
+	    Bye ("Client attr destroy: %s\n", strerror(errno));
+}
+
+/* find or make a free clinfo entry and set it up for a new client on socket s.
+ * exit if trouble.
+ */
+static ClInfo *
+newClInfo (int s)
+{
 	ClInfo *cp = NULL;
 	socklen_t len = sizeof(struct sockaddr_in);
-	int s, i;
-
-	/* assign new socket */
-	s = newClSocket ();
+	int i;
 
 	/* lock clinfo for changes */
 	pthread_rwlock_wrlock (&cl_rwlock);
@@ -815,18 +1038,7 @@ newClient()
 			cp->s, cp->addrname, ntohs(cp->addr.sin_port));
 	}
 
-	/* start detached threads */
-	if (pthread_attr_init (&attr))
-	    Bye ("Client attr init: %s\n", strerror(errno));
-	if (pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED))
-	    Bye ("Client setdetacthed: %s\n", strerror(errno));
-	(void) pthread_attr_setscope(&attr, PTHREAD_SCOPE_SYSTEM);
-	if (pthread_create (&thr, &attr, clientReaderThread, cp))
-	    Bye ("Client read thread: %s\n", strerror(errno));
-	if (pthread_create (&thr, &attr, clientWriterThread, cp))
-	    Bye ("Client write thread: %s\n", strerror(errno));
-	if (pthread_attr_destroy (&attr))
-	    Bye ("Client attr destroy: %s\n", strerror(errno));
+	return (cp);
 }
 
 /* block to accept a new client arriving on lsocket.
@@ -849,100 +1061,114 @@ newClSocket ()
 	return (cli_fd);
 }
 
-/* thread to read from the given client, send to each appropriate driver when see
- * xml closure. also send all newXXX() to all other interested clients.
+/* thread to read from the given client until it disconnects.
  * if trouble signal clientWriterThread and return.
  */
 static void *
 clientReaderThread (void *vp)
 {
 	ClInfo *cp = (ClInfo *)vp;
-	int i, nr;
 
-	/* read until client disconnects */
 	while (1) {
-	    /* insure more message space */
-	    minMsg (cp->mp, MAXRBUF);
-
-	    /* read more from client directly into cp->mp */
-	    nr = read (cp->s, cp->mp->cp + cp->mp->used, cp->mp->total - cp->mp->used);
-	    if (nr <= 0) {
-		if (nr < 0)
-		    logMessage ("from Client %d: read error: %s\n", cp->s, strerror(errno));
-		else if (verbose > 0)
-		    logMessage ("from Client %d: read EOF\n", cp->s);
+	    if (readClient (cp) < 0) {
 		onClientError (cp);
 		return (NULL);	/* thread exit */
 	    }
-	    cp->mp->used += nr;
-
-	    /* process XML, sending when find closure */
-	    for (i = 0; i < nr; i++) {
-		char err[1024];
-		XMLEle *root = readXMLEle (cp->lp, cp->mp->cp[cp->mp->next++], err);
-		if (root) {
-		    /* found new complete message */
-
-		    char *roottag = tagXMLEle(root);
-		    char *dev = findXMLAttValu (root, "device");
-		    char *name = findXMLAttValu (root, "name");
-		    int isblob = !strcmp (roottag, "setBLOBVector");
-		    Msg *newmp;
-
-		    /* keep the good part and start a new msg with remaining */
-		    newmp = splitMsg (cp->mp, cp->mp->next);
-
-		    if (verbose > 3) {
-			logMessage ("from Client %d: read:\n", cp->s);
-			traceMsg (root);
-		    } else if (verbose > 2) {
-			logMessage ("from Client %d: read <%s device='%s' name='%s'>\n",
-					cp->s, roottag, dev, name);
-		    } else if (verbose > 1)
-			logMsg ("from", NULL, cp, cp->mp);
-
-		    /* enableBLOB control is just handled locally. */
-		    if (!strcmp (roottag, "enableBLOB")) {
-			BLOBHandling bh;
-			crackBLOB (pcdataXMLEle(root), &bh);
-			if (bh == B_ALSO || bh == B_ONLY)
-			    addClDevice (cp, 1, dev, name);
-			else
-			    rmClDevice (cp, 1, dev, name);
-			goto done;
-		    }
+	}
+
+	/* for lint */
+	return (NULL);
+}
+
+/* read once from the given client, send to each appropriate driver when see
+ * xml closure. also send all newXXX() to all other interested clients.
+ * return 0 if ok (including nothing to read in evloop mode), -1 if trouble.
+ */
+static int
+readClient (ClInfo *cp)
+{
+	int i, nr;
+
+	/* insure more message space */
+	minMsg (cp->mp, MAXRBUF);
+
+	/* read more from client directly into cp->mp */
+	nr = read (cp->s, cp->mp->cp + cp->mp->used, cp->mp->total - cp->mp->used);
+	if (nr <= 0) {
+	    if (nr < 0 && evloop && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+		return (0);
+	    if (nr < 0)
+		logMessage ("from Client %d: read error: %s\n", cp->s, strerror(errno));
+	    else if (verbose > 0)
+		logMessage ("from Client %d: read EOF\n", cp->s);
+	    return (-1);
+	}
+	cp->mp->used += nr;
+
+	/* process XML, sending when find closure */
+	for (i = 0; i < nr; i++) {
+	    char err[1024];
+	    XMLEle *root = readXMLEle (cp->lp, cp->mp->cp[cp->mp->next++], err);
+	    if (root) {
+		/* found new complete message */
+
+		char *roottag = tagXMLEle(root);
+		char *dev = findXMLAttValu (root, "device");
+		char *name = findXMLAttValu (root, "name");
+		int isblob = !strcmp (roottag, "setBLOBVector");
+		Msg *newmp;
+
+		/* keep the good part and start a new msg with remaining */
+		newmp = splitMsg (cp->mp, cp->mp->next);
+
+		if (verbose > 3) {
+		    logMessage ("from Client %d: read:\n", cp->s);
+		    traceMsg (root);
+		} else if (verbose > 2) {
+		    logMessage ("from Client %d: read <%s device='%s' name='%s'>\n",
+				    cp->s, roottag, dev, name);
+		} else if (verbose > 1)
+		    logMsg ("from", NULL, cp, cp->mp);
+
+		/* enableBLOB control is just handled locally. */
+		if (!strcmp (roottag, "enableBLOB")) {
+		    BLOBHandling bh;
+		    crackBLOB (pcdataXMLEle(root), &bh);
+		    if (bh == B_ALSO || bh == B_ONLY)
+			addClDevice (cp, 1, dev, name);
+		    else
+			rmClDevice (cp, 1, dev, name);
+		    goto done;
+		}
 
-		    /* snag interested properties */
-		    addClDevice (cp, 0, dev, name);
+		/* snag interested properties */
+		addClDevice (cp, 0, dev, name);
 
-		    /* send message to driver(s) responsible for dev */
-		    q2Drivers (dev, cp->mp, roottag);
+		/* send message to driver(s) responsible for dev */
+		q2Drivers (dev, cp->mp, roottag);
 
-		    /* echo new* commands back to other clients */
-		    if (!strncmp (roottag, "new", 3))
-			q2Clients (cp, isblob, dev, name, cp->mp);
+		/* echo new* commands back to other clients */
+		if (!strncmp (roottag, "new", 3))
+		    q2Clients (cp, isblob, dev, name, cp->mp);
 
-		  done:
+	      done:
 
-		    /* we're done with this msg here */
-		    decMsg (cp->mp);
+		/* we're done with this msg here */
+		decMsg (cp->mp);
 
-		    /* continue with newmp */
-		    cp->mp = newmp;
+		/* continue with newmp */
+		cp->mp = newmp;
 
-		    /* done with root */
-		    delXMLEle (root);
+		/* done with root */
+		delXMLEle (root);
 
-		} else if (err[0]) {
-		    logMessage ("from Client %d: XML error: %s\n", cp->s, err);
-		    onClientError (cp);
-		    return (NULL);	/* thread exit */
-		}
+	    } else if (err[0]) {
+		logMessage ("from Client %d: XML error: %s\n", cp->s, err);
+		return (-1);
 	    }
 	}
 
-	/* for lint */
-	return (NULL);
+	return (0);
 }
 
 /* thread to send Msgs to the given client.
@@ -978,6 +1204,8 @@ clientWriterThread (void *vp)
 		mp = (Msg *) popFQ (cp->msgq);
 		if (!mp)
 		    Bye ("Bug! Client %d message queue is empty!\n", cp->s);
+		cp->qbytes -= mp->used + 1;
+		clMsgSent (cp, mp);
 		if (verbose > 1)
 		    logMsg ("send to", NULL, cp, mp);
 
@@ -1020,108 +1248,280 @@ clientWriterThread (void *vp)
 }
 
 /* thread to read from the given local driver's stdout or remote driver's socket.
- * send messages to each interested client when see xml closure.
  * if trouble signal driverWriterThread and return/exit.
  */
 static void *
 driverStdoutReaderThread (void *vp)
 {
 	DvrInfo *dp = (DvrInfo *)vp;
-	int i, nr;
 
 	while (1) {
-	    /* insure more message space */
-	    minMsg (dp->mp, MAXRBUF);
-
-	    /* read more from driver */
-	    nr = read (dp->rfd, dp->mp->cp + dp->mp->used, dp->mp->total - dp->mp->used);
-	    if (nr <= 0) {
-		if (nr < 0)
-		    logMessage ("from Driver %s: stdin %s\n", dp->name, strerror(errno));
-		else
-		    logMessage ("from Driver %s: stdin EOF\n", dp->name);
+	    if (readDriver (dp) < 0) {
 		onDriverError (dp);
 		return (NULL);	/* thread exit */
 	    }
-	    dp->mp->used += nr;
-
-	    /* process XML, sending when find closure */
-	    for (i = 0; i < nr; i++) {
-		char err[1024];
-		XMLEle *root = readXMLEle (dp->lp, dp->mp->cp[dp->mp->next++], err);
-		if (root) {
-		    /* found new complete message */
-
-		    char *roottag = tagXMLEle(root);
-		    char *dev = findXMLAttValu (root, "device");
-		    char *name = findXMLAttValu (root, "name");
-		    int isblob = !strcmp (roottag, "setBLOBVector");
-		    Msg *newmp;
-
-		    /* keep the good part and start a new msg with remaining */
-		    newmp = splitMsg (dp->mp, dp->mp->next);
-
-		    if (verbose > 3) {
-			logMessage ("from Driver %s: read:\n", dp->name);
-			traceMsg (root);
-		    } else if (verbose > 2) {
-			logMessage ("from Driver %s: read <%s device='%s' name='%s'>\n",
-					dp->name, roottag, dev, name);
-		    } else if (verbose > 1)
-			logMsg ("from", dp, NULL, dp->mp);
-
-		    /* that's all if driver is just registering a snoop */
-		    if (!strcmp (roottag, "getProperties")) {
-			addSnoopDevice (dp, dev, name);
-                        q2Drivers (dev, dp->mp, roottag);        // force initial report
-			goto done;
-		    }
+	}
 
-		    /* that's all if driver is just registering a BLOB mode */
-		    if (!strcmp (roottag, "enableBLOB")) {
-			Snoopee *sp = findSnoopDevice (dp, dev, name);
-			if (sp)
-			    crackBLOB (pcdataXMLEle (root), &sp->blob);
-			goto done;
-		    }
+	/* for lint */
+	return (NULL);
+}
 
-		    /* snag device name if not known yet */
-		    if (!dp->dev[0] && dev[0]) {
-			strncpyz (dp->dev, dev, MAXINDIDEVICE-1);
-			if (verbose > 1)
-			    logMessage ("Driver %s snooping for %s\n", dp->name, dp->dev);
-		    }
+/* read once from the given local driver's stdout or remote driver's socket.
+ * send messages to each interested client when see xml closure.
+ * return 0 if ok (including nothing to read in evloop mode), -1 if trouble.
+ */
+static int
+readDriver (DvrInfo *dp)
+{
+	int nr;
+
+	/* insure more message space */
+	minMsg (dp->mp, MAXRBUF);
+
+	/* read more from driver */
+	nr = read (dp->rfd, dp->mp->cp + dp->mp->used, dp->mp->total - dp->mp->used);
+	if (nr <= 0) {
+	    if (nr < 0 && evloop && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+		return (0);
+	    if (nr < 0)
+		logMessage ("from Driver %s: stdin %s\n", dp->name, strerror(errno));
+	    else
+		logMessage ("from Driver %s: stdin EOF\n", dp->name);
+	    return (-1);
+	}
+	dp->mp->used += nr;
+
+	/* process XML and binary frames, sending when find closure */
+	while (dp->mp->next < dp->mp->used) {
+	    char err[1024];
+	    char c = dp->mp->cp[dp->mp->next];
+	    XMLEle *root;
+
+	    /* binary frames start between XML messages, may need more to finish */
+	    if (!dp->inxml && (unsigned char)c == IBF_MAGIC) {
+		int ok = readDvrFrame (dp);
+		if (ok < 0)
+		    return (-1);
+		if (ok == 0)
+		    break;
+		continue;
+	    }
+	    if (!isspace (c))
+		dp->inxml = 1;
+
+	    root = readXMLEle (dp->lp, dp->mp->cp[dp->mp->next++], err);
+	    if (root) {
+		/* found new complete message */
+
+		char *roottag = tagXMLEle(root);
+		char *dev = findXMLAttValu (root, "device");
+		char *name = findXMLAttValu (root, "name");
+		int isblob = !strcmp (roottag, "setBLOBVector");
+		Msg *newmp;
+
+		/* keep the good part and start a new msg with remaining */
+		newmp = splitMsg (dp->mp, dp->mp->next);
+		dp->inxml = 0;
+
+		if (verbose > 3) {
+		    logMessage ("from Driver %s: read:\n", dp->name);
+		    traceMsg (root);
+		} else if (verbose > 2) {
+		    logMessage ("from Driver %s: read <%s device='%s' name='%s'>\n",
+				    dp->name, roottag, dev, name);
+		} else if (verbose > 1)
+		    logMsg ("from", dp, NULL, dp->mp);
+
+		/* that's all if driver is just registering a snoop */
+		if (!strcmp (roottag, "getProperties")) {
+		    addSnoopDevice (dp, dev, name);
+		    q2Drivers (dev, dp->mp, roottag);        // force initial report
+		    goto done;
+		}
+
+		/* that's all if driver is just registering a BLOB mode */
+		if (!strcmp (roottag, "enableBLOB")) {
+		    Snoopee *sp = findSnoopDevice (dp, dev, name);
+		    if (sp)
+			crackBLOB (pcdataXMLEle (root), &sp->blob);
+		    goto done;
+		}
 
-		    /* log messages if any */
-		    logDvrMsg (root, dev);
+		/* snag device name if not known yet */
+		if (!dp->dev[0] && dev[0]) {
+		    strncpyz (dp->dev, dev, MAXINDIDEVICE-1);
+		    if (evloop)
+			evSetDvrDev (dp);
+		    if (verbose > 1)
+			logMessage ("Driver %s snooping for %s\n", dp->name, dp->dev);
+		}
+
+		/* log messages if any */
+		logDvrMsg (root, dev);
 
-		    /* send to interested clients */
-		    q2Clients (NULL, isblob, dev, name, dp->mp);
+		/* note which property a set is for so a newer one may replace it */
+		if (softqsiz > 0 && dev[0] && !strncmp (roottag, "set", 3)) {
+		    Msg *mp = dp->mp;
+		    strncpyz (mp->set.dev, dev, MAXINDIDEVICE-1);
+		    strncpyz (mp->set.name, name, MAXINDINAME-1);
+		    mp->sethash = setHash (dev, name);
+		    mp->replaceable = !findXMLAtt (root, "message");
+		}
 
-		    /* send to snooping drivers */
-		    q2SnoopingDrivers (isblob, dev, name, dp->mp);
+		/* send to interested clients */
+		q2Clients (NULL, isblob, dev, name, dp->mp);
 
-		done:
+		/* send to snooping drivers */
+		q2SnoopingDrivers (isblob, dev, name, dp->mp);
 
-		    /* we're done with this msg here */
-		    decMsg (dp->mp);
+	    done:
 
-		    /* continue with newmp */
-		    dp->mp = newmp;
+		/* we're done with this msg here */
+		decMsg (dp->mp);
 
-		    /* done with root */
-		    delXMLEle (root);
+		/* continue with newmp */
+		dp->mp = newmp;
 
-		} else if (err[0]) {
-		    logMessage ("Driver %s: XML error: %s\n", dp->name, err);
-		    onDriverError (dp);
-		    return (NULL);	/* thread exit */
-		}
+		/* done with root */
+		delXMLEle (root);
+
+	    } else if (err[0]) {
+		logMessage ("Driver %s: XML error: %s\n", dp->name, err);
+		return (-1);
 	    }
 	}
 
-	/* for lint */
-	return (NULL);
+	return (0);
+}
+
+/* handle the binary frame starting at dp->mp->cp[dp->mp->next].
+ * a DEF is recorded, a SET is sent on like a set*Vector but left as a frame
+ * for pushMsg to make XML if anyone wants it.
+ * return 1 if handled, 0 if more must be read first, -1 if trouble.
+ */
+static int
+readDvrFrame (DvrInfo *dp)
+{
+	Msg *mp = dp->mp, *newmp;
+	unsigned char *frame = (unsigned char *) mp->cp + mp->next;
+	int len = ibfFrameLen (frame, mp->used - mp->next);
+	unsigned id;
+	IBFDef *bp;
+
+	if (len < 0) {
+	    logMessage ("Driver %s: bad binary frame\n", dp->name);
+	    return (-1);
+	}
+	if (len == 0 || mp->used - mp->next < len)
+	    return (0);
+
+	/* keep the frame and start a new msg with remaining */
+	newmp = splitMsg (mp, mp->next + len);
+	id = ibfId (frame);
+
+	if (frame[1] == IBF_DEF) {
+	    IBFDef def;
+
+	    if (ibfReadDef (frame, len, &def) < 0) {
+		logMessage ("Driver %s: bad binary def for id %u\n", dp->name, id);
+		decMsg (newmp);
+		return (-1);
+	    }
+	    if (id >= (unsigned)dp->nbdefs) {
+		dp->bdefs = (IBFDef *) realloc (dp->bdefs, (id+1)*sizeof(IBFDef));
+		if (!dp->bdefs)
+		    Bye ("No memory for binary defs of driver %s\n", dp->name);
+		memset (dp->bdefs + dp->nbdefs, 0, (id+1-dp->nbdefs)*sizeof(IBFDef));
+		dp->nbdefs = id+1;
+	    } else
+		ibfFreeDef (&dp->bdefs[id]);
+	    dp->bdefs[id] = def;
+	    dp->askdefs = 0;
+	    if (verbose > 2)
+		logMessage ("from Driver %s: binary def %u is %s.%s\n", dp->name, id,
+								def.dev, def.name);
+
+	    /* snag device name if not known yet */
+	    if (!dp->dev[0]) {
+		strncpyz (dp->dev, def.dev, MAXINDIDEVICE-1);
+		if (evloop)
+		    evSetDvrDev (dp);
+		if (verbose > 1)
+		    logMessage ("Driver %s snooping for %s\n", dp->name, dp->dev);
+	    }
+
+	} else if (id >= (unsigned)dp->nbdefs || !(bp = &dp->bdefs[id])->dev) {
+	    /* ask once for all the properties, which also has the driver send its defs */
+	    if (!dp->askdefs) {
+		char buf[128];
+		Msg *gmp = newMsg();
+		int l = snprintf (buf, sizeof(buf), "<getProperties version='%g'/>\n", INDIV);
+		logMessage ("Driver %s: binary set for unknown id %u, asking for defs\n", dp->name, id);
+		addMsg (gmp, buf, l);
+		(void) pushMsg (dp, NULL, gmp);
+		decMsg (gmp);
+		dp->askdefs = 1;
+	    }
+
+	} else {
+	    if (verbose > 2)
+		logMessage ("from Driver %s: read binary set %s.%s\n", dp->name, bp->dev, bp->name);
+
+	    mp->bdef = bp;
+	    mp->bfrom = mp->next;
+	    if (softqsiz > 0) {
+		strncpyz (mp->set.dev, bp->dev, MAXINDIDEVICE-1);
+		strncpyz (mp->set.name, bp->name, MAXINDINAME-1);
+		mp->sethash = setHash (bp->dev, bp->name);
+		mp->replaceable = 1;
+	    }
+
+	    /* send to interested clients and snooping drivers */
+	    q2Clients (NULL, 0, bp->dev, bp->name, mp);
+	    q2SnoopingDrivers (0, bp->dev, bp->name, mp);
+
+	    /* bp may move with the next def */
+	    mp->bdef = NULL;
+	}
+
+	/* done with this msg, continue with newmp */
+	decMsg (mp);
+	dp->mp = newmp;
+	return (1);
+}
+
+/* if mp is still a binary SET frame replace it with the equivalent XML.
+ * called just before mp is first queued.
+ */
+static void
+binMsgXML (Msg *mp)
+{
+	unsigned char fbuf[1024], *frame = fbuf;
+	int len = mp->used - mp->bfrom;
+	int n;
+
+	/* copy the frame out of the way then write XML over it */
+	if (len > (int)sizeof(fbuf)) {
+	    frame = (unsigned char *) malloc (len);
+	    if (!frame)
+		Bye ("No memory for binary frame of %d\n", len);
+	}
+	memcpy (frame, mp->cp + mp->bfrom, len);
+	mp->used = 0;
+	n = ibfSetXML (mp->bdef, frame, len, mp->cp, mp->total);
+	if (n >= mp->total) {
+	    minMsg (mp, n+1);
+	    n = ibfSetXML (mp->bdef, frame, len, mp->cp, mp->total);
+	}
+	if (n < 0) {
+	    logMessage ("Bad binary set for %s.%s\n", mp->bdef->dev, mp->bdef->name);
+	    n = 0;
+	}
+	mp->used = n;
+	mp->bdef = NULL;
+
+	if (frame != fbuf)
+	    free (frame);
 }
 
 /* thread to read from the given local driver's stderr.
@@ -1231,11 +1631,17 @@ driverWriterThread (void *vp)
 }
 
 /* called by driverStdoutReaderThread to inform driverWriterThread it has
- * detected an error
+ * detected an error. in evloop mode evFlush() restarts the driver.
  */
 static void
 onDriverError (DvrInfo *dp)
 {
+	if (evloop) {
+	    dp->err = 1;
+	    evMarkDirty (&dp->evwr);
+	    return;
+	}
+
 	pthread_mutex_lock (&dp->q_lock);
 	dp->err = 1;
 	pthread_cond_signal (&dp->go_cond);
@@ -1243,11 +1649,17 @@ onDriverError (DvrInfo *dp)
 }
 
 /* called by clientReaderThread to inform clientWriterThread it has
- * detected an error
+ * detected an error. in evloop mode evFlush() shuts down the client.
  */
 static void
 onClientError (ClInfo *cp)
 {
+	if (evloop) {
+	    cp->err = 1;
+	    evMarkDirty (&cp->ev);
+	    return;
+	}
+
 	pthread_mutex_lock (&cp->q_lock);
 	cp->err = 1;
 	pthread_cond_signal (&cp->go_cond);
@@ -1259,13 +1671,25 @@ onClientError (ClInfo *cp)
 static void
 shutdownClient (ClInfo *cp)
 {
+	int i;
+
 	/* lock clinfo while updating */
 	pthread_rwlock_wrlock (&cl_rwlock);
 
 	/* close socket connection */
+	if (evloop)
+	    (void) epoll_ctl (epfd, EPOLL_CTL_DEL, cp->s, NULL);
 	shutdown (cp->s, SHUT_RDWR);
 	close (cp->s);
 
+	/* forget routes to this client */
+	if (evloop) {
+	    for (i = 0; i < cp->nprops; i++)
+		evRmSub (evcltab, cp->props[i].dev, cp->props[i].name, 0, cp, NULL);
+	    for (i = 0; i < cp->nblobs; i++)
+		evRmSub (evcltab, cp->blobs[i].dev, cp->blobs[i].name, 1, cp, NULL);
+	}
+
 	/* free memory and locks */
 	delLilXML (cp->lp);
 	free (cp->props);
@@ -1274,6 +1698,8 @@ shutdownClient (ClInfo *cp)
 	pthread_mutex_destroy (&cp->q_lock);
 	pthread_cond_destroy (&cp->go_cond);
 	pthread_rwlock_destroy (&cp->props_rwlock);
+	if (cp->ncoalesced > 0)
+	    logMessage ("Client %d: %d sets coalesced in all\n", cp->s, cp->ncoalesced);
 	if (verbose > 1)
 	    logMessage ("Client %d: draining with %d on queue\n", cp->s, nFQ(cp->msgq));
 	drainMsgs (cp->msgq);
@@ -1307,52 +1733,80 @@ shutdownClient (ClInfo *cp)
 static void
 restartDvr (DvrInfo *dp)
 {
-	int i;
-
 	/* write-lock while we edit */
 	pthread_rwlock_wrlock (&dp->restart_lock);
 
+	/* make sure it's dead, reclaim resources */
+	closeDvr (dp);
+
+	/* start this driver again */
+	logMessage ("Driver %s: restart #%d\n", dp->name, ++dp->restarts);
+	startDvr (dp);
+
+	/* done */
+	pthread_rwlock_unlock (&dp->restart_lock);
+}
+
+/* make sure the given driver is dead and reclaim its resources.
+ */
+static void
+closeDvr (DvrInfo *dp)
+{
+	int i;
+
 	/* make sure it's dead, reclaim resources */
 	if (dp->pid == REMOTEDVR) {
 	    /* socket connection */
 	    shutdown (dp->wfd, SHUT_RDWR);
 	    close (dp->wfd);	/* same as rfd */
+	} else if (evloop) {
+	    /* local pipe connection broke.
+	     * the event loop can not wait for the driver to exit, so close its
+	     * pipes first so it sees EOF or SIGPIPE, ask it to stop, and let
+	     * evReap() collect it.
+	     */
+	    close (dp->wfd);
+	    close (dp->rfd);
+	    if (dp->efp)
+		fclose (dp->efp);
+	    if (dp->efd >= 0)
+		close (dp->efd);
+	    dp->efp = NULL;
+	    dp->efd = -1;
+	    (void) kill (dp->pid, SIGTERM);
+	    evAddReap (dp);
 	} else {
 	    /* local pipe connection broke */
 	    int status, wpid = waitpid (dp->pid, &status, 0);
-	    if (wpid == dp->pid) {
-		if (WIFEXITED(status)) {
-		    int es = WEXITSTATUS(status);
-		    logMessage ("Driver %s: Exit status %d\n", dp->name, es);
-		    if (es == EXITEXFAIL) {
-			logMessage ("Exiting because of hopeless driver: %s\n", dp->name);
-			exit(1);
-		    }
-		} else if (WIFSIGNALED(status))
-#ifdef WCOREDUMP
-		    logMessage ("Driver %s: Exit signal %d%s\n", dp->name,
-			WTERMSIG(status),
-			WCOREDUMP(status) ? " (core dumped)" : "");
-#else
-		    logMessage ("Driver %s: Exit signal %d\n", dp->name,
-			WTERMSIG(status));
-#endif	/* WCOREDUMP */
-		else
-		    logMessage ("Driver %s: Unknown exit condition\n", dp->name);
-	    } else {
+	    if (wpid == dp->pid)
+		logDvrExit (dp, status);
+	    else {
 		logMessage ("Driver %s: Killed: %d\n", dp->name,
 			kill (dp->pid, SIGKILL));
 		(void) waitpid (dp->pid, &status, WNOHANG);
 	    }
 	    close (dp->wfd);
 	    close (dp->rfd);
-	    fclose (dp->efp);
+	    if (dp->efp)
+		fclose (dp->efp);
+	    dp->efp = NULL;
 	}
 
+	/* forget this driver's snoops */
+	if (evloop)
+	    for (i = 0; i < dp->nsprops; i++)
+		evRmSub (evsntab, dp->sprops[i]->prop.dev, dp->sprops[i]->prop.name, 0, NULL, dp);
+
 	/* free memory and locks */
 	for (i = 0; i < dp->nsprops; i++)
 	    free (dp->sprops[i]);
 	free (dp->sprops);
+	for (i = 0; i < dp->nbdefs; i++)
+	    ibfFreeDef (&dp->bdefs[i]);
+	free (dp->bdefs);
+	dp->bdefs = NULL;
+	dp->nbdefs = 0;
+	dp->askdefs = 0;
 	delLilXML (dp->lp);
 	decMsg (dp->mp);
 	pthread_mutex_destroy (&dp->q_lock);
@@ -1362,19 +1816,36 @@ restartDvr (DvrInfo *dp)
 	    logMessage ("Driver %s: draining with %d on queue\n", dp->name, nFQ(dp->msgq));
 	drainMsgs (dp->msgq);
 	delFQ (dp->msgq);
+}
 
-	/* start this driver again */
-	logMessage ("Driver %s: restart #%d\n", dp->name, ++dp->restarts);
-	startDvr (dp);
-
-	/* done */
-	pthread_rwlock_unlock (&dp->restart_lock);
+/* log how the local driver dp exited, as given by waitpid status.
+ * exit if it says it is hopeless.
+ */
+static void
+logDvrExit (DvrInfo *dp, int status)
+{
+	if (WIFEXITED(status)) {
+	    int es = WEXITSTATUS(status);
+	    logMessage ("Driver %s: Exit status %d\n", dp->name, es);
+	    if (es == EXITEXFAIL) {
+		logMessage ("Exiting because of hopeless driver: %s\n", dp->name);
+		exit(1);
+	    }
+	} else if (WIFSIGNALED(status))
+#ifdef WCOREDUMP
+	    logMessage ("Driver %s: Exit signal %d%s\n", dp->name,
+		WTERMSIG(status),
+		WCOREDUMP(status) ? " (core dumped)" : "");
+#else
+	    logMessage ("Driver %s: Exit signal %d\n", dp->name,
+		WTERMSIG(status));
+#endif	/* WCOREDUMP */
+	else
+	    logMessage ("Driver %s: Unknown exit condition\n", dp->name);
 }
 
 /* put Msg mp on queue of each driver responsible for dev, or all drivers
  *   if dev not specified.
- * N.B. add device to any generic getProperties going to remote drivers, else
- *   they get sent back out everywhere and go around forever.
  */
 static void
 q2Drivers (char *dev, Msg *mp, char *roottag)
@@ -1382,6 +1853,11 @@ q2Drivers (char *dev, Msg *mp, char *roottag)
 	int isggp = !strcmp (roottag, "getProperties") && !dev[0];
 	DvrInfo *dp;
 
+	if (evloop) {
+	    evQ2Drivers (dev, mp, isggp);
+	    return;
+	}
+
 	/* queue message to each driver unless it is restarting or we
 	 * know it does not support this dev
 	 */
@@ -1389,49 +1865,8 @@ q2Drivers (char *dev, Msg *mp, char *roottag)
 
 	    if (pthread_rwlock_tryrdlock (&dp->restart_lock) == 0) {
 
-		if (!dev[0] || !dp->dev[0] || !strcmp (dev, dp->dev)) {
-
-		    Msg *remote_mp = NULL;
-		    Msg *sendmp;
-		    int ql;
-
-		    /* insure getProperties to remote drivers includes device to avoid
-		     * chained loops
-		     */
-		    if (isggp && dp->pid == REMOTEDVR) {
-			char gp[100];
-			int gpl;
-
-			if (verbose)
-			    logMessage ("Driver %s: Loop caught, adding %s to generic getProperties\n",
-					    dp->name, dp->dev);
-			remote_mp = newMsg();
-			gpl = snprintf (gp, sizeof(gp), "<getProperties version='%g' device='%s' />\n", INDIV, dp->dev);
-			addMsg (remote_mp, gp, gpl);
-			sendmp = remote_mp;
-		    } else
-			sendmp = mp;
-
-		    /* ok: queue message to this driver -- beware it getting too far behind */
-                    if (verbose > 2)
-                        logMsg ("queue to", dp, NULL, sendmp);
-		    ql = pushMsg (dp, NULL, sendmp);
-		    if (ql > maxqsiz) {
-			logMessage ("Driver %s: %d bytes behind in %d messages, restarting\n",
-							dp->name, ql, nFQ(dp->msgq));
-
-			/* close reader socket to force driverStdoutReader to set err */
-			close (dp->rfd);
-
-			/* just blow away stderr reader, if we have one */
-			if (dp->pid != REMOTEDVR)
-			    pthread_cancel (dp->stderr_thr);
-		    }
-
-		    /* finished with remote_mp here if we used it */
-		    if (remote_mp)
-			decMsg (remote_mp);
-		}
+		if (!dev[0] || !dp->dev[0] || !strcmp (dev, dp->dev))
+		    q2Dvr (dp, mp, isggp);
 
 		/* done with this dvr */
 		pthread_rwlock_unlock (&dp->restart_lock);
@@ -1439,15 +1874,73 @@ q2Drivers (char *dev, Msg *mp, char *roottag)
 	}
 }
 
-/* put Msg mp on queue of each driver snooping dev/name.
- * if is BLOB always honor current mode.
+/* put Msg mp on queue of driver dp, isggp if mp is a generic getProperties.
+ * N.B. add device to any generic getProperties going to remote drivers, else
+ *   they get sent back out everywhere and go around forever.
  */
 static void
-q2SnoopingDrivers (int isblob, char *dev, char *name, Msg *mp)
+q2Dvr (DvrInfo *dp, Msg *mp, int isggp)
 {
-	DvrInfo *dp;
+	Msg *remote_mp = NULL;
+	Msg *sendmp;
 	int ql;
 
+	/* insure getProperties to remote drivers includes device to avoid
+	 * chained loops
+	 */
+	if (isggp && dp->pid == REMOTEDVR) {
+	    char gp[100];
+	    int gpl;
+
+	    if (verbose)
+		logMessage ("Driver %s: Loop caught, adding %s to generic getProperties\n",
+				dp->name, dp->dev);
+	    remote_mp = newMsg();
+	    gpl = snprintf (gp, sizeof(gp), "<getProperties version='%g' device='%s' />\n", INDIV, dp->dev);
+	    addMsg (remote_mp, gp, gpl);
+	    sendmp = remote_mp;
+	} else
+	    sendmp = mp;
+
+	/* ok: queue message to this driver -- beware it getting too far behind */
+	if (verbose > 2)
+	    logMsg ("queue to", dp, NULL, sendmp);
+	ql = pushMsg (dp, NULL, sendmp);
+	if (ql > maxqsiz) {
+	    logMessage ("Driver %s: %d bytes behind in %d messages, restarting\n",
+						dp->name, ql, nFQ(dp->msgq));
+
+	    if (evloop)
+		onDriverError (dp);
+	    else {
+		/* close reader socket to force driverStdoutReader to set err */
+		close (dp->rfd);
+
+		/* just blow away stderr reader, if we have one */
+		if (dp->pid != REMOTEDVR)
+		    pthread_cancel (dp->stderr_thr);
+	    }
+	}
+
+	/* finished with remote_mp here if we used it */
+	if (remote_mp)
+	    decMsg (remote_mp);
+}
+
+/* put Msg mp on queue of each driver snooping dev/name.
+ * if is BLOB always honor current mode.
+ */
+static void
+q2SnoopingDrivers (int isblob, char *dev, char *name, Msg *mp)
+{
+	DvrInfo *dp;
+	int ql;
+
+	if (evloop) {
+	    evQ2SnoopingDrivers (isblob, dev, name, mp);
+	    return;
+	}
+
 	/* queue message to each driver if it is not restarting and
 	 * it is snooping for this dev/name
 	 */
@@ -1507,6 +2000,10 @@ addSnoopDevice (DvrInfo *dp, char *dev, char *name)
 	strncpyz (sp->prop.name, name, MAXINDINAME-1);
 	sp->blob = B_NEVER;
 
+	/* route by dev too */
+	if (evloop)
+	    evAddSub (evsntab, sp->prop.dev, sp->prop.name, 0, NULL, dp, sp);
+
 	/* unlock */
 	pthread_rwlock_unlock (&dp->sprops_rwlock);
 
@@ -1550,6 +2047,11 @@ q2Clients (ClInfo *notme, int isblob, char *dev, char *name, Msg *mp)
 	ClInfo *cp;
 	int i, ql;
 
+	if (evloop) {
+	    evQ2Clients (notme, isblob, dev, name, mp);
+	    return;
+	}
+
 	/* read access */
 	pthread_rwlock_rdlock (&cl_rwlock);
 
@@ -1591,6 +2093,29 @@ pushMsg (DvrInfo *dp, ClInfo *cp, Msg *mp)
 	pthread_cond_t *vp;
 	int n;
 
+	/* make XML of a binary SET the first time anyone wants it */
+	if (mp->bdef)
+	    binMsgXML (mp);
+
+	/* just queue it and note the writer in evloop mode */
+	if (evloop) {
+	    incMsg (mp);
+	    if (dp) {
+		pushFQ (dp->msgq, mp);
+		dp->qbytes += mp->used + 1;
+		evMarkDirty (&dp->evwr);
+		return (dp->qbytes);
+	    } else if (cp) {
+		coalesceMsg (cp, mp);
+		pushFQ (cp->msgq, mp);
+		cp->qbytes += mp->used + 1;
+		evMarkDirty (&cp->ev);
+		return (cp->qbytes);
+	    }
+	    decMsg (mp);
+	    return (0);
+	}
+
 	/* get appropriate q and locks */
 	if (dp) {
 	    qp = dp->msgq;
@@ -1608,8 +2133,14 @@ pushMsg (DvrInfo *dp, ClInfo *cp, Msg *mp)
 
 	/* push onto this queue, handy time to get size too */
 	pthread_mutex_lock (lp);
-	pushFQ (qp, mp);
-	n = msgQSize (qp);
+	if (cp) {
+	    coalesceMsg (cp, mp);
+	    pushFQ (qp, mp);
+	    n = cp->qbytes += mp->used + 1;
+	} else {
+	    pushFQ (qp, mp);
+	    n = msgQSize (qp);
+	}
 	pthread_cond_signal (vp);
 	pthread_mutex_unlock (lp);
 
@@ -1648,6 +2179,89 @@ logMsg (const char *label, DvrInfo *dp, ClInfo *cp, Msg *mp)
 	delXMLEle (root);
 }
 
+/* called with cp's q locked just before mp is pushed onto it.
+ * once cp is more than softqsiz behind, if mp is a set remove the newest older
+ * set for the same dev.name still on the q, unless that has started being
+ * written. either way remember mp as the newest if it may itself be replaced.
+ */
+static void
+coalesceMsg (ClInfo *cp, Msg *mp)
+{
+	Msg **latestp, *oldmp;
+	int i, first;
+
+	if (softqsiz <= 0 || !mp->set.dev[0])
+	    return;
+	latestp = &cp->latest[mp->sethash & (COALSIZ-1)];
+	oldmp = *latestp;
+	*latestp = mp->replaceable ? mp : NULL;
+
+	if (cp->qbytes <= softqsiz)
+	    return;
+	if (!cp->coalescing) {
+	    cp->coalescing = 1;
+	    logMessage ("Client %d: %d bytes behind in %d messages, coalescing sets\n",
+					cp->s, cp->qbytes, nFQ(cp->msgq));
+	}
+
+	/* slot may be for another property */
+	if (!oldmp || strcmp (oldmp->set.name, mp->set.name) || strcmp (oldmp->set.dev, mp->set.dev))
+	    return;
+
+	/* find it, it is usually close to the end */
+	first = (evloop && cp->nsent > 0) ? 1 : 0;
+	for (i = nFQ(cp->msgq) - 1; i >= first; i--)
+	    if (peekiFQ (cp->msgq, i) == oldmp)
+		break;
+	if (i < first)
+	    return;
+
+	(void) rmiFQ (cp->msgq, i);
+	cp->qbytes -= oldmp->used + 1;
+	cp->ncoalesced++;
+	if (verbose > 2)
+	    logMsg ("coalesced for", NULL, cp, oldmp);
+	decMsg (oldmp);
+}
+
+/* called with cp's q locked after mp has been popped to be written.
+ * forget mp as the newest set for its property and note when cp has caught up.
+ */
+static void
+clMsgSent (ClInfo *cp, Msg *mp)
+{
+	if (mp->replaceable) {
+	    Msg **latestp = &cp->latest[mp->sethash & (COALSIZ-1)];
+	    if (*latestp == mp)
+		*latestp = NULL;
+	}
+
+	if (cp->coalescing && cp->qbytes <= softqsiz/2) {
+	    cp->coalescing = 0;
+	    logMessage ("Client %d: caught up, %d sets coalesced so far\n", cp->s, cp->ncoalesced);
+	}
+}
+
+/* FNV-1a hash of dev and name.
+ */
+static unsigned
+setHash (const char *dev, const char *name)
+{
+	unsigned h = 2166136261u;
+
+	while (*dev) {
+	    h ^= (unsigned char) *dev++;
+	    h *= 16777619u;
+	}
+	h ^= '.';
+	h *= 16777619u;
+	while (*name) {
+	    h ^= (unsigned char) *name++;
+	    h *= 16777619u;
+	}
+	return (h);
+}
+
 /* return total size of all Msqs on the given q */
 static int
 msgQSize (FQ *q)
@@ -1668,15 +2282,26 @@ msgQSize (FQ *q)
 static Msg *
 newMsg (void)
 {
-	Msg *newmp = (Msg *) malloc(sizeof(Msg));
-	if (!newmp)
-	    Bye ("No memory for new Msg\n");
+	Msg *newmp;
+
+	/* reuse one if we can, else a new one */
+	if (evloop && nevfree > 0)
+	    newmp = evfree[--nevfree];
+	else {
+	    newmp = (Msg *) malloc(sizeof(Msg));
+	    if (!newmp)
+		Bye ("No memory for new Msg\n");
+	}
 	newmp->count = 1;
 	newmp->used = 0;
 	newmp->next = 0;
 	newmp->cp = newmp->buf;
 	newmp->total = sizeof(newmp->buf);
-	pthread_mutex_init (&newmp->count_lock, NULL);
+	newmp->set.dev[0] = '\0';
+	newmp->replaceable = 0;
+	newmp->bdef = NULL;
+	if (!evloop)
+	    pthread_mutex_init (&newmp->count_lock, NULL);
 	return (newmp);
 }
 
@@ -1694,6 +2319,11 @@ addMsg (Msg *mp, char buf[], int bufl)
 static void
 incMsg (Msg *mp)
 {
+	if (evloop) {
+	    mp->count += 1;
+	    return;
+	}
+
 	pthread_mutex_lock (&mp->count_lock);
 	mp->count += 1;
 	pthread_mutex_unlock (&mp->count_lock);
@@ -1705,6 +2335,19 @@ incMsg (Msg *mp)
 static void
 decMsg (Msg *mp)
 {
+	/* no lock, and keep some for reuse, in evloop mode */
+	if (evloop) {
+	    if (--mp->count <= 0) {
+		if (mp->cp != mp->buf)
+		    free (mp->cp);
+		if (nevfree < EVMAXFREE)
+		    evfree[nevfree++] = mp;
+		else
+		    free (mp);
+	    }
+	    return;
+	}
+
 	pthread_mutex_lock (&mp->count_lock);
 	if (--mp->count <= 0) {
 	    if (mp->cp != mp->buf)
@@ -1835,6 +2478,10 @@ addClDevice (ClInfo *cp, int isblob, char *dev, char *name)
 	strncpyz (pp->dev, dev, MAXINDIDEVICE-1);
 	strncpyz (pp->name, name, MAXINDINAME-1);
 
+	/* route by dev too */
+	if (evloop)
+	    evAddSub (evcltab, pp->dev, pp->name, isblob, cp, NULL, NULL);
+
 	/* unlock and finished */
 	pthread_rwlock_unlock (&cp->props_rwlock);
 }
@@ -1853,6 +2500,12 @@ rmClDevice (ClInfo *cp, int isblob, char *dev, char *name)
 	    /* protect while modifying */
 	    pthread_rwlock_wrlock (&cp->props_rwlock);
 
+	    /* stop routing by dev too */
+	    if (evloop) {
+		Property *pp = isblob ? &cp->blobs[i] : &cp->props[i];
+		evRmSub (evcltab, pp->dev, pp->name, isblob, cp, NULL);
+	    }
+
 	    if (isblob)
 		memmove (&cp->blobs[i], &cp->blobs[i+1],
 			    (--cp->nblobs - i)*sizeof(Property));
@@ -2048,3 +2701,736 @@ Bye (const char *fmt, ...)
 
 	abort();
 }
+
+/* create the epoll set and add lsocket.
+ * exit if trouble.
+ */
+static void
+evInit (void)
+{
+	struct epoll_event ev;
+
+	epfd = epoll_create1 (EPOLL_CLOEXEC);
+	if (epfd < 0)
+	    Bye ("epoll_create1: %s\n", strerror(errno));
+
+	evNonBlock (lsocket);
+	evlisten.kind = EV_LISTEN;
+	evlisten.owner = NULL;
+	memset (&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = &evlisten;
+	if (epoll_ctl (epfd, EPOLL_CTL_ADD, lsocket, &ev) < 0)
+	    Bye ("epoll_ctl listen: %s\n", strerror(errno));
+
+	if (verbose > 0)
+	    logMessage ("using epoll event loop on fd %d\n", epfd);
+}
+
+/* handle all clients and drivers forever from this one thread.
+ */
+static void
+evLoop (void)
+{
+	struct epoll_event events[EVMAXEVENTS];
+	int i, n;
+
+	while (1) {
+	    /* collect drivers which have been stopped */
+	    evReap();
+
+	    /* start any drivers whose time has come */
+	    evRestarts();
+
+	    /* send what was queued since last time */
+	    evFlush();
+
+	    n = epoll_wait (epfd, events, EVMAXEVENTS, evTimeout());
+	    if (n < 0) {
+		if (errno == EINTR)
+		    continue;
+		Bye ("epoll_wait: %s\n", strerror(errno));
+	    }
+
+	    for (i = 0; i < n; i++) {
+		EvSource *ep = (EvSource *) events[i].data.ptr;
+		unsigned int what = events[i].events;
+		ClInfo *cp;
+		DvrInfo *dp;
+
+		switch (ep->kind) {
+		case EV_LISTEN:
+		    evNewClients();
+		    break;
+
+		case EV_CLIENT:
+		    cp = (ClInfo *) ep->owner;
+		    if (!cp->active || cp->err)
+			break;
+		    if ((what & (EPOLLIN|EPOLLHUP|EPOLLERR)) && readClient (cp) < 0)
+			onClientError (cp);
+		    else if (what & EPOLLOUT)
+			evMarkDirty (&cp->ev);
+		    break;
+
+		case EV_DVRRD:
+		    /* stdout of local driver, socket of remote driver */
+		    dp = (DvrInfo *) ep->owner;
+		    if (!dp->running || dp->err)
+			break;
+		    if ((what & (EPOLLIN|EPOLLHUP|EPOLLERR)) && readDriver (dp) < 0)
+			onDriverError (dp);
+		    else if (what & EPOLLOUT)
+			evMarkDirty (&dp->evwr);
+		    break;
+
+		case EV_DVRWR:
+		    /* stdin of local driver, only in set while output is waiting */
+		    dp = (DvrInfo *) ep->owner;
+		    if (!dp->running || dp->err)
+			break;
+		    if (what & EPOLLERR)
+			onDriverError (dp);
+		    else
+			evMarkDirty (&dp->evwr);
+		    break;
+
+		case EV_DVRERR:
+		    dp = (DvrInfo *) ep->owner;
+		    if (dp->running)
+			evReadStderr (dp);
+		    break;
+		}
+	    }
+	}
+}
+
+/* return ms until the next driver should be started, or -1 to wait forever.
+ */
+static int
+evTimeout (void)
+{
+	time_t now, next = 0;
+	DvrInfo *dp;
+	int ms;
+
+	/* check again soon for drivers still to be reaped */
+	ms = nevreap > 0 ? EVREAPMS : -1;
+
+	if (evnrestart == 0)
+	    return (ms);
+
+	for (dp = dvrinfo; dp < &dvrinfo[ndvrinfo]; dp++)
+	    if (dp->restart_at && (!next || dp->restart_at < next))
+		next = dp->restart_at;
+
+	now = time(NULL);
+	if (next <= now)
+	    return (0);
+	if (ms >= 0 && ms < (int)(next - now)*1000)
+	    return (ms);
+	return ((int)(next - now)*1000);
+}
+
+/* start each driver whose restart_at has passed.
+ */
+static void
+evRestarts (void)
+{
+	time_t now;
+	DvrInfo *dp;
+
+	if (evnrestart == 0)
+	    return;
+
+	now = time(NULL);
+	for (dp = dvrinfo; dp < &dvrinfo[ndvrinfo]; dp++)
+	    if (dp->restart_at && dp->restart_at <= now)
+		evStartDvr (dp);
+}
+
+/* remember the process of local driver dp, whose pipes have just been closed,
+ * so evReap() can collect it without blocking.
+ */
+static void
+evAddReap (DvrInfo *dp)
+{
+	if (nevreap == mevreap) {
+	    mevreap = mevreap ? 2*mevreap : 16;
+	    evreap = (EvReap *) realloc (evreap, mevreap*sizeof(EvReap));
+	    if (!evreap)
+		Bye ("No memory for %d drivers to reap\n", mevreap);
+	}
+	evreap[nevreap].dp = dp;
+	evreap[nevreap].pid = dp->pid;
+	evreap[nevreap].kill_at = time(NULL) + 2;	/* at least 1 s from now */
+	nevreap++;
+}
+
+/* collect each stopped driver which has exited, and kill any which has not
+ * exited in time. a driver which still does not exit, e.g. stuck in the
+ * kernel, just stays on the list.
+ */
+static void
+evReap (void)
+{
+	time_t now;
+	int i, status, wpid;
+
+	if (nevreap == 0)
+	    return;
+
+	now = time(NULL);
+	for (i = 0; i < nevreap; ) {
+	    EvReap *rp = &evreap[i];
+	    wpid = waitpid (rp->pid, &status, WNOHANG);
+	    if (wpid == rp->pid || (wpid < 0 && errno == ECHILD)) {
+		if (wpid == rp->pid)
+		    logDvrExit (rp->dp, status);
+		evreap[i] = evreap[--nevreap];
+		continue;
+	    }
+	    if (rp->kill_at && now >= rp->kill_at) {
+		logMessage ("Driver %s: Killed: %d\n", rp->dp->name,
+			kill (rp->pid, SIGKILL));
+		rp->kill_at = 0;
+	    }
+	    i++;
+	}
+}
+
+/* accept each client waiting on lsocket.
+ */
+static void
+evNewClients (void)
+{
+	struct epoll_event ev;
+	ClInfo *cp;
+	int s;
+
+	while (1) {
+	    s = accept (lsocket, NULL, NULL);
+	    if (s < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+		    logMessage ("accept: %s\n", strerror(errno));
+		return;
+	    }
+	    evNonBlock (s);
+
+	    cp = newClInfo (s);
+	    cp->ev.kind = EV_CLIENT;
+	    cp->ev.owner = cp;
+
+	    memset (&ev, 0, sizeof(ev));
+	    ev.events = EPOLLIN;
+	    ev.data.ptr = &cp->ev;
+	    if (epoll_ctl (epfd, EPOLL_CTL_ADD, s, &ev) < 0)
+		Bye ("epoll_ctl client %d: %s\n", s, strerror(errno));
+	}
+}
+
+/* add the fds of the newly started driver dp to the epoll set.
+ * efd is its stderr pipe, or -1 if remote.
+ * N.B. wfd is only added while there is output waiting.
+ */
+static void
+evAddDvr (DvrInfo *dp, int efd)
+{
+	struct epoll_event ev;
+
+	dp->evrd.kind = EV_DVRRD;
+	dp->evrd.owner = dp;
+	dp->evwr.kind = EV_DVRWR;
+	dp->evwr.owner = dp;
+	dp->everr.kind = EV_DVRERR;
+	dp->everr.owner = dp;
+	dp->efd = efd;
+	dp->nebuf = 0;
+	dp->qbytes = 0;
+	dp->nsent = 0;
+	dp->pollout = 0;
+	dp->running = 1;
+
+	evNonBlock (dp->rfd);
+	evNonBlock (dp->wfd);
+	memset (&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = &dp->evrd;
+	if (epoll_ctl (epfd, EPOLL_CTL_ADD, dp->rfd, &ev) < 0)
+	    Bye ("Driver %s epoll_ctl: %s\n", dp->name, strerror(errno));
+
+	if (efd >= 0) {
+	    if (!dp->ebuf && !(dp->ebuf = (char *) malloc (MAXRBUF)))
+		Bye ("No memory for Driver %s stderr\n", dp->name);
+	    evNonBlock (efd);
+	    ev.data.ptr = &dp->everr;
+	    if (epoll_ctl (epfd, EPOLL_CTL_ADD, efd, &ev) < 0)
+		Bye ("Driver %s stderr epoll_ctl: %s\n", dp->name, strerror(errno));
+	}
+}
+
+/* start dp if it is time, else arrange for evRestarts to try again.
+ * like startDvr but never sleeps.
+ */
+static void
+evStartDvr (DvrInfo *dp)
+{
+	time_t now = time(NULL);
+	int ok;
+
+	/* same minimum interval as startDvr, except when retrying */
+	if (!dp->retry && now - dp->start < RESTARTDT) {
+	    if (!dp->restart_at)
+		logMessage ("Driver %s: delaying restart by %d secs, min restart interval is %d secs\n",
+			dp->name, (int)(dp->start + RESTARTDT - now), RESTARTDT);
+	    evSchedule (dp, dp->start + RESTARTDT);
+	    return;
+	}
+	if (!dp->retry)
+	    dp->start = now;
+
+	if (strchr (dp->name, '@'))
+	    ok = startRemoteDvr (dp) == 0;
+	else
+	    ok = startLocalDvr (dp) == 0;
+
+	dp->retry = !ok;
+	evSchedule (dp, ok ? 0 : now + RDRTIME);
+}
+
+/* stop routing to dp, make sure it is dead and arrange for it to be restarted.
+ */
+static void
+evStopDvr (DvrInfo *dp)
+{
+	/* closing an fd also removes it from epfd, but be explicit */
+	(void) epoll_ctl (epfd, EPOLL_CTL_DEL, dp->rfd, NULL);
+	if (dp->pollout && dp->wfd != dp->rfd)
+	    (void) epoll_ctl (epfd, EPOLL_CTL_DEL, dp->wfd, NULL);
+	if (dp->efd >= 0) {
+	    (void) epoll_ctl (epfd, EPOLL_CTL_DEL, dp->efd, NULL);
+	    if (dp->nebuf > 0) {
+		dp->ebuf[dp->nebuf] = '\0';
+		logMessage ("Driver %s: %s\n", dp->name, dp->ebuf);
+	    }
+	}
+	dp->running = 0;
+	dp->pollout = 0;
+
+	closeDvr (dp);
+	dp->err = 0;
+
+	logMessage ("Driver %s: restart #%d\n", dp->name, ++dp->restarts);
+	evStartDvr (dp);
+}
+
+/* set or clear (when == 0) the time dp is to be started by evRestarts.
+ */
+static void
+evSchedule (DvrInfo *dp, time_t when)
+{
+	if (dp->restart_at && !when)
+	    evnrestart--;
+	else if (!dp->restart_at && when)
+	    evnrestart++;
+	dp->restart_at = when;
+}
+
+/* add dp to evdvtab now that its dev is known, if not already.
+ */
+static void
+evSetDvrDev (DvrInfo *dp)
+{
+	if (dp->devknown || !dp->dev[0])
+	    return;
+	evAddSub (evdvtab, dp->dev, "", 0, NULL, dp, NULL);
+	dp->devknown = 1;
+	evnodev--;
+}
+
+/* read the stderr of local driver dp, log each whole line.
+ * on EOF just stop listening, stdout EOF restarts the driver.
+ */
+static void
+evReadStderr (DvrInfo *dp)
+{
+	char *nl;
+	int nr;
+
+	nr = read (dp->efd, dp->ebuf + dp->nebuf, MAXRBUF - 1 - dp->nebuf);
+	if (nr <= 0) {
+	    if (nr < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+		return;
+	    if (nr < 0)
+		logMessage ("from Driver %s: stderr %s\n", dp->name, strerror(errno));
+	    else
+		logMessage ("from Driver %s: stderr EOF\n", dp->name);
+	    (void) epoll_ctl (epfd, EPOLL_CTL_DEL, dp->efd, NULL);
+	    close (dp->efd);
+	    dp->efd = -1;
+	    return;
+	}
+	dp->nebuf += nr;
+	dp->ebuf[dp->nebuf] = '\0';
+
+	/* prefix each whole line to our stderr, save extra for next time */
+	while ((nl = strchr (dp->ebuf, '\n')) != NULL) {
+	    int l = nl - dp->ebuf + 1;
+	    logMessage ("Driver %s: %.*s", dp->name, l, dp->ebuf);	/* includes nl */
+	    dp->nebuf -= l;
+	    memmove (dp->ebuf, dp->ebuf + l, dp->nebuf + 1);
+	}
+
+	/* a line too long for ebuf is logged in pieces, as fgets would */
+	if (dp->nebuf == MAXRBUF - 1) {
+	    logMessage ("Driver %s: %s\n", dp->name, dp->ebuf);
+	    dp->nebuf = 0;
+	}
+}
+
+/* add ep to the list of writers evFlush must visit, if not already.
+ */
+static void
+evMarkDirty (EvSource *ep)
+{
+	int *dirtyp;
+
+	if (ep->kind == EV_CLIENT)
+	    dirtyp = &((ClInfo *) ep->owner)->dirty;
+	else
+	    dirtyp = &((DvrInfo *) ep->owner)->dirty;
+	if (*dirtyp)
+	    return;
+
+	if (nevdirty == mevdirty) {
+	    mevdirty = mevdirty ? 2*mevdirty : 64;
+	    evdirty = (EvSource **) realloc (evdirty, mevdirty*sizeof(EvSource*));
+	    if (!evdirty)
+		Bye ("No memory for %d dirty writers\n", mevdirty);
+	}
+	evdirty[nevdirty++] = ep;
+	*dirtyp = 1;
+}
+
+/* write to each dirty client and driver, shutting down clients and restarting
+ * drivers in trouble.
+ * N.B. restarting a driver queues to it again, so evdirty may grow as we go.
+ */
+static void
+evFlush (void)
+{
+	int i;
+
+	for (i = 0; i < nevdirty; i++) {
+	    EvSource *ep = evdirty[i];
+
+	    if (ep->kind == EV_CLIENT) {
+		ClInfo *cp = (ClInfo *) ep->owner;
+		cp->dirty = 0;
+		if (!cp->active)
+		    continue;
+		if (!cp->err && evWriteQ (NULL, cp) < 0)
+		    cp->err = 1;
+		if (cp->err)
+		    shutdownClient (cp);
+	    } else {
+		DvrInfo *dp = (DvrInfo *) ep->owner;
+		dp->dirty = 0;
+		if (!dp->running)
+		    continue;
+		if (!dp->err && evWriteQ (dp, NULL) < 0)
+		    dp->err = 1;
+		if (dp->err)
+		    evStopDvr (dp);
+	    }
+	}
+
+	nevdirty = 0;
+}
+
+/* write as much of dp's or cp's queue as its fd will take now, several Msgs per
+ * writev, each followed by one nl as in the writer threads.
+ * listen for writability if some is left.
+ * return 0 if ok, -1 if trouble.
+ */
+static int
+evWriteQ (DvrInfo *dp, ClInfo *cp)
+{
+	static char nl[] = "\n";
+	struct iovec iov[2*EVMAXIOV];
+	FQ *q = dp ? dp->msgq : cp->msgq;
+	int fd = dp ? dp->wfd : cp->s;
+	int *nsentp = dp ? &dp->nsent : &cp->nsent;
+	int *qbytesp = dp ? &dp->qbytes : &cp->qbytes;
+
+	while (nFQ(q) > 0) {
+	    int i, niov = 0, nq = nFQ(q);
+	    ssize_t nw;
+
+	    /* gather Msgs, skipping what was already sent of the first */
+	    for (i = 0; i < nq && i < EVMAXIOV; i++) {
+		Msg *mp = (Msg *) peekiFQ (q, i);
+		int skip = i == 0 ? *nsentp : 0;
+		if (skip < mp->used) {
+		    iov[niov].iov_base = mp->cp + skip;
+		    iov[niov].iov_len = mp->used - skip;
+		    niov++;
+		}
+		iov[niov].iov_base = nl;
+		iov[niov].iov_len = 1;
+		niov++;
+	    }
+
+	    nw = writev (fd, iov, niov);
+	    if (nw < 0) {
+		if (errno == EINTR)
+		    continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+		    evPollOut (dp, cp, 1);
+		    return (0);
+		}
+		if (verbose > 1 || errno != EPIPE) {
+		    if (dp)
+			logMessage ("to Driver %s: write with %d on q: %s\n", dp->name, nq, strerror(errno));
+		    else
+			logMessage ("to Client %d: write with %d on q: %s\n", cp->s, nq, strerror(errno));
+		}
+		return (-1);
+	    }
+	    *qbytesp -= nw;
+
+	    /* pop each Msg now completely sent */
+	    nw += *nsentp;
+	    while (nFQ(q) > 0) {
+		Msg *mp = (Msg *) peekFQ (q);
+		if (nw < mp->used + 1)
+		    break;
+		nw -= mp->used + 1;
+		(void) popFQ (q);
+		if (cp)
+		    clMsgSent (cp, mp);
+		if (verbose > 1)
+		    logMsg ("send to", dp, cp, mp);
+		decMsg (mp);
+	    }
+	    *nsentp = nw;
+	}
+
+	evPollOut (dp, cp, 0);
+	return (0);
+}
+
+/* start or stop listening for dp's or cp's fd to be writable.
+ */
+static void
+evPollOut (DvrInfo *dp, ClInfo *cp, int on)
+{
+	struct epoll_event ev;
+	int *polloutp = dp ? &dp->pollout : &cp->pollout;
+
+	if (*polloutp == on)
+	    return;
+	*polloutp = on;
+
+	memset (&ev, 0, sizeof(ev));
+	if (cp) {
+	    ev.events = EPOLLIN | (on ? EPOLLOUT : 0);
+	    ev.data.ptr = &cp->ev;
+	    if (epoll_ctl (epfd, EPOLL_CTL_MOD, cp->s, &ev) < 0)
+		logMessage ("Client %d: epoll_ctl: %s\n", cp->s, strerror(errno));
+	} else if (dp->wfd == dp->rfd) {
+	    /* remote, one socket */
+	    ev.events = EPOLLIN | (on ? EPOLLOUT : 0);
+	    ev.data.ptr = &dp->evrd;
+	    if (epoll_ctl (epfd, EPOLL_CTL_MOD, dp->rfd, &ev) < 0)
+		logMessage ("Driver %s: epoll_ctl: %s\n", dp->name, strerror(errno));
+	} else {
+	    /* local, stdin pipe is only in the set while waiting */
+	    ev.events = EPOLLOUT;
+	    ev.data.ptr = &dp->evwr;
+	    if (epoll_ctl (epfd, on ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, dp->wfd, &ev) < 0)
+		logMessage ("Driver %s: epoll_ctl: %s\n", dp->name, strerror(errno));
+	}
+}
+
+/* set O_NONBLOCK on fd.
+ */
+static void
+evNonBlock (int fd)
+{
+	int flags = fcntl (fd, F_GETFL, 0);
+	if (flags < 0 || fcntl (fd, F_SETFL, flags | O_NONBLOCK) < 0)
+	    Bye ("fcntl(%d, O_NONBLOCK): %s\n", fd, strerror(errno));
+}
+
+/* evloop version of q2Drivers: look up the driver for dev rather than comparing
+ * with each. scan them all if no dev or some driver has not told us its dev yet.
+ */
+static void
+evQ2Drivers (char *dev, Msg *mp, int isggp)
+{
+	DvrInfo *dp;
+	EvSub *sub;
+
+	if (!dev[0] || evnodev > 0) {
+	    for (dp = dvrinfo; dp < &dvrinfo[ndvrinfo]; dp++)
+		if (dp->running && (!dev[0] || !dp->dev[0] || !strcmp (dev, dp->dev)))
+		    q2Dvr (dp, mp, isggp);
+	    return;
+	}
+
+	for (sub = evdvtab[evHash(dev)]; sub; sub = sub->next)
+	    if (sub->dp->running && !strcmp (sub->prop.dev, dev))
+		q2Dvr (sub->dp, mp, isggp);
+}
+
+/* evloop version of q2SnoopingDrivers: only visit snoops of dev.
+ * the first match for each driver decides, as in findSnoopDevice.
+ */
+static void
+evQ2SnoopingDrivers (int isblob, char *dev, char *name, Msg *mp)
+{
+	EvSub *sub;
+	int ql;
+
+	evgen++;
+	for (sub = evsntab[evHash(dev)]; sub; sub = sub->next) {
+	    DvrInfo *dp = sub->dp;
+	    Snoopee *sp = sub->sp;
+
+	    if (dp->evgen == evgen || strcmp (sub->prop.dev, dev)
+	    			|| (sub->prop.name[0] && strcmp (sub->prop.name, name)))
+		continue;
+	    dp->evgen = evgen;
+
+	    /* nothing for dp if not running or wrong BLOB mode */
+	    if (!dp->running || (isblob && sp->blob==B_NEVER) || (!isblob && sp->blob==B_ONLY))
+		continue;
+
+	    /* ok: queue message to this driver -- beware it getting too far behind */
+	    ql = pushMsg (dp, NULL, mp);
+	    if (ql > maxqsiz) {
+		logMessage ("Driver %s: %d bytes behind in %d messages, restarting\n",
+					    dp->name, ql, nFQ(dp->msgq));
+		onDriverError (dp);
+	    }
+	}
+}
+
+/* evloop version of q2Clients: only visit clients who asked for dev or for
+ * all devices. scan them all if the message has no dev.
+ */
+static void
+evQ2Clients (ClInfo *notme, int isblob, char *dev, char *name, Msg *mp)
+{
+	EvSub *subs[2], *sub;
+	int i, ql;
+
+	evgen++;
+
+	if (!dev[0]) {
+	    for (i = 0; i < nclinfo; i++) {
+		ClInfo *cp = clinfo[i];
+		if (!cp->active || cp == notme || findClDevice (cp, isblob, dev, name) < 0)
+		    continue;
+		cp->evgen = evgen;
+		if (verbose > 2)
+		    logMsg ("queue to", NULL, cp, mp);
+		ql = pushMsg (NULL, cp, mp);
+		if (ql > maxqsiz) {
+		    logMessage ("Client %d: %d bytes behind in %d messages, shutting down\n",
+					    cp->s, ql, nFQ(cp->msgq));
+		    onClientError (cp);
+		}
+	    }
+	    return;
+	}
+
+	/* those who asked for dev, then those who asked for any dev */
+	subs[0] = evcltab[evHash(dev)];
+	subs[1] = evcltab[evHash("")];
+	for (i = 0; i < 2; i++) {
+	    for (sub = subs[i]; sub; sub = sub->next) {
+		ClInfo *cp = sub->cp;
+
+		if (cp->evgen == evgen || cp == notme || !cp->active || sub->isblob != isblob)
+		    continue;
+		if (sub->prop.dev[0] && strcmp (sub->prop.dev, dev))
+		    continue;
+		if (name[0] && sub->prop.name[0] && strcmp (sub->prop.name, name))
+		    continue;
+		cp->evgen = evgen;
+
+		/* ok: queue message to this client -- beware it getting too far behind */
+		if (verbose > 2)
+		    logMsg ("queue to", NULL, cp, mp);
+		ql = pushMsg (NULL, cp, mp);
+		if (ql > maxqsiz) {
+		    logMessage ("Client %d: %d bytes behind in %d messages, shutting down\n",
+					    cp->s, ql, nFQ(cp->msgq));
+		    onClientError (cp);
+		}
+	    }
+
+	    /* just one list if dev hashes the same as "" */
+	    if (subs[1] == subs[0])
+		break;
+	}
+}
+
+/* FNV-1a hash of dev, reduced to an index into a routing table.
+ */
+static unsigned
+evHash (const char *dev)
+{
+	unsigned h = 2166136261u;
+
+	while (*dev) {
+	    h ^= (unsigned char) *dev++;
+	    h *= 16777619u;
+	}
+	return (h & (EVHASHSIZ-1));
+}
+
+/* add a route for dev.name to the end of its bucket in tab.
+ */
+static void
+evAddSub (EvSub **tab, const char *dev, const char *name, int isblob,
+ClInfo *cp, DvrInfo *dp, Snoopee *sp)
+{
+	EvSub **subp = &tab[evHash(dev)];
+	EvSub *sub;
+
+	sub = (EvSub *) calloc (1, sizeof(EvSub));
+	if (!sub)
+	    Bye ("No memory to route %s.%s\n", dev, name);
+	strncpyz (sub->prop.dev, dev, MAXINDIDEVICE-1);
+	strncpyz (sub->prop.name, name, MAXINDINAME-1);
+	sub->isblob = isblob;
+	sub->cp = cp;
+	sub->dp = dp;
+	sub->sp = sp;
+
+	while (*subp)
+	    subp = &(*subp)->next;
+	*subp = sub;
+}
+
+/* remove the first route in tab for exactly dev.name belonging to cp or dp.
+ */
+static void
+evRmSub (EvSub **tab, const char *dev, const char *name, int isblob,
+ClInfo *cp, DvrInfo *dp)
+{
+	EvSub **subp;
+
+	for (subp = &tab[evHash(dev)]; *subp; subp = &(*subp)->next) {
+	    EvSub *sub = *subp;
+	    if (sub->cp == cp && sub->dp == dp && sub->isblob == isblob
+	    		&& !strcmp (sub->prop.dev, dev) && !strcmp (sub->prop.name, name)) {
+		*subp = sub->next;
+		free (sub);
+		return;
+	    }
+	}
+}
@@ -0,0 +1,419 @@
+/* load test for indiserver, comparing the threaded and epoll (-e) modes.
+ * licensed under GNU Lesser Public License version 2.1 or later.
+ *
+ * For each mode we start indiserver with ndrivers copies of ourself as drivers,
+ * connect nclients clients which each ask for all properties, then count how
+ * many setNumberVector messages the clients receive per second and how much cpu
+ * indiserver uses doing it. Each driver sends one number vector at the given
+ * rate, so both modes see the same offered load.
+ *
+ * When started by indiserver (INDILOAD_DRIVER is set in the environment) we are
+ * one of the drivers instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define	DEFPORT		7700		/* port for the indiserver under test */
+#define	DEFNDRIVERS	80		/* default n drivers */
+#define	DEFNCLIENTS	20		/* default n clients */
+#define	DEFRATE		100		/* default msgs/sec from each driver */
+#define	DEFSECS		10		/* default seconds to measure each mode */
+#define	WARMSECS	2		/* seconds to let things settle before measuring */
+#define	TAG		"<setNumberVector"
+
+static char *me;
+static int port = DEFPORT;
+static int ndrivers = DEFNDRIVERS;
+static int nclients = DEFNCLIENTS;
+static int rate = DEFRATE;
+static int secs = DEFSECS;
+static char *server = "indiserver";
+
+static void usage (void);
+static void runDriver (void);
+static int runMode (int evloop, double *msgrate, double *cpu, int *nthreads);
+static int connectClient (void);
+static long cpuTicks (int pid);
+static int nThreads (int pid);
+static double now (void);
+
+int
+main (int ac, char *av[])
+{
+	char *modes[2] = {"threads", "epoll"};
+	double msgrate[2], cpu[2];
+	int nthreads[2];
+	int i;
+
+	me = av[0];
+
+	/* drivers are started by indiserver with no args */
+	if (getenv ("INDILOAD_DRIVER"))
+	    runDriver();
+
+	/* crack args */
+	while ((--ac > 0) && ((*++av)[0] == '-')) {
+	    char *s;
+	    for (s = av[0]+1; *s != '\0'; s++)
+		switch (*s) {
+		case 'c':
+		    if (ac < 2)
+			usage();
+		    nclients = atoi(*++av);
+		    ac--;
+		    break;
+		case 'd':
+		    if (ac < 2)
+			usage();
+		    ndrivers = atoi(*++av);
+		    ac--;
+		    break;
+		case 'p':
+		    if (ac < 2)
+			usage();
+		    port = atoi(*++av);
+		    ac--;
+		    break;
+		case 'r':
+		    if (ac < 2)
+			usage();
+		    rate = atoi(*++av);
+		    ac--;
+		    break;
+		case 's':
+		    if (ac < 2)
+			usage();
+		    server = *++av;
+		    ac--;
+		    break;
+		case 't':
+		    if (ac < 2)
+			usage();
+		    secs = atoi(*++av);
+		    ac--;
+		    break;
+		default:
+		    usage();
+		}
+	}
+	if (ac > 0 || ndrivers < 1 || nclients < 1 || rate < 1 || secs < 1)
+	    usage();
+
+	/* a client dying must not kill us */
+	signal (SIGPIPE, SIG_IGN);
+
+	printf ("%d drivers at %d msgs/sec, %d clients, %d secs per mode\n",
+					ndrivers, rate, nclients, secs);
+	for (i = 0; i < 2; i++) {
+	    if (runMode (i, &msgrate[i], &cpu[i], &nthreads[i]) < 0)
+		exit (1);
+	    printf ("%-8s: %9.0f msgs/sec delivered, indiserver cpu %5.1f%%, %4d threads, %6.2f us cpu/msg\n",
+	    			modes[i], msgrate[i], 100*cpu[i], nthreads[i],
+				msgrate[i] > 0 ? 1e6*cpu[i]/msgrate[i] : 0);
+	    fflush (stdout);
+	}
+
+	return (0);
+}
+
+static void
+usage (void)
+{
+	fprintf (stderr, "Usage: %s [options]\n", me);
+	fprintf (stderr, "Purpose: compare indiserver with threads and with -e under load\n");
+	fprintf (stderr, "Options:\n");
+	fprintf (stderr, " -c n : number of clients, default %d\n", DEFNCLIENTS);
+	fprintf (stderr, " -d n : number of drivers, default %d\n", DEFNDRIVERS);
+	fprintf (stderr, " -p p : port for indiserver, default %d\n", DEFPORT);
+	fprintf (stderr, " -r r : messages per second from each driver, default %d\n", DEFRATE);
+	fprintf (stderr, " -s s : indiserver to run, default indiserver\n");
+	fprintf (stderr, " -t t : seconds to measure each mode, default %d\n", DEFSECS);
+	exit (2);
+}
+
+/* be one driver: define one number vector then update it at rate until
+ * indiserver goes away.
+ */
+static void
+runDriver (void)
+{
+	char dev[64], buf[1024];
+	double t0, period;
+	long n;
+	int l;
+
+	rate = getenv ("INDILOAD_RATE") ? atoi (getenv ("INDILOAD_RATE")) : DEFRATE;
+	period = 1.0/(rate > 0 ? rate : DEFRATE);
+	snprintf (dev, sizeof(dev), "load%d", (int)getpid());
+
+	/* we don't care what indiserver sends us, just don't let the pipe fill */
+	fcntl (0, F_SETFL, fcntl (0, F_GETFL, 0) | O_NONBLOCK);
+
+	l = snprintf (buf, sizeof(buf),
+	    "<defNumberVector device='%s' name='temp' state='Ok' perm='ro'>\n"
+	    "  <defNumber name='current' format='%%g' min='0' max='0' step='0'>0</defNumber>\n"
+	    "  <defNumber name='target' format='%%g' min='0' max='0' step='0'>0</defNumber>\n"
+	    "</defNumberVector>\n", dev);
+	if (write (1, buf, l) != l)
+	    exit (0);
+
+	t0 = now();
+	for (n = 0; ; n++) {
+	    double dt = t0 + n*period - now();
+
+	    if (dt > 0) {
+		struct pollfd pfd = {0, POLLIN, 0};
+		(void) poll (&pfd, 1, (int)(dt*1000));
+	    }
+	    while (read (0, buf, sizeof(buf)) > 0)
+		continue;
+
+	    l = snprintf (buf, sizeof(buf),
+		"<setNumberVector device='%s' name='temp' state='Ok' timestamp='2024-01-01T00:00:00.000000Z'>\n"
+		"  <oneNumber name='current'>\n%ld\n  </oneNumber>\n"
+		"  <oneNumber name='target'>\n-15\n  </oneNumber>\n"
+		"</setNumberVector>\n", dev, n);
+	    if (write (1, buf, l) != l)
+		exit (0);
+	}
+}
+
+/* run indiserver in one mode, connect the clients and measure.
+ * return 0 if ok, else -1.
+ */
+static int
+runMode (int evloop, double *msgrate, double *cpu, int *nthreads)
+{
+	char rate_env[32], port_str[16], self[1024];
+	char **args;
+	struct pollfd *pfds;
+	char (*carry)[sizeof(TAG)];
+	int *ncarry;
+	long nmsgs, ticks0, ticks1;
+	double t0, t1, tend;
+	int pid, i, n;
+
+	/* each driver is us */
+	n = readlink ("/proc/self/exe", self, sizeof(self)-1);
+	if (n < 0) {
+	    fprintf (stderr, "/proc/self/exe: %s\n", strerror(errno));
+	    return (-1);
+	}
+	self[n] = '\0';
+
+	/* indiserver [-e] -n -p port driver ... */
+	args = (char **) calloc (ndrivers + 6, sizeof(char *));
+	n = 0;
+	args[n++] = server;
+	if (evloop)
+	    args[n++] = "-e";
+	args[n++] = "-n";
+	args[n++] = "-p";
+	snprintf (port_str, sizeof(port_str), "%d", port);
+	args[n++] = port_str;
+	for (i = 0; i < ndrivers; i++)
+	    args[n++] = self;
+	args[n] = NULL;
+
+	snprintf (rate_env, sizeof(rate_env), "%d", rate);
+	setenv ("INDILOAD_DRIVER", "1", 1);
+	setenv ("INDILOAD_RATE", rate_env, 1);
+
+	pid = fork();
+	if (pid < 0) {
+	    fprintf (stderr, "fork: %s\n", strerror(errno));
+	    return (-1);
+	}
+	if (pid == 0) {
+	    /* quiet, we only want our own report */
+	    int fd = open ("/dev/null", O_WRONLY);
+	    dup2 (fd, 2);
+	    execvp (server, args);
+	    _exit (1);
+	}
+	unsetenv ("INDILOAD_DRIVER");
+
+	/* connect clients, each wanting everything */
+	pfds = (struct pollfd *) calloc (nclients, sizeof(struct pollfd));
+	carry = calloc (nclients, sizeof(*carry));
+	ncarry = (int *) calloc (nclients, sizeof(int));
+	for (i = 0; i < nclients; i++) {
+	    static char gp[] = "<getProperties version='1.7'/>\n";
+	    pfds[i].fd = connectClient();
+	    if (pfds[i].fd < 0) {
+		kill (pid, SIGKILL);
+		waitpid (pid, NULL, 0);
+		return (-1);
+	    }
+	    pfds[i].events = POLLIN;
+	    if (write (pfds[i].fd, gp, sizeof(gp)-1) < 0)
+		fprintf (stderr, "client %d: %s\n", i, strerror(errno));
+	}
+
+	/* read everything, count messages once warmed up */
+	nmsgs = 0;
+	t0 = now();
+	tend = t0 + WARMSECS + secs;
+	ticks0 = -1;
+	t1 = t0;
+	while ((t1 = now()) < tend) {
+	    int measuring = t1 >= t0 + WARMSECS;
+
+	    if (measuring && ticks0 < 0) {
+		ticks0 = cpuTicks (pid);
+		t0 = t1 - WARMSECS;
+		nmsgs = 0;
+	    }
+
+	    if (poll (pfds, nclients, 100) < 0)
+		continue;
+	    for (i = 0; i < nclients; i++) {
+		char buf[65536 + sizeof(TAG)];
+		char *cp, *end;
+		int nr;
+
+		if (!(pfds[i].revents & (POLLIN|POLLHUP|POLLERR)))
+		    continue;
+		memcpy (buf, carry[i], ncarry[i]);
+		nr = read (pfds[i].fd, buf + ncarry[i], 65536);
+		if (nr <= 0) {
+		    fprintf (stderr, "client %d: %s\n", i, nr < 0 ? strerror(errno) : "EOF");
+		    pfds[i].fd = -1;
+		    continue;
+		}
+		nr += ncarry[i];
+
+		/* count tags, keeping any partial one for next time */
+		end = buf + nr;
+		for (cp = buf; (cp = memchr (cp, '<', end - cp)) != NULL; cp++) {
+		    if (end - cp < (long)sizeof(TAG)-1)
+			break;
+		    if (!memcmp (cp, TAG, sizeof(TAG)-1))
+			nmsgs++;
+		}
+		ncarry[i] = cp ? end - cp : 0;
+		memcpy (carry[i], cp ? cp : buf, ncarry[i]);
+	    }
+	}
+	ticks1 = cpuTicks (pid);
+	*nthreads = nThreads (pid);
+
+	*msgrate = nmsgs/(t1 - t0 - WARMSECS);
+	*cpu = (ticks1 - ticks0)/(double)sysconf(_SC_CLK_TCK)/(t1 - t0 - WARMSECS);
+
+	/* drivers exit when their stdout closes */
+	for (i = 0; i < nclients; i++)
+	    if (pfds[i].fd >= 0)
+		close (pfds[i].fd);
+	kill (pid, SIGTERM);
+	waitpid (pid, NULL, 0);
+	sleep (1);
+
+	free (pfds);
+	free (carry);
+	free (ncarry);
+	free (args);
+
+	return (0);
+}
+
+/* connect to indiserver on port, waiting a while for it to start.
+ * return socket or -1.
+ */
+static int
+connectClient (void)
+{
+	struct sockaddr_in serv_addr;
+	struct timespec ts = {0, 100000000};	/* 0.1 s between tries */
+	int tries, sockfd;
+
+	memset (&serv_addr, 0, sizeof(serv_addr));
+	serv_addr.sin_family = AF_INET;
+	serv_addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+	serv_addr.sin_port = htons ((unsigned short)port);
+
+	for (tries = 0; tries < 50; tries++) {
+	    sockfd = socket (AF_INET, SOCK_STREAM, 0);
+	    if (sockfd < 0) {
+		fprintf (stderr, "socket: %s\n", strerror(errno));
+		return (-1);
+	    }
+	    if (connect (sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) == 0)
+		return (sockfd);
+	    close (sockfd);
+	    nanosleep (&ts, NULL);
+	}
+
+	fprintf (stderr, "can not connect to %s on port %d\n", server, port);
+	return (-1);
+}
+
+/* return user+system clock ticks used so far by pid, or -1.
+ */
+static long
+cpuTicks (int pid)
+{
+	char fn[64], buf[1024], *cp;
+	unsigned long utime, stime;
+	FILE *fp;
+
+	snprintf (fn, sizeof(fn), "/proc/%d/stat", pid);
+	fp = fopen (fn, "r");
+	if (!fp)
+	    return (-1);
+	cp = fgets (buf, sizeof(buf), fp);
+	fclose (fp);
+
+	/* fields after the parenthesized command name, utime and stime are 14 and 15 */
+	if (!cp || !(cp = strrchr (buf, ')')))
+	    return (-1);
+	if (sscanf (cp + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+						    &utime, &stime) != 2)
+	    return (-1);
+	return (utime + stime);
+}
+
+/* return number of threads in pid, or -1.
+ */
+static int
+nThreads (int pid)
+{
+	char fn[64], buf[256];
+	int n = -1;
+	FILE *fp;
+
+	snprintf (fn, sizeof(fn), "/proc/%d/status", pid);
+	fp = fopen (fn, "r");
+	if (!fp)
+	    return (-1);
+	while (fgets (buf, sizeof(buf), fp))
+	    if (sscanf (buf, "Threads: %d", &n) == 1)
+		break;
+	fclose (fp);
+	return (n);
+}
+
+/* return the time now in seconds.
+ */
+static double
+now (void)
+{
+	struct timeval tv;
+
+	gettimeofday (&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec*1e-6);
+}
@@ -0,0 +1,223 @@
+/// IndiBinaryWriter.cpp
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+#include <stdexcept>
+#include "IndiElement.hpp"
+#include "IndiBinaryWriter.hpp"
+#include "../INDI/indibin.h"
+
+using std::string;
+using std::runtime_error;
+using pcf::IndiElement;
+using pcf::IndiElementMap;
+using pcf::IndiProperty;
+using pcf::IndiBinaryWriter;
+using pcf::TimeStamp;
+
+namespace
+{
+////////////////////////////////////////////////////////////////////////////////
+/// Append the bytes of 'tValue', in host byte order.
+
+template <class TT> void appendRaw( string &szOut, const TT &tValue )
+{
+  szOut.append( reinterpret_cast<const char *>( &tValue ), sizeof( TT ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Append the common frame header. The length is filled in by 'endFrame'.
+
+void beginFrame( string &szOut, const char &cKind, const size_t &nNumElements )
+{
+  if ( nNumElements > 0xffff )
+    throw runtime_error( "INDI binary frame has too many elements." );
+
+  szOut += char( IBF_MAGIC );
+  szOut += cKind;
+  appendRaw( szOut, uint16_t( nNumElements ) );
+  appendRaw( szOut, uint32_t( 0 ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Write the length of the frame which starts at 'nStart' into its header.
+
+void endFrame( string &szOut, const size_t &nStart )
+{
+  size_t nLen = szOut.size() - nStart;
+  if ( nLen > IBF_MAXLEN )
+    throw runtime_error( "INDI binary frame is too long." );
+
+  uint32_t uiLen = nLen;
+  ::memcpy( &szOut[nStart + 4], &uiLen, 4 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Append a text value, with its length first.
+
+void appendText( string &szOut, const string &szText )
+{
+  szOut += char( IBF_VTEXT );
+  appendRaw( szOut, uint32_t( szText.size() ) );
+  szOut += szText;
+}
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+/// Can a set property message for this property be sent as a frame?
+
+bool IndiBinaryWriter::canWriteSetProperty( const IndiProperty &ipSend )
+{
+  switch ( ipSend.getType() )
+  {
+    case IndiProperty::Light:
+    case IndiProperty::Number:
+    case IndiProperty::Switch:
+    case IndiProperty::Text:
+      return ( ipSend.hasValidMessage() == false );
+    default:
+      return false;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Append the DEF frame: the id, the type, then the device, name and each
+/// element name, each null terminated.
+
+void IndiBinaryWriter::appendDefine( string &szOut,
+                                     const unsigned int &uiId,
+                                     const IndiProperty &ipSend )
+{
+  char cType = 0;
+
+  switch ( ipSend.getType() )
+  {
+    case IndiProperty::Light: cType = IBF_LIGHT; break;
+    case IndiProperty::Number: cType = IBF_NUMBER; break;
+    case IndiProperty::Switch: cType = IBF_SWITCH; break;
+    case IndiProperty::Text: cType = IBF_TEXT; break;
+    default:
+      throw runtime_error( "INDI property type can not be sent as a binary frame." );
+  }
+  if ( uiId > IBF_MAXID )
+    throw runtime_error( "INDI binary frame id is too large." );
+  if ( ipSend.hasValidDevice() == false || ipSend.hasValidName() == false )
+    throw runtime_error( "INDI binary frame '" + ipSend.getName() +
+                         "' must have 'device' and 'name' defined." );
+
+  const IndiElementMap &mapElements = ipSend.getElements();
+  size_t nStart = szOut.size();
+
+  beginFrame( szOut, IBF_DEF, mapElements.size() );
+  appendRaw( szOut, uint32_t( uiId ) );
+  szOut += cType;
+  szOut.append( 3, '\0' );
+
+  szOut += ipSend.getDevice();
+  szOut += '\0';
+  szOut += ipSend.getName();
+  szOut += '\0';
+
+  IndiElementMap::const_iterator itr = mapElements.begin();
+  for ( ; itr != mapElements.end(); ++itr )
+  {
+    if ( itr->second.hasValidName() == false )
+      throw runtime_error( "INDI binary frame element must have 'name' defined." );
+    szOut += itr->second.getName();
+    szOut += '\0';
+  }
+
+  endFrame( szOut, nStart );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Append the SET frame. A number which can be written as %.15g, giving the
+/// same text the element holds, is sent as a double. Anything else, like a
+/// number set from text or an unknown switch state, is sent as its text.
+
+void IndiBinaryWriter::appendSetProperty( string &szOut,
+                                          const unsigned int &uiId,
+                                          const IndiProperty &ipSend,
+                                          const TimeStamp &tsSend )
+{
+  unsigned char ucState = IBF_NOSTATE;
+  unsigned char ucFlags = 0;
+
+  switch ( ipSend.getState() )
+  {
+    case IndiProperty::Idle: ucState = 0; break;
+    case IndiProperty::Ok: ucState = 1; break;
+    case IndiProperty::Busy: ucState = 2; break;
+    case IndiProperty::Alert: ucState = 3; break;
+    default: break;
+  }
+  if ( ipSend.getType() != IndiProperty::Light && ipSend.hasValidTimeout() == true )
+    ucFlags |= IBF_HASTIMEOUT;
+
+  const IndiElementMap &mapElements = ipSend.getElements();
+  size_t nStart = szOut.size();
+
+  beginFrame( szOut, IBF_SET, mapElements.size() );
+  appendRaw( szOut, uint32_t( uiId ) );
+  szOut += char( ucState );
+  szOut += char( ucFlags );
+  szOut.append( 2, '\0' );
+  appendRaw( szOut, int64_t( tsSend.getTimeValSecs() ) );
+  appendRaw( szOut, int32_t( tsSend.getTimeValMicros() ) );
+  szOut.append( 4, '\0' );
+  appendRaw( szOut, double( ( ucFlags & IBF_HASTIMEOUT ) ? ipSend.getTimeout() : 0 ) );
+
+  IndiElementMap::const_iterator itr = mapElements.begin();
+  for ( ; itr != mapElements.end(); ++itr )
+  {
+    const IndiElement &ieSend = itr->second;
+
+    switch ( ipSend.getType() )
+    {
+      case IndiProperty::Number:
+      {
+        // Integers are kept as '%lld', which only matches '%.15g' below 1e15.
+        double xValue = 0;
+        if ( ieSend.getNumber( xValue ) == true &&
+             ( xValue != std::floor( xValue ) || std::fabs( xValue ) < 1e15 ) )
+        {
+          szOut += char( IBF_VDOUBLE );
+          appendRaw( szOut, xValue );
+        }
+        else
+        {
+          appendText( szOut, ieSend.getValue() );
+        }
+        break;
+      }
+      case IndiProperty::Switch:
+        switch ( ieSend.getSwitchState() )
+        {
+          case IndiElement::Off: szOut += char( IBF_VSTATE ); szOut += char( 0 ); break;
+          case IndiElement::On: szOut += char( IBF_VSTATE ); szOut += char( 1 ); break;
+          default: appendText( szOut, "" ); break;
+        }
+        break;
+      case IndiProperty::Light:
+        switch ( ieSend.getLightState() )
+        {
+          case IndiElement::Idle: szOut += char( IBF_VSTATE ); szOut += char( 0 ); break;
+          case IndiElement::Ok: szOut += char( IBF_VSTATE ); szOut += char( 1 ); break;
+          case IndiElement::Busy: szOut += char( IBF_VSTATE ); szOut += char( 2 ); break;
+          case IndiElement::Alert: szOut += char( IBF_VSTATE ); szOut += char( 3 ); break;
+          default: appendText( szOut, "" ); break;
+        }
+        break;
+      default:
+        appendText( szOut, ieSend.getValue() );
+        break;
+    }
+  }
+
+  endFrame( szOut, nStart );
+}
+
+////////////////////////////////////////////////////////////////////////////////
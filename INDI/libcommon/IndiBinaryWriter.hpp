@@ -0,0 +1,50 @@
+/// IndiBinaryWriter.hpp
+///
+/// Writes the binary frames described in INDI/indibin.h, which a driver can
+/// send to a local indiserver in place of the XML of a set property message.
+/// A DEF frame gives a property an id and lists its element names once, then
+/// each SET frame carries only the id, the attributes and the values.
+/// indiserver turns a SET back into the XML IndiXmlWriter would have written.
+///
+/// Like IndiXmlWriter, the string is appended to so it can be reused.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INDI_BINARY_WRITER_HPP
+#define INDI_BINARY_WRITER_HPP
+#pragma once
+
+#include <string>
+#include "IndiProperty.hpp"
+#include "TimeStamp.hpp"
+
+namespace pcf
+{
+class IndiBinaryWriter
+{
+  // Methods.
+  public:
+    /// Can a set property message for this property be sent as a frame?
+    /// This is true for lights, numbers, switches, and text, as long as
+    /// there is no message, which is always sent as XML.
+    static bool canWriteSetProperty( const pcf::IndiProperty &ipSend );
+    /// Append the DEF frame which assigns 'uiId' to 'ipSend' to 'szOut'.
+    /// The element names are listed in the order they were added. Throws
+    /// if the device, name, or an element name is missing.
+    static void appendDefine( std::string &szOut,
+                              const unsigned int &uiId,
+                              const pcf::IndiProperty &ipSend );
+    /// Append the SET frame for 'ipSend' to 'szOut', using 'tsSend' as
+    /// the timestamp. 'uiId' must have been defined for this property
+    /// with the same type and elements.
+    static void appendSetProperty( std::string &szOut,
+                                   const unsigned int &uiId,
+                                   const pcf::IndiProperty &ipSend,
+                                   const pcf::TimeStamp &tsSend );
+
+}; // class IndiBinaryWriter
+} // namespace pcf
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // INDI_BINARY_WRITER_HPP
@@ -15,6 +15,9 @@
 #include <sys/time.h>  // provides 'setrlimit'
 #include <sys/resource.h>  // provides 'setrlimit'
 #include "IndiConnection.hpp"
+#include "IndiXmlWriter.hpp"
+#include "IndiBinaryWriter.hpp"
+#include "../INDI/indibin.h"
 #include "TimeStamp.hpp"
 
 using std::exception;
@@ -26,8 +29,11 @@ using std::endl;
 using pcf::TimeStamp;
 using pcf::IndiConnection;
 using pcf::IndiXmlParser;
+using pcf::IndiXmlWriter;
+using pcf::IndiBinaryWriter;
 using pcf::IndiMessage;
 using pcf::IndiProperty;
+using pcf::IndiElementMap;
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -274,7 +280,6 @@ void IndiConnection::process()
 
       // The length of the command received.
       int nInputBufLen = 0;
-      ::memset( &m_vecInputBuf[0], 0, InputBufSize );
 
       // Create and clear out the FD set.
       fd_set fdsRead;
@@ -309,8 +314,27 @@ void IndiConnection::process()
       // We must check the input file descriptor.
       else if ( FD_ISSET( m_fdInput, &fdsRead ) != 0 )
       {
-        // Receive a command
-        nInputBufLen = ::read( m_fdInput, &m_vecInputBuf[0], InputBufSize );
+        // Make sure there is room to read more. The buffer only grows past
+        // its normal size if a single message is larger than it.
+        if ( m_vecInputBuf.size() - m_nInputBufLen < InputBufSize / 2 )
+        {
+          if ( m_vecInputBuf.size() >= MaxInputBufSize )
+          {
+            // A message this long is never going to end, so drop it.
+            std::cerr << "Error processing XML: message longer than "
+                      << MaxInputBufSize << " bytes discarded." << std::endl;
+            m_ispIndi.clear();
+            m_nInputBufLen = 0;
+          }
+          else
+          {
+            m_vecInputBuf.resize( 2 * m_vecInputBuf.size() );
+          }
+        }
+
+        // Receive a command, after any partial message from the last read.
+        nInputBufLen = ::read( m_fdInput, &m_vecInputBuf[m_nInputBufLen],
+                               m_vecInputBuf.size() - m_nInputBufLen );
         if ( nInputBufLen < 0 )
         {
           m_oQuitProcess = true;
@@ -322,25 +346,53 @@ void IndiConnection::process()
         }
         else
         {
+          m_nInputBufLen += nInputBufLen;
+
           // A message for the error.
           std::string szErrorMsg;
-          // Now, is this a command which fits our requirements?
-          m_ixpIndi.parseXml( ( char * )( &m_vecInputBuf[0] ), nInputBufLen, szErrorMsg );
+          IndiMessage imRecv;
+          bool oComplete = false;
 
-          while( m_ixpIndi.getState() == IndiXmlParser::CompleteState )
+          // Parse and dispatch each complete message in place.
+          size_t nPos = 0;
+          while ( nPos < m_nInputBufLen )
           {
-            // Create the message from the XML.
-            IndiMessage imRecv = m_ixpIndi.createIndiMessage();
-            const IndiProperty &ipRecv = imRecv.getProperty();
-
-            // Dispatch!
-            dispatch( imRecv.getType(), ipRecv );
+            size_t nUsed = m_ispIndi.parse( ( char * )( m_vecInputBuf.data() + nPos ),
+                                            m_nInputBufLen - nPos,
+                                            imRecv, oComplete, szErrorMsg );
+            nPos += nUsed;
+
+            if ( oComplete == true )
+            {
+              // Dispatch! An error here must not stop the rest of the
+              // buffer being parsed, or the messages would be repeated.
+              try
+              {
+                dispatch( imRecv.getType(), imRecv.getProperty() );
+              }
+              catch ( const exception &excep )
+              {
+              }
+            }
+            else if ( nUsed == 0 )
+            {
+              // The rest is an incomplete message.
+              break;
+            }
+          }
 
-            // Get ready for some new XML.
-            //m_ixpIndi.clear();
+          // Move the incomplete message, if any, to the front of the buffer.
+          if ( nPos > 0 )
+          {
+            m_nInputBufLen -= nPos;
+            ::memmove( m_vecInputBuf.data(), m_vecInputBuf.data() + nPos, m_nInputBufLen );
+          }
 
-            //Test whether there is more unparsed data.
-            m_ixpIndi.parseXml( "", szErrorMsg);
+          // Give back the memory used by an unusually large message.
+          if ( m_nInputBufLen == 0 && m_vecInputBuf.size() > InputBufSize )
+          {
+            m_vecInputBuf.resize( InputBufSize );
+            m_vecInputBuf.shrink_to_fit();
           }
         }
       }
@@ -364,10 +416,120 @@ void IndiConnection::process()
 void IndiConnection::sendXml( const string &szXml ) const
 {
   MutexLock::AutoLock autoOut( &m_mutOutput );
-  int nNumPrinted = ::dprintf( m_fdOutput, "%s", szXml.c_str() );
-  //if ( fflush( m_fdOutput ) != 0 || nNumPrinted < (int)( szXml.length() ) )
-  if ( nNumPrinted < ( int )( szXml.length() ) )
+  writeOutput( szXml.c_str(), szXml.length() );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief IndiConnection::sendSetPropertyXml
+/// Writes a set property message straight to the file descriptor. The XML
+/// is built in m_szOutputBuf, which keeps its capacity between calls, so
+/// there is no allocation once it has grown to the largest message.
+/// \param ipSend The property to send. It must not be a BLOB.
+/// \param tsSend The timestamp to send with it.
+
+void IndiConnection::sendSetPropertyXml( const IndiProperty &ipSend,
+                                         const TimeStamp &tsSend ) const
+{
+  MutexLock::AutoLock autoOut( &m_mutOutput );
+  m_szOutputBuf.clear();
+  IndiXmlWriter::appendSetProperty( m_szOutputBuf, ipSend, tsSend );
+  writeOutput( m_szOutputBuf.data(), m_szOutputBuf.size() );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief IndiConnection::sendSetPropertyBinary
+/// Writes a set property message as a binary frame. The first time a
+/// property is sent it is given the next id, and a DEF frame listing its
+/// element names goes out with the SET frame, in the same write. The DEF
+/// is sent again after 'resetBinaryIds', or if the elements have changed.
+/// \param ipSend The property to send. It must pass
+/// IndiBinaryWriter::canWriteSetProperty.
+/// \param tsSend The timestamp to send with it.
+/// \return False if nothing was sent because the ids have run out.
+
+bool IndiConnection::sendSetPropertyBinary( const IndiProperty &ipSend,
+                                            const TimeStamp &tsSend ) const
+{
+  MutexLock::AutoLock autoOut( &m_mutOutput );
+
+  m_szBinaryKey = ipSend.getDevice();
+  m_szBinaryKey += '\0';
+  m_szBinaryKey += ipSend.getName();
+
+  std::map<string, BinaryId>::iterator itr = m_mapBinaryIds.find( m_szBinaryKey );
+  if ( itr == m_mapBinaryIds.end() )
+  {
+    if ( m_mapBinaryIds.size() > IBF_MAXID )
+      return false;
+
+    BinaryId biNew;
+    biNew.m_uiId = m_mapBinaryIds.size();
+    biNew.m_oIsDefined = false;
+    biNew.m_tType = IndiProperty::Unknown;
+    itr = m_mapBinaryIds.insert( std::make_pair( m_szBinaryKey, biNew ) ).first;
+  }
+  BinaryId &biSend = itr->second;
+
+  // The element names must match the DEF, in the same order.
+  const IndiElementMap &mapElements = ipSend.getElements();
+  bool oIsSame = ( biSend.m_oIsDefined == true &&
+                   biSend.m_tType == ipSend.getType() &&
+                   biSend.m_vecNames.size() == mapElements.size() );
+  IndiElementMap::const_iterator itrElement = mapElements.begin();
+  for ( unsigned int ii = 0; oIsSame == true && ii < biSend.m_vecNames.size(); ii++, ++itrElement )
+    oIsSame = ( biSend.m_vecNames[ii] == itrElement->first );
+
+  m_szOutputBuf.clear();
+  if ( oIsSame == false )
+  {
+    IndiBinaryWriter::appendDefine( m_szOutputBuf, biSend.m_uiId, ipSend );
+    biSend.m_oIsDefined = true;
+    biSend.m_tType = ipSend.getType();
+    biSend.m_vecNames.clear();
+    for ( itrElement = mapElements.begin(); itrElement != mapElements.end(); ++itrElement )
+      biSend.m_vecNames.push_back( itrElement->first );
+  }
+  IndiBinaryWriter::appendSetProperty( m_szOutputBuf, biSend.m_uiId, ipSend, tsSend );
+  writeOutput( m_szOutputBuf.data(), m_szOutputBuf.size() );
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief IndiConnection::resetBinaryIds
+/// Forget which binary ids have been defined. This is done whenever a
+/// 'getProperties' arrives, since the reader may have been restarted.
+
+void IndiConnection::resetBinaryIds() const
+{
+  MutexLock::AutoLock autoOut( &m_mutOutput );
+
+  std::map<string, BinaryId>::iterator itr = m_mapBinaryIds.begin();
+  for ( ; itr != m_mapBinaryIds.end(); ++itr )
+    itr->second.m_oIsDefined = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \brief IndiConnection::writeOutput
+/// Write all the bytes to the output file descriptor. A partial write, or
+/// one interrupted by a signal, is continued. Any other error drops the
+/// rest of the message, as there is nobody to report it to.
+/// \param pcData The bytes to write.
+/// \param nNumBytes How many bytes to write.
+
+void IndiConnection::writeOutput( const char *pcData,
+                                  const size_t &nNumBytes ) const
+{
+  size_t nNumWritten = 0;
+  while ( nNumWritten < nNumBytes )
   {
+    ssize_t nNum = ::write( m_fdOutput, pcData + nNumWritten,
+                            nNumBytes - nNumWritten );
+    if ( nNum < 0 && errno == EINTR )
+      continue;
+    if ( nNum <= 0 )
+      break;
+    nNumWritten += nNum;
   }
 }
 
@@ -10,6 +10,7 @@
 #ifndef PCF_INDI_CONNECTION_HPP
 #define PCF_INDI_CONNECTION_HPP
 
+#include <map>
 #include <string>
 #include <vector>
 #include "Thread.hpp"
@@ -17,6 +18,7 @@
 #include "TimeStamp.hpp"
 //#include "ConfigFile.hpp"
 #include "IndiXmlParser.hpp"
+#include "IndiStreamParser.hpp"
 #include "IndiMessage.hpp"
 #include "IndiProperty.hpp"
 
@@ -31,6 +33,9 @@ class IndiConnection : public pcf::Thread
     {
       // This is the size of the input buffer to hold the incoming commands.
       InputBufSize = 65536,
+      // The input buffer only grows this large for one message. A message
+      // which is still not complete is discarded.
+      MaxInputBufSize = 64 * 1024 * 1024,
     };
 
   // construction/destruction/assign/copy
@@ -103,6 +108,21 @@ class IndiConnection : public pcf::Thread
     /// Sends an XML string out to a file descriptor. If there is an error,
     /// it will be logged.
     virtual void sendXml( const std::string &szXml ) const;
+    /// Writes a set property message straight to the file descriptor,
+    /// using 'tsSend' as the timestamp. The XML is built in a reusable
+    /// buffer, without copying the property. BLOBs are not supported.
+    void sendSetPropertyXml( const pcf::IndiProperty &ipSend,
+                             const pcf::TimeStamp &tsSend ) const;
+    /// Writes a set property message as a binary frame (see
+    /// IndiBinaryWriter), preceded by a DEF frame if the property has not
+    /// been defined since the last 'resetBinaryIds', or has changed its
+    /// type or elements. Returns false, having sent nothing, if there are
+    /// no ids left, so the caller can send the XML instead.
+    bool sendSetPropertyBinary( const pcf::IndiProperty &ipSend,
+                                const pcf::TimeStamp &tsSend ) const;
+    /// Forget which binary ids have been defined, so each property is sent
+    /// with a DEF frame again. The ids themselves are kept.
+    void resetBinaryIds() const;
 
     /// Which FD will be used for input?
     void setInputFd( const int &iFd );
@@ -131,6 +151,9 @@ class IndiConnection : public pcf::Thread
     /// Passing a pointer back to this class allows us to call the 'runLoop'
     /// function from within the new thread.
     static void *pthreadProcess( void *pUnknown );
+    /// Write all the bytes to the output file descriptor, retrying after
+    /// a partial write. The output mutex must be held.
+    void writeOutput( const char *pcData, const size_t &nNumBytes ) const;
 
   // Variables
   private:
@@ -144,6 +167,9 @@ class IndiConnection : public pcf::Thread
     int m_iCpuAffinity;
     /// allocate a big buffer to hold the input data.
     std::vector<unsigned char> m_vecInputBuf;
+    /// How many bytes of m_vecInputBuf hold data not yet parsed. This is
+    /// the start of a message which has not been completely received.
+    size_t m_nInputBufLen {0};
     
     /// The flag to tell this to quit.
     //Changed from static to prevent app-wide INDI shutdown.
@@ -151,8 +177,26 @@ class IndiConnection : public pcf::Thread
     
     /// This is the object that conglomerates all the INDI XML
     pcf::IndiXmlParser m_ixpIndi;
+    /// This parses the incoming messages in place in m_vecInputBuf.
+    pcf::IndiStreamParser m_ispIndi;
     /// A mutex to protect output.
     mutable pcf::MutexLock m_mutOutput;
+    /// The reusable buffer for the messages written by 'sendSetPropertyXml'.
+    /// This is protected by m_mutOutput.
+    mutable std::string m_szOutputBuf;
+    /// What was last defined for a binary id.
+    struct BinaryId
+    {
+      unsigned int m_uiId;
+      bool m_oIsDefined;
+      pcf::IndiProperty::Type m_tType;
+      std::vector<std::string> m_vecNames;
+    };
+    /// The binary ids, keyed by the device and name separated by a null.
+    /// These are protected by m_mutOutput.
+    mutable std::map<std::string, BinaryId> m_mapBinaryIds;
+    /// The reusable key to look up m_mapBinaryIds.
+    mutable std::string m_szBinaryKey;
     /// The file descriptor to read from.
     int m_fdInput;
     /// The file descriptor to write to.
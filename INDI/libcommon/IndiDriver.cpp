@@ -6,6 +6,8 @@
 
 #include "IndiDriver.hpp"
 #include "System.hpp"
+#include "IndiXmlWriter.hpp"
+#include "IndiBinaryWriter.hpp"
 
 using std::runtime_error;
 using std::string;
@@ -18,6 +20,8 @@ using pcf::IndiConnection;
 using pcf::IndiDriver;
 using pcf::IndiMessage;
 using pcf::IndiProperty;
+using pcf::IndiXmlWriter;
+using pcf::IndiBinaryWriter;
 
 ////////////////////////////////////////////////////////////////////////////////
 /// Standard constructor.
@@ -96,6 +100,10 @@ void IndiDriver::setup()
   // decide whether or not to send an alarm email.
   m_oIsAlarmModeEnabled = true;
 
+  // Set property messages are sent as XML unless the user of this class
+  // knows the reader is a local indiserver which accepts binary frames.
+  m_oIsBinaryModeEnabled = false;
+
   // This is a comma-separated list of email recipients which will receive
   // an email when a alarm is logged.
   m_szEmailList = "";
@@ -161,6 +169,9 @@ void IndiDriver::dispatch( const IndiMessage::Type &tType,
   // Make sure the client knows about the basic properties the driver supports.
   if ( tType == IndiMessage::GetProperties )
   {
+    // The reader may have restarted, so define the binary ids again.
+    if ( m_oIsBinaryModeEnabled == true )
+      resetBinaryIds();
     handleDriverGetProperties( ipDispatch );
   }
 
@@ -434,12 +445,22 @@ void IndiDriver::sendMessage( const IndiProperty &ipSend )
 
 void IndiDriver::sendSetProperty( const IndiProperty &ipSend ) const
 {
-   IndiProperty _ipSend = ipSend;
-   
-   _ipSend.setTimeStamp(TimeStamp::now());
-   
   if ( isResponseModeEnabled() == true )
   {
+    // Most properties are written straight to the output, without a copy.
+    if ( m_oIsBinaryModeEnabled == true &&
+         IndiBinaryWriter::canWriteSetProperty( ipSend ) == true &&
+         sendSetPropertyBinary( ipSend, TimeStamp::now() ) == true )
+      return;
+    if ( IndiXmlWriter::canWriteSetProperty( ipSend ) == true )
+    {
+      sendSetPropertyXml( ipSend, TimeStamp::now() );
+      return;
+    }
+
+    IndiProperty _ipSend = ipSend;
+    _ipSend.setTimeStamp( TimeStamp::now() );
+
     IndiXmlParser ixp( IndiMessage( IndiMessage::SetProperty, _ipSend ),
                        getProtocolVersion() );
     sendXml( ixp.createXmlString() );
@@ -456,6 +477,15 @@ void IndiDriver::sendSetProperties( const vector<IndiProperty> &vecIpSend )
   {
     for ( unsigned int ii = 0; ii < vecIpSend.size(); ii++ )
     {
+      if ( m_oIsBinaryModeEnabled == true &&
+           IndiBinaryWriter::canWriteSetProperty( vecIpSend[ii] ) == true &&
+           sendSetPropertyBinary( vecIpSend[ii], vecIpSend[ii].getTimeStamp() ) == true )
+        continue;
+      if ( IndiXmlWriter::canWriteSetProperty( vecIpSend[ii] ) == true )
+      {
+        sendSetPropertyXml( vecIpSend[ii], vecIpSend[ii].getTimeStamp() );
+        continue;
+      }
       IndiXmlParser ixp( IndiMessage( IndiMessage::SetProperty, vecIpSend[ii] ),
                          getProtocolVersion() );
       sendXml( ixp.createXmlString() );
@@ -479,6 +509,23 @@ void IndiDriver::enableAlarmMode( const bool &oEnable )
   m_oIsAlarmModeEnabled = oEnable;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+/// Are set property messages sent as binary frames? True if yes.
+
+bool IndiDriver::isBinaryModeEnabled() const
+{
+  return m_oIsBinaryModeEnabled;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Turn on or off sending set property messages as binary frames. Only
+/// turn this on if the output goes to a local indiserver.
+
+void IndiDriver::enableBinaryMode( const bool &oEnable )
+{
+  m_oIsBinaryModeEnabled = oEnable;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 /// Are we sending outgoing messages? True if yes, false otherwise.
 
@@ -76,6 +76,9 @@ class IndiDriver : public pcf::IndiConnection
 
     // Enables this device to send an email if an alarm is triggered.
     void enableAlarmMode( const bool &oEnable );
+    // Enables sending set property messages as binary frames, which only
+    // a local indiserver can read (see IndiBinaryWriter).
+    void enableBinaryMode( const bool &oEnable );
     // Enables the sending of outgoing messages, like 'SET', 'NEW', and 'DEF'.
     // If this is false no messages will be sent.
     void enableResponseMode( const bool & oEnable );
@@ -94,6 +97,8 @@ class IndiDriver : public pcf::IndiConnection
     pcf::TimeStamp getStartTime() const;
     // Are alarms being sent via email?
     bool isAlarmModeEnabled() const;
+    // Are set property messages sent as binary frames?
+    bool isBinaryModeEnabled() const;
     // Once we have seen at least 1 'GET PROPERTIES' message, we can send
     // 'SET', 'NEW', and 'DEF', but not before.
     bool isResponseModeEnabled() const;
@@ -149,6 +154,8 @@ class IndiDriver : public pcf::IndiConnection
     std::string m_szDataDirectory;
     // Are alarms enabled?
     bool m_oIsAlarmModeEnabled;
+    // Are set property messages sent as binary frames?
+    bool m_oIsBinaryModeEnabled;
     // Can we send outgoing messages? This can only happen after we
     // have received at least 1 'getProperties'.
     bool m_oIsResponseModeEnabled;
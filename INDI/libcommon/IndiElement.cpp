@@ -4,8 +4,10 @@
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <cstdio>
 #include <string>
 #include <sstream>
+#include <utility>
 #include <iostream>           // for std::cerr
 #include <stdexcept>          // for std::runtime_error
 #include "IndiElement.hpp"
@@ -226,6 +228,31 @@ IndiElement::IndiElement( const IndiElement &ieRhs )
   m_szSize = ieRhs.m_szSize;
   m_szStep = ieRhs.m_szStep;
   m_szValue = ieRhs.m_szValue;
+  m_tNumber = ieRhs.m_tNumber;
+  m_xValue = ieRhs.m_xValue;
+  m_llValue = ieRhs.m_llValue;
+  m_ullValue = ieRhs.m_ullValue;
+  m_lsValue = ieRhs.m_lsValue;
+  m_ssValue = ieRhs.m_ssValue;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///  Move constructor.
+
+IndiElement::IndiElement( IndiElement &&ieRhs )
+{
+  m_szFormat = std::move( ieRhs.m_szFormat );
+  m_szLabel = std::move( ieRhs.m_szLabel );
+  m_szMax = std::move( ieRhs.m_szMax );
+  m_szMin = std::move( ieRhs.m_szMin );
+  m_szName = std::move( ieRhs.m_szName );
+  m_szSize = std::move( ieRhs.m_szSize );
+  m_szStep = std::move( ieRhs.m_szStep );
+  m_szValue = std::move( ieRhs.m_szValue );
+  m_tNumber = ieRhs.m_tNumber;
+  m_xValue = ieRhs.m_xValue;
+  m_llValue = ieRhs.m_llValue;
+  m_ullValue = ieRhs.m_ullValue;
   m_lsValue = ieRhs.m_lsValue;
   m_ssValue = ieRhs.m_ssValue;
 }
@@ -254,6 +281,37 @@ const IndiElement &IndiElement::operator=( const IndiElement &ieRhs )
     m_szSize = ieRhs.m_szSize;
     m_szStep = ieRhs.m_szStep;
     m_szValue = ieRhs.m_szValue;
+    m_tNumber = ieRhs.m_tNumber;
+    m_xValue = ieRhs.m_xValue;
+    m_llValue = ieRhs.m_llValue;
+    m_ullValue = ieRhs.m_ullValue;
+    m_lsValue = ieRhs.m_lsValue;
+    m_ssValue = ieRhs.m_ssValue;
+  }
+  return *this;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Moves the internal data of an existing object into this one.
+
+const IndiElement &IndiElement::operator=( IndiElement &&ieRhs )
+{
+  if ( &ieRhs != this )
+  {
+    pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
+
+    m_szFormat = std::move( ieRhs.m_szFormat );
+    m_szLabel = std::move( ieRhs.m_szLabel );
+    m_szMax = std::move( ieRhs.m_szMax );
+    m_szMin = std::move( ieRhs.m_szMin );
+    m_szName = std::move( ieRhs.m_szName );
+    m_szSize = std::move( ieRhs.m_szSize );
+    m_szStep = std::move( ieRhs.m_szStep );
+    m_szValue = std::move( ieRhs.m_szValue );
+    m_tNumber = ieRhs.m_tNumber;
+    m_xValue = ieRhs.m_xValue;
+    m_llValue = ieRhs.m_llValue;
+    m_ullValue = ieRhs.m_ullValue;
     m_lsValue = ieRhs.m_lsValue;
     m_ssValue = ieRhs.m_ssValue;
   }
@@ -277,7 +335,7 @@ bool IndiElement::operator==( const IndiElement &ieRhs ) const
            m_szName == ieRhs.m_szName &&
            m_szSize == ieRhs.m_szSize &&
            m_szStep == ieRhs.m_szStep &&
-           m_szValue == ieRhs.m_szValue &&
+           readText() == ieRhs.readText() &&
            m_lsValue == ieRhs.m_lsValue &&
            m_ssValue == ieRhs.m_ssValue );
 }
@@ -291,7 +349,7 @@ string IndiElement::createString() const
   stringstream ssOutput;
   ssOutput << "{ "
            << "\"name\" : \"" << m_szName << "\" , "
-           << "\"value\" : \"" << m_szValue << "\" , "
+           << "\"value\" : \"" << readText() << "\" , "
            << "\"lightstate\" : \"" << getLightStateString( m_lsValue ) << "\" , "
            << "\"switchstate\" : \"" << getSwitchStateString( m_ssValue ) << "\" , "
            << "\"label\" : \"" << m_szLabel << "\" , "
@@ -320,6 +378,10 @@ void IndiElement::clear()
   m_szSize = "0";
   m_szStep = "0";
   m_szValue = "";
+  m_tNumber = NotNumber;
+  m_xValue = 0;
+  m_llValue = 0;
+  m_ullValue = 0;
   m_lsValue = UnknownLightState;
   m_ssValue = UnknownSwitchState;
 }
@@ -431,7 +493,7 @@ bool IndiElement::isNumeric() const
   pcf::ReadWriteLock::AutoRLock rwAuto( &m_rwData );
 
   int iValue;
-  std::stringstream ssValue( m_szValue );
+  std::stringstream ssValue( readText() );
 
   // Try to stream the data into the int variable.
   // If we fail, this value is not numeric.
@@ -560,7 +622,7 @@ IndiElement::operator unsigned int() const
 string IndiElement::get() const
 {
   pcf::ReadWriteLock::AutoRLock rwAuto( &m_rwData );
-  return m_szValue;
+  return readText();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -569,7 +631,7 @@ string IndiElement::get() const
 string IndiElement::getValue() const
 {
   pcf::ReadWriteLock::AutoRLock rwAuto( &m_rwData );
-  return m_szValue;
+  return readText();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -581,10 +643,12 @@ void IndiElement::getValue( char *pcValue, unsigned int &uiSize ) const
 {
   pcf::ReadWriteLock::AutoRLock rwAuto( &m_rwData );
 
+  string szValue = readText();
+
   // Modify the number of bytes to copy. It will be the lesser of the two sizes.
-  uiSize = ( uiSize > m_szValue.size() ) ? ( m_szValue.size() ) : ( uiSize );
+  uiSize = ( uiSize > szValue.size() ) ? ( szValue.size() ) : ( uiSize );
 
-  ::memcpy( pcValue, m_szValue.c_str(), uiSize );
+  ::memcpy( pcValue, szValue.c_str(), uiSize );
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -686,6 +750,7 @@ void IndiElement::setValue( const string &szValue )
 {
   pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
   m_szValue = szValue;
+  m_tNumber = NotNumber;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -696,6 +761,93 @@ void IndiElement::setValue( const char *pcValue,
 {
   pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
   m_szValue.assign( const_cast<char *>( pcValue ), uiSize );
+  m_tNumber = NotNumber;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// If the value was last set from a number, return it and true.
+
+bool IndiElement::getNumber( double &xValue ) const
+{
+  pcf::ReadWriteLock::AutoRLock rwAuto( &m_rwData );
+  return readNumber( xValue );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Get the number as a double. An integer is only returned if a double
+/// holds it exactly.
+
+bool IndiElement::readNumber( double &xValue ) const
+{
+  switch ( m_tNumber )
+  {
+    case FloatNumber:
+      xValue = m_xValue;
+      return true;
+    case SignedNumber:
+      xValue = static_cast<double>( m_llValue );
+      return ( m_llValue >= -( 1LL << 53 ) && m_llValue <= ( 1LL << 53 ) );
+    case UnsignedNumber:
+      xValue = static_cast<double>( m_ullValue );
+      return ( m_ullValue <= ( 1ULL << 53 ) );
+    default:
+      xValue = 0;
+      return false;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Get the value as text. A number is formatted here, rather than when it
+/// is set, since most values which are set are never sent. "%.15g" is what
+/// a stringstream with a precision of 15 uses, so the text is the same.
+
+string IndiElement::readText() const
+{
+  char pcValue[32];
+  int nLen = 0;
+
+  switch ( m_tNumber )
+  {
+    case FloatNumber:
+      nLen = ::snprintf( pcValue, sizeof( pcValue ), "%.15g", m_xValue );
+      break;
+    case SignedNumber:
+      nLen = ::snprintf( pcValue, sizeof( pcValue ), "%lld", m_llValue );
+      break;
+    case UnsignedNumber:
+      nLen = ::snprintf( pcValue, sizeof( pcValue ), "%llu", m_ullValue );
+      break;
+    default:
+      return m_szValue;
+  }
+  return string( pcValue, nLen );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Sets the value from a floating point number.
+
+void IndiElement::assignNumber( const double &xValue )
+{
+  m_xValue = xValue;
+  m_tNumber = FloatNumber;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Sets the value from a signed integer.
+
+void IndiElement::assignNumber( const long long &llValue )
+{
+  m_llValue = llValue;
+  m_tNumber = SignedNumber;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Sets the value from an unsigned integer.
+
+void IndiElement::assignNumber( const unsigned long long &ullValue )
+{
+  m_ullValue = ullValue;
+  m_tNumber = UnsignedNumber;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -775,7 +927,7 @@ bool IndiElement::hasValidSwitchState() const
 bool IndiElement::hasValidValue() const
 {
   pcf::ReadWriteLock::AutoRLock rwAuto( &m_rwData );
-  return ( m_szValue.size() > 0 );
+  return ( m_tNumber != NotNumber || m_szValue.size() > 0 );
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -6,6 +6,10 @@
 /// form it is a name-value pair with other attributes associated with it.
 /// All access is protected by a read-write lock.
 ///
+/// When the value is set from a number, only the number is kept. It can be
+/// read back or compared without parsing, and the text is only made when it
+/// is asked for, e.g. when the element is written to a message.
+///
 ////////////////////////////////////////////////////////////////////////////////
 
 #ifndef INDI_ELEMENT_HPP
@@ -16,6 +20,7 @@
 #include <string>
 #include <sstream>
 #include <exception>
+#include <type_traits>
 #include "ReadWriteLock.hpp"
 
 namespace pcf
@@ -66,6 +71,33 @@ class IndiElement
       On
     };
 
+    /// Is TT stored as a number when it is used to set the value?
+    /// bool and the character types are not, since they stream as text,
+    /// and neither is long double, which a double can not hold.
+    template <class TT> struct IsNumber
+    {
+      static const bool value = std::is_arithmetic<TT>::value &&
+                                !std::is_same<TT, bool>::value &&
+                                !std::is_same<TT, long double>::value &&
+                                !std::is_same<TT, char>::value &&
+                                !std::is_same<TT, signed char>::value &&
+                                !std::is_same<TT, unsigned char>::value &&
+                                !std::is_same<TT, wchar_t>::value &&
+                                !std::is_same<TT, char16_t>::value &&
+                                !std::is_same<TT, char32_t>::value;
+    };
+
+  private:
+    // How the value was last set.
+    enum NumberType
+    {
+      // From text, which is in m_szValue.
+      NotNumber = 0,
+      FloatNumber,
+      SignedNumber,
+      UnsignedNumber,
+    };
+
     // Constructor/copy constructor/destructor.
   public:
     /// Constructor.
@@ -95,6 +127,8 @@ class IndiElement
     IndiElement( const std::string &szName, const SwitchStateType &tValue );
     /// Copy constructor.
     IndiElement( const IndiElement &ieRhs );
+    /// Move constructor.
+    IndiElement( IndiElement &&ieRhs );
     /// Destructor.
     virtual ~IndiElement();
 
@@ -102,6 +136,8 @@ class IndiElement
   public:
     /// Assigns the internal data of this object from an existing one.
     const IndiElement &operator= ( const IndiElement &ieRhs );
+    /// Moves the internal data of an existing object into this one.
+    const IndiElement &operator= ( IndiElement &&ieRhs );
     /// This is an alternate way of calling 'setLightState'.
     const LightStateType &operator= ( const LightStateType &tValue );
     /// This is an alternate way of calling 'setSwitchState'.
@@ -151,6 +187,9 @@ class IndiElement
     template <class TT> TT getValue() const;
     /// Return the value as type TT.
     template <class TT> TT get() const;
+    /// If the value was last set from a number, return it in 'xValue' and
+    /// return true. Otherwise, return false.
+    bool getNumber( double &xValue ) const;
 
     // Are the entries valid (non zero size)?
     bool hasValidFormat() const;
@@ -201,6 +240,27 @@ class IndiElement
     template <class TT> void setValue( const TT &ttValue );
     template <class TT> void set( const TT &ttValue );
 
+    // Helper functions.
+  private:
+    /// Set the value from a TT. The write lock must be held.
+    template <class TT> void assignValue( const TT &ttValue );
+    template <class TT> void assignValue( const TT &ttValue, std::true_type );
+    template <class TT> void assignValue( const TT &ttValue, std::false_type );
+    /// Set the value from a number. The write lock must be held.
+    void assignNumber( const double &xValue );
+    void assignNumber( const long long &llValue );
+    void assignNumber( const unsigned long long &ullValue );
+    /// Get the value as text, formatting the number the same as a
+    /// stringstream with a precision of 15 if it is one. The read lock must
+    /// be held.
+    std::string readText() const;
+    /// Get the number as a double, if it is one which a double holds
+    /// exactly. The read lock must be held.
+    bool readNumber( double &xValue ) const;
+    /// Get the value as a TT. The read lock must be held.
+    template <class TT> TT readValue( std::true_type ) const;
+    template <class TT> TT readValue( std::false_type ) const;
+
     // Members.
   private:
     /// If this is a number or BLOB, this is the 'printf' format.
@@ -217,8 +277,16 @@ class IndiElement
     std::string m_szSize;
     /// If this is a number, this is increment for it.
     std::string m_szStep;
-    /// This is the value of the data.
+    /// This is the value of the data, if it was set from text.
     std::string m_szValue;
+    /// How the value was last set. If it is a number, m_szValue is not used.
+    NumberType m_tNumber {NotNumber};
+    /// The value, if m_tNumber is FloatNumber.
+    double m_xValue {0};
+    /// The value, if m_tNumber is SignedNumber.
+    long long m_llValue {0};
+    /// The value, if m_tNumber is UnsignedNumber.
+    unsigned long long m_ullValue {0};
     /// This can also be the value.
     LightStateType m_lsValue;
     /// This can also be the value.
@@ -257,11 +325,7 @@ template <class TT> TT pcf::IndiElement::get() const
 {
   pcf::ReadWriteLock::AutoRLock rwAuto( &m_rwData );
 
-  TT tValue;
-  //  stream the data into the variable.
-  std::stringstream ssValue( m_szValue );
-  ssValue >> std::boolalpha >> tValue;
-  return tValue;
+  return readValue<TT>( std::is_floating_point<TT>() );
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -271,9 +335,29 @@ template <class TT> TT pcf::IndiElement::getValue() const
 {
   pcf::ReadWriteLock::AutoRLock rwAuto( &m_rwData );
 
+  return readValue<TT>( std::is_floating_point<TT>() );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Get a floating point value, using the stored number if there is one.
+
+template <class TT> TT pcf::IndiElement::readValue( std::true_type ) const
+{
+  double xValue;
+  if ( readNumber( xValue ) == true )
+    return static_cast<TT>( xValue );
+
+  return readValue<TT>( std::false_type() );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Get a value by streaming the text into it.
+
+template <class TT> TT pcf::IndiElement::readValue( std::false_type ) const
+{
   TT tValue;
   //  stream the data into the variable.
-  std::stringstream ssValue( m_szValue );
+  std::stringstream ssValue( readText() );
   ssValue >> std::boolalpha >> tValue;
   return tValue;
 }
@@ -311,10 +395,7 @@ template <class TT> const TT &pcf::IndiElement::operator= ( const TT &ttValue )
 {
   pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
 
-  std::stringstream ssValue;
-  ssValue.precision( 15 );
-  ssValue << std::boolalpha << ttValue;
-  m_szValue = ssValue.str();
+  assignValue( ttValue );
   return ttValue;
 }
 
@@ -325,10 +406,7 @@ template <class TT> void pcf::IndiElement::set( const TT &ttValue )
 {
   pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
 
-  std::stringstream ssValue;
-  ssValue.precision( 15 );
-  ssValue << std::boolalpha << ttValue;
-  m_szValue = ssValue.str();
+  assignValue( ttValue );
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -338,10 +416,41 @@ template <class TT> void pcf::IndiElement::setValue( const TT &ttValue )
 {
   pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
 
+  assignValue( ttValue );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Set the value from type TT, keeping the number if it is one.
+
+template <class TT> void pcf::IndiElement::assignValue( const TT &ttValue )
+{
+  assignValue( ttValue, std::integral_constant<bool, IsNumber<TT>::value>() );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Set the value from a number, without a stringstream.
+
+template <class TT> void pcf::IndiElement::assignValue( const TT &ttValue,
+                                                        std::true_type )
+{
+  typedef typename std::conditional<std::is_floating_point<TT>::value, double,
+          typename std::conditional<std::is_signed<TT>::value, long long,
+                                    unsigned long long>::type>::type NumType;
+
+  assignNumber( static_cast<NumType>( ttValue ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Set the value from anything else by streaming it to text.
+
+template <class TT> void pcf::IndiElement::assignValue( const TT &ttValue,
+                                                        std::false_type )
+{
   std::stringstream ssValue;
   ssValue.precision( 15 );
   ssValue << std::boolalpha << ttValue;
   m_szValue = ssValue.str();
+  m_tNumber = NotNumber;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
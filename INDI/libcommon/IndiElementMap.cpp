@@ -0,0 +1,202 @@
+/// IndiElementMap.cpp
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include "IndiElementMap.hpp"
+
+using std::string;
+using std::vector;
+using std::map;
+using std::pair;
+using pcf::IndiElement;
+using pcf::IndiElementMap;
+
+////////////////////////////////////////////////////////////////////////////////
+/// Constructor.
+
+IndiElementMap::IndiElementMap()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Construct from a map. The map is sorted by name already, so the sorted
+/// indices are simply 0, 1, 2, ...
+
+IndiElementMap::IndiElementMap( const map<string, IndiElement> &mapElements )
+{
+  m_vecElements.reserve( mapElements.size() );
+  m_vecSorted.reserve( mapElements.size() );
+
+  map<string, IndiElement>::const_iterator itr = mapElements.begin();
+  for ( ; itr != mapElements.end(); ++itr )
+  {
+    m_vecSorted.push_back( m_vecElements.size() );
+    m_vecElements.push_back( *itr );
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Destructor.
+
+IndiElementMap::~IndiElementMap()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Return the element named 'szName', adding an empty one if there is none.
+
+IndiElement &IndiElementMap::operator[]( const string &szName )
+{
+  return insert( szName, IndiElement() ).first->second;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+IndiElementMap::iterator IndiElementMap::begin()
+{
+  return m_vecElements.begin();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+IndiElementMap::const_iterator IndiElementMap::begin() const
+{
+  return m_vecElements.begin();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+IndiElementMap::iterator IndiElementMap::end()
+{
+  return m_vecElements.end();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+IndiElementMap::const_iterator IndiElementMap::end() const
+{
+  return m_vecElements.end();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Remove all the elements.
+
+void IndiElementMap::clear()
+{
+  m_vecElements.clear();
+  m_vecSorted.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// How many elements are named 'szName' (0 or 1).
+
+size_t IndiElementMap::count( const string &szName ) const
+{
+  return ( indexOf( szName ) < 0 ) ? ( 0 ) : ( 1 );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Are there no elements?
+
+bool IndiElementMap::empty() const
+{
+  return m_vecElements.empty();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Remove the element at 'itr'. Its entry is removed from the sorted
+/// indices, and the indices after it are moved down by one.
+
+void IndiElementMap::erase( iterator itr )
+{
+  unsigned int uiIndex = itr - m_vecElements.begin();
+
+  vector<unsigned int>::iterator itrSorted = m_vecSorted.begin();
+  while ( itrSorted != m_vecSorted.end() )
+  {
+    if ( *itrSorted == uiIndex )
+    {
+      itrSorted = m_vecSorted.erase( itrSorted );
+      continue;
+    }
+    if ( *itrSorted > uiIndex )
+      ( *itrSorted )--;
+    ++itrSorted;
+  }
+
+  m_vecElements.erase( itr );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Find the element named 'szName', or return 'end()'.
+
+IndiElementMap::iterator IndiElementMap::find( const string &szName )
+{
+  int iIndex = indexOf( szName );
+  return ( iIndex < 0 ) ? ( m_vecElements.end() ) : ( m_vecElements.begin() + iIndex );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Find the element named 'szName', or return 'end()'.
+
+IndiElementMap::const_iterator IndiElementMap::find( const string &szName ) const
+{
+  int iIndex = indexOf( szName );
+  return ( iIndex < 0 ) ? ( m_vecElements.end() ) : ( m_vecElements.begin() + iIndex );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Return the index of the element named 'szName', or -1.
+
+int IndiElementMap::indexOf( const string &szName ) const
+{
+  vector<unsigned int>::const_iterator itr = lowerBound( szName );
+
+  if ( itr == m_vecSorted.end() || m_vecElements[*itr].first != szName )
+    return -1;
+
+  return *itr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Add an element at the end, unless one with the name exists already.
+
+pair<IndiElementMap::iterator, bool> IndiElementMap::insert( const string &szName,
+                                                             const IndiElement &ieNew )
+{
+  vector<unsigned int>::const_iterator itr = lowerBound( szName );
+
+  if ( itr != m_vecSorted.end() && m_vecElements[*itr].first == szName )
+    return pair<iterator, bool>( m_vecElements.begin() + *itr, false );
+
+  unsigned int uiIndex = m_vecElements.size();
+  m_vecSorted.insert( m_vecSorted.begin() + ( itr - m_vecSorted.begin() ), uiIndex );
+  m_vecElements.push_back( value_type( szName, ieNew ) );
+
+  return pair<iterator, bool>( m_vecElements.begin() + uiIndex, true );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// The number of elements.
+
+size_t IndiElementMap::size() const
+{
+  return m_vecElements.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// The position in m_vecSorted where 'szName' is, or would be inserted.
+
+vector<unsigned int>::const_iterator IndiElementMap::lowerBound( const string &szName ) const
+{
+  const vector<value_type> &vecElements = m_vecElements;
+
+  return std::lower_bound( m_vecSorted.begin(), m_vecSorted.end(), szName,
+                           [&vecElements]( const unsigned int &uiIndex, const string &szKey )
+                           {
+                             return vecElements[uiIndex].first < szKey;
+                           } );
+}
+
+////////////////////////////////////////////////////////////////////////////////
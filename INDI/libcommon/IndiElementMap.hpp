@@ -0,0 +1,100 @@
+/// IndiElementMap.hpp
+///
+/// The elements of an IndiProperty. The elements are kept in one contiguous
+/// vector, in the order they were added, so an element can be addressed by
+/// its index without a search. A second vector holds the indices sorted by
+/// name, so finding an element by name is a binary search over a few
+/// contiguous integers rather than a walk over the nodes of a tree.
+///
+/// The interface is the part of std::map that was used on the elements, so
+/// code which iterates over 'getElements' and uses 'first' and 'second' does
+/// not change. Iteration is in the order the elements were added.
+///
+/// This class is not protected by a lock, IndiProperty does that.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INDI_ELEMENT_MAP_HPP
+#define INDI_ELEMENT_MAP_HPP
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include "IndiElement.hpp"
+
+namespace pcf
+{
+class IndiElementMap
+{
+  // Our iterators.
+  public:
+    typedef std::pair<std::string, pcf::IndiElement> value_type;
+    typedef std::vector<value_type>::iterator iterator;
+    typedef std::vector<value_type>::const_iterator const_iterator;
+
+  // Construction/destruction/assign/copy.
+  public:
+    IndiElementMap();
+    /// Construct from a map, adding the elements in the map's order.
+    IndiElementMap( const std::map<std::string, pcf::IndiElement> &mapElements );
+    IndiElementMap( const IndiElementMap &iemRhs ) = default;
+    IndiElementMap( IndiElementMap &&iemRhs ) = default;
+    IndiElementMap &operator= ( const IndiElementMap &iemRhs ) = default;
+    IndiElementMap &operator= ( IndiElementMap &&iemRhs ) = default;
+    ~IndiElementMap();
+
+  // Operators.
+  public:
+    /// Return the element named 'szName', adding an empty one if there is
+    /// none, the same as std::map.
+    pcf::IndiElement &operator[] ( const std::string &szName );
+
+  // Member functions.
+  public:
+    /// The first element.
+    iterator begin();
+    const_iterator begin() const;
+    /// Past the last element.
+    iterator end();
+    const_iterator end() const;
+    /// Remove all the elements.
+    void clear();
+    /// How many elements are named 'szName' (0 or 1).
+    size_t count( const std::string &szName ) const;
+    /// Are there no elements?
+    bool empty() const;
+    /// Remove the element at 'itr'. The index of each element after it
+    /// goes down by one.
+    void erase( iterator itr );
+    /// Find the element named 'szName', or return 'end()'.
+    iterator find( const std::string &szName );
+    const_iterator find( const std::string &szName ) const;
+    /// Return the index of the element named 'szName', or -1.
+    int indexOf( const std::string &szName ) const;
+    /// Add an element named 'szName' at the end, unless it already exists.
+    /// Returns the element with the name, and true if it was added.
+    std::pair<iterator, bool> insert( const std::string &szName,
+                                      const pcf::IndiElement &ieNew );
+    /// The number of elements.
+    size_t size() const;
+
+  // Helper functions.
+  private:
+    /// The position in m_vecSorted where 'szName' is, or would be.
+    std::vector<unsigned int>::const_iterator lowerBound( const std::string &szName ) const;
+
+  // Members.
+  private:
+    /// The elements, in the order they were added.
+    std::vector<value_type> m_vecElements;
+    /// The indices into m_vecElements, sorted by name.
+    std::vector<unsigned int> m_vecSorted;
+
+}; // class IndiElementMap
+} // namespace pcf
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // INDI_ELEMENT_MAP_HPP
@@ -8,6 +8,7 @@
 #include <functional>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include "IndiProperty.hpp"
 
 using std::runtime_error;
@@ -16,6 +17,7 @@ using std::stringstream;
 using std::map;
 using pcf::TimeStamp;
 using pcf::IndiElement;
+using pcf::IndiElementMap;
 using pcf::IndiProperty;
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -108,6 +110,29 @@ IndiProperty::IndiProperty(const IndiProperty &ipRhs )
   m_tType = ipRhs.m_tType;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+/// Move constructor. The strings and elements are taken, not copied.
+
+IndiProperty::IndiProperty( IndiProperty &&ipRhs )
+{
+  m_szDevice = std::move( ipRhs.m_szDevice );
+  m_szGroup = std::move( ipRhs.m_szGroup );
+  m_szLabel = std::move( ipRhs.m_szLabel );
+  m_szMessage = std::move( ipRhs.m_szMessage );
+  m_szName = std::move( ipRhs.m_szName );
+  m_tPerm = ipRhs.m_tPerm;
+  m_oRequested = ipRhs.m_oRequested;
+  m_tRule = ipRhs.m_tRule;
+  m_tState = ipRhs.m_tState;
+  m_xTimeout = ipRhs.m_xTimeout;
+  m_tsTimeStamp = ipRhs.m_tsTimeStamp;
+  m_szVersion = std::move( ipRhs.m_szVersion );
+  m_beValue = ipRhs.m_beValue;
+
+  m_mapElements = std::move( ipRhs.m_mapElements );
+  m_tType = ipRhs.m_tType;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 /// Destructor.
 
@@ -144,6 +169,35 @@ const IndiProperty &IndiProperty::operator=( const IndiProperty &ipRhs )
   return *this;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+/// Moves the internal data of an existing object into this one.
+
+const IndiProperty &IndiProperty::operator=( IndiProperty &&ipRhs )
+{
+  if ( &ipRhs != this )
+  {
+    pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
+
+    m_szDevice = std::move( ipRhs.m_szDevice );
+    m_szGroup = std::move( ipRhs.m_szGroup );
+    m_szLabel = std::move( ipRhs.m_szLabel );
+    m_szMessage = std::move( ipRhs.m_szMessage );
+    m_szName = std::move( ipRhs.m_szName );
+    m_tPerm = ipRhs.m_tPerm;
+    m_oRequested = ipRhs.m_oRequested;
+    m_tRule = ipRhs.m_tRule;
+    m_tState = ipRhs.m_tState;
+    m_xTimeout = ipRhs.m_xTimeout;
+    m_tsTimeStamp = ipRhs.m_tsTimeStamp;
+    m_szVersion = std::move( ipRhs.m_szVersion );
+    m_beValue = ipRhs.m_beValue;
+
+    m_mapElements = std::move( ipRhs.m_mapElements );
+    m_tType = ipRhs.m_tType;
+  }
+  return *this;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 /// This is an alternate way of calling 'setBLOBEnable'.
 
@@ -170,8 +224,8 @@ bool IndiProperty::operator==( const IndiProperty &ipRhs ) const
     return false;
 
   // We need some iterators for each of the maps.
-  map<string, IndiElement>::const_iterator itrRhs = ipRhs.m_mapElements.end();
-  map<string, IndiElement>::const_iterator itr = m_mapElements.begin();
+  IndiElementMap::const_iterator itrRhs = ipRhs.m_mapElements.end();
+  IndiElementMap::const_iterator itr = m_mapElements.begin();
   for ( ; itr != m_mapElements.end(); ++itr )
   {
     // Can we find an element of the same name in the other map?
@@ -256,8 +310,8 @@ bool IndiProperty::compareProperty( const IndiProperty &ipComp ) const
     return false;
 
   // We need some iterators for each of the maps.
-  map<string, IndiElement>::const_iterator itrComp = ipComp.m_mapElements.end();
-  map<string, IndiElement>::const_iterator itr = m_mapElements.begin();
+  IndiElementMap::const_iterator itrComp = ipComp.m_mapElements.end();
+  IndiElementMap::const_iterator itr = m_mapElements.begin();
   for ( ; itr != m_mapElements.end(); ++itr )
   {
     // Can we find an element of the same name in the other map?
@@ -293,13 +347,13 @@ bool IndiProperty::compareValue( const IndiProperty &ipComp,
     return false;
 
   // Can we find this element in this map? If not, we fail.
-  map<string, IndiElement>::const_iterator itr =
+  IndiElementMap::const_iterator itr =
       m_mapElements.find( szElementName );
   if ( itr == m_mapElements.end() )
     return false;
 
   // Can we find this element in the other map? If not, we fail.
-  map<string, IndiElement>::const_iterator itrComp =
+  IndiElementMap::const_iterator itrComp =
       ipComp.m_mapElements.find( szElementName );
   if ( itrComp == ipComp.m_mapElements.end() )
     return false;
@@ -336,8 +390,8 @@ bool IndiProperty::compareValues( const IndiProperty &ipComp ) const
     return false;
 
   // We need some iterators for each of the maps.
-  map<string, IndiElement>::const_iterator itrComp = ipComp.m_mapElements.end();
-  map<string, IndiElement>::const_iterator itr = m_mapElements.begin();
+  IndiElementMap::const_iterator itrComp = ipComp.m_mapElements.end();
+  IndiElementMap::const_iterator itr = m_mapElements.begin();
   for ( ; itr != m_mapElements.end(); ++itr )
   {
     // Can we find an element of the same name in the other map?
@@ -380,13 +434,13 @@ bool IndiProperty::hasNewValue( const IndiProperty &ipComp,
     return false;
 
   // Can we find this element in this map? If not, we fail.
-  map<string, IndiElement>::const_iterator itr =
+  IndiElementMap::const_iterator itr =
       m_mapElements.find( szElementName );
   if ( itr == m_mapElements.end() )
     return false;
 
   // Can we find this element in the other map? If not, we fail.
-  map<string, IndiElement>::const_iterator itrComp =
+  IndiElementMap::const_iterator itrComp =
       ipComp.m_mapElements.find( szElementName );
   if ( itrComp == ipComp.m_mapElements.end() )
     return false;
@@ -425,7 +479,7 @@ string IndiProperty::createString() const
            << "\"message\" : \"" << m_szMessage << "\" "
            << "\"elements\" : [ \n";
 
-  map<string, IndiElement>::const_iterator itr = m_mapElements.begin();
+  IndiElementMap::const_iterator itr = m_mapElements.begin();
   for ( ; itr != m_mapElements.end(); ++itr )
   {
     ssOutput << "    ";
@@ -815,7 +869,7 @@ unsigned int IndiProperty::getNumElements() const
 const IndiElement& IndiProperty::at( const string& szName ) const
 {
   pcf::ReadWriteLock::AutoRLock rwAuto( &m_rwData );
-  map<string, IndiElement>::const_iterator itr = m_mapElements.find( szName );
+  IndiElementMap::const_iterator itr = m_mapElements.find( szName );
 
   if ( itr == m_mapElements.end() )
     throw runtime_error( string( "Element name '" ) + szName + "' not found." );
@@ -830,7 +884,7 @@ const IndiElement& IndiProperty::at( const string& szName ) const
 IndiElement& IndiProperty::at( const string& szName )
 {
   pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
-  map<string, IndiElement>::iterator itr = m_mapElements.find( szName );
+  IndiElementMap::iterator itr = m_mapElements.find( szName );
 
   if ( itr == m_mapElements.end() )
     throw runtime_error( string( "Element name '" ) + szName + "' not found." );
@@ -846,13 +900,10 @@ const IndiElement& IndiProperty::at( const unsigned int& uiIndex ) const
 {
   pcf::ReadWriteLock::AutoRLock rwAuto( &m_rwData );
 
-  if ( uiIndex > m_mapElements.size() - 1 )
+  if ( uiIndex >= m_mapElements.size() )
     throw Excep( ErrIndexOutOfBounds );
 
-  map<string, IndiElement>::const_iterator itr = m_mapElements.begin();
-  std::advance( itr, uiIndex );
-
-  return itr->second;
+  return ( m_mapElements.begin() + uiIndex )->second;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -863,13 +914,10 @@ IndiElement& IndiProperty::at( const unsigned int& uiIndex )
 {
   pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
 
-  if ( uiIndex > m_mapElements.size() - 1 )
+  if ( uiIndex >= m_mapElements.size() )
     throw Excep( ErrIndexOutOfBounds );
 
-  map<string, IndiElement>::iterator itr = m_mapElements.begin();
-  std::advance( itr, uiIndex );
-
-  return itr->second;
+  return ( m_mapElements.begin() + uiIndex )->second;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -879,7 +927,7 @@ IndiElement& IndiProperty::at( const unsigned int& uiIndex )
 const IndiElement& IndiProperty::operator[]( const string& szName ) const
 {
   pcf::ReadWriteLock::AutoRLock rwAuto( &m_rwData );
-  map<string, IndiElement>::const_iterator itr = m_mapElements.find( szName );
+  IndiElementMap::const_iterator itr = m_mapElements.find( szName );
 
   if ( itr == m_mapElements.end() )
     throw runtime_error( string( "Element name '" ) + szName + "' not found." );
@@ -894,7 +942,7 @@ const IndiElement& IndiProperty::operator[]( const string& szName ) const
 IndiElement& IndiProperty::operator[]( const string& szName )
 {
   pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
-  map<string, IndiElement>::iterator itr = m_mapElements.find( szName );
+  IndiElementMap::iterator itr = m_mapElements.find( szName );
 
   if ( itr == m_mapElements.end() )
     throw runtime_error( string( "Element name '" ) + szName + "' not found." );
@@ -910,13 +958,10 @@ const IndiElement& IndiProperty::operator[]( const unsigned int& uiIndex ) const
 {
   pcf::ReadWriteLock::AutoRLock rwAuto( &m_rwData );
 
-  if ( uiIndex > m_mapElements.size() - 1 )
+  if ( uiIndex >= m_mapElements.size() )
     throw Excep( ErrIndexOutOfBounds );
 
-  map<string, IndiElement>::const_iterator itr = m_mapElements.begin();
-  std::advance( itr, uiIndex );
-
-  return itr->second;
+  return ( m_mapElements.begin() + uiIndex )->second;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -927,19 +972,16 @@ IndiElement& IndiProperty::operator[]( const unsigned int& uiIndex )
 {
   pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
 
-  if ( uiIndex > m_mapElements.size() - 1 )
+  if ( uiIndex >= m_mapElements.size() )
     throw Excep( ErrIndexOutOfBounds );
 
-  map<string, IndiElement>::iterator itr = m_mapElements.begin();
-  std::advance( itr, uiIndex );
-
-  return itr->second;
+  return ( m_mapElements.begin() + uiIndex )->second;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 /// Returns the entire map of elements.
 
-const map<string, IndiElement> &IndiProperty::getElements() const
+const IndiElementMap &IndiProperty::getElements() const
 {
   pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
   return m_mapElements;
@@ -948,12 +990,37 @@ const map<string, IndiElement> &IndiProperty::getElements() const
 ////////////////////////////////////////////////////////////////////////////////
 /// Sets the entire map of elements.
 
-void IndiProperty::setElements( const map<string, IndiElement> &mapElements )
+void IndiProperty::setElements( const IndiElementMap &mapElements )
 {
   pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
   m_mapElements = mapElements;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+/// Sets the entire map of elements from a std::map. They will be in the
+/// order of the map.
+
+void IndiProperty::setElements( const map<string, IndiElement> &mapElements )
+{
+  pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
+  m_mapElements = IndiElementMap( mapElements );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Returns the index of the element named 'szName'.
+/// Throws exception if name is not found.
+
+unsigned int IndiProperty::getElementIndex( const string &szName ) const
+{
+  pcf::ReadWriteLock::AutoRLock rwAuto( &m_rwData );
+  int iIndex = m_mapElements.indexOf( szName );
+
+  if ( iIndex < 0 )
+    throw runtime_error( string( "Element name '" ) + szName + "' not found." );
+
+  return iIndex;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 /// Updates the value of an element, adds it if it doesn't exist.
 
@@ -974,13 +1041,13 @@ void IndiProperty::addIfNoExist( const IndiElement &ieNew )
 {
   pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
 
-  map<string, IndiElement>::const_iterator itr =
+  IndiElementMap::const_iterator itr =
     m_mapElements.find( ieNew.getName() );
 
   if ( itr == m_mapElements.end() )
   {
     // Actually add it to the map.
-    m_mapElements[ ieNew.getName() ] = ieNew;
+    m_mapElements.insert( ieNew.getName(), ieNew );
     m_tsTimeStamp = TimeStamp::now();
   }
 }
@@ -993,14 +1060,14 @@ void IndiProperty::add( const IndiElement &ieNew )
 {
   pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
 
-  map<string, IndiElement>::const_iterator itr =
+  IndiElementMap::const_iterator itr =
     m_mapElements.find( ieNew.getName() );
 
   if ( itr != m_mapElements.end() )
     throw Excep( ErrElementAlreadyExists );
 
   // Actually add it to the map.
-  m_mapElements[ ieNew.getName() ] = ieNew;
+  m_mapElements.insert( ieNew.getName(), ieNew );
 
   m_tsTimeStamp = TimeStamp::now();
 }
@@ -1013,7 +1080,7 @@ void IndiProperty::remove( const string &szElementName )
 {
   pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
 
-  map<string, IndiElement>::iterator itr =
+  IndiElementMap::iterator itr =
     m_mapElements.find( szElementName );
 
   if ( itr == m_mapElements.end() )
@@ -1032,7 +1099,7 @@ void IndiProperty::update( const string &szElementName,
 {
   pcf::ReadWriteLock::AutoWLock rwAuto( &m_rwData );
 
-  map<string, IndiElement>::iterator itr =
+  IndiElementMap::iterator itr =
     m_mapElements.find( szElementName );
 
   if ( itr == m_mapElements.end() )
@@ -1050,7 +1117,7 @@ bool IndiProperty::find( const string &szElementName ) const
 {
   pcf::ReadWriteLock::AutoRLock rwAuto( &m_rwData );
 
-  map<string, IndiElement>::const_iterator itr =
+  IndiElementMap::const_iterator itr =
     m_mapElements.find( szElementName );
 
   return ( itr != m_mapElements.end() );
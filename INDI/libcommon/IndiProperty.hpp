@@ -5,6 +5,11 @@
 /// This class represents a list of INDI elements with additional information
 /// associated with it. All access is protected by a read-write lock.
 ///
+/// The elements are kept in the order they were added. The index of an
+/// element can be looked up once, with 'getElementIndex', and then used
+/// with '[]' or 'at' to get the element without searching for its name.
+/// The index stays valid until an element is removed.
+///
 ////////////////////////////////////////////////////////////////////////////////
 
 #ifndef INDI_PROPERTY_HPP
@@ -17,6 +22,7 @@
 #include "ReadWriteLock.hpp"
 #include "TimeStamp.hpp"
 #include "IndiElement.hpp"
+#include "IndiElementMap.hpp"
 
 namespace pcf
 {
@@ -119,6 +125,8 @@ class IndiProperty
                   const SwitchRuleType &tRule = UnknownSwitchRule );
     /// Copy constructor.
     IndiProperty( const IndiProperty &ipRhs );
+    /// Move constructor.
+    IndiProperty( IndiProperty &&ipRhs );
     /// Destructor.
     virtual ~IndiProperty();
 
@@ -126,6 +134,8 @@ class IndiProperty
   public:
     /// Assigns the internal data of this object from an existing one.
     const IndiProperty &operator= ( const IndiProperty &ipRhs );
+    /// Moves the internal data of an existing object into this one.
+    const IndiProperty &operator= ( IndiProperty &&ipRhs );
     /// This is an alternate way of calling 'setBLOBEnable'.
     const BLOBEnableType &operator= ( const BLOBEnableType &tValue );
     /// Returns true if we have an exact match (value as well).
@@ -275,11 +285,15 @@ class IndiProperty
     ///  Returns true if the element 'szElementName' exists, false otherwise.
     bool find( const std::string &szElementName ) const;
     /// Get the entire map of elements.
-    const std::map<std::string, pcf::IndiElement> &getElements() const;
+    const pcf::IndiElementMap &getElements() const;
+    /// Returns the index of the element named 'szName', for use with '[]'
+    /// and 'at'. Throws if the element doesn't exist.
+    unsigned int getElementIndex( const std::string &szName ) const;
     /// Removes an element named 'szElementName'.
     /// Throws if the element doesn't exist.
     void remove( const std::string &szElementName );
     /// Set the entire map of elements.
+    void setElements( const pcf::IndiElementMap &mapElements );
     void setElements( const std::map<std::string, pcf::IndiElement> &mapElements );
     /// Updates the value of an element named 'szElementName'.
     /// Throws if the element doesn't exist.
@@ -306,8 +320,8 @@ class IndiProperty
     std::string m_szVersion;
     /// This can also be the value.
     BLOBEnableType m_beValue;
-    /// A dictionary of elements, indexable by name.
-    std::map<std::string, pcf::IndiElement> m_mapElements;
+    /// A dictionary of elements, indexable by name or by position.
+    pcf::IndiElementMap m_mapElements;
     /// The type of this object. It cannot be changed.
     pcf::IndiProperty::Type m_tType;
     // A read write lock to protect the internal data.
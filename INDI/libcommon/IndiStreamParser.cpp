@@ -0,0 +1,708 @@
+/// IndiStreamParser.cpp
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <iostream>
+#include <stdexcept>
+#include "IndiMessage.hpp"
+#include "IndiProperty.hpp"
+#include "IndiStreamParser.hpp"
+
+using std::string;
+using pcf::IndiElement;
+using pcf::IndiMessage;
+using pcf::IndiProperty;
+using pcf::IndiStreamParser;
+using pcf::TimeStamp;
+
+namespace
+{
+
+////////////////////////////////////////////////////////////////////////////////
+/// The same token characters as lilxml.
+
+inline bool isTokenChar( const bool &oStart, const char &c )
+{
+  return ( ::isalpha( ( unsigned char )( c ) ) || c == '_' ||
+           ( !oStart && ::isdigit( ( unsigned char )( c ) ) ) );
+}
+
+inline bool isSpace( const char &c )
+{
+  return ::isspace( ( unsigned char )( c ) ) != 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// How the pcdata of the elements of a message is interpreted.
+
+enum ValueKind
+{
+  TextValue = 0,
+  LightValue,
+  SwitchValue
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Sets the property type, message type, and value kind given the tag.
+/// Returns false for an unknown tag.
+
+bool convertTag( const string &szTag,
+                 IndiProperty::Type &tPropType,
+                 IndiMessage::Type &tMsgType,
+                 ValueKind &tValueKind )
+{
+  tValueKind = TextValue;
+  tPropType = IndiProperty::Unknown;
+
+  if ( szTag.size() < 6 )
+    return false;
+
+  // Most of the traffic is set*, so test those first.
+  if ( szTag.compare( 0, 3, "set" ) == 0 )
+  {
+    tMsgType = IndiMessage::SetProperty;
+    if ( szTag == "setNumberVector" ) tPropType = IndiProperty::Number;
+    else if ( szTag == "setSwitchVector" ) { tPropType = IndiProperty::Switch; tValueKind = SwitchValue; }
+    else if ( szTag == "setTextVector" ) tPropType = IndiProperty::Text;
+    else if ( szTag == "setLightVector" ) { tPropType = IndiProperty::Light; tValueKind = LightValue; }
+    else if ( szTag == "setBLOBVector" ) tPropType = IndiProperty::BLOB;
+    else return false;
+    return true;
+  }
+  if ( szTag.compare( 0, 3, "new" ) == 0 )
+  {
+    tMsgType = IndiMessage::NewProperty;
+    if ( szTag == "newNumberVector" ) tPropType = IndiProperty::Number;
+    else if ( szTag == "newSwitchVector" ) { tPropType = IndiProperty::Switch; tValueKind = SwitchValue; }
+    else if ( szTag == "newTextVector" ) tPropType = IndiProperty::Text;
+    else if ( szTag == "newBLOBVector" ) tPropType = IndiProperty::BLOB;
+    else return false;
+    return true;
+  }
+  if ( szTag.compare( 0, 3, "def" ) == 0 )
+  {
+    tMsgType = IndiMessage::Define;
+    if ( szTag == "defNumberVector" ) tPropType = IndiProperty::Number;
+    else if ( szTag == "defSwitchVector" ) { tPropType = IndiProperty::Switch; tValueKind = SwitchValue; }
+    else if ( szTag == "defTextVector" ) tPropType = IndiProperty::Text;
+    else if ( szTag == "defLightVector" ) { tPropType = IndiProperty::Light; tValueKind = LightValue; }
+    else if ( szTag == "defBLOBVector" ) tPropType = IndiProperty::BLOB;
+    else return false;
+    return true;
+  }
+  if ( szTag == "delProperty" ) { tMsgType = IndiMessage::Delete; return true; }
+  if ( szTag == "enableBLOB" ) { tMsgType = IndiMessage::EnableBLOB; return true; }
+  if ( szTag == "getProperties" ) { tMsgType = IndiMessage::GetProperties; return true; }
+  if ( szTag == "message" ) { tMsgType = IndiMessage::Message; return true; }
+
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// A read position in a complete XML document.
+
+struct Cursor
+{
+  const char *m_pcBuf;
+  size_t m_nPos;
+  size_t m_nLen;
+  string *m_pszError;
+
+  bool fail( const string &szWhy )
+  {
+    *m_pszError = szWhy;
+    return false;
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Decode the entity starting at the '&' at the cursor and append it to
+/// szOut, advancing past the ';'. Unknown entities are appended as is.
+
+bool readEntity( Cursor &cur, string &szOut )
+{
+  const char *pcStart = cur.m_pcBuf + cur.m_nPos;
+  const char *pcEnd = static_cast<const char *>(
+    ::memchr( pcStart, ';', cur.m_nLen - cur.m_nPos ) );
+  if ( pcEnd == NULL )
+    return cur.fail( "Unterminated entity" );
+
+  size_t nLen = pcEnd - pcStart + 1;
+  cur.m_nPos += nLen;
+
+  switch ( nLen )
+  {
+    case 4:
+      if ( ::memcmp( pcStart, "&lt;", 4 ) == 0 ) { szOut += '<'; return true; }
+      if ( ::memcmp( pcStart, "&gt;", 4 ) == 0 ) { szOut += '>'; return true; }
+      break;
+    case 5:
+      if ( ::memcmp( pcStart, "&amp;", 5 ) == 0 ) { szOut += '&'; return true; }
+      break;
+    case 6:
+      if ( ::memcmp( pcStart, "&apos;", 6 ) == 0 ) { szOut += '\''; return true; }
+      if ( ::memcmp( pcStart, "&quot;", 6 ) == 0 ) { szOut += '"'; return true; }
+      break;
+  }
+
+  szOut.append( pcStart, nLen );
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Read a tag name at the cursor, skipping leading whitespace.
+
+bool readTag( Cursor &cur, string &szTag )
+{
+  while ( cur.m_nPos < cur.m_nLen && isSpace( cur.m_pcBuf[cur.m_nPos] ) )
+    cur.m_nPos++;
+
+  size_t nStart = cur.m_nPos;
+  if ( nStart >= cur.m_nLen || !isTokenChar( true, cur.m_pcBuf[nStart] ) )
+    return cur.fail( "Bogus tag char" );
+
+  while ( cur.m_nPos < cur.m_nLen && isTokenChar( false, cur.m_pcBuf[cur.m_nPos] ) )
+    cur.m_nPos++;
+
+  szTag.assign( cur.m_pcBuf + nStart, cur.m_nPos - nStart );
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Read the attributes of a start tag, up to and including the '>'.
+/// Each attribute is passed to tHandler( name, value ).
+
+template <class THandler>
+bool readAttributes( Cursor &cur, bool &oSelfClosed, THandler tHandler )
+{
+  string szName;
+  string szValue;
+
+  oSelfClosed = false;
+
+  while ( cur.m_nPos < cur.m_nLen )
+  {
+    char c = cur.m_pcBuf[cur.m_nPos];
+
+    if ( c == '>' )
+    {
+      cur.m_nPos++;
+      return true;
+    }
+    if ( c == '/' )
+    {
+      if ( cur.m_nPos + 1 >= cur.m_nLen || cur.m_pcBuf[cur.m_nPos + 1] != '>' )
+        return cur.fail( "Bogus char before >" );
+      cur.m_nPos += 2;
+      oSelfClosed = true;
+      return true;
+    }
+    if ( isSpace( c ) )
+    {
+      cur.m_nPos++;
+      continue;
+    }
+    if ( !isTokenChar( true, c ) )
+      return cur.fail( string( "Bogus leading attr name char: " ) + c );
+
+    // The name.
+    size_t nStart = cur.m_nPos;
+    while ( cur.m_nPos < cur.m_nLen && isTokenChar( false, cur.m_pcBuf[cur.m_nPos] ) )
+      cur.m_nPos++;
+    szName.assign( cur.m_pcBuf + nStart, cur.m_nPos - nStart );
+
+    // Up to the opening quote.
+    while ( cur.m_nPos < cur.m_nLen &&
+            ( isSpace( cur.m_pcBuf[cur.m_nPos] ) || cur.m_pcBuf[cur.m_nPos] == '=' ) )
+      cur.m_nPos++;
+    if ( cur.m_nPos >= cur.m_nLen ||
+         ( cur.m_pcBuf[cur.m_nPos] != '"' && cur.m_pcBuf[cur.m_nPos] != '\'' ) )
+      return cur.fail( "No value for attribute " + szName );
+
+    char cDelim = cur.m_pcBuf[cur.m_nPos++];
+
+    // The value, decoding entities and dropping control characters.
+    szValue.clear();
+    while ( true )
+    {
+      if ( cur.m_nPos >= cur.m_nLen )
+        return cur.fail( "Unterminated value for attribute " + szName );
+
+      char cv = cur.m_pcBuf[cur.m_nPos];
+      if ( cv == cDelim )
+      {
+        cur.m_nPos++;
+        break;
+      }
+      if ( cv == '&' )
+      {
+        if ( readEntity( cur, szValue ) == false )
+          return false;
+        continue;
+      }
+      if ( !::iscntrl( ( unsigned char )( cv ) ) )
+        szValue += cv;
+      cur.m_nPos++;
+    }
+
+    tHandler( szName, szValue );
+  }
+
+  return cur.fail( "Unterminated start tag" );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Read the content of an element up to and including its end tag.
+/// Leading whitespace is skipped, and trailing whitespace before a tag is
+/// removed, as lilxml does. For each child element, tChild( cur ) is called
+/// with the cursor just past the '<', and must consume the child.
+
+template <class TChild>
+bool readContent( Cursor &cur, const string &szTag, string &szPcData, TChild tChild )
+{
+  bool oLeading = true;
+
+  while ( cur.m_nPos < cur.m_nLen )
+  {
+    char c = cur.m_pcBuf[cur.m_nPos];
+
+    if ( c == '<' )
+    {
+      if ( oLeading == false )
+      {
+        size_t nLen = szPcData.size();
+        while ( nLen > 0 && isSpace( szPcData[nLen - 1] ) )
+          nLen--;
+        szPcData.resize( nLen );
+      }
+
+      cur.m_nPos++;
+      if ( cur.m_nPos < cur.m_nLen && cur.m_pcBuf[cur.m_nPos] == '/' )
+      {
+        cur.m_nPos++;
+        string szEndTag;
+        if ( readTag( cur, szEndTag ) == false )
+          return cur.fail( "Bogus preend tag char" );
+        if ( szEndTag != szTag )
+          return cur.fail( "closing tag " + szEndTag + " does not match " + szTag );
+        while ( cur.m_nPos < cur.m_nLen && isSpace( cur.m_pcBuf[cur.m_nPos] ) )
+          cur.m_nPos++;
+        if ( cur.m_nPos >= cur.m_nLen || cur.m_pcBuf[cur.m_nPos] != '>' )
+          return cur.fail( "Bogus end tag char" );
+        cur.m_nPos++;
+        return true;
+      }
+
+      if ( tChild( cur ) == false )
+        return false;
+      oLeading = true;
+    }
+    else if ( c == '&' )
+    {
+      if ( readEntity( cur, szPcData ) == false )
+        return false;
+      oLeading = false;
+    }
+    else if ( oLeading && isSpace( c ) )
+    {
+      cur.m_nPos++;
+    }
+    else
+    {
+      // Append the run of plain characters in one go.
+      size_t nStart = cur.m_nPos;
+      while ( cur.m_nPos < cur.m_nLen &&
+              cur.m_pcBuf[cur.m_nPos] != '<' && cur.m_pcBuf[cur.m_nPos] != '&' )
+        cur.m_nPos++;
+      szPcData.append( cur.m_pcBuf + nStart, cur.m_nPos - nStart );
+      oLeading = false;
+    }
+  }
+
+  return cur.fail( "Missing end tag for " + szTag );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Consume an element which is not used, e.g. a grandchild of the message.
+
+bool skipElement( Cursor &cur )
+{
+  string szTag;
+  if ( readTag( cur, szTag ) == false )
+    return false;
+
+  bool oSelfClosed;
+  if ( readAttributes( cur, oSelfClosed, []( const string &, const string & ) {} ) == false )
+    return false;
+  if ( oSelfClosed )
+    return true;
+
+  string szPcData;
+  return readContent( cur, szTag, szPcData, skipElement );
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////////////////////////
+/// Constructor.
+
+IndiStreamParser::IndiStreamParser()
+{
+  clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Destructor.
+
+IndiStreamParser::~IndiStreamParser()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Reset this object, discarding any partial message.
+
+void IndiStreamParser::clear()
+{
+  m_tState = LookForStart;
+  m_nScanned = 0;
+  m_cQuote = 0;
+  m_szEndTag.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Parse at most one message from the start of the buffer.
+
+size_t IndiStreamParser::parse( const char *pcBuf,
+                                const size_t &nNumBytes,
+                                IndiMessage &imOut,
+                                bool &oComplete,
+                                string &szErrorMsg )
+{
+  oComplete = false;
+  szErrorMsg.clear();
+
+  size_t nSkip = 0;
+
+  // Silently skip anything before the start of the message, as lilxml does.
+  if ( m_tState == LookForStart )
+  {
+    const char *pcStart = static_cast<const char *>( ::memchr( pcBuf, '<', nNumBytes ) );
+    if ( pcStart == NULL )
+      return nNumBytes;
+
+    nSkip = pcStart - pcBuf;
+    m_tState = InStartTag;
+    m_nScanned = 1;
+    m_cQuote = 0;
+    m_szEndTag.clear();
+  }
+
+  long nLen = findEnd( pcBuf + nSkip, nNumBytes - nSkip, szErrorMsg );
+
+  if ( nLen == 0 )
+    return nSkip;
+
+  clear();
+
+  if ( nLen < 0 )
+  {
+    // Drop the '<' and resync on the next one.
+    std::cerr << "Error processing XML: " << szErrorMsg << std::endl;
+    return nSkip + 1;
+  }
+
+  // A bad value, like a duplicate element name, throws. The message must
+  // still be consumed, or it would be parsed again on the next call.
+  bool oBuilt = false;
+  try
+  {
+    oBuilt = build( pcBuf + nSkip, nLen, imOut, szErrorMsg );
+  }
+  catch ( const IndiProperty::Excep &excep )
+  {
+    // Its 'what' points into a temporary, so use the code.
+    szErrorMsg = IndiProperty::getErrorMsg( excep.getCode() );
+  }
+  catch ( const std::exception &excep )
+  {
+    szErrorMsg = excep.what();
+  }
+
+  if ( oBuilt == true )
+  {
+    oComplete = true;
+  }
+  else
+  {
+    std::cerr << "Error processing XML: '" << string( pcBuf + nSkip, nLen ) << "'" << std::endl
+              << "Error message: '" << szErrorMsg << "'" << std::endl;
+  }
+
+  return nSkip + nLen;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Find the end of the message starting at pcBuf[0], resuming the scan.
+
+long IndiStreamParser::findEnd( const char *pcBuf,
+                                const size_t &nNumBytes,
+                                string &szErrorMsg )
+{
+  if ( m_tState == InStartTag )
+  {
+    // First get the tag, so we know which end tag to look for.
+    if ( m_szEndTag.size() == 0 )
+    {
+      size_t nPos = m_nScanned;
+      while ( nPos < nNumBytes && isSpace( pcBuf[nPos] ) )
+        nPos++;
+      if ( nPos >= nNumBytes )
+        return 0;
+      if ( !isTokenChar( true, pcBuf[nPos] ) )
+      {
+        szErrorMsg = string( "Bogus tag char " ) + pcBuf[nPos];
+        return -1;
+      }
+
+      size_t nStart = nPos;
+      while ( nPos < nNumBytes && isTokenChar( false, pcBuf[nPos] ) )
+        nPos++;
+      if ( nPos >= nNumBytes )
+        return 0;
+
+      m_szEndTag = "</";
+      m_szEndTag.append( pcBuf + nStart, nPos - nStart );
+      m_nScanned = nPos;
+    }
+
+    // Now find the '>' which ends the start tag, skipping quoted values.
+    for ( ; m_nScanned < nNumBytes; m_nScanned++ )
+    {
+      char c = pcBuf[m_nScanned];
+      if ( m_cQuote != 0 )
+      {
+        if ( c == m_cQuote )
+          m_cQuote = 0;
+      }
+      else if ( c == '"' || c == '\'' )
+      {
+        m_cQuote = c;
+      }
+      else if ( c == '>' )
+      {
+        // A message with no content is complete now.
+        if ( pcBuf[m_nScanned - 1] == '/' )
+          return m_nScanned + 1;
+
+        m_tState = LookForEndTag;
+        m_nScanned++;
+        break;
+      }
+    }
+
+    if ( m_tState == InStartTag )
+      return 0;
+  }
+
+  // Look for the end tag, starting far enough back to catch one split
+  // across the previous call.
+  const size_t nTagLen = m_szEndTag.size();
+  while ( m_nScanned + nTagLen <= nNumBytes )
+  {
+    const char *pcFound = static_cast<const char *>(
+      ::memmem( pcBuf + m_nScanned, nNumBytes - m_nScanned, m_szEndTag.c_str(), nTagLen ) );
+    if ( pcFound == NULL )
+      break;
+
+    size_t nPos = pcFound - pcBuf;
+    size_t nAfter = nPos + nTagLen;
+
+    // Make sure the tag is not just a prefix of a longer one.
+    if ( nAfter < nNumBytes && isTokenChar( false, pcBuf[nAfter] ) )
+    {
+      m_nScanned = nPos + 1;
+      continue;
+    }
+
+    while ( nAfter < nNumBytes && isSpace( pcBuf[nAfter] ) )
+      nAfter++;
+    if ( nAfter >= nNumBytes )
+    {
+      m_nScanned = nPos;
+      return 0;
+    }
+    if ( pcBuf[nAfter] != '>' )
+    {
+      szErrorMsg = string( "Bogus end tag char " ) + pcBuf[nAfter];
+      return -1;
+    }
+
+    return nAfter + 1;
+  }
+
+  if ( nNumBytes >= nTagLen && nNumBytes - nTagLen + 1 > m_nScanned )
+    m_nScanned = nNumBytes - nTagLen + 1;
+
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Build the message from a complete XML document.
+
+bool IndiStreamParser::build( const char *pcBuf,
+                              const size_t &nLen,
+                              IndiMessage &imOut,
+                              string &szErrorMsg ) const
+{
+  Cursor cur;
+  cur.m_pcBuf = pcBuf;
+  cur.m_nPos = 1; // Past the '<'.
+  cur.m_nLen = nLen;
+  cur.m_pszError = &szErrorMsg;
+
+  string szTag;
+  if ( readTag( cur, szTag ) == false )
+    return false;
+
+  IndiProperty::Type tPropType;
+  IndiMessage::Type tMsgType = IndiMessage::Unknown;
+  ValueKind tValueKind;
+  if ( convertTag( szTag, tPropType, tMsgType, tValueKind ) == false )
+    tMsgType = IndiMessage::Unknown;
+
+  // Build the property in place in the message, to avoid copying it.
+  imOut = IndiMessage( tMsgType, IndiProperty( tPropType ) );
+  IndiProperty &ipNew = imOut.getProperty();
+
+  // Set the attributes.
+  bool oSelfClosed;
+  bool oOk = readAttributes( cur, oSelfClosed,
+    [&ipNew]( const string &szName, const string &szValue )
+    {
+      if ( szValue.size() == 0 )
+        return;
+
+      switch ( szName[0] )
+      {
+        case 'd':
+          if ( szName == "device" ) ipNew.setDevice( szValue );
+          break;
+        case 'g':
+          if ( szName == "group" ) ipNew.setGroup( szValue );
+          break;
+        case 'l':
+          if ( szName == "label" ) ipNew.setLabel( szValue );
+          break;
+        case 'm':
+          if ( szName == "message" ) ipNew.setMessage( szValue );
+          break;
+        case 'n':
+          if ( szName == "name" ) ipNew.setName( szValue );
+          break;
+        case 'p':
+          if ( szName == "perm" ) ipNew.setPerm( IndiProperty::getPropertyPermType( szValue ) );
+          break;
+        case 'r':
+          if ( szName == "rule" ) ipNew.setRule( IndiProperty::getSwitchRuleType( szValue ) );
+          break;
+        case 's':
+          if ( szName == "state" ) ipNew.setState( IndiProperty::getPropertyStateType( szValue ) );
+          break;
+        case 't':
+          if ( szName == "timestamp" )
+          {
+            TimeStamp tsMod;
+            tsMod.fromFormattedIso8601Str( szValue );
+            ipNew.setTimeStamp( tsMod );
+          }
+          else if ( szName == "timeout" )
+          {
+            ipNew.setTimeout( ::strtod( szValue.c_str(), NULL ) );
+          }
+          break;
+        case 'v':
+          if ( szName == "version" ) ipNew.setVersion( szValue );
+          break;
+      }
+    } );
+
+  if ( oOk == false )
+    return false;
+
+  string szPcData;
+
+  if ( oSelfClosed == false )
+  {
+    // Each child element becomes an element of the property.
+    IndiElement ieNew;
+    string szChildTag;
+    string szValue;
+
+    auto tChild = [&]( Cursor &curChild ) -> bool
+    {
+      if ( readTag( curChild, szChildTag ) == false )
+        return false;
+
+      ieNew = IndiElement();
+
+      bool oChildClosed;
+      if ( readAttributes( curChild, oChildClosed,
+        [&ieNew]( const string &szName, const string &szAttValue )
+        {
+          if ( szAttValue.size() == 0 )
+            return;
+
+          if ( szName == "name" ) ieNew.setName( szAttValue );
+          else if ( szName == "format" ) ieNew.setFormat( szAttValue );
+          else if ( szName == "label" ) ieNew.setLabel( szAttValue );
+          else if ( szName == "max" ) ieNew.setMax( szAttValue );
+          else if ( szName == "min" ) ieNew.setMin( szAttValue );
+          else if ( szName == "size" ) ieNew.setSize( szAttValue );
+          else if ( szName == "step" ) ieNew.setStep( szAttValue );
+        } ) == false )
+        return false;
+
+      szValue.clear();
+      if ( oChildClosed == false )
+      {
+        if ( readContent( curChild, szChildTag, szValue, skipElement ) == false )
+          return false;
+      }
+
+      // The different types have different data...
+      switch ( tValueKind )
+      {
+        case LightValue:
+          ieNew.setLightState( IndiElement::getLightStateType( szValue ) );
+          break;
+        case SwitchValue:
+          ieNew.setSwitchState( IndiElement::getSwitchStateType( szValue ) );
+          break;
+        default:
+          ieNew.setValue( szValue );
+      }
+
+      // Now add this element to the message.
+      ipNew.add( ieNew );
+      return true;
+    };
+
+    if ( readContent( cur, szTag, szPcData, tChild ) == false )
+      return false;
+  }
+
+  // A special case is a BLOB enable message - it has no elements,
+  // but has data in it.
+  if ( tMsgType == IndiMessage::EnableBLOB )
+  {
+    ipNew = IndiProperty::getBLOBEnableType( szPcData );
+  }
+
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,99 @@
+/// IndiStreamParser.hpp
+///
+/// An incremental parser for a stream of INDI XML messages. The caller
+/// owns the buffer, and the parser scans it in place. Each call to 'parse'
+/// is given the unconsumed bytes, starting with any partial message left
+/// over from the previous call, and returns how many bytes it consumed.
+/// Complete messages are built directly into an IndiMessage, without an
+/// intermediate DOM.
+///
+/// Finding the end of a partial message resumes where the previous call
+/// stopped, so a message which arrives over many reads is only scanned
+/// once for its end, and then once to build it.
+///
+/// The XML accepted, and the handling of whitespace and entities, is the
+/// same as lilxml as used by IndiXmlParser.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INDI_STREAM_PARSER_HPP
+#define INDI_STREAM_PARSER_HPP
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include "IndiProperty.hpp"
+#include "IndiMessage.hpp"
+
+namespace pcf
+{
+class IndiStreamParser
+{
+  private:
+    enum ScanState
+    {
+      // Looking for the '<' which starts the message.
+      LookForStart = 0,
+      // In the start tag of the message, looking for the '>' which ends it.
+      InStartTag,
+      // In the content of the message, looking for the end tag.
+      LookForEndTag,
+    };
+
+  // Constructor/destructor.
+  public:
+    /// Constructor.
+    IndiStreamParser();
+    /// Destructor.
+    virtual ~IndiStreamParser();
+
+  // Methods.
+  public:
+    /// Reset this object, discarding any partial message.
+    void clear();
+    /// Parse at most one message from the start of the buffer.
+    /// Returns the number of bytes consumed, which may be more than 0 even
+    /// if no message was completed (e.g. leading whitespace was skipped).
+    /// 'oComplete' is true if 'imOut' holds a new message. If the message
+    /// was malformed, the bytes up to the error are consumed, 'oComplete'
+    /// is false, and 'szErrorMsg' holds the reason.
+    /// If no message was completed, the next call must be passed the
+    /// unconsumed bytes again, with any new data appended.
+    size_t parse( const char *pcBuf,
+                  const size_t &nNumBytes,
+                  pcf::IndiMessage &imOut,
+                  bool &oComplete,
+                  std::string &szErrorMsg );
+
+  // Helper functions.
+  private:
+    /// Find the end of the message starting at pcBuf[0], resuming the scan.
+    /// Returns the length of the message, or 0 if it is not complete yet.
+    /// Returns -1 if the message is malformed.
+    long findEnd( const char *pcBuf,
+                  const size_t &nNumBytes,
+                  std::string &szErrorMsg );
+    /// Build the message from a complete XML document of length nLen.
+    /// Returns false if it is malformed.
+    bool build( const char *pcBuf,
+                const size_t &nLen,
+                pcf::IndiMessage &imOut,
+                std::string &szErrorMsg ) const;
+
+  // Members.
+  private:
+    /// Where we are in finding the end of the current message.
+    ScanState m_tState;
+    /// How many bytes of the current message have been scanned.
+    size_t m_nScanned;
+    /// The quote character, if we are in an attribute value in the start tag.
+    char m_cQuote;
+    /// The end tag we are looking for, e.g. "</setNumberVector".
+    std::string m_szEndTag;
+
+}; // class IndiStreamParser
+} // namespace pcf
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // INDI_STREAM_PARSER_HPP
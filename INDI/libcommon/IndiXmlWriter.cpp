@@ -0,0 +1,211 @@
+/// IndiXmlWriter.cpp
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include "IndiElement.hpp"
+#include "IndiXmlWriter.hpp"
+
+using std::string;
+using std::runtime_error;
+using pcf::IndiElement;
+using pcf::IndiElementMap;
+using pcf::IndiProperty;
+using pcf::IndiXmlWriter;
+using pcf::TimeStamp;
+
+////////////////////////////////////////////////////////////////////////////////
+/// Can a set property message for this property be written directly?
+
+bool IndiXmlWriter::canWriteSetProperty( const IndiProperty &ipSend )
+{
+  switch ( ipSend.getType() )
+  {
+    case IndiProperty::Light:
+    case IndiProperty::Number:
+    case IndiProperty::Switch:
+    case IndiProperty::Text:
+      return true;
+    default:
+      return false;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Append the set property message. This matches the output of
+/// IndiXmlParser::createSet*Vector, except that the message attribute is
+/// made XML-safe.
+/// SetVector REQUIRED: device name
+/// SetVector IMPLIED:  state timeout (not for lights) timestamp message
+/// oneXXX REQUIRED: name
+
+void IndiXmlWriter::appendSetProperty( string &szOut,
+                                       const IndiProperty &ipSend,
+                                       const TimeStamp &tsSend )
+{
+  const char *pcTag = NULL;
+  const char *pcElementTag = NULL;
+
+  switch ( ipSend.getType() )
+  {
+    case IndiProperty::Light:
+      pcTag = "setLightVector"; pcElementTag = "oneLight"; break;
+    case IndiProperty::Number:
+      pcTag = "setNumberVector"; pcElementTag = "oneNumber"; break;
+    case IndiProperty::Switch:
+      pcTag = "setSwitchVector"; pcElementTag = "oneSwitch"; break;
+    case IndiProperty::Text:
+      pcTag = "setTextVector"; pcElementTag = "oneText"; break;
+    default:
+      throw runtime_error( "INDI property SET type can not be written directly." );
+  }
+
+  // "required" means that the attribute must be added and contain a valid
+  // entry. If it is not part of the generated XML, it is an error.
+  if ( ipSend.hasValidDevice() == false )
+    throw runtime_error( string( pcTag ) + " '" + ipSend.getName() +
+                         "' must have attribute 'device' defined." );
+  if ( ipSend.hasValidName() == false )
+    throw runtime_error( string( pcTag ) + " '" + ipSend.getName() +
+                         "' must have attribute 'name' defined." );
+
+  szOut += '<';
+  szOut += pcTag;
+  szOut += " device=\"";
+  szOut += ipSend.getDevice();
+  szOut += "\" name=\"";
+  szOut += ipSend.getName();
+  szOut += '"';
+
+  // "implied" means that if they are not defined, don't add them. Adding an
+  // empty "implied" attribute to the generated XML is an error.
+  if ( ipSend.hasValidState() == true )
+  {
+    szOut += " state=\"";
+    szOut += IndiProperty::getPropertyStateString( ipSend.getState() );
+    szOut += '"';
+  }
+  if ( ipSend.getType() != IndiProperty::Light && ipSend.hasValidTimeout() == true )
+  {
+    char pcTimeout[32];
+    ::snprintf( pcTimeout, sizeof( pcTimeout ), "%g", ipSend.getTimeout() );
+    szOut += " timeout=\"";
+    szOut += pcTimeout;
+    szOut += '"';
+  }
+  szOut += " timestamp=\"";
+  appendIso8601( szOut, tsSend );
+  szOut += '"';
+  if ( ipSend.hasValidMessage() == true )
+  {
+    szOut += " message=\"";
+    appendSafeXml( szOut, ipSend.getMessage() );
+    szOut += '"';
+  }
+  szOut += ">\r\n";
+
+  // Walk the elements once, in the order they were added.
+  const IndiElementMap &mapElements = ipSend.getElements();
+  IndiElementMap::const_iterator itr = mapElements.begin();
+  for ( ; itr != mapElements.end(); ++itr )
+  {
+    const IndiElement &ieSend = itr->second;
+
+    if ( ieSend.hasValidName() == false )
+      throw runtime_error( string( pcElementTag ) +
+                           " must have attribute 'name' defined." );
+
+    szOut += "\t<";
+    szOut += pcElementTag;
+    szOut += " name=\"";
+    szOut += ieSend.getName();
+    szOut += "\">\r\n";
+
+    // Only text can contain characters which must be escaped.
+    switch ( ipSend.getType() )
+    {
+      case IndiProperty::Light:
+        szOut += IndiElement::getLightStateString( ieSend.getLightState() );
+        break;
+      case IndiProperty::Switch:
+        szOut += IndiElement::getSwitchStateString( ieSend.getSwitchState() );
+        break;
+      case IndiProperty::Text:
+        appendSafeXml( szOut, ieSend.getValue() );
+        break;
+      default:
+        szOut += ieSend.getValue();
+        break;
+    }
+
+    szOut += "\r\n\t</";
+    szOut += pcElementTag;
+    szOut += ">\r\n";
+  }
+
+  szOut += "</";
+  szOut += pcTag;
+  szOut += ">\r\n";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Append the text, replacing each special character with its XML entity.
+/// Runs of ordinary characters are appended in one go.
+
+void IndiXmlWriter::appendSafeXml( string &szOut, const string &szText )
+{
+  const char *pcText = szText.c_str();
+  const char *pcEnd = pcText + szText.size();
+
+  while ( pcText < pcEnd )
+  {
+    // A run also stops at an embedded null, which is copied as is below.
+    size_t nRun = ::strcspn( pcText, "&<>'\"" );
+    szOut.append( pcText, nRun );
+    pcText += nRun;
+    if ( pcText >= pcEnd )
+      break;
+
+    switch ( *pcText )
+    {
+      case '&': szOut += "&amp;"; break;
+      case '<': szOut += "&lt;"; break;
+      case '>': szOut += "&gt;"; break;
+      case '\'': szOut += "&apos;"; break;
+      case '"': szOut += "&quot;"; break;
+      default: szOut += *pcText; break;
+    }
+    pcText++;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Append the time, in the same format as
+/// TimeStamp::getFormattedIso8601Str, but without the stringstream.
+/// 'gmtime_r' is used, since this may be called from several threads.
+
+void IndiXmlWriter::appendIso8601( string &szOut, const TimeStamp &tsValue )
+{
+  time_t tNumSecs = tsValue.getTimeValSecs();
+  int nNumMicros = tsValue.getTimeValMicros();
+  tm tmCurr;
+
+  if ( ::gmtime_r( &tNumSecs, &tmCurr ) == NULL )
+  {
+    szOut += "0000-00-00T00:00:00.000000Z";
+    return;
+  }
+
+  char pcFormatted[64];
+  int nLen = ::snprintf( pcFormatted, sizeof( pcFormatted ),
+                         "%04d-%02d-%02dT%02d:%02d:%02d.%06dZ",
+                         1900 + tmCurr.tm_year, 1 + tmCurr.tm_mon,
+                         tmCurr.tm_mday, tmCurr.tm_hour, tmCurr.tm_min,
+                         tmCurr.tm_sec, nNumMicros );
+  szOut.append( pcFormatted, nLen );
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,49 @@
+/// IndiXmlWriter.hpp
+///
+/// Writes the XML for an INDI message directly into a string, without
+/// copying the property or building an intermediate document. This is used
+/// for the set property messages, which are by far the most frequent
+/// messages sent by a driver. The output is the same as IndiXmlParser.
+///
+/// The string is appended to, so the caller can reuse one string for every
+/// message and avoid allocating once it has grown large enough.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INDI_XML_WRITER_HPP
+#define INDI_XML_WRITER_HPP
+#pragma once
+
+#include <string>
+#include "IndiProperty.hpp"
+#include "TimeStamp.hpp"
+
+namespace pcf
+{
+class IndiXmlWriter
+{
+  // Methods.
+  public:
+    /// Can a set property message for this property be written directly?
+    /// This is true for all the types except BLOB.
+    static bool canWriteSetProperty( const pcf::IndiProperty &ipSend );
+    /// Append the set property message for 'ipSend' to 'szOut', using
+    /// 'tsSend' as the timestamp. Throws if a required attribute is missing,
+    /// or if the property is a BLOB.
+    static void appendSetProperty( std::string &szOut,
+                                   const pcf::IndiProperty &ipSend,
+                                   const pcf::TimeStamp &tsSend );
+    /// Append 'szText' to 'szOut', replacing '&', '<', '>', ''', and '"'
+    /// with the equivalent XML entity.
+    static void appendSafeXml( std::string &szOut,
+                               const std::string &szText );
+    /// Append the time in the form 2009-12-30T12:34:56.123456Z to 'szOut'.
+    static void appendIso8601( std::string &szOut,
+                               const pcf::TimeStamp &tsValue );
+
+}; // class IndiXmlWriter
+} // namespace pcf
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // INDI_XML_WRITER_HPP
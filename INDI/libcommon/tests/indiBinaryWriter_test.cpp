@@ -0,0 +1,197 @@
+/** \file indiBinaryWriter_test.cpp
+  * \brief Catch2 tests for the binary set property frames.
+  *
+  * History:
+  */
+#include "../../../tests/catch2/catch.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../IndiBinaryWriter.hpp"
+#include "../IndiXmlWriter.hpp"
+
+//indiserver's reader is not in a library, so compile it here to check the round trip.
+#include "../../INDI/indibin.c"
+
+namespace indiBinaryWriter_test
+{
+
+std::string xmlSet( const pcf::IndiProperty & ip,
+                    const pcf::TimeStamp & ts
+                  )
+{
+   std::string xml;
+   pcf::IndiXmlWriter::appendSetProperty(xml, ip, ts);
+   return xml;
+}
+
+/// Write the DEF and SET frames, then convert them back the way indiserver does.
+std::string binarySet( const pcf::IndiProperty & ip,
+                       const pcf::TimeStamp & ts
+                     )
+{
+   std::string def, set;
+   pcf::IndiBinaryWriter::appendDefine(def, 7, ip);
+   pcf::IndiBinaryWriter::appendSetProperty(set, 7, ip, ts);
+
+   const unsigned char * pdef = reinterpret_cast<const unsigned char *>(def.data());
+   const unsigned char * pset = reinterpret_cast<const unsigned char *>(set.data());
+
+   REQUIRE(ibfFrameLen(pdef, def.size()) == (int) def.size());
+   REQUIRE(ibfFrameLen(pset, set.size()) == (int) set.size());
+   REQUIRE(ibfId(pdef) == 7);
+   REQUIRE(ibfId(pset) == 7);
+
+   IBFDef d;
+   REQUIRE(ibfReadDef(pdef, def.size(), &d) == 0);
+
+   int len = ibfSetXML(&d, pset, set.size(), NULL, 0);
+   REQUIRE(len > 0);
+
+   std::string xml(len+1, '\0');
+   REQUIRE(ibfSetXML(&d, pset, set.size(), &xml[0], xml.size()) == len);
+   xml.resize(len);
+
+   ibfFreeDef(&d);
+   return xml;
+}
+
+SCENARIO( "Writing set property messages as binary frames", "[indiBinaryWriter]" )
+{
+   pcf::TimeStamp ts(timeval({1600000000, 1234}));
+
+   GIVEN("A number property")
+   {
+      pcf::IndiProperty ip(pcf::IndiProperty::Number, "camwfs", "temp_ccd");
+      ip.setState(pcf::IndiProperty::Ok);
+      ip.add(pcf::IndiElement("current", -14.98));
+      ip.add(pcf::IndiElement("target", -15.0));
+      ip.add(pcf::IndiElement("count", 1234567890123456789LL));
+      ip.add(pcf::IndiElement("text", "not a number"));
+
+      WHEN("written with no timeout")
+      {
+         REQUIRE(binarySet(ip, ts) == xmlSet(ip, ts));
+      }
+
+      WHEN("written with a timeout")
+      {
+         ip.setTimeout(2.5);
+         REQUIRE(binarySet(ip, ts) == xmlSet(ip, ts));
+      }
+
+      WHEN("written with a message")
+      {
+         ip.setMessage("cooling");
+         REQUIRE(pcf::IndiBinaryWriter::canWriteSetProperty(ip) == false);
+      }
+   }
+
+   GIVEN("A switch property")
+   {
+      pcf::IndiProperty ip(pcf::IndiProperty::Switch, "fwpupil", "filterName");
+      ip.setState(pcf::IndiProperty::Busy);
+      for(int n = 0; n < 8; ++n)
+      {
+         ip.add(pcf::IndiElement("filter" + std::to_string(n), (n == 3) ? pcf::IndiElement::On : pcf::IndiElement::Off));
+      }
+
+      REQUIRE(binarySet(ip, ts) == xmlSet(ip, ts));
+   }
+
+   GIVEN("A light property with no state")
+   {
+      pcf::IndiProperty ip(pcf::IndiProperty::Light, "pdu0", "status");
+      ip.add(pcf::IndiElement("fan", pcf::IndiElement::Alert));
+      ip.add(pcf::IndiElement("power", pcf::IndiElement::Idle));
+
+      REQUIRE(binarySet(ip, ts) == xmlSet(ip, ts));
+   }
+
+   GIVEN("A text property with characters which must be escaped")
+   {
+      pcf::IndiProperty ip(pcf::IndiProperty::Text, "tcsi", "catalog");
+      ip.setState(pcf::IndiProperty::Idle);
+      ip.add(pcf::IndiElement("object", "Alpha <Cen> & \"friends\" 'A'"));
+      ip.add(pcf::IndiElement("empty", ""));
+
+      REQUIRE(binarySet(ip, ts) == xmlSet(ip, ts));
+   }
+
+   GIVEN("A frame which is cut short")
+   {
+      pcf::IndiProperty ip(pcf::IndiProperty::Number, "camwfs", "temp_ccd");
+      ip.add(pcf::IndiElement("current", -14.98));
+
+      std::string set;
+      pcf::IndiBinaryWriter::appendSetProperty(set, 1, ip, ts);
+      const unsigned char * pset = reinterpret_cast<const unsigned char *>(set.data());
+
+      REQUIRE(ibfFrameLen(pset, IBF_HDRLEN-1) == 0);
+      REQUIRE(ibfFrameLen(reinterpret_cast<const unsigned char *>("<set"), 4) == -1);
+   }
+
+   GIVEN("Properties which can not be sent as frames")
+   {
+      pcf::IndiProperty ipBlob(pcf::IndiProperty::BLOB, "camwfs", "image");
+      REQUIRE(pcf::IndiBinaryWriter::canWriteSetProperty(ipBlob) == false);
+
+      std::string def;
+      REQUIRE_THROWS(pcf::IndiBinaryWriter::appendDefine(def, 0, ipBlob));
+
+      pcf::IndiProperty ipNoDev(pcf::IndiProperty::Number);
+      ipNoDev.setName("temp_ccd");
+      REQUIRE_THROWS(pcf::IndiBinaryWriter::appendDefine(def, 0, ipNoDev));
+   }
+}
+
+SCENARIO( "Benchmarking the binary set property writer", "[.benchmark]" )
+{
+   GIVEN("A typical number property written to /dev/null")
+   {
+      pcf::IndiProperty ip(pcf::IndiProperty::Number, "camwfs", "temp_ccd");
+      ip.setState(pcf::IndiProperty::Ok);
+      ip.add(pcf::IndiElement("current", -14.98));
+      ip.add(pcf::IndiElement("target", -15.0));
+
+      int fd = open("/dev/null", O_WRONLY);
+      REQUIRE(fd >= 0);
+
+      const size_t N = 1000000;
+
+      std::string buf;
+      size_t nShort = 0;
+      auto t0 = std::chrono::steady_clock::now();
+      for(size_t n = 0; n < N; ++n)
+      {
+         buf.clear();
+         pcf::IndiXmlWriter::appendSetProperty(buf, ip, pcf::TimeStamp::now());
+         if(write(fd, buf.data(), buf.size()) != (ssize_t) buf.size()) ++nShort;
+      }
+      size_t nXml = buf.size();
+      auto t1 = std::chrono::steady_clock::now();
+      for(size_t n = 0; n < N; ++n)
+      {
+         buf.clear();
+         pcf::IndiBinaryWriter::appendSetProperty(buf, 0, ip, pcf::TimeStamp::now());
+         if(write(fd, buf.data(), buf.size()) != (ssize_t) buf.size()) ++nShort;
+      }
+      auto t2 = std::chrono::steady_clock::now();
+
+      REQUIRE(nShort == 0);
+
+      close(fd);
+
+      double dXml = std::chrono::duration<double>(t1-t0).count();
+      double dBin = std::chrono::duration<double>(t2-t1).count();
+
+      std::cout << "IndiXmlWriter:    " << N/dXml << " msgs/s, " << nXml << " bytes\n";
+      std::cout << "IndiBinaryWriter: " << N/dBin << " msgs/s, " << buf.size() << " bytes\n";
+   }
+}
+
+} //namespace indiBinaryWriter_test
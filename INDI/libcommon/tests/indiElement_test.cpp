@@ -0,0 +1,333 @@
+/** \file indiElement_test.cpp
+  * \brief Catch2 tests for the numeric storage in IndiElement, the element container in IndiProperty, and the raw comparison in updateIfChanged.
+  *
+  * History:
+  */
+#include "../../../tests/catch2/catch.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#include "../IndiElement.hpp"
+#include "../IndiProperty.hpp"
+#include "../../../libMagAOX/app/indiUtils.hpp"
+
+namespace indiElement_test
+{
+
+/// The text the element used to hold, formatted with a stringstream
+template<typename T>
+std::string streamed( const T & val )
+{
+   std::stringstream ss;
+   ss.precision(15);
+   ss << std::boolalpha << val;
+   return ss.str();
+}
+
+/// Counts the set property messages instead of sending them
+struct fakeDriver
+{
+   int m_nSent {0};
+
+   void sendSetProperty( const pcf::IndiProperty & )
+   {
+      ++m_nSent;
+   }
+};
+
+SCENARIO( "Setting IndiElement values from numbers", "[indiElement]" )
+{
+   GIVEN("Numbers of different types")
+   {
+      pcf::IndiElement ie("val");
+      double xVal;
+
+      WHEN("set from doubles, the text is unchanged and the number is kept")
+      {
+         std::vector<double> vals = {0.0, -0.0, 1.0, -14.98, 0.1, 1.0/3.0, 1e-300, 6.02214076e23, 123456789012345.0,
+                                     std::numeric_limits<double>::infinity(), std::numeric_limits<double>::quiet_NaN()};
+         for(size_t n = 0; n < vals.size(); ++n)
+         {
+            ie.set(vals[n]);
+            REQUIRE(ie.getValue() == streamed(vals[n]));
+            REQUIRE(ie.getNumber(xVal));
+            if(!std::isnan(vals[n])) REQUIRE(xVal == vals[n]);
+         }
+      }
+
+      WHEN("set from floats")
+      {
+         float fVal = 0.1;
+         ie = fVal;
+         REQUIRE(ie.getValue() == streamed(fVal));
+         REQUIRE(ie.getValue<float>() == fVal);
+      }
+
+      WHEN("set from integers")
+      {
+         ie.setValue(-42);
+         REQUIRE(ie.getValue() == "-42");
+         REQUIRE(ie.getNumber(xVal));
+         REQUIRE(xVal == -42);
+
+         uint64_t big = 18446744073709551615ULL;
+         ie.set(big);
+         REQUIRE(ie.getValue() == streamed(big));
+         REQUIRE(ie.getNumber(xVal) == false); //not exact in a double
+         REQUIRE(ie.getValue<uint64_t>() == big);
+      }
+
+      WHEN("set from types which are not numbers")
+      {
+         ie.set(true);
+         REQUIRE(ie.getValue() == "true");
+         REQUIRE(ie.getNumber(xVal) == false);
+
+         ie.set('c');
+         REQUIRE(ie.getValue() == "c");
+         REQUIRE(ie.getNumber(xVal) == false);
+      }
+
+      WHEN("set from text after a number")
+      {
+         ie.set(2.5);
+         ie.setValue(std::string("3.5"));
+         REQUIRE(ie.getNumber(xVal) == false);
+         REQUIRE(ie.getValue<double>() == 3.5);
+      }
+
+      WHEN("copied")
+      {
+         ie.set(2.5);
+         pcf::IndiElement ie2(ie);
+         REQUIRE(ie2.getNumber(xVal));
+         REQUIRE(xVal == 2.5);
+         REQUIRE(ie2 == ie);
+      }
+   }
+}
+
+SCENARIO( "Addressing the elements of an IndiProperty", "[indiElement]" )
+{
+   GIVEN("A property with elements added out of alphabetical order")
+   {
+      pcf::IndiProperty p(pcf::IndiProperty::Number, "dev", "prop");
+      std::vector<std::string> els = {"zeta", "alpha", "mu", "beta"};
+      for(size_t n = 0; n < els.size(); ++n) p.add(pcf::IndiElement(els[n], (int) n));
+
+      WHEN("iterated, the elements are in the order they were added")
+      {
+         size_t n = 0;
+         for(auto it = p.getElements().begin(); it != p.getElements().end(); ++it, ++n)
+         {
+            REQUIRE(it->first == els[n]);
+            REQUIRE(it->second.getName() == els[n]);
+         }
+         REQUIRE(n == els.size());
+      }
+
+      WHEN("looked up by name and by index")
+      {
+         for(size_t n = 0; n < els.size(); ++n)
+         {
+            unsigned int idx = p.getElementIndex(els[n]);
+            REQUIRE(idx == n);
+            REQUIRE(p[idx].getName() == els[n]);
+            REQUIRE(p[els[n]].get<int>() == (int) n);
+            REQUIRE(p.find(els[n]) == true);
+         }
+         REQUIRE(p.find("omega") == false);
+         REQUIRE_THROWS(p.getElementIndex("omega"));
+         REQUIRE_THROWS(p.at(els.size()));
+      }
+
+      WHEN("an element is added twice or removed")
+      {
+         REQUIRE_THROWS(p.add(pcf::IndiElement("mu", 7)));
+         p.addIfNoExist(pcf::IndiElement("mu", 7));
+         REQUIRE(p["mu"].get<int>() == 2);
+
+         p.remove("alpha");
+         REQUIRE(p.getNumElements() == 3);
+         REQUIRE(p.getElementIndex("mu") == 1);
+         REQUIRE(p.getElementIndex("beta") == 2);
+         REQUIRE(p["beta"].get<int>() == 3);
+         REQUIRE(p.find("alpha") == false);
+      }
+
+      WHEN("copied and moved")
+      {
+         pcf::IndiProperty p2(p);
+         REQUIRE(p2 == p);
+         pcf::IndiProperty p3(std::move(p2));
+         REQUIRE(p3 == p);
+         REQUIRE(p3.getElementIndex("mu") == 2);
+      }
+   }
+}
+
+SCENARIO( "Updating INDI properties only if changed", "[indiElement]" )
+{
+   GIVEN("A number property and a driver")
+   {
+      pcf::IndiProperty p(pcf::IndiProperty::Number, "dev", "prop");
+      p.add(pcf::IndiElement("current", 0));
+      p.setState(pcf::IndiProperty::Ok);
+
+      fakeDriver drv;
+
+      WHEN("the same value is set again")
+      {
+         MagAOX::app::indi::updateIfChanged(p, "current", 1.5, &drv);
+         REQUIRE(drv.m_nSent == 1);
+         MagAOX::app::indi::updateIfChanged(p, "current", 1.5, &drv);
+         REQUIRE(drv.m_nSent == 1);
+         MagAOX::app::indi::updateIfChanged(p, "current", 1.5, &drv, pcf::IndiProperty::Busy);
+         REQUIRE(drv.m_nSent == 2);
+      }
+
+      WHEN("a deadband is used")
+      {
+         MagAOX::app::indi::updateIfChanged(p, "current", 10.0, &drv, pcf::IndiProperty::Ok, 0.5);
+         REQUIRE(drv.m_nSent == 1);
+         MagAOX::app::indi::updateIfChanged(p, "current", 10.4, &drv, pcf::IndiProperty::Ok, 0.5);
+         REQUIRE(drv.m_nSent == 1);
+         REQUIRE(p["current"].get<double>() == 10.0);
+         MagAOX::app::indi::updateIfChanged(p, "current", 10.6, &drv, pcf::IndiProperty::Ok, 0.5);
+         REQUIRE(drv.m_nSent == 2);
+         REQUIRE(p["current"].get<double>() == 10.6);
+      }
+
+      WHEN("the value becomes NaN")
+      {
+         double nan = std::numeric_limits<double>::quiet_NaN();
+         MagAOX::app::indi::updateIfChanged(p, "current", 1.0, &drv);
+         MagAOX::app::indi::updateIfChanged(p, "current", nan, &drv, pcf::IndiProperty::Ok, 10.0);
+         REQUIRE(drv.m_nSent == 2);
+         MagAOX::app::indi::updateIfChanged(p, "current", nan, &drv, pcf::IndiProperty::Ok, 10.0);
+         REQUIRE(drv.m_nSent == 2);
+      }
+
+      WHEN("several elements are updated")
+      {
+         p.add(pcf::IndiElement("target", 0));
+         std::vector<std::string> els = {"current", "target"};
+         MagAOX::app::indi::updateIfChanged(p, els, std::vector<float>({1.0, 2.0}), &drv);
+         REQUIRE(drv.m_nSent == 1);
+         MagAOX::app::indi::updateIfChanged(p, els, std::vector<float>({1.0, 2.0}), &drv);
+         REQUIRE(drv.m_nSent == 1);
+         MagAOX::app::indi::updateIfChanged(p, els, std::vector<float>({1.0, 2.1}), &drv);
+         REQUIRE(drv.m_nSent == 2);
+      }
+   }
+
+   GIVEN("A text property")
+   {
+      pcf::IndiProperty p(pcf::IndiProperty::Text, "dev", "prop");
+      p.add(pcf::IndiElement("current", ""));
+      p.setState(pcf::IndiProperty::Ok);
+
+      fakeDriver drv;
+
+      MagAOX::app::indi::updateIfChanged(p, "current", std::string("READY"), &drv);
+      REQUIRE(drv.m_nSent == 1);
+      MagAOX::app::indi::updateIfChanged(p, "current", std::string("READY"), &drv);
+      REQUIRE(drv.m_nSent == 1);
+   }
+}
+
+SCENARIO( "Benchmarking updateIfChanged", "[.benchmark]" )
+{
+   GIVEN("A four element number property which rarely changes")
+   {
+      pcf::IndiProperty p(pcf::IndiProperty::Number, "dev", "prop");
+      std::vector<std::string> els = {"one_sec", "two_sec", "five_sec", "ten_sec"};
+      for(auto & el : els) p.add(pcf::IndiElement(el, 0));
+      p.setState(pcf::IndiProperty::Ok);
+
+      fakeDriver drv;
+      std::vector<double> vals = {1.25, 2.5, 5.75, 10.125};
+      MagAOX::app::indi::updateIfChanged(p, els, vals, &drv);
+
+      const size_t N = 200000;
+
+      auto t0 = std::chrono::steady_clock::now();
+      size_t nChanged = 0;
+      for(size_t n = 0; n < N; ++n)
+      {
+         //The original comparison, in string space
+         for(size_t k = 0; k < els.size(); ++k)
+         {
+            if(p[els[k]].getValue() != streamed(vals[k])) ++nChanged;
+         }
+      }
+      auto t1 = std::chrono::steady_clock::now();
+      for(size_t n = 0; n < N; ++n)
+      {
+         MagAOX::app::indi::updateIfChanged(p, els, vals, &drv);
+      }
+      auto t2 = std::chrono::steady_clock::now();
+
+      REQUIRE(nChanged == 0);
+      REQUIRE(drv.m_nSent == 1);
+
+      double dOld = std::chrono::duration<double>(t1-t0).count();
+      double dNew = std::chrono::duration<double>(t2-t1).count();
+
+      std::cout << "string compare: " << N/dOld << " updates/s\n";
+      std::cout << "raw compare:    " << N/dNew << " updates/s\n";
+   }
+}
+
+SCENARIO( "Benchmarking IndiProperty element lookup", "[.benchmark]" )
+{
+   GIVEN("Eight elements, in the original map and in the new container")
+   {
+      std::map<std::string, pcf::IndiElement> mapEls;
+      std::vector<std::string> els;
+      for(int n = 0; n < 8; ++n)
+      {
+         els.push_back("element_" + std::to_string(n));
+         mapEls[els.back()] = pcf::IndiElement(els.back(), n);
+      }
+      pcf::IndiElementMap iem(mapEls);
+
+      std::vector<int> idx;
+      for(auto & el : els) idx.push_back(iem.indexOf(el));
+
+      const size_t N = 1000000;
+      size_t sum[3] = {0, 0, 0};
+
+      auto t0 = std::chrono::steady_clock::now();
+      for(size_t n = 0; n < N; ++n)
+      {
+         for(size_t k = 0; k < els.size(); ++k) sum[0] += mapEls.find(els[k])->first.size();
+      }
+      auto t1 = std::chrono::steady_clock::now();
+      for(size_t n = 0; n < N; ++n)
+      {
+         for(size_t k = 0; k < els.size(); ++k) sum[1] += iem.find(els[k])->first.size();
+      }
+      auto t2 = std::chrono::steady_clock::now();
+      for(size_t n = 0; n < N; ++n)
+      {
+         for(size_t k = 0; k < idx.size(); ++k) sum[2] += (iem.begin() + idx[k])->first.size();
+      }
+      auto t3 = std::chrono::steady_clock::now();
+
+      REQUIRE(sum[0] == sum[1]);
+      REQUIRE(sum[0] == sum[2]);
+
+      double dMap = std::chrono::duration<double>(t1-t0).count();
+      double dName = std::chrono::duration<double>(t2-t1).count();
+      double dIndex = std::chrono::duration<double>(t3-t2).count();
+
+      std::cout << "std::map by name:        " << N*els.size()/dMap << " lookups/s\n";
+      std::cout << "IndiElementMap by name:  " << N*els.size()/dName << " lookups/s\n";
+      std::cout << "IndiElementMap by index: " << N*els.size()/dIndex << " lookups/s\n";
+   }
+}
+
+} //namespace indiElement_test
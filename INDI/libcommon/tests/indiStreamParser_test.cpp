@@ -0,0 +1,292 @@
+/** \file indiStreamParser_test.cpp
+  * \brief Catch2 tests for the streaming INDI XML parser.
+  *
+  * History:
+  */
+#include "../../../tests/catch2/catch.hpp"
+
+#include <chrono>
+#include <random>
+
+#include "../IndiStreamParser.hpp"
+#include "../IndiXmlParser.hpp"
+
+namespace indiStreamParser_test 
+{
+
+/// Generate a stream of INDI messages similar to indiserver traffic
+/** Mostly setNumberVector and setSwitchVector updates, with some definitions, text with entities,
+  * messages and deletes.
+  */
+std::vector<std::string> makeTraffic( size_t nMsgs )
+{
+   std::vector<std::string> xml;
+
+   pcf::IndiProperty ipNum(pcf::IndiProperty::Number, "camwfs", "temp_ccd");
+   ipNum.setState(pcf::IndiProperty::Ok);
+   ipNum.add(pcf::IndiElement("current", 0.0));
+   ipNum.add(pcf::IndiElement("target", -15.0));
+
+   pcf::IndiProperty ipDefNum = ipNum;
+   ipDefNum.setPerm(pcf::IndiProperty::ReadWrite);
+   ipDefNum.setLabel("CCD Temperature");
+   ipDefNum.setGroup("Temps");
+   ipDefNum["current"].setFormat("%0.2f");
+   ipDefNum["current"].setMin("-100");
+   ipDefNum["current"].setMax("100");
+   ipDefNum["current"].setStep("0.1");
+   ipDefNum["target"].setFormat("%0.2f");
+   ipDefNum["target"].setMin("-100");
+   ipDefNum["target"].setMax("100");
+   ipDefNum["target"].setStep("0.1");
+
+   pcf::IndiProperty ipSw(pcf::IndiProperty::Switch, "fwpupil", "filterName");
+   ipSw.setState(pcf::IndiProperty::Busy);
+   ipSw.setRule(pcf::IndiProperty::OneOfMany);
+   ipSw.setPerm(pcf::IndiProperty::ReadWrite);
+   for(int n = 0; n < 8; ++n)
+   {
+      ipSw.add(pcf::IndiElement("filter" + std::to_string(n), pcf::IndiElement::Off));
+   }
+
+   pcf::IndiProperty ipTxt(pcf::IndiProperty::Text, "tcsi", "catalog");
+   ipTxt.setState(pcf::IndiProperty::Idle);
+   ipTxt.setPerm(pcf::IndiProperty::ReadOnly);
+   ipTxt.add(pcf::IndiElement("object", "Alpha <Cen> & \"friends\" 'A'"));
+   ipTxt.add(pcf::IndiElement("rotator", "  leading and trailing  "));
+
+   pcf::IndiProperty ipDel(pcf::IndiProperty::Unknown, "camwfs", "old_prop");
+
+   std::mt19937 gen(2);
+
+   for(size_t n = 0; n < nMsgs; ++n)
+   {
+      int r = n % 20;
+      if(r < 12)
+      {
+         ipNum["current"] = -15.0 + 0.01*(gen() % 1000);
+         xml.push_back(pcf::IndiXmlParser(pcf::IndiMessage(pcf::IndiMessage::SetProperty, ipNum)).createXmlString());
+      }
+      else if(r < 16)
+      {
+         for(int k = 0; k < 8; ++k) ipSw["filter" + std::to_string(k)] = (k == (int)(gen()%8)) ? pcf::IndiElement::On : pcf::IndiElement::Off;
+         xml.push_back(pcf::IndiXmlParser(pcf::IndiMessage(pcf::IndiMessage::SetProperty, ipSw)).createXmlString());
+      }
+      else if(r == 16)
+      {
+         xml.push_back(pcf::IndiXmlParser(pcf::IndiMessage(pcf::IndiMessage::Define, ipDefNum)).createXmlString());
+      }
+      else if(r == 17)
+      {
+         xml.push_back(pcf::IndiXmlParser(pcf::IndiMessage(pcf::IndiMessage::Define, ipTxt)).createXmlString());
+      }
+      else if(r == 18)
+      {
+         xml.push_back(pcf::IndiXmlParser(pcf::IndiMessage(pcf::IndiMessage::Delete, ipDel)).createXmlString());
+      }
+      else
+      {
+         xml.push_back("<getProperties version=\"1.7\"/>\n");
+      }
+   }
+
+   return xml;
+}
+
+/// The property as a string for comparison, without the timestamp.
+/** Both parsers set the timestamp to the current time when elements are added, as IndiProperty::add does.
+  */
+std::string propString( const pcf::IndiProperty & ip )
+{
+   pcf::IndiProperty ipc = ip;
+   ipc.setTimeStamp(pcf::TimeStamp(0));
+   return ipc.createString();
+}
+
+/// Parse a stream with IndiXmlParser, in chunks, as IndiConnection used to.
+void parseOld( std::vector<pcf::IndiMessage> & msgs,
+               const std::string & stream,
+               size_t chunk
+             )
+{
+   pcf::IndiXmlParser ixp;
+   std::string szErrorMsg;
+
+   for(size_t pos = 0; pos < stream.size(); pos += chunk)
+   {
+      size_t n = std::min(chunk, stream.size() - pos);
+      ixp.parseXml(stream.data() + pos, n, szErrorMsg);
+      while(ixp.getState() == pcf::IndiXmlParser::CompleteState)
+      {
+         msgs.push_back(ixp.createIndiMessage());
+         ixp.parseXml("", szErrorMsg);
+      }
+   }
+}
+
+/// Parse a stream with IndiStreamParser, in chunks, using the buffer handling of IndiConnection.
+void parseNew( std::vector<pcf::IndiMessage> & msgs,
+               const std::string & stream,
+               size_t chunk
+             )
+{
+   pcf::IndiStreamParser isp;
+   std::string szErrorMsg;
+   std::vector<char> buf;
+   size_t bufLen = 0;
+   pcf::IndiMessage im;
+   bool complete;
+
+   for(size_t pos = 0; pos < stream.size(); pos += chunk)
+   {
+      size_t n = std::min(chunk, stream.size() - pos);
+      if(buf.size() < bufLen + n) buf.resize(bufLen + n);
+      memcpy(buf.data() + bufLen, stream.data() + pos, n);
+      bufLen += n;
+
+      size_t p = 0;
+      while(p < bufLen)
+      {
+         size_t used = isp.parse(buf.data() + p, bufLen - p, im, complete, szErrorMsg);
+         p += used;
+         if(complete) msgs.push_back(im);
+         else if(used == 0) break;
+      }
+      bufLen -= p;
+      memmove(buf.data(), buf.data() + p, bufLen);
+   }
+}
+
+SCENARIO( "Parsing a stream of INDI messages", "[IndiStreamParser]" )
+{
+   GIVEN("A stream of generated traffic")
+   {
+      std::vector<std::string> xml = makeTraffic(100);
+      std::string stream;
+      for(size_t n = 0; n < xml.size(); ++n) stream += xml[n];
+
+      std::vector<pcf::IndiMessage> ref;
+      parseOld(ref, stream, stream.size());
+      REQUIRE(ref.size() == xml.size());
+
+      WHEN("The stream is parsed in one read")
+      {
+         std::vector<pcf::IndiMessage> msgs;
+         parseNew(msgs, stream, stream.size());
+
+         REQUIRE(msgs.size() == ref.size());
+         for(size_t n = 0; n < msgs.size(); ++n)
+         {
+            REQUIRE(msgs[n].getType() == ref[n].getType());
+            REQUIRE(propString(msgs[n].getProperty()) == propString(ref[n].getProperty()));
+         }
+      }
+
+      WHEN("The stream is parsed in small reads which split messages and tags")
+      {
+         size_t chunks[] = {1, 7, 64, 1000};
+         for(size_t c = 0; c < sizeof(chunks)/sizeof(chunks[0]); ++c)
+         {
+            std::vector<pcf::IndiMessage> msgs;
+            parseNew(msgs, stream, chunks[c]);
+
+            REQUIRE(msgs.size() == ref.size());
+            for(size_t n = 0; n < msgs.size(); ++n)
+            {
+               REQUIRE(msgs[n].getType() == ref[n].getType());
+               REQUIRE(propString(msgs[n].getProperty()) == propString(ref[n].getProperty()));
+            }
+         }
+      }
+   }
+
+   GIVEN("Text values with entities and whitespace")
+   {
+      std::string stream = "<setTextVector device=\"a&amp;b\" name='t' timestamp=\"2023-01-02T03:04:05.6Z\">\n"
+                           "  <oneText name=\"x\">  &lt;v&gt; 1 &unknown; </oneText>\n"
+                           "</setTextVector  >\n";
+
+      std::vector<pcf::IndiMessage> msgs;
+      parseNew(msgs, stream, stream.size());
+
+      REQUIRE(msgs.size() == 1);
+      REQUIRE(msgs[0].getType() == pcf::IndiMessage::SetProperty);
+      REQUIRE(msgs[0].getProperty().getDevice() == "a&b");
+      REQUIRE(msgs[0].getProperty().getName() == "t");
+      REQUIRE(msgs[0].getProperty()["x"].getValue() == "<v> 1 &unknown;");
+
+      std::vector<pcf::IndiMessage> ref;
+      parseOld(ref, stream, stream.size());
+      REQUIRE(ref.size() == 1);
+      REQUIRE(propString(msgs[0].getProperty()) == propString(ref[0].getProperty()));
+   }
+
+   GIVEN("A malformed message followed by a good one")
+   {
+      std::string stream = "junk <setNumberVector device=\"d\" name=\"n\"><oneNumber name=\"e\" 5>1</oneNumber></setNumberVector>"
+                           "<setNumberVector device=\"d\" name=\"n\"><oneNumber name=\"e\">2</oneNumber></setNumberVector>";
+
+      std::vector<pcf::IndiMessage> msgs;
+      parseNew(msgs, stream, 5);
+
+      REQUIRE(msgs.size() >= 1);
+      REQUIRE(msgs.back().getProperty()["e"].getValue() == "2");
+   }
+
+   GIVEN("A message with a duplicate element name followed by a good one")
+   {
+      std::string stream = "<setNumberVector device=\"d\" name=\"n\"><oneNumber name=\"e\">1</oneNumber><oneNumber name=\"e\">2</oneNumber></setNumberVector>"
+                           "<setNumberVector device=\"d\" name=\"n\"><oneNumber name=\"e\">3</oneNumber></setNumberVector>";
+
+      pcf::IndiStreamParser isp;
+      pcf::IndiMessage im;
+      bool complete;
+      std::string szErrorMsg;
+
+      size_t used = 0;
+      REQUIRE_NOTHROW(used = isp.parse(stream.data(), stream.size(), im, complete, szErrorMsg));
+      REQUIRE(complete == false);
+      REQUIRE(szErrorMsg.size() > 0);
+      REQUIRE(used == stream.find("<setNumberVector", 1));
+
+      used += isp.parse(stream.data() + used, stream.size() - used, im, complete, szErrorMsg);
+      REQUIRE(complete == true);
+      REQUIRE(used == stream.size());
+      REQUIRE(im.getProperty()["e"].getValue() == "3");
+   }
+}
+
+SCENARIO( "Benchmarking the INDI stream parsers", "[.benchmark]" )
+{
+   GIVEN("A stream of generated traffic")
+   {
+      std::vector<std::string> xml = makeTraffic(20000);
+      std::string stream;
+      for(size_t n = 0; n < xml.size(); ++n) stream += xml[n];
+
+      size_t chunk = 65536;
+
+      std::vector<pcf::IndiMessage> msgs;
+      msgs.reserve(xml.size());
+
+      auto t0 = std::chrono::steady_clock::now();
+      parseOld(msgs, stream, chunk);
+      auto t1 = std::chrono::steady_clock::now();
+      size_t nOld = msgs.size();
+
+      msgs.clear();
+      auto t2 = std::chrono::steady_clock::now();
+      parseNew(msgs, stream, chunk);
+      auto t3 = std::chrono::steady_clock::now();
+
+      double dOld = std::chrono::duration<double>(t1-t0).count();
+      double dNew = std::chrono::duration<double>(t3-t2).count();
+
+      std::cout << "IndiXmlParser:    " << nOld/dOld << " msgs/s, " << stream.size()/dOld/1e6 << " MB/s\n";
+      std::cout << "IndiStreamParser: " << msgs.size()/dNew << " msgs/s, " << stream.size()/dNew/1e6 << " MB/s\n";
+
+      REQUIRE(msgs.size() == nOld);
+   }
+}
+
+} //namespace indiStreamParser_test 
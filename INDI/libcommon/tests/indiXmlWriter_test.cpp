@@ -0,0 +1,167 @@
+/** \file indiXmlWriter_test.cpp
+  * \brief Catch2 tests for the direct INDI set property writer.
+  *
+  * History:
+  */
+#include "../../../tests/catch2/catch.hpp"
+
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../IndiXmlWriter.hpp"
+#include "../IndiXmlParser.hpp"
+
+namespace indiXmlWriter_test
+{
+
+/// The set property XML as produced by the original IndiDriver::sendSetProperty
+std::string oldSetXml( const pcf::IndiProperty & ip,
+                       const pcf::TimeStamp & ts
+                     )
+{
+   pcf::IndiProperty ipSend = ip;
+   ipSend.setTimeStamp(ts);
+   pcf::IndiXmlParser ixp(pcf::IndiMessage(pcf::IndiMessage::SetProperty, ipSend), "1.7");
+   return ixp.createXmlString();
+}
+
+std::string newSetXml( const pcf::IndiProperty & ip,
+                       const pcf::TimeStamp & ts
+                     )
+{
+   std::string xml;
+   pcf::IndiXmlWriter::appendSetProperty(xml, ip, ts);
+   return xml;
+}
+
+SCENARIO( "Writing set property messages directly", "[indiXmlWriter]" )
+{
+   pcf::TimeStamp ts(timeval({1600000000, 1234}));
+
+   GIVEN("A number property")
+   {
+      pcf::IndiProperty ip(pcf::IndiProperty::Number, "camwfs", "temp_ccd");
+      ip.setState(pcf::IndiProperty::Ok);
+      ip.add(pcf::IndiElement("current", -14.98));
+      ip.add(pcf::IndiElement("target", -15.0));
+
+      WHEN("written with no timeout")
+      {
+         REQUIRE(newSetXml(ip, ts) == oldSetXml(ip, ts));
+      }
+
+      WHEN("written with a timeout")
+      {
+         ip.setTimeout(2.5);
+         REQUIRE(newSetXml(ip, ts) == oldSetXml(ip, ts));
+      }
+
+      WHEN("written with a message")
+      {
+         ip.setMessage("cooling");
+         REQUIRE(newSetXml(ip, ts) == oldSetXml(ip, ts));
+      }
+   }
+
+   GIVEN("A switch property")
+   {
+      pcf::IndiProperty ip(pcf::IndiProperty::Switch, "fwpupil", "filterName");
+      ip.setState(pcf::IndiProperty::Busy);
+      for(int n = 0; n < 8; ++n)
+      {
+         ip.add(pcf::IndiElement("filter" + std::to_string(n), (n == 3) ? pcf::IndiElement::On : pcf::IndiElement::Off));
+      }
+
+      REQUIRE(newSetXml(ip, ts) == oldSetXml(ip, ts));
+   }
+
+   GIVEN("A light property")
+   {
+      pcf::IndiProperty ip(pcf::IndiProperty::Light, "pdu0", "status");
+      ip.setState(pcf::IndiProperty::Alert);
+      ip.add(pcf::IndiElement("fan", pcf::IndiElement::Alert));
+      ip.add(pcf::IndiElement("power", pcf::IndiElement::Ok));
+
+      REQUIRE(newSetXml(ip, ts) == oldSetXml(ip, ts));
+   }
+
+   GIVEN("A text property with characters which must be escaped")
+   {
+      pcf::IndiProperty ip(pcf::IndiProperty::Text, "tcsi", "catalog");
+      ip.add(pcf::IndiElement("object", "Alpha <Cen> & \"friends\" 'A'"));
+      ip.add(pcf::IndiElement("empty", ""));
+
+      REQUIRE(newSetXml(ip, ts) == oldSetXml(ip, ts));
+
+      WHEN("the message needs escaping")
+      {
+         ip.setMessage("a < b");
+         std::string xml = newSetXml(ip, ts);
+         REQUIRE(xml.find("message=\"a &lt; b\"") != std::string::npos);
+      }
+   }
+
+   GIVEN("Properties which can not be written directly")
+   {
+      pcf::IndiProperty ipBlob(pcf::IndiProperty::BLOB, "camwfs", "image");
+      REQUIRE(pcf::IndiXmlWriter::canWriteSetProperty(ipBlob) == false);
+
+      std::string xml;
+      REQUIRE_THROWS(pcf::IndiXmlWriter::appendSetProperty(xml, ipBlob, ts));
+
+      pcf::IndiProperty ipNoDev(pcf::IndiProperty::Number);
+      ipNoDev.setName("temp_ccd");
+      REQUIRE_THROWS(pcf::IndiXmlWriter::appendSetProperty(xml, ipNoDev, ts));
+   }
+}
+
+SCENARIO( "Benchmarking the set property writers", "[.benchmark]" )
+{
+   GIVEN("A typical number property written to /dev/null")
+   {
+      pcf::IndiProperty ip(pcf::IndiProperty::Number, "camwfs", "temp_ccd");
+      ip.setState(pcf::IndiProperty::Ok);
+      ip.add(pcf::IndiElement("current", -14.98));
+      ip.add(pcf::IndiElement("target", -15.0));
+
+      int fd = open("/dev/null", O_WRONLY);
+      REQUIRE(fd >= 0);
+
+      const size_t N = 200000;
+
+      auto t0 = std::chrono::steady_clock::now();
+      for(size_t n = 0; n < N; ++n)
+      {
+         //The original path: copy, message, parser, string, dprintf
+         pcf::IndiProperty ipSend = ip;
+         ipSend.setTimeStamp(pcf::TimeStamp::now());
+         pcf::IndiXmlParser ixp(pcf::IndiMessage(pcf::IndiMessage::SetProperty, ipSend), "1.7");
+         dprintf(fd, "%s", ixp.createXmlString().c_str());
+      }
+      auto t1 = std::chrono::steady_clock::now();
+
+      std::string buf;
+      size_t nShort = 0;
+      auto t2 = std::chrono::steady_clock::now();
+      for(size_t n = 0; n < N; ++n)
+      {
+         buf.clear();
+         pcf::IndiXmlWriter::appendSetProperty(buf, ip, pcf::TimeStamp::now());
+         if(write(fd, buf.data(), buf.size()) != (ssize_t) buf.size()) ++nShort;
+      }
+      auto t3 = std::chrono::steady_clock::now();
+
+      REQUIRE(nShort == 0);
+
+      close(fd);
+
+      double dOld = std::chrono::duration<double>(t1-t0).count();
+      double dNew = std::chrono::duration<double>(t3-t2).count();
+
+      std::cout << "IndiXmlParser: " << N/dOld << " msgs/s\n";
+      std::cout << "IndiXmlWriter: " << N/dNew << " msgs/s\n";
+   }
+}
+
+} //namespace indiXmlWriter_test
@@ -6,7 +6,10 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <signal.h>
+#include <poll.h>
 #include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
 
 #ifndef XINDID_BUFFSIZE
 #define XINDID_BUFFSIZE (1024)
@@ -28,21 +31,40 @@ bool timeToDie;
 std::ofstream debug;
 #endif
 
-/// The details of one driver FIFO, this is passed to xoverThread to start the rd/wr thread for the indicated FIFO.
+/// The details of one driver FIFO, which is opened by relayLoop as soon as it exists.
 struct driverFIFO
 {
    std::string fileName;    ///< the name of the driver FIFO
-   int fd {-1};             ///< file desriptor of the diver FIFO after opened.  Note that this must be < 0 on entry into xoverThread or it interprets it as an error.
-   int stdfd {STDIN_FILENO}; ///< one of this processes file descriptor denoting which direction this FIFO is, must be either STDIN_FILENO or STDOUT_FILENO.
+   std::string baseName;    ///< the name of the FIFO within XINDID_FIFODIR, to match inotify events.
+   int fd {-1};             ///< file desriptor of the diver FIFO after opened, < 0 if not open.
+   bool lock {false};       ///< if true an exclusive lock is placed on the FIFO after opening.
 
-   /// Constructor to initialize the fileName and stdfd members.
+   /// Constructor to initialize the fileName and lock members.
    driverFIFO( const std::string & fn, ///< [in] the fileName to set
-               int sfd ///< [in] one of this processes file descriptor, must be either STDIN_FILENO or STDOUT_FILENO
-             ) : fileName(fn), stdfd(sfd)
+               bool lk ///< [in] whether to lock the FIFO
+             ) : fileName(fn), lock(lk)
    {
+      size_t slash = fn.rfind('/');
+      baseName = (slash == std::string::npos) ? fn : fn.substr(slash+1);
    }
 };
 
+/// One direction of the relay.
+/** Bytes are spliced from src into a pipe, and then from the pipe to dst, so they never pass through user space.
+  * The pipe is only refilled once it is empty, so a slow dst holds the data back in src.
+  */
+struct relay
+{
+   int src {-1};             ///< the file descriptor read from
+   int dst {-1};             ///< the file descriptor written to, < 0 if not yet open.
+   int pipefd[2] {-1, -1};   ///< the pipe holding the bytes in transit
+   size_t inPipe {0};        ///< the number of bytes in the pipe
+   bool spliceIn {true};     ///< false if src does not support splice, e.g. a terminal, and read is used instead.
+   bool spliceOut {true};    ///< false if dst does not support splice, and write is used instead.
+   uint32_t srcId {0};       ///< the epoll id of src
+   uint32_t dstId {0};       ///< the epoll id of dst
+};
+
 int flushFIFO(const std::string & fileName)
 {
    int fd {-1};
@@ -106,216 +128,399 @@ int flushFIFO(const std::string & fileName)
    return 0;
 }
 
-/// Work function for the FIFO read/write threads.
-void * xoverThread( void * vdf /**< [in] pointer to a driverFIFO struct */)
+/// The epoll ids of the file descriptors in relayLoop.
+enum relayIds : uint32_t
+{
+   ID_STDIN,
+   ID_STDOUT,
+   ID_FIFOIN,
+   ID_FIFOOUT,
+   ID_CTRL,
+   ID_INOTIFY
+};
+
+/// The events each epoll id is currently registered for, 0 if not registered.
+uint32_t registered[ID_INOTIFY+1];
+
+/// Register fd with epoll for events, changing or removing an earlier registration.
+void setInterest( int epfd,       ///< [in] the epoll file descriptor
+                  int fd,         ///< [in] the file descriptor
+                  uint32_t id,    ///< [in] the epoll id of fd
+                  uint32_t events ///< [in] the events, 0 to remove fd
+                )
 {
-   driverFIFO * df = static_cast<driverFIFO *>(vdf);
+   if(fd < 0 || events == registered[id]) return;
+
+   epoll_event ev;
+   ev.events = events;
+   ev.data.u32 = id;
 
-   //Make sure the driverFIFO was initialized properly.
-   if(df->stdfd != STDIN_FILENO && df->stdfd != STDOUT_FILENO)
+   int op = EPOLL_CTL_MOD;
+   if(registered[id] == 0) op = EPOLL_CTL_ADD;
+   else if(events == 0) op = EPOLL_CTL_DEL;
+
+   if(epoll_ctl(epfd, op, fd, &ev) < 0)
    {
-      std::cerr << " (" << XINDID_COMPILEDNAME << "): stdfd must be either STDIN_FILENO or STDOUT_FILENO.\n";
-      return nullptr;
+      std::cerr << " (" << XINDID_COMPILEDNAME << "): " << std::strerror( errno);
+      std::cerr << " in " << __FILE__ << " at " << __LINE__ << "\n";
    }
 
-   if(df->fd >= 0)
+   registered[id] = events;
+}
+
+/// Set the epoll registration of both ends of a relay: read src while the pipe is empty, otherwise write dst.
+void setInterest( int epfd,       ///< [in] the epoll file descriptor
+                  relay & r       ///< [in] the relay
+                )
+{
+   if(r.dst < 0)
    {
-      std::cerr << " (" << XINDID_COMPILEDNAME << "): file descriptor for " << df->fileName << " already initialized.\n";
-      return nullptr;
+      //Until the FIFO is open, input is consumed and discarded.
+      setInterest(epfd, r.src, r.srcId, EPOLLIN);
+      return;
    }
 
-   //The buffer for reading from the FIFO.
+   if(r.src >= 0) setInterest(epfd, r.src, r.srcId, (r.inPipe == 0) ? (uint32_t) EPOLLIN : 0);
+   setInterest(epfd, r.dst, r.dstId, (r.inPipe > 0) ? (uint32_t) EPOLLOUT : 0);
+}
+
+/// Fill the empty pipe of a relay from its src.
+/**
+  * \returns the number of bytes moved, 0 on end of file, -1 on error.
+  */
+ssize_t relayIn( relay & r /**< [in] the relay */ )
+{
    char rdbuff[XINDID_BUFFSIZE];
+   ssize_t rd;
 
-   //Open the controller's FIFO
-   while(df->fd < 0 && !timeToDie)
+   if(r.dst < 0)
    {
-      errno = 0;
-      df->fd = open( df->fileName.c_str(), O_RDWR);
+      //No FIFO yet, so consume and discard.
+      rd = read(r.src, rdbuff, sizeof(rdbuff));
+      if(rd < 0 && (errno == EAGAIN || errno == EINTR)) rd = 1;
+      return rd;
+   }
+
+   if(r.spliceIn)
+   {
+      rd = splice(r.src, NULL, r.pipefd[1], NULL, 65536, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
 
-      if(df->fd < 0)
+      if(rd >= 0 || errno != EINVAL)
       {
-         if( errno == ENOENT ) //If it's just cuz the file doesn't exist, we'll be patient.
-         {
-            //std::cerr << " (" << XINDID_COMPILEDNAME << "): no driver fifo " << df->fileName << ".\n";
+         if(rd > 0) r.inPipe += rd;
+         if(rd < 0 && (errno == EAGAIN || errno == EINTR)) rd = 1;
+         return rd;
+      }
 
-            //Consume any waiting input on stdin
-            if(df->stdfd == STDIN_FILENO)
-            {
-               int rd = read(STDIN_FILENO, rdbuff, sizeof(rdbuff));
+      r.spliceIn = false;
+   }
 
-               while(rd > 0 && !timeToDie)
-               {
-                  //std::cerr << " (" << XINDID_COMPILEDNAME << "): consumed " << rd << " bytes.\n";
-                  rd = read(STDIN_FILENO, rdbuff, sizeof(rdbuff));
-               }
+   //The pipe is empty, so this is all written at once.
+   rd = read(r.src, rdbuff, sizeof(rdbuff));
+   if(rd > 0)
+   {
+      if(write(r.pipefd[1], rdbuff, rd) != rd) return -1;
+      r.inPipe += rd;
+   }
+   if(rd < 0 && (errno == EAGAIN || errno == EINTR)) rd = 1;
+   return rd;
+}
 
-               if(timeToDie) break; //Woke up from a blocking read due to a signal
+/// Move as much as dst will take from the pipe of a relay.
+/**
+  * \returns 0 on success, -1 on error.
+  */
+int relayOut( relay & r /**< [in] the relay */ )
+{
+   while(r.inPipe > 0 && !timeToDie)
+   {
+      ssize_t wr;
 
-               if( rd < 0 && !timeToDie)
-               {
-                  //An error on the read.  Report it, and go back around.
-                  std::cerr << " (" << XINDID_COMPILEDNAME << "): " << std::strerror( errno);
-                  std::cerr << " in " << __FILE__ << " at " << __LINE__ << "\n";
-                  break;
-               }
-            }
+      if(r.spliceOut)
+      {
+         wr = splice(r.pipefd[0], NULL, r.dst, NULL, r.inPipe, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
 
-            sleep(1);
+         if(wr < 0 && errno == EINVAL)
+         {
+            r.spliceOut = false;
+            continue;
          }
-         else
+         if(wr < 0 && errno == EAGAIN) return 0; //wait for EPOLLOUT
+         if(wr < 0 && errno == EINTR) continue;
+         if(wr <= 0) return -1;
+
+         r.inPipe -= wr;
+         continue;
+      }
+
+      //We write until we have written all that was read.
+      char rdbuff[XINDID_BUFFSIZE];
+      ssize_t rd = read(r.pipefd[0], rdbuff, sizeof(rdbuff));
+      if(rd <= 0) return -1;
+      r.inPipe -= rd;
+
+      ssize_t totwr = 0;
+      while(totwr != rd && !timeToDie)
+      {
+         wr = write(r.dst, rdbuff + totwr, rd - totwr);
+
+         if(wr < 0 && errno == EAGAIN)
          {
-            std::cerr << " (" << XINDID_COMPILEDNAME << "): failed to open " << df->fileName << ".\n";
-            return nullptr;
+            pollfd pfd = {r.dst, POLLOUT, 0};
+            poll(&pfd, 1, -1);
+            continue;
          }
+         if(wr < 0 && errno == EINTR) continue;
+         if(wr < 0) return -1;
+
+         totwr += wr;
       }
    }
 
+   return 0;
+}
 
-   //Setup the file descriptors.
-   int fdRead, fdWrite;
-   if(df->stdfd == STDIN_FILENO)
+/// Open a driver FIFO if it exists, and register it with epoll.
+/**
+  * \returns 0 on success or if the FIFO does not exist yet, -1 on any other error.
+  */
+int openFIFO( int epfd,         ///< [in] the epoll file descriptor
+              driverFIFO & df,  ///< [in/out] the FIFO to open
+              uint32_t id       ///< [in] the epoll id of the FIFO
+            )
+{
+   if(df.fd >= 0)
+   {
+      setInterest(epfd, df.fd, id, 0);
+      close(df.fd);
+      df.fd = -1;
+   }
+
+   errno = 0;
+   df.fd = open( df.fileName.c_str(), O_RDWR | O_NONBLOCK);
+
+   if(df.fd < 0)
+   {
+      if( errno == ENOENT ) return 0; //If it's just cuz the file doesn't exist, we'll be patient.
+
+      std::cerr << " (" << XINDID_COMPILEDNAME << "): failed to open " << df.fileName << ".\n";
+      return -1;
+   }
+
+   if(df.lock)
    {
-      fdRead = df->stdfd;
-      fdWrite = df->fd;
-      
       struct flock fl;
       fl.l_type = F_WRLCK; //get an exclusive lock
       fl.l_whence = SEEK_SET;
       fl.l_start = 0;
       fl.l_len = 0;
       fl.l_pid = getpid();
-   
-      if(fcntl(df->fd, F_SETLK, &fl) < 0)
+
+      if(fcntl(df.fd, F_SETLK, &fl) < 0)
       {
-         std::cerr << " (" << XINDID_COMPILEDNAME << "): failed to lock " << df->fileName << ".  Another process is already running.  Kill the zombies.\n";
-         return nullptr;
+         std::cerr << " (" << XINDID_COMPILEDNAME << "): failed to lock " << df.fileName << ".  Another process is already running.  Kill the zombies.\n";
+         return -1;
       }
    }
-   else // (df->stdfd == STDOUT_FILENO)
+
+   std::cerr << " (" << XINDID_COMPILEDNAME << "): opened " << df.fileName << "\n";
+
+   return 0;
+}
+
+/// Relay STDIN to the driver's .in FIFO and its .out FIFO to STDOUT until the control FIFO is written or a signal arrives.
+/** Both directions, the control FIFO, and the creation of the FIFOs are all handled by one epoll loop, which
+  * only wakes up when there is something to do.  A FIFO which does not exist yet is opened as soon as inotify reports
+  * it was created, and a FIFO which is replaced, say by a restarted controller, is reopened.
+  *
+  * \returns 0 on a normal exit, -1 on an error.
+  */
+int relayLoop( driverFIFO & dfIn,  ///< [in] the driver's STDIN FIFO
+               driverFIFO & dfOut, ///< [in] the driver's STDOUT FIFO
+               driverFIFO & dfCtrl ///< [in] the driver's control FIFO
+             )
+{
+   int epfd = epoll_create1(EPOLL_CLOEXEC);
+   if(epfd < 0)
+   {
+      std::cerr << " (" << XINDID_COMPILEDNAME << "): " << std::strerror( errno) << " in " << __FILE__ << " at " << __LINE__ << "\n";
+      return -1;
+   }
+
+   //Watch for the FIFOs being created.  If this fails we fall back to checking once a second.
+   int infd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+   if(infd >= 0 && inotify_add_watch(infd, XINDID_FIFODIR, IN_CREATE | IN_MOVED_TO) < 0)
    {
-      fdRead = df->fd;
-      fdWrite = df->stdfd;
+      close(infd);
+      infd = -1;
    }
+   if(infd >= 0) setInterest(epfd, infd, ID_INOTIFY, EPOLLIN);
+
+   relay rIn;
+   rIn.src = STDIN_FILENO;
+   rIn.srcId = ID_STDIN;
+   rIn.dstId = ID_FIFOIN;
+
+   relay rOut;
+   rOut.dst = STDOUT_FILENO;
+   rOut.srcId = ID_FIFOOUT;
+   rOut.dstId = ID_STDOUT;
+
+   if(pipe2(rIn.pipefd, O_CLOEXEC) < 0 || pipe2(rOut.pipefd, O_CLOEXEC) < 0)
+   {
+      std::cerr << " (" << XINDID_COMPILEDNAME << "): " << std::strerror( errno) << " in " << __FILE__ << " at " << __LINE__ << "\n";
+      return -1;
+   }
+
+   //Signals are only delivered while waiting in epoll_pwait, so one can not be missed.
+   sigset_t blocked, waitmask;
+   sigemptyset(&blocked);
+   sigaddset(&blocked, SIGTERM);
+   sigaddset(&blocked, SIGQUIT);
+   sigaddset(&blocked, SIGINT);
+   sigprocmask(SIG_BLOCK, &blocked, &waitmask);
+
+   bool reopen = true;
+   int rv = 0;
 
-   //Now loop until told to stop.
    while(!timeToDie)
    {
-      rdbuff[0] = 0;
+      if(reopen)
+      {
+         //Open any FIFO which is missing.  Those which were replaced were closed already.
+         if(dfIn.fd < 0 && openFIFO(epfd, dfIn, ID_FIFOIN) < 0) { rv = -1; break; }
+         if(dfOut.fd < 0 && openFIFO(epfd, dfOut, ID_FIFOOUT) < 0) { rv = -1; break; }
+         if(dfCtrl.fd < 0 && openFIFO(epfd, dfCtrl, ID_CTRL) < 0) { rv = -1; break; }
 
-      // Create and clear out the FD set, set to watch the reader.
-      fd_set fdsRead;
-      FD_ZERO( &fdsRead );
-      FD_SET( fdRead, &fdsRead );
+         rIn.dst = dfIn.fd;
+         rOut.src = dfOut.fd;
+         if(dfCtrl.fd >= 0) setInterest(epfd, dfCtrl.fd, ID_CTRL, EPOLLIN);
 
-      // Set the timeout on the select call.
-      timeval tv;
-      tv.tv_sec = 1;
-      tv.tv_usec = 0;
+         reopen = false;
+      }
+
+      setInterest(epfd, rIn);
+      setInterest(epfd, rOut);
+
+      int timeout = -1;
+      if(infd < 0 && (dfIn.fd < 0 || dfOut.fd < 0 || dfCtrl.fd < 0)) timeout = 1000;
 
-      /// \todo This doesn't seem to be doing anything -- since we open O_RDWR this returns immediately. Remove?
-      int nRetval = ::select( fdRead + 1, &fdsRead, NULL, NULL, &tv );
+      epoll_event evs[8];
+      int nev = epoll_pwait(epfd, evs, 8, timeout, &waitmask);
 
       if(timeToDie) break;
 
-      if ( nRetval == -1 )
+      if(nev < 0)
       {
-         //Select returned some error.  Report it, and sleep for a bit.  Then try again.
-         if ( timeToDie == false )
-         {
-            std::cerr << " (" << XINDID_COMPILEDNAME << "): " << std::strerror( errno);
-            std::cerr << " in " << __FILE__ << " at " << __LINE__ << "\n";
-            sleep(1);
-         }
+         if(errno == EINTR) continue;
+         std::cerr << " (" << XINDID_COMPILEDNAME << "): " << std::strerror( errno) << " in " << __FILE__ << " at " << __LINE__ << "\n";
+         rv = -1;
+         break;
       }
-      else if ( FD_ISSET( fdRead, &fdsRead ) != 0 )
-      {
-         //Input is available.
 
-         int rd = 1; //Initialzed > 0 for while loop.
+      if(nev == 0) reopen = true;
 
-         while(rd > 0 && !timeToDie)
+      for(int n = 0; n < nev && !timeToDie; ++n)
+      {
+         switch(evs[n].data.u32)
          {
-            rd = read(fdRead, rdbuff, sizeof(rdbuff));
-
-            if(timeToDie) break; //Woke up from a blocking read due to a signal
-
-            if( rd < 0 && !timeToDie)
+            case ID_STDIN:
             {
-               //An error on the read.  Report it, and go back around.
-               std::cerr << " (" << XINDID_COMPILEDNAME << "): " << std::strerror( errno);
-               std::cerr << " in " << __FILE__ << " at " << __LINE__ << "\n";
+               ssize_t rd = relayIn(rIn);
+               if(rd == 0)
+               {
+                  std::cerr << " (" << XINDID_COMPILEDNAME << "): STDIN closed.\n";
+                  timeToDie = true;
+               }
+               else if(rd < 0 || relayOut(rIn) < 0)
+               {
+                  std::cerr << " (" << XINDID_COMPILEDNAME << "): " << std::strerror( errno) << " in " << __FILE__ << " at " << __LINE__ << "\n";
+                  timeToDie = true;
+                  rv = -1;
+               }
                break;
             }
-
-            //We write until we have written all that was read.
-            int totwr = 0;
-
-            //std::cerr << " (" << XINDID_COMPILEDNAME << "): starting write\n";
-            while(totwr != rd && !timeToDie)
+            case ID_FIFOIN:
+               if(relayOut(rIn) < 0)
+               {
+                  std::cerr << " (" << XINDID_COMPILEDNAME << "): " << std::strerror( errno) << " in " << __FILE__ << " at " << __LINE__ << "\n";
+                  timeToDie = true;
+                  rv = -1;
+               }
+               break;
+            case ID_FIFOOUT:
+               //The FIFO is open O_RDWR, so it never reaches end of file.
+               if(relayIn(rOut) < 0 || relayOut(rOut) < 0)
+               {
+                  std::cerr << " (" << XINDID_COMPILEDNAME << "): " << std::strerror( errno) << " in " << __FILE__ << " at " << __LINE__ << "\n";
+                  timeToDie = true;
+                  rv = -1;
+               }
+               break;
+            case ID_STDOUT:
+               if(relayOut(rOut) < 0)
+               {
+                  std::cerr << " (" << XINDID_COMPILEDNAME << "): STDOUT closed.\n";
+                  timeToDie = true;
+               }
+               break;
+            case ID_CTRL:
+               //Anything at all will cause us to set timeToDie and thus this program will exit.
+               std::cerr << " (" << XINDID_COMPILEDNAME << "): control signaled -- time to die" << std::endl;
+               timeToDie = true;
+               break;
+            case ID_INOTIFY:
             {
-               int wr = write(fdWrite, rdbuff + totwr, rd - totwr);
-
-               if( wr < 0 && !timeToDie)
+               char evbuff[4096] __attribute__ ((aligned(__alignof__(inotify_event))));
+               ssize_t rd;
+               while((rd = read(infd, evbuff, sizeof(evbuff))) > 0)
                {
-                  //An error on write.  Report it and go back around.
-                  std::cerr << " (" << XINDID_COMPILEDNAME << "): " << std::strerror( errno);
-                  std::cerr << " in " << __FILE__ << " at " << __LINE__ << "\n";
-                  break;
+                  for(char * p = evbuff; p < evbuff + rd; p += sizeof(inotify_event) + reinterpret_cast<inotify_event *>(p)->len)
+                  {
+                     inotify_event * ie = reinterpret_cast<inotify_event *>(p);
+                     if(ie->len == 0) continue;
+
+                     //A FIFO we have open was replaced, so close it to open the new one.
+                     driverFIFO * dfs[] = {&dfIn, &dfOut, &dfCtrl};
+                     uint32_t ids[] = {ID_FIFOIN, ID_FIFOOUT, ID_CTRL};
+                     for(int k = 0; k < 3; ++k)
+                     {
+                        if(dfs[k]->fd >= 0 && dfs[k]->baseName == ie->name)
+                        {
+                           setInterest(epfd, dfs[k]->fd, ids[k], 0);
+                           close(dfs[k]->fd);
+                           dfs[k]->fd = -1;
+                        }
+                     }
+                  }
                }
-
-               totwr += wr;
+               reopen = true;
+               break;
             }
-            //std::cerr << " (" << XINDID_COMPILEDNAME << "): finished write\n";
          }
       }
-   }
-
-   close(df->fd);
-
-   return 0;
-}
-
-
-/// Work function for the restart FIFO thread 
-void * ctrlThread( void * vdf /**< [in] pointer to a driverFIFO struct */)
-{
-   driverFIFO * df = static_cast<driverFIFO *>(vdf);
-
-   //Open the controller's restart FIFO
-
-   while(df->fd < 0 && !timeToDie)
-   {
-      errno = 0;
-      df->fd = open( df->fileName.c_str(), O_RDWR);
 
-      if(df->fd < 0)
+      //A replaced FIFO must be dropped by its relay before anything else is done with it.
+      if(reopen)
       {
-         if( errno == ENOENT ) //If it's just cuz the file doesn't exist, we'll be patient.
-         {
-            sleep(1);
-         }
-         else
-         {
-            std::cerr << " (" << XINDID_COMPILEDNAME << "): failed to open " << df->fileName << ".\n";
-            return nullptr;
-         }
+         if(dfIn.fd < 0) rIn.dst = -1;
+         if(dfOut.fd < 0) rOut.src = -1;
       }
    }
-   
-   char rdbuff[XINDID_BUFFSIZE];
-   
-   //Now we try to read from it.  Anything at all will cause us to set timeToDie and thus this program will exit.
-   int rd = read(df->fd, rdbuff, sizeof(rdbuff));
-   
-   std::cerr << " (" << XINDID_COMPILEDNAME << "): control signaled -- time to die" << std::endl;
-   
-   static_cast<void>(rd); //suppress warning
-   
-   timeToDie = true;
-   
-   
-   return 0;
+
+   sigprocmask(SIG_SETMASK, &waitmask, NULL);
+
+   if(dfIn.fd >= 0) close(dfIn.fd);
+   if(dfOut.fd >= 0) close(dfOut.fd);
+   if(dfCtrl.fd >= 0) close(dfCtrl.fd);
+   if(infd >= 0) close(infd);
+   close(rIn.pipefd[0]);
+   close(rIn.pipefd[1]);
+   close(rOut.pipefd[0]);
+   close(rOut.pipefd[1]);
+   close(epfd);
+
+   return rv;
 }
 
 void sigHandler( int signum,
@@ -448,67 +653,20 @@ int main( int argc, char **argv)
 
    std::cerr << " (" << XINDID_COMPILEDNAME << "): starting with " << stdinFifo << " & " << stdoutFifo << std::endl;
 
-   driverFIFO dfIn (stdinFifo, STDIN_FILENO);
+   //An exclusive lock is placed on the .in FIFO, so only one xindidriver runs for a driver.
+   driverFIFO dfIn (stdinFifo, true);
 
-   driverFIFO dfOut (stdoutFifo, STDOUT_FILENO);
+   driverFIFO dfOut (stdoutFifo, false);
 
-   driverFIFO dfCtrl (ctrlFifo, 0);
+   driverFIFO dfCtrl (ctrlFifo, false);
    
    sleep(2); //This gives indiserver time to startup so it can handle any thing that comes from the fifos.
 
-   //Launch the read/write threads, one each for STDIN and STDOUT and for control.
-   pthread_t stdIn_th = 0;
-   pthread_create( &stdIn_th, NULL, xoverThread, &dfIn );
-
-   pthread_t stdOut_th = 0;
-   pthread_create( &stdOut_th, NULL, xoverThread, &dfOut );
-
-   pthread_t ctrl_th = 0;
-   pthread_create( &ctrl_th, NULL, ctrlThread, &dfCtrl );
-   
-   //Now loop until killed.
-   int rv;
-   while( !timeToDie )
-   {
-      rv = pthread_tryjoin_np(stdIn_th, 0);
-
-      if(rv == 0)
-      {
-         std::cerr << " (" << XINDID_COMPILEDNAME << "): STDIN thread exited.\n";
-         timeToDie = true;
-      }
-
-      rv = pthread_tryjoin_np(stdOut_th, 0);
-
-      if(rv == 0)
-      {
-         std::cerr << " (" << XINDID_COMPILEDNAME << "): STDOUT thread exited.\n";
-         timeToDie = true;
-      }
-
-      rv = pthread_tryjoin_np(ctrl_th, 0);
-
-      if(rv == 0)
-      {
-         std::cerr << " (" << XINDID_COMPILEDNAME << "): control thread exited.\n";
-         timeToDie = true;
-      }
-      
-      if(!timeToDie) sleep(1);
-   }
-
-   //Wake up each thread:
-   pthread_kill(stdIn_th, SIGTERM);
-   pthread_kill(stdOut_th, SIGTERM);
-   pthread_kill(ctrl_th, SIGTERM);
-
-   //Give each thread a chance to cleanup.
-   pthread_join(stdIn_th, 0);
-   pthread_join(stdOut_th, 0);
-   pthread_join(ctrl_th, 0);
+   //Now relay until killed.
+   int rv = relayLoop(dfIn, dfOut, dfCtrl);
 
    std::cerr << " (" << XINDID_COMPILEDNAME << "): exiting" << std::endl;
    
-   return 0;
+   return rv;
 
 }
@@ -179,6 +179,8 @@ protected:
    int * m_actuator_mapping {nullptr}; ///< Array containing the mapping from 2D grid position to linear index in the command vector
    
    double * m_dminputs {nullptr}; ///< Pre-allocated command vector, used only in commandDM
+
+   dev::dmTransform<double, dev::dmSqrtTransfer> m_transform; ///< Converts shmim commands to m_dminputs, compiled from the actuator mapping in initDM
    
    DM m_dm = {}; ///< BMC SDK handle for the DM.
    
@@ -391,6 +393,13 @@ int bmcCtrl::initDM()
       return -1;
    }
    
+   /* convert to volume-normalized displacement, which is the squared fractional voltage (0 to +1) */
+   if(m_transform.setup(m_actuator_mapping, m_nbAct, m_volume_factor/m_act_gain) < 0)
+   {
+      log<text_log>("DM initialization failed.  Failed to set up command transform.", logPrio::LOG_ERROR);
+      return -1;
+   }
+   
    state(stateCodes::OPERATING);
    
    return 0;
@@ -434,52 +443,14 @@ int bmcCtrl::commandDM(void * curr_src)
 {
    //This is based on Kyle Van Gorkoms original sendCommand function.
    
-   /*This loop performs the following steps:
+   /*The transform performs the following steps in one pass, and updates m_instSatMap:
      1) converts from float to double
-     2) convert to volume-normalized displacement
-     3) convert to squared fractional voltage (0 to +1)
-     4) calculate the mean
+     2) convert to volume-normalized displacement, the squared fractional voltage
+     3) clip to fractional values between 0 and 1.
+     4) take the square root to approximate the voltage-displacement curve
+     Addressable but ignored actuators are set to 0.
    */
-
-
-   // want to rework the logic here so that we don't have to check
-   // if every actuator is addressable.
-   // Loop over addressable only?
-   //double mean = 0;
-   for (uint32_t idx = 0; idx < m_nbAct; ++idx)
-   {
-     int address = m_actuator_mapping[idx];
-     if(address == -1)
-     {
-        m_dminputs[idx] = 0.; // addressable but ignored actuators set to 0
-     } 
-     else 
-     {
-        m_dminputs[idx] = ((double)  ((realT *) curr_src)[address]) * m_volume_factor/m_act_gain;
-        //mean += m_dminputs[idx];
-     }
-   }
-   //mean /= m_nbAct;
-
-   /*This loop performas the following steps:
-      1) remove mean from each actuator input (and add midpoint bias)
-      2) clip to fractional values between 0 and 1.
-      3) take the square root to approximate the voltage-displacement curve
-   */
-   for (uint32_t idx = 0 ; idx < m_nbAct ; ++idx)
-   {
-      //m_dminputs[idx] -= mean - 0.5;
-      if (m_dminputs[idx] > 1)
-      {
-         ++m_nsat;
-         m_dminputs[idx] = 1;
-      } else if (m_dminputs[idx] < 0)
-      {
-         ++m_nsat;
-         m_dminputs[idx] = 0;
-      }
-      m_dminputs[idx] = sqrt(m_dminputs[idx]);
-   }
+   m_nsat += m_transform.apply(m_dminputs, (realT *) curr_src, m_instSatMap.data());
 
    /* Finally, send the command to the DM */
    BMCRC ret = BMCSetArray(&m_dm, m_dminputs, NULL);
@@ -494,22 +465,6 @@ int bmcCtrl::commandDM(void * curr_src)
       return -1;
    }
 
-   /* Now update the instantaneous sat map */
-   for (uint32_t idx = 0; idx < m_nbAct; ++idx)
-   {
-      int address = m_actuator_mapping[idx];
-      if(address == -1) continue;
-     
-      if(m_dminputs[idx] >= 1 || m_dminputs[idx] <= 0)
-      {
-         m_instSatMap.data()[address] = 1;
-      }
-      else
-      {
-         m_instSatMap.data()[address] = 0;
-      }
-   }
-   
    return ret;
 }
 
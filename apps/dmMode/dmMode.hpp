@@ -65,13 +65,23 @@ protected:
    
    std::string m_dmChannelName;
    
+   int m_resynthInterval {1000}; ///< The number of incremental mode updates after which the shape is fully resynthesized.
+
    ///@}
 
-   mx::improc::eigenCube<realT> m_modes;
+   mx::improc::eigenCube<realT> m_modes; ///< The modes.  The cube is contiguous, so is also used as an actuators x modes matrix.
    
    std::vector<realT> m_amps;
    
    mx::improc::eigenImage<realT> m_shape;
+
+   std::vector<realT> m_shapeAmps; ///< The amplitudes m_shape was synthesized with.
+
+   std::vector<size_t> m_changed; ///< Working memory for the indices of the changed amplitudes.
+
+   int m_nIncremental {0}; ///< The number of incremental mode updates since the last full synthesis.
+
+   bool m_resynth {true}; ///< Flag to force a full synthesis at the next update.
    
    IMAGE m_imageStream; 
    uint32_t m_width {0}; ///< The width of the image
@@ -120,6 +130,13 @@ public:
    virtual int appShutdown();
 
 
+   /// Update m_shape to the amplitudes in m_amps.
+   /** If only a few amplitudes have changed the shape is updated incrementally as `shape += (a_k - a0_k)*mode_k`.
+     * Otherwise, or every m_resynthInterval incremental updates to bound round-off drift, it is synthesized with
+     * one GEMV of the actuators x modes matrix.
+     */
+   int updateShape();
+
    int sendCommand();
    
    //INDI:
@@ -128,11 +145,13 @@ protected:
    pcf::IndiProperty m_indiP_dm;
    pcf::IndiProperty m_indiP_currAmps;
    pcf::IndiProperty m_indiP_tgtAmps;
+   pcf::IndiProperty m_indiP_batchAmps; ///< Sets a contiguous range of amplitudes in one message, with elements start and values (a comma separated list).
 
    std::vector<std::string> m_elNames;
 public:
    INDI_NEWCALLBACK_DECL(dmMode, m_indiP_currAmps);
    INDI_NEWCALLBACK_DECL(dmMode, m_indiP_tgtAmps);
+   INDI_NEWCALLBACK_DECL(dmMode, m_indiP_batchAmps);
 
    /** \name Telemeter Interface
      * 
@@ -161,6 +180,7 @@ void dmMode::setupConfig()
    config.add("dm.name", "", "dm.name", argType::Required, "dm", "name", false, "string", "The descriptive name of this dm. Default is the channel name.");
    config.add("dm.channelName", "", "dm.channelName", argType::Required, "dm", "channelName", false, "string", "The name of the DM channel to write to.");
    config.add("dm.maxModes", "", "dm.maxModes", argType::Required, "dm", "maxModes", false, "int", "The maximum number of modes to use (truncates the cube).");
+   config.add("dm.resynthInterval", "", "dm.resynthInterval", argType::Required, "dm", "resynthInterval", false, "int", "The number of incremental mode updates after which the shape is fully resynthesized.  If <=0 the shape is always fully synthesized.  Default is 1000.");
 
    telemeterT::setupConfig(config);
 }
@@ -175,6 +195,8 @@ int dmMode::loadConfigImpl( mx::app::appConfigurator & _config )
    m_dmName = m_dmChannelName;
    _config(m_dmName, "dm.name");
    
+   _config(m_resynthInterval, "dm.resynthInterval");
+
    if(telemeterT::loadConfig(_config) < 0)
    {
       log<text_log>("Error during telemeter config", logPrio::LOG_CRITICAL);
@@ -212,6 +234,9 @@ int dmMode::appStartup()
    
    m_amps.resize(m_modes.planes(), 0);
    m_shape.resize(m_modes.rows(), m_modes.cols());
+   m_shapeAmps.resize(m_modes.planes(), 0);
+   m_changed.reserve(m_modes.planes());
+   m_resynth = true;
    
    REG_INDI_NEWPROP_NOCB(m_indiP_dm, "dm", pcf::IndiProperty::Text);
    m_indiP_dm.add(pcf::IndiElement("name"));
@@ -221,6 +246,12 @@ int dmMode::appStartup()
    
    REG_INDI_NEWPROP(m_indiP_currAmps, "current_amps", pcf::IndiProperty::Number);
    REG_INDI_NEWPROP(m_indiP_tgtAmps, "target_amps", pcf::IndiProperty::Number);
+
+   REG_INDI_NEWPROP(m_indiP_batchAmps, "batch_amps", pcf::IndiProperty::Text);
+   m_indiP_batchAmps.add(pcf::IndiElement("start"));
+   m_indiP_batchAmps["start"] = 0;
+   m_indiP_batchAmps.add(pcf::IndiElement("values"));
+   m_indiP_batchAmps["values"] = "";
    
    m_elNames.resize(m_amps.size());
    
@@ -301,6 +332,7 @@ int dmMode::appLogic()
       }
       
       for(size_t n=0; n < m_amps.size(); ++n) m_amps[n] = 0;
+      m_resynth = true;
       sendCommand();
       
       state(stateCodes::READY);
@@ -325,6 +357,44 @@ int dmMode::appShutdown()
    return 0;
 }
 
+int dmMode::updateShape()
+{
+   const size_t nModes = m_amps.size();
+   const Eigen::Index nAct = m_modes.rows()*m_modes.cols();
+
+   Eigen::Map<Eigen::Matrix<realT,-1,-1>> modes(m_modes.data(), nAct, nModes);
+   Eigen::Map<Eigen::Matrix<realT,-1,1>> shape(m_shape.data(), nAct);
+
+   m_changed.clear();
+   for(size_t n = 0; n < nModes; ++n)
+   {
+      if(m_amps[n] != m_shapeAmps[n]) m_changed.push_back(n);
+   }
+
+   //Each changed mode costs a pass over the actuators, so if many have changed one GEMV is faster
+   if( m_resynth || 2*m_changed.size() >= nModes || m_nIncremental + (int) m_changed.size() > m_resynthInterval )
+   {
+      shape.noalias() = modes * Eigen::Map<Eigen::Matrix<realT,-1,1>>(m_amps.data(), nModes);
+
+      m_shapeAmps = m_amps;
+      m_nIncremental = 0;
+      m_resynth = false;
+
+      return 0;
+   }
+
+   for(size_t n = 0; n < m_changed.size(); ++n)
+   {
+      size_t k = m_changed[n];
+      shape += (m_amps[k] - m_shapeAmps[k]) * modes.col(k);
+      m_shapeAmps[k] = m_amps[k];
+   }
+
+   m_nIncremental += m_changed.size();
+
+   return 0;
+}
+
 int dmMode::sendCommand()
 {
    if(!m_opened)
@@ -333,12 +403,7 @@ int dmMode::sendCommand()
       return 0;
    }
    
-   m_shape = m_amps[0]*m_modes.image(0);
-   
-   for(size_t n = 1; n<m_amps.size(); ++n)
-   {
-      m_shape += m_amps[n]*m_modes.image(n);
-   }
+   updateShape();
    
    if(m_imageStream.md[0].write)
    {
@@ -437,6 +502,40 @@ INDI_NEWCALLBACK_DEFN(dmMode, m_indiP_tgtAmps)(const pcf::IndiProperty &ipRecv)
    return log<software_error,-1>({__FILE__,__LINE__, "invalid indi property name"});
 }
 
+INDI_NEWCALLBACK_DEFN(dmMode, m_indiP_batchAmps)(const pcf::IndiProperty &ipRecv)
+{
+   if (ipRecv.getName() != m_indiP_batchAmps.getName())
+   {
+      return log<software_error,-1>({__FILE__,__LINE__, "invalid indi property name"});
+   }
+
+   if(!ipRecv.find("values")) return 0;
+
+   int start = 0;
+   if(ipRecv.find("start"))
+   {
+      start = ipRecv["start"].get<int>();
+   }
+
+   std::vector<realT> amps;
+   mx::ioutils::parseStringVector(amps, ipRecv["values"].get(), ", ");
+
+   if(start < 0 || start + amps.size() > m_amps.size())
+   {
+      log<text_log>("batch amplitudes out of range: start " + std::to_string(start) + ", " + std::to_string(amps.size()) + " values", logPrio::LOG_ERROR);
+      return 0;
+   }
+
+   if(amps.size() == 0) return 0;
+
+   for(size_t n = 0; n < amps.size(); ++n)
+   {
+      m_amps[start + n] = amps[n];
+   }
+
+   return sendCommand();
+}
+
 int dmMode::checkRecordTimes()
 {
    return telemeterT::checkRecordTimes(telem_dmmodes());
@@ -44,11 +44,12 @@ namespace app
 /** 
   * \ingroup dmModulator
   */
-class dmModulator : public MagAOXApp<true>
+class dmModulator : public MagAOXApp<true>, public dev::telemeter<dmModulator>
 {
 
    typedef float realT;
    
+   friend class dev::telemeter<dmModulator>;
    friend class dmModulator_test;
 
 protected:
@@ -76,7 +77,15 @@ protected:
    ///@}
 
    mx::improc::eigenCube<realT> m_shapes;
-      
+
+   mx::improc::eigenCube<realT> m_ampShapes; ///< The shapes multiplied by the amplitude.
+
+   std::mutex m_ampShapesMutex; ///< Protects m_ampShapes, which is loaded by both the modulator thread and appLogic.
+
+   realT m_genAmp {0}; ///< The amplitude used to calculate m_ampShapes.
+
+   dev::waveformPlayer<realT> m_player; ///< Plays the shapes to the DM channel
+
    IMAGE m_imageStream; 
    uint32_t m_width {0}; ///< The width of the image
    uint32_t m_height {0}; ///< The height of the image.
@@ -129,6 +138,11 @@ public:
 
 protected:
 
+   /// Scale the shapes by the amplitude and load them into the player.
+   /** If the player is running the new shapes are used starting with the next cycle.
+     */
+   int loadShapes();
+
    /** \name Modulator Thread 
      * This thread sends the signal to the dm at the prescribed frequency
      *
@@ -171,7 +185,16 @@ public:
    INDI_NEWCALLBACK_DECL(dmModulator, m_indiP_trigger);
    INDI_NEWCALLBACK_DECL(dmModulator, m_indiP_modulating);
    INDI_NEWCALLBACK_DECL(dmModulator, m_indiP_zero);
-   
+
+   /** \name Telemeter Interface
+     *
+     * @{
+     */
+   int checkRecordTimes();
+
+   int recordTelem( const telem_waveform * );
+
+   ///@}
 };
 
 dmModulator::dmModulator() : MagAOXApp(MAGAOX_CURRENT_SHA1, MAGAOX_REPO_MODIFIED)
@@ -195,6 +218,7 @@ void dmModulator::setupConfig()
 
    config.add("modulator.cpuset", "", "modulator.cpuset", argType::Required, "modulator", "cpuset", false, "string", "The cpuset to assign the modulator thread to.");
 
+   dev::telemeter<dmModulator>::setupConfig(config);
 }
 
 int dmModulator::loadConfigImpl( mx::app::appConfigurator & _config )
@@ -214,6 +238,8 @@ int dmModulator::loadConfigImpl( mx::app::appConfigurator & _config )
    _config(m_modThreadPrio, "modulator.threadPrio");
    _config(m_modThreadCpuset, "modulator.cpuset");
    
+   dev::telemeter<dmModulator>::loadConfig(_config);
+
    return 0;
 }
 
@@ -282,6 +308,11 @@ int dmModulator::appStartup()
       log<software_critical>({__FILE__, __LINE__});
       return -1;
    }
+
+   if(dev::telemeter<dmModulator>::appStartup() < 0)
+   {
+      return log<software_error,-1>({__FILE__,__LINE__});
+   }
       
    state(stateCodes::NOTCONNECTED);
    
@@ -345,8 +376,33 @@ int dmModulator::appLogic()
          return log<text_log,-1>("Type-size mismatch, realT is not float.", logPrio::LOG_CRITICAL);
       }
 
+      m_player.stream(&m_imageStream);
+
       state(stateCodes::READY);
    }
+
+   if(state() == stateCodes::READY && m_modulating)
+   {
+      //Changes while modulating take effect at the start of the next cycle
+      if(m_amp != m_genAmp)
+      {
+         loadShapes();
+      }
+
+      if(m_frequency != m_player.frequency())
+      {
+         m_player.frequency(m_frequency);
+
+         std::lock_guard<std::mutex> guard(m_indiMutex);
+         updateIfChanged(m_indiP_frequency, "current", m_frequency);
+      }
+   }
+
+   if(telemeter<dmModulator>::appLogic() < 0)
+   {
+      log<software_error>({__FILE__, __LINE__});
+      return 0;
+   }
    
    return 0;
 }
@@ -364,6 +420,31 @@ int dmModulator::appShutdown()
       }
    }
 
+   dev::telemeter<dmModulator>::appShutdown();
+
+   return 0;
+}
+
+inline
+int dmModulator::loadShapes()
+{
+   std::lock_guard<std::mutex> lock(m_ampShapesMutex);
+
+   m_genAmp = m_amp;
+
+   m_ampShapes.resize(m_shapes.rows(), m_shapes.cols(), m_shapes.planes());
+   for(int p =0; p < m_ampShapes.planes(); ++p)
+   {
+      m_ampShapes.image(p) = m_shapes.image(p) * m_genAmp;
+   }
+
+   if(m_player.setPlanes(m_ampShapes) < 0)
+   {
+      return log<text_log,-1>("Modulation shapes do not match the DM channel.", logPrio::LOG_ERROR);
+   }
+
+   updateIfChanged(m_indiP_amp, "current", m_genAmp);
+
    return 0;
 }
 
@@ -379,8 +460,6 @@ void dmModulator::modThreadExec()
 {
    m_modThreadID = syscall(SYS_gettid);
 
-   mx::improc::eigenCube<realT> ampShapes;
-
    //Wait fpr the thread starter to finish initializing this thread.
    while( (m_modThreadInit == true || state() != stateCodes::READY) && m_shutdown == 0)
    {
@@ -396,17 +475,7 @@ void dmModulator::modThreadExec()
       
       if(m_modulating && !m_shutdown)
       {
-         
-         int64_t freqNsec = (1.0/m_frequency)*1e9;
-         int64_t dnsec;
-   
-         int idx = 0;
-         
-         timespec modstart;
-         timespec currtime;
-      
-         bool triggered = false;
-         sem_t * sem = nullptr;
+         IMAGE * trigger = nullptr;
          if(m_dmTriggerChannel == "") 
          {
             m_trigger = false;
@@ -414,111 +483,33 @@ void dmModulator::modThreadExec()
          }
          else if(m_trigger == true)
          {
-            ImageStreamIO_semflush(&m_triggerStream, m_triggerSemaphore);
-      
-            sem = m_triggerStream.semptr[m_triggerSemaphore]; ///< The semaphore to monitor for new image data
+            trigger = &m_triggerStream;
          }
 
-         ampShapes.resize(m_shapes.rows(), m_shapes.cols(), m_shapes.planes());
-         for(int p =0; p < ampShapes.planes(); ++p)
-         {
-            ampShapes.image(p) = m_shapes.image(p) * m_amp;
-         }
-         updateIfChanged(m_indiP_amp, "current", m_amp);
+         bool triggerMode = m_trigger;
+
+         loadShapes();
+         m_player.frequency(m_frequency);
 
          log<text_log>("started modulating",logPrio::LOG_NOTICE);
          
-         dnsec = freqNsec;
-         clock_gettime(CLOCK_REALTIME, &modstart);
+         //Play until stopped, or until the trigger mode is changed in which case we restart in the new mode.
+         int rv = m_player.play( [this, triggerMode](){ return m_modulating && !m_shutdown && m_trigger == triggerMode; }, trigger, m_triggerSemaphore);
 
-         while(m_modulating && !m_shutdown)
+         if(rv < 0)
          {
-            if(m_trigger)
-            {
-               timespec ts;
-
-               if(clock_gettime(CLOCK_REALTIME, &ts) < 0)
-               {
-                  log<software_critical>({__FILE__,__LINE__,errno,0,"clock_gettime"}); 
-                  return;
-               }
-         
-               ts.tv_sec += 1;
-         
-               if(sem_timedwait(sem, &ts) == 0)
-               {
-                  triggered = true;
-               }
-               else
-               {
-                  triggered = false;
-
-                  //Check for why we timed out
-                  if(errno == EINTR) break; //This indicates signal interrupted us, time to restart or shutdown, loop will exit normally if flags set.
-            
-                  //ETIMEDOUT just means we should wait more.
-                  //Otherwise, report an error.
-                  if(errno != ETIMEDOUT)
-                  {
-                     log<software_error>({__FILE__, __LINE__,errno, "sem_timedwait"});
-                     break;
-                  }
-               }
-            }
-            else
-            {
-               mx::sys::nanoSleep(0.5*dnsec);
-               clock_gettime(CLOCK_REALTIME, &currtime);
-         
-               dnsec = (currtime.tv_sec - modstart.tv_sec)*1000000000 + (currtime.tv_nsec - modstart.tv_nsec);
-               triggered = false;
-            }
-
-            if(dnsec >= freqNsec || triggered)
-            {
-               //Do the write
-               
-               m_imageStream.md->write = 1;
-   
-               memcpy(m_imageStream.array.raw, ampShapes.image(idx).data(), m_width*m_height*m_typeSize);
-      
-               m_imageStream.md->atime = currtime;
-               m_imageStream.md->writetime = currtime;
-               
-               if(!m_trigger) m_imageStream.md->cnt0++;
-   
-               m_imageStream.md->write=0;
-               ImageStreamIO_sempost(&m_imageStream,-1);
-   
-               ++idx;
-               if(idx >= m_shapes.planes()) idx=0;
-               
-               if(!m_trigger)
-               {
-                  modstart.tv_nsec += freqNsec;
-                  if(modstart.tv_nsec >= 1000000000)
-                  {
-                     modstart.tv_nsec -= 1000000000;
-                     modstart.tv_sec += 1;
-                  }
-                  dnsec = freqNsec;
-               }
-            }
+            log<software_error>({__FILE__, __LINE__, "shape cube does not match the DM channel"});
+            m_modulating = false;
+            indi::updateSwitchIfChanged(m_indiP_modulating, "toggle", pcf::IndiElement::Off, m_indiDriver, INDI_IDLE);
+         }
+         else if(rv > 0)
+         {
+            log<software_error>({__FILE__, __LINE__, rv, "waveform player"});
          }
+
          log<text_log>("stopped modulating", logPrio::LOG_NOTICE);
          //Always zero when done
-         clock_gettime(CLOCK_REALTIME, &currtime);
-         m_imageStream.md->write = 1;
-   
-         memset(m_imageStream.array.raw, 0.0, m_width*m_height*m_typeSize);
-
-         m_imageStream.md->atime = currtime;
-         m_imageStream.md->writetime = currtime;
-               
-         if(!m_trigger) m_imageStream.md->cnt0++;
-   
-         m_imageStream.md->write=0;
-         ImageStreamIO_sempost(&m_imageStream,-1);
+         m_player.zero(!triggerMode);
          log<text_log>("zeroed");
 
       }
@@ -683,6 +674,25 @@ INDI_NEWCALLBACK_DEFN(dmModulator, m_indiP_zero)(const pcf::IndiProperty &ipRecv
 }
 
 
+inline
+int dmModulator::checkRecordTimes()
+{
+   return telemeter<dmModulator>::checkRecordTimes(telem_waveform());
+}
+
+inline
+int dmModulator::recordTelem( const telem_waveform * )
+{
+   dev::waveformPlayer<realT>::timingStats ts = m_player.stats();
+
+   //Nothing to record if we haven't written since the last record
+   if(ts.writes == 0) return 0;
+
+   telem<telem_waveform>({ts.period, ts.periodJitter, ts.latency, ts.latencyMax, (uint32_t) ts.skipped});
+
+   return 0;
+}
+
 } //namespace app
 } //namespace MagAOX
 
@@ -83,7 +83,16 @@ protected:
    ///@}
 
    mx::improc::eigenCube<realT> m_shapes;
-      
+
+   std::mutex m_shapesMutex; ///< Protects m_shapes, which is loaded by both the modulator thread and appLogic.
+
+   realT m_genSeparation {0}; ///< The separation used to generate the current shapes
+   realT m_genAngle {0}; ///< The angle used to generate the current shapes
+   realT m_genAmp {0}; ///< The amplitude used to generate the current shapes
+   bool m_genCross {true}; ///< The cross setting used to generate the current shapes
+
+   dev::waveformPlayer<realT> m_player; ///< Plays the shapes to the DM channel
+
    IMAGE m_imageStream; 
    uint32_t m_width {0}; ///< The width of the image
    uint32_t m_height {0}; ///< The height of the image.
@@ -138,6 +147,11 @@ protected:
 
    int generateSpeckles();
 
+   /// Generate the speckles and load them into the player.
+   /** If the player is running the new shapes are used starting with the next cycle.
+     */
+   int loadSpeckles();
+
    /** \name Modulator Thread 
      * This thread sends the signal to the dm at the prescribed frequency
      *
@@ -193,6 +207,8 @@ public:
    int checkRecordTimes();
    
    int recordTelem( const telem_dmspeck * );
+
+   int recordTelem( const telem_waveform * );
    
    int recordDmSpeck(bool force = false);
    
@@ -385,8 +401,30 @@ int dmSpeckle::appLogic()
          return log<text_log,-1>("Type-size mismatch, realT is not float.", logPrio::LOG_CRITICAL);
       }
 
+      m_player.stream(&m_imageStream);
+
       state(stateCodes::READY);
    }
+
+   if(state() == stateCodes::READY && m_modulating)
+   {
+      //Changes while modulating take effect at the start of the next cycle
+      if(m_separation != m_genSeparation || m_angle != m_genAngle || m_amp != m_genAmp || m_cross != m_genCross)
+      {
+         loadSpeckles();
+         recordDmSpeck();
+      }
+
+      if(m_frequency != m_player.frequency())
+      {
+         m_player.frequency(m_frequency);
+         {
+            std::lock_guard<std::mutex> guard(m_indiMutex);
+            updateIfChanged(m_indiP_frequency, "current", m_frequency);
+         }
+         recordDmSpeck();
+      }
+   }
    
    if(telemeter<dmSpeckle>::appLogic() < 0)
    {
@@ -461,6 +499,25 @@ int dmSpeckle::generateSpeckles()
    return 0;
 }
 
+int dmSpeckle::loadSpeckles()
+{
+   std::lock_guard<std::mutex> lock(m_shapesMutex);
+
+   m_genSeparation = m_separation;
+   m_genAngle = m_angle;
+   m_genAmp = m_amp;
+   m_genCross = m_cross;
+
+   generateSpeckles();
+
+   if(m_player.setPlanes(m_shapes) < 0)
+   {
+      return log<text_log,-1>("Speckle shapes do not match the DM channel.", logPrio::LOG_ERROR);
+   }
+
+   return 0;
+}
+
 inline
 void dmSpeckle::modThreadStart( dmSpeckle * d)
 {
@@ -487,18 +544,10 @@ void dmSpeckle::modThreadExec()
       
       if(m_modulating && !m_shutdown)
       {
-         generateSpeckles();
-         
-         int64_t freqNsec = (1.0/m_frequency)*1e9;
-         int64_t dnsec;
-   
-         int idx = 0;
-         
-         timespec modstart;
-         timespec currtime;
-      
-         bool triggered = false;
-         sem_t * sem = nullptr;
+         loadSpeckles();
+         m_player.frequency(m_frequency);
+
+         IMAGE * trigger = nullptr;
          if(m_dmTriggerChannel == "") 
          {
             m_trigger = false;
@@ -506,11 +555,10 @@ void dmSpeckle::modThreadExec()
          }
          else if(m_trigger == true)
          {
-            ImageStreamIO_semflush(&m_triggerStream, m_triggerSemaphore);
-      
-            sem = m_triggerStream.semptr[m_triggerSemaphore]; ///< The semaphore to monitor for new image data
+            trigger = &m_triggerStream;
          }
 
+         bool triggerMode = m_trigger;
          
          log<text_log>("started modulating",logPrio::LOG_NOTICE);
          //To send a message
@@ -519,98 +567,24 @@ void dmSpeckle::modThreadExec()
          //The official record:
          recordDmSpeck(true);
 
-         dnsec = freqNsec;
-         clock_gettime(CLOCK_REALTIME, &modstart);
+         //Play until stopped, or until the trigger mode is changed in which case we restart in the new mode.
+         int rv = m_player.play( [this, triggerMode](){ return m_modulating && !m_shutdown && m_trigger == triggerMode; }, trigger, m_triggerSemaphore);
 
-         while(m_modulating && !m_shutdown)
+         if(rv < 0)
          {
-            if(m_trigger)
-            {
-               timespec ts;
-
-               if(clock_gettime(CLOCK_REALTIME, &ts) < 0)
-               {
-                  log<software_critical>({__FILE__,__LINE__,errno,0,"clock_gettime"}); 
-                  return;
-               }
-         
-               ts.tv_sec += 1;
-         
-               if(sem_timedwait(sem, &ts) == 0)
-               {
-                  triggered = true;
-               }
-               else
-               {
-                  triggered = false;
-
-                  //Check for why we timed out
-                  if(errno == EINTR) break; //This indicates signal interrupted us, time to restart or shutdown, loop will exit normally if flags set.
-            
-                  //ETIMEDOUT just means we should wait more.
-                  //Otherwise, report an error.
-                  if(errno != ETIMEDOUT)
-                  {
-                     log<software_error>({__FILE__, __LINE__,errno, "sem_timedwait"});
-                     break;
-                  }
-               }
-            }
-            else
-            {
-               mx::sys::nanoSleep(0.5*dnsec);
-               clock_gettime(CLOCK_REALTIME, &currtime);
-         
-               dnsec = (currtime.tv_sec - modstart.tv_sec)*1000000000 + (currtime.tv_nsec - modstart.tv_nsec);
-               triggered = false;
-            }
-
-            if(dnsec >= freqNsec || triggered)
-            {
-               //Do the write
-               
-               m_imageStream.md->write = 1;
-   
-               memcpy(m_imageStream.array.raw, m_shapes.image(idx).data(), m_width*m_height*m_typeSize);
-      
-               m_imageStream.md->atime = currtime;
-               m_imageStream.md->writetime = currtime;
-               
-               if(!m_trigger) m_imageStream.md->cnt0++;
-   
-               m_imageStream.md->write=0;
-               ImageStreamIO_sempost(&m_imageStream,-1);
-   
-               ++idx;
-               if(idx >= m_shapes.planes()) idx=0;
-               
-               if(!m_trigger)
-               {
-                  modstart.tv_nsec += freqNsec;
-                  if(modstart.tv_nsec >= 1000000000)
-                  {
-                     modstart.tv_nsec -= 1000000000;
-                     modstart.tv_sec += 1;
-                  }
-                  dnsec = freqNsec;
-               }
-            }
+            log<software_error>({__FILE__, __LINE__, "speckle shapes do not match the DM channel"});
+            m_modulating = false;
+            indi::updateSwitchIfChanged(m_indiP_modulating, "toggle", pcf::IndiElement::Off, m_indiDriver, INDI_IDLE);
          }
+         else if(rv > 0)
+         {
+            log<software_error>({__FILE__, __LINE__, rv, "waveform player"});
+         }
+
          recordDmSpeck(true);
          log<text_log>("stopped modulating", logPrio::LOG_NOTICE);
          //Always zero when done
-         clock_gettime(CLOCK_REALTIME, &currtime);
-         m_imageStream.md->write = 1;
-   
-         memset(m_imageStream.array.raw, 0.0, m_width*m_height*m_typeSize);
-
-         m_imageStream.md->atime = currtime;
-         m_imageStream.md->writetime = currtime;
-               
-         if(!m_trigger) m_imageStream.md->cnt0++;
-   
-         m_imageStream.md->write=0;
-         ImageStreamIO_sempost(&m_imageStream,-1);
+         m_player.zero(!triggerMode);
          log<text_log>("zeroed");
 
       }
@@ -841,7 +815,7 @@ INDI_NEWCALLBACK_DEFN(dmSpeckle, m_indiP_zero)(const pcf::IndiProperty &ipRecv)
 inline
 int dmSpeckle::checkRecordTimes()
 {
-   return telemeter<dmSpeckle>::checkRecordTimes(telem_dmspeck());
+   return telemeter<dmSpeckle>::checkRecordTimes(telem_dmspeck(), telem_waveform());
 }
    
 inline
@@ -849,6 +823,19 @@ int dmSpeckle::recordTelem( const telem_dmspeck * )
 {
    return recordDmSpeck(true);
 }
+
+inline
+int dmSpeckle::recordTelem( const telem_waveform * )
+{
+   dev::waveformPlayer<realT>::timingStats ts = m_player.stats();
+
+   //Nothing to record if we haven't written since the last record
+   if(ts.writes == 0) return 0;
+
+   telem<telem_waveform>({ts.period, ts.periodJitter, ts.latency, ts.latencyMax, (uint32_t) ts.skipped});
+
+   return 0;
+}
  
 inline
 int dmSpeckle::recordDmSpeck( bool force )
@@ -0,0 +1,278 @@
+#ifndef PCCPU_DDSC_HPP
+#define PCCPU_DDSC_HPP
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+
+#include <Eigen/Dense>
+
+#include "cpu_utils.hpp"
+#include "cpu_recursive_least_squares.hpp"
+
+namespace DDSPC
+{
+namespace cpu
+{
+
+/*
+	CPU implementation of the DistributedAutoRegressiveController in distributed_ar_controller.cu.
+
+	The buffers have the same layout as on the GPU: the measurement and command buffers hold one
+	num_modes vector per time step, and phi, xf, wp and the controller hold one vector per mode.
+*/
+class DistributedAutoRegressiveController{
+
+	public:
+		typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic> matrixT;
+		typedef Eigen::Matrix<float, Eigen::Dynamic, 1> vectorT;
+
+		RecursiveLeastSquares* rls;
+
+		std::vector<float> measurement_buffer; // num_modes x (buffer_size + 1)
+		std::vector<float> command_buffer; // num_modes x (buffer_size + 1)
+		std::vector<float> phi; // nfeatures x num_modes
+		std::vector<float> xf; // nfuture x num_modes
+		std::vector<float> wp; // (nfeatures - nfuture) x num_modes
+
+		const float* newest_measurement;
+		std::vector<float> command; // num_modes
+		std::vector<float> controller; // (nfeatures - nfuture) x num_modes
+		std::vector<float> lambda; // num_modes
+
+		int nhistory, nfuture, nmodes, nfeatures;
+		unsigned long long int buffer_size;
+		unsigned long long int buffer_index;
+
+		float gamma;
+
+		bool use_predictor;
+		float int_gain;
+		float int_leakage;
+
+		DistributedAutoRegressiveController(int num_history, int num_future, int num_modes, float new_gamma, const float* new_lambda, float P0){
+			nhistory = num_history;
+			nfuture = num_future;
+			nmodes = num_modes;
+
+			// Use all future DM commands except the most recent because that one will only have an effect in later measurements
+			nfeatures = nfuture - 1 + 2 * nhistory;
+
+			std::cout << "Nhist :: " << nhistory << std::endl;
+			std::cout << "Nfut :: " << nfuture << std::endl;
+			std::cout << "Nmodes :: " << nmodes << std::endl;
+			std::cout << "Nfeatures :: " << nfeatures << std::endl;
+
+			gamma = new_gamma;
+
+			// The buffer size is a bit mask one less than a power of two, so it can be used to cycle through the buffer
+			buffer_size = 0;
+			auto num_bits = find_next_power_of_2(nhistory + nfuture + 2);
+			for(unsigned long long int i =0; i < num_bits ; i++){
+				buffer_size |= 1 << i;
+			}
+
+			measurement_buffer.resize((size_t) nmodes * (buffer_size + 1));
+			command_buffer.resize((size_t) nmodes * (buffer_size + 1));
+
+			rls = new RecursiveLeastSquares(nfeatures, nfuture, nmodes, gamma, P0);
+
+			phi.resize((size_t) nfeatures * nmodes);
+			xf.resize((size_t) nfuture * nmodes);
+			wp.resize((size_t) (nfeatures - nfuture) * nmodes);
+
+			command.resize(nmodes);
+			controller.resize((size_t) (nfeatures - nfuture) * nmodes);
+			lambda.assign(new_lambda, new_lambda + nmodes);
+
+			reset_data_buffer();
+
+			// Initialize controller with an integrator
+			std::fill(controller.begin(), controller.end(), 0.0f);
+			for(int k=0; k < nmodes; k++)
+				controller[(size_t) k * (nfeatures - nfuture) + nhistory - 1] = -0.15;
+
+			newest_measurement = nullptr;
+
+			use_predictor = false;
+			int_gain = 0.2;
+			int_leakage = 0.95;
+		};
+
+		~DistributedAutoRegressiveController(){
+			delete rls;
+		};
+
+		void set_new_regularization(const float* new_lambda){
+			lambda.assign(new_lambda, new_lambda + nmodes);
+
+			// We used a new regularization parameter, so update the controller!
+			// This can then be used to adapt to noisy measurements.
+			update_controller();
+		};
+
+		inline void set_new_gamma(float new_gamma){
+			gamma = new_gamma;
+		};
+
+		inline void set_integrator(bool new_use_predictor, float new_int_gain, float new_int_leakage){
+			use_predictor = new_use_predictor;
+			int_gain = new_int_gain;
+			int_leakage = new_int_leakage;
+		};
+
+		void reset_data_buffer(){
+			buffer_index = 0;
+
+			std::fill(measurement_buffer.begin(), measurement_buffer.end(), 0.0f);
+			std::fill(command_buffer.begin(), command_buffer.end(), 0.0f);
+			std::fill(command.begin(), command.end(), 0.0f);
+			std::fill(phi.begin(), phi.end(), 0.0f);
+			std::fill(xf.begin(), xf.end(), 0.0f);
+			std::fill(wp.begin(), wp.end(), 0.0f);
+		};
+
+		void reset_controller(){
+			std::fill(controller.begin(), controller.end(), 0.0f);
+			rls->reset();
+		};
+
+		void add_measurement(const float* new_measurement){
+			newest_measurement = new_measurement;
+
+			// Copy the new measurement into our data buffer
+			std::copy(new_measurement, new_measurement + nmodes, measurement_slot(buffer_index));
+
+			const int nwp = nfeatures - nfuture;
+
+			// The past and future commands
+			for(int i=0; i < (nfuture - 1 + nhistory); i++)
+				copy_strided(command_slot(buffer_index-1-i), phi.data() + i, nfeatures);
+
+			// The past measurements
+			int phi_offset = nfuture-1 + nhistory;
+			int data_offset = nfuture;
+			for(int i=0; i < nhistory; i++)
+				copy_strided(measurement_slot(buffer_index-data_offset-i), phi.data() + i + phi_offset, nfeatures);
+
+			// The future measurements
+			for(int i=0; i < nfuture; i++)
+				copy_strided(measurement_slot(buffer_index-i), xf.data() + i, nfuture);
+
+			// The past vector for the control command, the N-1 past commands and N past measurements
+			for(int i=0; i < nhistory-1; i++)
+				copy_strided(command_slot(buffer_index-1-i), wp.data() + i, nwp);
+
+			int offset = nhistory-1;
+			for(int i=0; i < nhistory; i++)
+				copy_strided(measurement_slot(buffer_index-i), wp.data() + i + offset, nwp);
+		};
+
+		void update_predictor(){
+			// Estimate the future wavefront
+			rls->update(phi.data(), xf.data());
+		};
+
+		void update_controller(){
+			/*
+				A consists of two submatrices, B = A[:, :nfuture] does the system dynamics and the
+				rest does the prediction.  The controller is the last row of -inv(B^T B + lambda) B^T A[:, nfuture:].
+				Only that row of the inverse is needed, so we solve for it instead of inverting, and
+				apply B^T as B before A[:, nfuture:]^T.
+			*/
+			const int nwp = nfeatures - nfuture;
+
+			#pragma omp parallel
+			{
+				// Working memory for each thread, so nothing is allocated per mode
+				matrixT H11(nfuture, nfuture);
+				Eigen::LDLT<matrixT> ldlt(nfuture);
+				vectorT e = vectorT::Zero(nfuture);
+				e(nfuture-1) = 1.0;
+				vectorT z(nfuture), v(nfuture);
+
+				#pragma omp for schedule(static)
+				for(int k=0; k < nmodes; k++){
+					Eigen::Map<const matrixT> Ak(rls->prediction_matrix(k), nfuture, nfeatures);
+					Eigen::Map<vectorT> ck(controller.data() + (size_t) k * nwp, nwp);
+
+					H11.noalias() = Ak.leftCols(nfuture).transpose() * Ak.leftCols(nfuture);
+					H11.diagonal().array() += lambda[k];
+
+					ldlt.compute(H11);
+					z = ldlt.solve(e);
+					v.noalias() = Ak.leftCols(nfuture) * z;
+
+					ck.noalias() = -Ak.rightCols(nwp).transpose() * v;
+				}
+			}
+		};
+
+		float* get_command(){
+			return command.data();
+		};
+
+		float* get_new_control_command(float clip_val, const float* exploration_signal){
+
+			// Switch between the predictor and integrator
+			if(use_predictor){
+				const int nwp = nfeatures - nfuture;
+				float* cmd_slot = command_slot(buffer_index);
+
+				for(int k=0; k < nmodes; k++){
+					Eigen::Map<const vectorT> ck(controller.data() + (size_t) k * nwp, nwp);
+					Eigen::Map<const vectorT> wpk(wp.data() + (size_t) k * nwp, nwp);
+
+					float delta = ck.dot(wpk) + exploration_signal[k];
+					delta = std::min(std::max(delta, -clip_val), clip_val);
+
+					// Copy the new command into our data buffer
+					cmd_slot[k] = delta;
+					command[k] += delta;
+				}
+			}else{
+				#pragma omp simd
+				for(int k=0; k < nmodes; k++)
+					command[k] = int_leakage * command[k] - int_gain * newest_measurement[k];
+			}
+
+			buffer_index++;
+			return command.data();
+		};
+
+		/*
+			Saves the learned state and the controller in the Matrix::to_file format.
+		*/
+		void save_controller_state(std::string filename){
+			rls->save_state(filename);
+
+			batch_to_file(filename + "_controller.csv", controller.data(), 1, nfeatures - nfuture, nmodes);
+
+			std::vector<float> condition((size_t) nfuture * nfuture * nmodes, 0.0f);
+			for(int k=0; k < nmodes; k++)
+				for(int i=0; i < nfuture; i++)
+					condition[(size_t) k * nfuture * nfuture + i * nfuture + i] = lambda[k];
+
+			batch_to_file(filename + "_condition_matrix.csv", condition.data(), nfuture, nfuture, nmodes);
+		};
+
+	private:
+		inline float* measurement_slot(unsigned long long int index){
+			return measurement_buffer.data() + (size_t) (index & buffer_size) * nmodes;
+		};
+
+		inline float* command_slot(unsigned long long int index){
+			return command_buffer.data() + (size_t) (index & buffer_size) * nmodes;
+		};
+
+		inline void copy_strided(const float* src, float* dest, int stride){
+			for(int k=0; k < nmodes; k++)
+				dest[(size_t) k * stride] = src[k];
+		};
+};
+
+}
+}
+
+#endif
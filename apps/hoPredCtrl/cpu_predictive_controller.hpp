@@ -0,0 +1,227 @@
+#ifndef PCCPU_RDDSC_HPP
+#define PCCPU_RDDSC_HPP
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <random>
+
+#include <Eigen/Dense>
+
+#include "cpu_utils.hpp"
+#include "cpu_distributed_ar_controller.hpp"
+
+namespace DDSPC
+{
+namespace cpu
+{
+
+/*
+	CPU implementation of the PredictiveController in predictive_controller.cu.
+
+	This has the same interface as the GPU controller, so hoPredCtrl can use either one.
+	The saved states have the same format, so a state saved by one can be loaded by the other.
+*/
+class PredictiveController{
+	public:
+		typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic> matrixT;
+		typedef Eigen::Matrix<float, Eigen::Dynamic, 1> vectorT;
+
+	private:
+		int m_num_history;
+		int m_num_future;
+		int m_num_modes;
+		int m_num_measurements;
+		int m_num_actuators;
+
+		float m_gamma;
+		std::vector<float> m_lambda;
+		float m_P0;
+
+		unsigned long long int m_exploration_buffer_size;
+		unsigned long long int m_exploration_index;
+
+		vectorT m_exploration_signal;
+		vectorT m_voltages;
+		matrixT m_interaction_matrix; // num_modes x num_measurements
+		matrixT m_mode_mapping_matrix; // num_actuators x num_modes
+
+		matrixT m_exploration_buffer; // num_modes x exploration_buffer_size
+
+	public:
+
+		DistributedAutoRegressiveController* controller;
+
+		vectorT m_measurement;
+
+		PredictiveController(int num_history, int num_future, int num_modes, int num_measurements, float gamma, float lambda, float P0, int num_actuators){
+			m_num_history = num_history;
+			m_num_future = num_future;
+			m_num_modes = num_modes;
+			m_num_measurements = num_measurements;
+			m_num_actuators = num_actuators;
+			m_exploration_buffer_size = 0;
+			m_exploration_index = 0;
+
+			m_gamma = gamma;
+			m_P0 = P0;
+
+			m_lambda.assign(num_modes, lambda);
+
+			m_measurement = vectorT::Zero(num_modes);
+			m_exploration_signal = vectorT::Zero(num_modes);
+			m_voltages = vectorT::Zero(num_actuators);
+
+			m_interaction_matrix = matrixT::Constant(num_modes, num_measurements, 1.0);
+			m_mode_mapping_matrix = matrixT::Constant(num_actuators, num_modes, 1.0);
+
+			controller = new DistributedAutoRegressiveController(m_num_history, m_num_future, m_num_modes, m_gamma, m_lambda.data(), m_P0);
+		};
+
+		~PredictiveController(){
+			delete controller;
+		};
+
+		// Just direct function wrappers
+		void reset_data_buffer(){controller->reset_data_buffer();};
+		void reset_controller(){controller->reset_controller();};
+		void update_predictor(){controller->update_predictor();};
+		void update_controller(){controller->update_controller();};
+
+		// This function should reset the buffers and set the current control command to zero.
+		void set_zero(){
+			std::fill(controller->command.begin(), controller->command.end(), 0.0f);
+		};
+
+		// Training signal
+		void get_next_exploration_signal(){
+			if(m_exploration_index < m_exploration_buffer_size){
+				m_exploration_signal = m_exploration_buffer.col(m_exploration_index);
+				m_exploration_index += 1;
+			}else{
+				m_exploration_signal.setZero();
+			}
+		};
+
+		void create_exploration_buffer(float rms, int exploration_buffer_size){
+			std::cout << " Create buffer with size: " << exploration_buffer_size << std::endl;
+			m_exploration_index = 0;
+			m_exploration_buffer_size = exploration_buffer_size;
+
+			// A random binary signal with amplitude rms
+			std::mt19937 generator{(unsigned int) std::chrono::steady_clock::now().time_since_epoch().count()};
+			std::bernoulli_distribution distribution(0.5);
+
+			m_exploration_buffer.resize(m_num_modes, m_exploration_buffer_size + 1);
+			for(int j=0; j < m_exploration_buffer.cols(); j++){
+				for(int i=0; i < m_num_modes; i++){
+					m_exploration_buffer(i,j) = distribution(generator) ? rms : -rms;
+				}
+			}
+		};
+
+		// New wrapper functions
+		void set_new_regularization(float new_lambda){
+			std::fill(m_lambda.begin(), m_lambda.end(), new_lambda);
+			controller->set_new_regularization(m_lambda.data());
+		};
+
+		void set_new_gamma(float new_gamma){
+			static_cast<void>(new_gamma);
+			controller->set_new_regularization(m_lambda.data());
+		};
+
+		void set_interaction_matrix(const float* interaction_matrix){
+			m_interaction_matrix = Eigen::Map<const matrixT>(interaction_matrix, m_num_modes, m_num_measurements);
+		};
+
+		void set_mapping_matrix(const float* mapping_matrix){
+			m_mode_mapping_matrix = Eigen::Map<const matrixT>(mapping_matrix, m_num_actuators, m_num_modes);
+		};
+
+		void add_measurement(const float* new_wfs_measurement){
+			m_measurement.noalias() = m_interaction_matrix * Eigen::Map<const vectorT>(new_wfs_measurement, m_num_measurements);
+
+			// Add data to controller
+			controller->add_measurement(m_measurement.data());
+		};
+
+		float* get_command(float clip_val){
+			get_next_exploration_signal();
+
+			// Determine the command vector
+			float* command = controller->get_new_control_command(clip_val, m_exploration_signal.data());
+
+			m_voltages.noalias() = m_mode_mapping_matrix * Eigen::Map<const vectorT>(command, m_num_modes);
+
+			return m_voltages.data();
+		};
+
+		/*
+			Saves the state with the same files and format as the GPU controller.
+			Returns the timestamp used in the file names.
+		*/
+		std::string save_state(std::string path){
+			using namespace std::chrono;
+			uint64_t elapsed_time = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+
+			std::ostringstream oss;
+			oss << elapsed_time;
+			std::string timestamp(oss.str());
+			std::cout << timestamp << std::endl;
+
+			// Make the header file with all the parameters
+			std::fstream f;
+			f.open(path + "header_" + timestamp + ".txt", std::ios::out);
+			f << "Header file for the Predictive controller. \n\r";
+
+			f << "Time: " << timestamp << "\n\r";
+			f << "History: " << m_num_history << "\n\r";
+			f << "Future: " << m_num_future << "\n\r";
+			f << "Gamma: " << m_gamma << "\n\r";
+			f << "Num modes: " << m_num_modes << "\n\r";
+			f << "Num measurements: " << m_num_measurements << "\n\r";
+			f.close();
+
+			// Save the current controller
+			int nf = controller->nfeatures;
+			int nfut = m_num_future;
+
+			batch_to_file(path + "controller_" + timestamp + ".csv", controller->controller.data(), 1, nf - nfut, m_num_modes);
+
+			std::vector<float> condition((size_t) nfut * nfut * m_num_modes, 0.0f);
+			for(int k=0; k < m_num_modes; k++)
+				for(int i=0; i < nfut; i++)
+					condition[(size_t) k * nfut * nfut + i * nfut + i] = controller->lambda[k];
+
+			batch_to_file(path + "condition_matrix_" + timestamp + ".csv", condition.data(), nfut, nfut, m_num_modes);
+			batch_to_file(path + "prediction_matrix_" + timestamp + ".csv", controller->rls->prediction_matrix(), nfut, nf, m_num_modes);
+			batch_to_file(path + "covariance_matrix_" + timestamp + ".csv", controller->rls->covariance_matrix(), nf, nf, m_num_modes);
+
+			// The modal reconstructor
+			batch_to_file(path + "mode_mapping_matrix_" + timestamp + ".csv", m_mode_mapping_matrix.data(), m_num_actuators, m_num_modes, 1);
+			batch_to_file(path + "interaction_matrix_" + timestamp + ".csv", m_interaction_matrix.data(), m_num_modes, m_num_measurements, 1);
+
+			return timestamp;
+		};
+
+		void load_state(std::string path, std::string timestamp){
+			int nf = controller->nfeatures;
+
+			// These are learned
+			batch_from_file(path + "prediction_matrix_" + timestamp + ".csv", controller->rls->prediction_matrix(), (size_t) m_num_future * nf * m_num_modes);
+			batch_from_file(path + "covariance_matrix_" + timestamp + ".csv", controller->rls->covariance_matrix(), (size_t) nf * nf * m_num_modes);
+
+			// Create the controller
+			update_controller();
+		};
+
+};
+
+}
+}
+
+#endif
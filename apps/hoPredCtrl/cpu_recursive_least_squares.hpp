@@ -0,0 +1,204 @@
+#ifndef PCCPU_RLS_HPP
+#define PCCPU_RLS_HPP
+
+#include <vector>
+#include <string>
+
+#include <Eigen/Dense>
+
+#include "cpu_utils.hpp"
+
+namespace DDSPC
+{
+namespace cpu
+{
+
+/*
+	CPU implementation of the batched Recursive Least Squares in recursive_least_squares.cu.
+
+	Each batch (mode) has its own prediction matrix A (num_predictors x num_features) and inverse
+	covariance P (num_features x num_features), stored column-major and contiguous per batch in the
+	same layout as the GPU Matrix class.
+
+	The modes are independent, so the update is done one mode at a time with the modes split over
+	OpenMP threads.  All the steps for a mode are done while its A and P are in cache, instead of
+	sweeping every batch for each step as the batched cuBLAS calls do.
+
+	The rank-1 update of P is deferred and fused with the P^T x product of the next update, so
+	P is streamed through the cache once per update instead of twice.  Use covariance_matrix() to
+	get P, which applies any pending update first.
+*/
+class RecursiveLeastSquares{
+
+	public:
+		typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic> matrixT;
+		typedef Eigen::Matrix<float, Eigen::Dynamic, 1> vectorT;
+
+	private:
+		std::vector<float> A; // Prediction matrices, num_predictors x num_features x batch
+		std::vector<float> P; // Inverse covariance matrices, num_features x num_features x batch
+
+		std::vector<float> xtP; // x^T P for each batch, kept for the pending P update
+		std::vector<float> K; // Gain vector for each batch, kept for the pending P update
+		std::vector<float> err; // The a-priori prediction error for each batch
+
+		bool pending; // True if the rank-1 update of P from the last update has not been applied
+		float pending_inv_gamma;
+
+	public:
+		float gamma; // The forgetting factor
+		float _initial_covariance;
+		int _num_features;
+		int _num_predictors;
+		int _batch_size;
+
+		RecursiveLeastSquares(int num_features, int num_predictors, int batch_size, float forgetting_factor, float P0){
+			gamma = forgetting_factor;
+			_initial_covariance = P0;
+			_num_features = num_features;
+			_num_predictors = num_predictors;
+			_batch_size = batch_size;
+
+			A.resize((size_t) num_predictors * num_features * batch_size);
+			P.resize((size_t) num_features * num_features * batch_size);
+			xtP.resize((size_t) num_features * batch_size);
+			K.resize((size_t) num_features * batch_size);
+			err.resize((size_t) num_predictors * batch_size);
+
+			reset();
+		};
+
+		void reset(){
+			std::fill(A.begin(), A.end(), 0.0f);
+			std::fill(P.begin(), P.end(), 0.0f);
+			std::fill(xtP.begin(), xtP.end(), 0.0f);
+			std::fill(K.begin(), K.end(), 0.0f);
+			std::fill(err.begin(), err.end(), 0.0f);
+
+			for(int k=0; k < _batch_size; k++){
+				Eigen::Map<matrixT> Pk(P.data() + (size_t) k * _num_features * _num_features, _num_features, _num_features);
+				Pk.diagonal().setConstant(_initial_covariance);
+			}
+
+			pending = false;
+		};
+
+		/*
+			x is num_features x batch and y is num_predictors x batch, column-major.
+		*/
+		void update(const float* x, const float* y){
+			const int nf = _num_features;
+			const int np = _num_predictors;
+			const bool apply_pending = pending;
+			const float inv_gamma_old = pending_inv_gamma;
+			const float g = gamma;
+
+			#pragma omp parallel for schedule(static)
+			for(int k=0; k < _batch_size; k++){
+				float* __restrict__ Pk = P.data() + (size_t) k * nf * nf;
+				float* __restrict__ Ak = A.data() + (size_t) k * np * nf;
+				float* __restrict__ uk = xtP.data() + (size_t) k * nf;
+				float* __restrict__ Kk = K.data() + (size_t) k * nf;
+				float* __restrict__ ek = err.data() + (size_t) k * np;
+				const float* __restrict__ xk = x + (size_t) k * nf;
+				const float* __restrict__ yk = y + (size_t) k * np;
+
+				// Apply the last P update and calculate x^T P in one pass over the columns of P.
+				// The old gain K(j) is not needed after column j is updated, so the new x^T P
+				// is accumulated in its place.
+				if(apply_pending){
+					for(int j=0; j < nf; j++){
+						float* __restrict__ Pj = Pk + (size_t) j * nf;
+						const float kj = Kk[j];
+						float s = 0;
+						for(int i=0; i < nf; i++){
+							Pj[i] = (Pj[i] - kj * uk[i]) * inv_gamma_old;
+							s += Pj[i] * xk[i];
+						}
+						Kk[j] = s;
+					}
+					std::copy(Kk, Kk + nf, uk);
+				}else{
+					for(int j=0; j < nf; j++){
+						const float* __restrict__ Pj = Pk + (size_t) j * nf;
+						float s = 0;
+						for(int i=0; i < nf; i++)
+							s += Pj[i] * xk[i];
+						uk[j] = s;
+					}
+				}
+
+				float cn = g;
+				for(int i=0; i < nf; i++)
+					cn += uk[i] * xk[i];
+
+				// The gain vector
+				const float inv_cn = 1.0f / cn;
+				for(int i=0; i < nf; i++)
+					Kk[i] = uk[i] * inv_cn;
+
+				// The a-priori error
+				std::copy(yk, yk + np, ek);
+				for(int j=0; j < nf; j++){
+					const float xj = xk[j];
+					for(int i=0; i < np; i++)
+						ek[i] -= Ak[(size_t) j * np + i] * xj;
+				}
+
+				// Update the prediction matrix
+				for(int j=0; j < nf; j++){
+					const float kj = Kk[j];
+					for(int i=0; i < np; i++)
+						Ak[(size_t) j * np + i] += ek[i] * kj;
+				}
+			}
+
+			pending = true;
+			pending_inv_gamma = 1.0f / gamma;
+		};
+
+		// Apply any pending update to the covariance matrices
+		void flush(){
+			if(!pending)
+				return;
+
+			const int nf = _num_features;
+
+			#pragma omp parallel for schedule(static)
+			for(int k=0; k < _batch_size; k++){
+				Eigen::Map<matrixT> Pk(P.data() + (size_t) k * nf * nf, nf, nf);
+				Eigen::Map<vectorT> uk(xtP.data() + (size_t) k * nf, nf);
+				Eigen::Map<vectorT> Kk(K.data() + (size_t) k * nf, nf);
+
+				for(int j=0; j < nf; j++){
+					Pk.col(j) = (Pk.col(j) - Kk(j) * uk) * pending_inv_gamma;
+				}
+			}
+
+			pending = false;
+		};
+
+		float* prediction_matrix(){
+			return A.data();
+		};
+
+		float* prediction_matrix(int batch_index){
+			return A.data() + (size_t) batch_index * _num_predictors * _num_features;
+		};
+
+		// Note that this applies any pending update first
+		float* covariance_matrix(){
+			flush();
+			return P.data();
+		};
+
+		void save_state(std::string filename){
+			batch_to_file(filename + "_prediction_matrix.csv", prediction_matrix(), _num_predictors, _num_features, _batch_size);
+			batch_to_file(filename + "_covariance_matrix.csv", covariance_matrix(), _num_features, _num_features, _batch_size);
+		};
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef PCCPU_UTILS_HPP
+#define PCCPU_UTILS_HPP
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cstdint>
+
+namespace DDSPC
+{
+namespace cpu
+{
+
+/*
+	Helpers for the CPU implementation of the predictive controller.
+	These do not depend on CUDA so that the CPU controller can be built on machines without a GPU.
+*/
+
+static inline std::vector<std::string> split(const std::string &s, char delim){
+	std::vector<std::string> result;
+	std::stringstream ss (s);
+	std::string item;
+
+	while (std::getline (ss, item, delim)) {
+		result.push_back (item);
+	}
+
+	return result;
+}
+
+static inline uint64_t find_next_power_of_2(int sample){
+	uint64_t num_bits = 0;
+
+	do{
+		sample >>= 1;
+		++num_bits;
+	} while(sample);
+
+	return num_bits;
+}
+
+/*
+	Write a batch of column-major matrices in the same format as Matrix::to_file.
+	This way saved states can be exchanged between the CPU and GPU controllers.
+*/
+static inline void batch_to_file(const std::string & filename, const float* data, int nrows, int ncols, int batch_size){
+	std::fstream f;
+	f.open(filename, std::ios::out);
+
+	size_t total_size = (size_t) nrows * ncols * batch_size;
+
+	f << "Shape: (" << nrows << " , " << ncols  << " , " << batch_size << ")\n";
+	for(size_t i=0; i < total_size; ++i){
+		f << data[i];
+		if(i < (total_size-1)){
+			f << ",";
+		}
+	}
+
+	f.close();
+}
+
+/*
+	Read a batch of matrices written by batch_to_file or Matrix::to_file.
+	Returns the number of values read, which is 0 if the file could not be opened.
+*/
+static inline size_t batch_from_file(const std::string & filename, float* data, size_t total_size){
+	std::ifstream myfile (filename);
+
+	if (!myfile.is_open())
+		return 0;
+
+	std::string shape("");
+	std::getline(myfile, shape); // Get the line with the shape
+
+	std::string line("");
+	std::getline(myfile, line);
+
+	std::vector<std::string> split_result = split(line, ',');
+
+	size_t n = 0;
+	for(; n < split_result.size() && n < total_size; n++){
+		data[n] = std::stof(split_result[n]);
+	}
+
+	myfile.close();
+
+	return n;
+}
+
+}
+}
+
+#endif
@@ -20,7 +20,13 @@ using namespace mx::improc;
 #include "../../libMagAOX/libMagAOX.hpp" //Note this is included on command line to trigger pch
 #include "../../magaox_git_version.h"
 
+#ifdef HOPREDCTRL_CPU
+#include "cpu_predictive_controller.hpp"
+typedef DDSPC::cpu::PredictiveController predictiveControllerT;
+#else
 #include "predictive_controller.cuh"
+typedef DDSPC::PredictiveController predictiveControllerT;
+#endif
 
 using namespace DDSPC;
 
@@ -151,7 +157,7 @@ protected:
 	realT m_intgain;
 	realT m_intleak;
 
-	DDSPC::PredictiveController* controller;
+	predictiveControllerT* controller; ///< The GPU controller, or the CPU controller if built with HOPREDCTRL_CPU=yes
 
 	// Learning time
 	int m_exploration_steps;
@@ -706,7 +712,7 @@ int hoPredCtrl::allocate(const dev::shmimT & dummy)
 	}
 
 	// Controller setup
-	controller = new DDSPC::PredictiveController(m_numHist, m_numFut, m_numModes, m_measurement_size, m_gamma, m_lambda, m_inv_covariance, m_dmWidth * m_dmHeight);
+	controller = new predictiveControllerT(m_numHist, m_numFut, m_numModes, m_measurement_size, m_gamma, m_lambda, m_inv_covariance, m_dmWidth * m_dmHeight);
 	controller->set_interaction_matrix(m_interaction_matrix.data());
 	controller->set_mapping_matrix(m_mapping_matrix.data());
 	std::cerr << "Finished intializing the controller.\n";
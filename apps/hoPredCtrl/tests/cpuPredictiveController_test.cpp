@@ -0,0 +1,315 @@
+/** \file cpuPredictiveController_test.cpp
+  * \brief Catch2 tests for the CPU predictive controller.
+  *
+  * The benchmark is hidden, run it with `cpuPredictiveController_test "[.benchmark]"`.
+  *
+  * History:
+  */
+#include "../../../tests/catch2/catch.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <cstdio>
+
+#include "../cpu_predictive_controller.hpp"
+
+using namespace DDSPC::cpu;
+
+namespace cpuPredictiveController_tests
+{
+
+typedef Eigen::Matrix<float, -1, -1> matT;
+typedef Eigen::Matrix<float, -1, 1> vecT;
+
+/// A transcription of the GPU RLS and controller updates, one batched operation at a time.
+struct referenceRLS
+{
+   int m_nf;
+   int m_np;
+   int m_nb;
+   float m_gamma;
+
+   std::vector<float> m_A;
+   std::vector<float> m_P;
+   std::vector<float> m_controller;
+
+   referenceRLS(int nf, int np, int nb, float gamma, float P0) : m_nf(nf), m_np(np), m_nb(nb), m_gamma(gamma)
+   {
+      m_A.assign((size_t) np*nf*nb, 0.0f);
+      m_P.assign((size_t) nf*nf*nb, 0.0f);
+      for(int k=0; k < nb; ++k) for(int i=0; i < nf; ++i) m_P[(size_t) k*nf*nf + i*nf + i] = P0;
+   }
+
+   void update(const float * x, const float * y)
+   {
+      std::vector<float> xtP((size_t) m_nf*m_nb), K((size_t) m_nf*m_nb), err((size_t) m_np*m_nb), cn(m_nb);
+
+      // x->dot(P, xtP, 1.0, 0.0, CUBLAS_OP_T, CUBLAS_OP_N)
+      for(int k=0; k < m_nb; ++k)
+         for(int j=0; j < m_nf; ++j)
+         {
+            float s = 0;
+            for(int i=0; i < m_nf; ++i) s += x[k*m_nf + i] * m_P[(size_t) k*m_nf*m_nf + j*m_nf + i];
+            xtP[k*m_nf + j] = s;
+         }
+
+      // xtP->dot(x, cn); cn->add(gamma_vec); xtP->divide_by_scalar(cn, K);
+      for(int k=0; k < m_nb; ++k)
+      {
+         float s = 0;
+         for(int i=0; i < m_nf; ++i) s += xtP[k*m_nf + i] * x[k*m_nf + i];
+         cn[k] = s + m_gamma;
+         for(int i=0; i < m_nf; ++i) K[k*m_nf + i] = xtP[k*m_nf + i] / cn[k];
+      }
+
+      // A->dot(x, err, -1.0, 0.0); err->add(y);
+      for(int k=0; k < m_nb; ++k)
+         for(int i=0; i < m_np; ++i)
+         {
+            float s = 0;
+            for(int j=0; j < m_nf; ++j) s += m_A[(size_t) k*m_np*m_nf + j*m_np + i] * x[k*m_nf + j];
+            err[k*m_np + i] = y[k*m_np + i] - s;
+         }
+
+      // err->dot(K, A, 1.0, 1.0)
+      for(int k=0; k < m_nb; ++k)
+         for(int j=0; j < m_nf; ++j)
+            for(int i=0; i < m_np; ++i)
+               m_A[(size_t) k*m_np*m_nf + j*m_np + i] += err[k*m_np + i] * K[k*m_nf + j];
+
+      // xtP->dot(K, P, -1.0 / gamma, 1.0 / gamma, CUBLAS_OP_T, CUBLAS_OP_N)
+      for(int k=0; k < m_nb; ++k)
+         for(int j=0; j < m_nf; ++j)
+            for(int i=0; i < m_nf; ++i)
+            {
+               float & p = m_P[(size_t) k*m_nf*m_nf + j*m_nf + i];
+               p = -1.0f/m_gamma * xtP[k*m_nf + i] * K[k*m_nf + j] + 1.0f/m_gamma * p;
+            }
+   }
+
+   void updateController(float lambda)
+   {
+      int nwp = m_nf - m_np;
+      m_controller.resize((size_t) nwp*m_nb);
+
+      for(int k=0; k < m_nb; ++k)
+      {
+         Eigen::Map<matT> A(m_A.data() + (size_t) k*m_np*m_nf, m_np, m_nf);
+
+         matT H12 = A.leftCols(m_np).transpose() * A.rightCols(nwp);
+         matT H11 = A.leftCols(m_np).transpose() * A.leftCols(m_np) + lambda*matT::Identity(m_np, m_np);
+         matT invH11 = H11.transpose().inverse();
+
+         Eigen::Map<vecT>(m_controller.data() + (size_t) k*nwp, nwp) = -(invH11.row(m_np-1) * H12).transpose();
+      }
+   }
+};
+
+/// Drive a controller with a stable random AR(2) signal per mode, returning the measurements.
+struct modalSignal
+{
+   int m_nmodes;
+   std::mt19937 m_gen {5};
+   std::normal_distribution<float> m_dist {0, 1};
+   std::vector<float> m_x0, m_x1;
+
+   explicit modalSignal(int nmodes) : m_nmodes(nmodes), m_x0(nmodes, 0.0f), m_x1(nmodes, 0.0f) {}
+
+   const std::vector<float> & next()
+   {
+      for(int k=0; k < m_nmodes; ++k)
+      {
+         float a1 = 1.6 - 0.3*k/m_nmodes;
+         float x = a1*m_x0[k] - 0.7*m_x1[k] + 0.05*m_dist(m_gen);
+         m_x1[k] = m_x0[k];
+         m_x0[k] = x;
+      }
+      return m_x0;
+   }
+};
+
+SCENARIO( "Recursive least squares on the CPU", "[cpuPredictiveController]" )
+{
+   GIVEN("A batch of modes with random features")
+   {
+      const int nf = 11;
+      const int np = 3;
+      const int nb = 17;
+
+      std::mt19937 gen(1);
+      std::normal_distribution<float> dist(0, 1);
+
+      std::vector<float> x((size_t) nf*nb), y((size_t) np*nb);
+
+      WHEN("Updating for many steps")
+      {
+         referenceRLS ref(nf, np, nb, 0.99, 1);
+         RecursiveLeastSquares rls(nf, np, nb, 0.99, 1);
+
+         for(int n=0; n < 200; ++n)
+         {
+            for(auto & v : x) v = dist(gen);
+            for(auto & v : y) v = dist(gen);
+
+            ref.update(x.data(), y.data());
+            rls.update(x.data(), y.data());
+         }
+
+         THEN("the prediction and covariance matrices match the GPU algorithm")
+         {
+            float * A = rls.prediction_matrix();
+            for(size_t n=0; n < ref.m_A.size(); ++n) REQUIRE(A[n] == Approx(ref.m_A[n]).margin(1e-4));
+
+            float * P = rls.covariance_matrix();
+            for(size_t n=0; n < ref.m_P.size(); ++n) REQUIRE(P[n] == Approx(ref.m_P[n]).margin(1e-4));
+         }
+      }
+   }
+}
+
+SCENARIO( "Predictive control on the CPU", "[cpuPredictiveController]" )
+{
+   GIVEN("A controller with 2 measurements per mode")
+   {
+      const int nhist = 4;
+      const int nfut = 3;
+      const int nmodes = 12;
+      const int nmeas = 2*nmodes;
+      const int nact = 30;
+      const float lambda = 0.05;
+
+      std::vector<float> im((size_t) nmodes*nmeas, 0.0f), map((size_t) nact*nmodes);
+      for(int k=0; k < nmodes; ++k) im[(size_t) (2*k)*nmodes + k] = 1.0;
+
+      std::mt19937 gen(3);
+      std::normal_distribution<float> dist(0, 1);
+      for(auto & v : map) v = dist(gen);
+
+      PredictiveController pc(nhist, nfut, nmodes, nmeas, 0.999, lambda, 100, nact);
+      pc.set_interaction_matrix(im.data());
+      pc.set_mapping_matrix(map.data());
+      pc.create_exploration_buffer(0.01, 50);
+
+      const int nf = pc.controller->nfeatures;
+      referenceRLS ref(nf, nfut, nmodes, 0.999, 100);
+
+      modalSignal sig(nmodes);
+      std::vector<float> wfs(nmeas, 0.0f);
+
+      pc.controller->set_integrator(true, 0.2, 0.99);
+      for(int n=0; n < 300; ++n)
+      {
+         const std::vector<float> & s = sig.next();
+         for(int k=0; k < nmodes; ++k) wfs[2*k] = s[k] + pc.controller->command[k];
+
+         pc.add_measurement(wfs.data());
+         pc.get_command(0.1);
+
+         pc.update_predictor();
+         ref.update(pc.controller->phi.data(), pc.controller->xf.data());
+      }
+      pc.set_new_regularization(lambda);
+      ref.updateController(lambda);
+
+      WHEN("The controller is updated")
+      {
+         THEN("it matches the GPU algorithm")
+         {
+            for(size_t n=0; n < ref.m_controller.size(); ++n)
+            {
+               REQUIRE(pc.controller->controller[n] == Approx(ref.m_controller[n]).margin(1e-3));
+            }
+         }
+
+         THEN("the voltages are the mapped command")
+         {
+            float * v = pc.get_command(0.1);
+            vecT cmd = Eigen::Map<vecT>(pc.controller->command.data(), nmodes);
+            vecT volts = Eigen::Map<matT>(map.data(), nact, nmodes) * cmd;
+            for(int n=0; n < nact; ++n) REQUIRE(v[n] == Approx(volts(n)).margin(1e-5));
+         }
+      }
+
+      WHEN("The state is saved and loaded into a new controller")
+      {
+         std::string path = "/tmp/cpuPredictiveController_test_";
+         std::string ts = pc.save_state(path);
+
+         PredictiveController pc2(nhist, nfut, nmodes, nmeas, 0.999, lambda, 100, nact);
+         pc2.load_state(path, ts);
+
+         THEN("the learned state and controller are restored")
+         {
+            for(size_t n=0; n < ref.m_A.size(); ++n)
+            {
+               REQUIRE(pc2.controller->rls->prediction_matrix()[n] == Approx(pc.controller->rls->prediction_matrix()[n]).margin(1e-5));
+            }
+
+            for(size_t n=0; n < ref.m_P.size(); ++n)
+            {
+               REQUIRE(pc2.controller->rls->covariance_matrix()[n] == Approx(pc.controller->rls->covariance_matrix()[n]).epsilon(1e-4));
+            }
+
+            for(size_t n=0; n < pc.controller->controller.size(); ++n)
+            {
+               REQUIRE(pc2.controller->controller[n] == Approx(pc.controller->controller[n]).margin(1e-3));
+            }
+         }
+
+         for(std::string f : {"header_", "controller_", "condition_matrix_", "prediction_matrix_", "covariance_matrix_", "mode_mapping_matrix_", "interaction_matrix_"})
+         {
+            std::remove((path + f + ts + (f == "header_" ? ".txt" : ".csv")).c_str());
+         }
+      }
+   }
+}
+
+SCENARIO( "Benchmarking the CPU predictive controller", "[.benchmark]" )
+{
+   GIVEN("A controller sized for the tweeter")
+   {
+      const int nhist = 10;
+      const int nfut = 2;
+      const int nmodes = 2000;
+      const float gamma = 0.999;
+
+      PredictiveController pc(nhist, nfut, nmodes, nmodes, gamma, 0.05, 100, 1);
+      std::vector<float> im((size_t) nmodes*nmodes, 0.0f), map(nmodes, 0.0f);
+      for(int k=0; k < nmodes; ++k) im[(size_t) k*nmodes + k] = 1.0;
+      pc.set_interaction_matrix(im.data());
+      pc.set_mapping_matrix(map.data());
+
+      const int nf = pc.controller->nfeatures;
+      referenceRLS ref(nf, nfut, nmodes, gamma, 100);
+
+      modalSignal sig(nmodes);
+
+      const int N = 500;
+      double tref = 0, tcpu = 0, tctrl = 0;
+      for(int n=0; n < N; ++n)
+      {
+         pc.add_measurement(sig.next().data());
+         pc.get_command(0.1);
+
+         auto t0 = std::chrono::steady_clock::now();
+         ref.update(pc.controller->phi.data(), pc.controller->xf.data());
+         auto t1 = std::chrono::steady_clock::now();
+         pc.update_predictor();
+         auto t2 = std::chrono::steady_clock::now();
+         if(n % 50 == 0) pc.update_controller();
+         auto t3 = std::chrono::steady_clock::now();
+
+         tref += std::chrono::duration<double, std::micro>(t1-t0).count();
+         tcpu += std::chrono::duration<double, std::micro>(t2-t1).count();
+         tctrl += std::chrono::duration<double, std::micro>(t3-t2).count();
+      }
+
+      std::cout << "cpu predictive controller benchmark (" << nmodes << " modes, " << nf << " features): batched reference "
+                << tref/N << " us/update, cpu rls " << tcpu/N << " us/update, controller " << tctrl/(N/50) << " us/update\n";
+
+      REQUIRE(pc.controller->rls->prediction_matrix()[0] == Approx(ref.m_A[0]).margin(1e-3));
+   }
+}
+
+} //namespace cpuPredictiveController_tests
@@ -24,6 +24,7 @@ X re-enable power management
 #ifndef irisaoCtrl_hpp
 #define irisaoCtrl_hpp
 
+#include <atomic>
 
 #include "../../libMagAOX/libMagAOX.hpp" //Note this is included on command line to trigger pch
 #include "../../magaox_git_version.h"
@@ -32,6 +33,8 @@ X re-enable power management
 /* IrisAO SDK C Header */
 #include <irisao.mirrors.h>
 
+#include "irisaoSegments.hpp"
+
 
 /** \defgroup irisaoCtrl 
   * \brief The MagAO-X application to control an IrisAO DM
@@ -79,6 +82,12 @@ protected:
    std::string m_dserialNumber; ///< The IrisAO DRIVER serial number
    bool m_hardwareDisable; ///< Hardware disable flag (set to true to disable sending commands)
    
+   std::atomic<bool> m_batched {false}; ///< If true, use the batched command path.  If false, set and query each segment in turn.  Requires m_maxPiston and m_maxTilt.  Set from INDI, read by the DM thread.
+
+   float m_maxPiston {0}; ///< The maximum absolute piston command.  Must be set for the batched path.
+
+   float m_maxTilt {0}; ///< The maximum absolute tip and tilt command.  Must be set for the batched path.
+
    ///@}
 
 public:
@@ -157,6 +166,23 @@ public:
      */
    int commandDM(void * curr_src);
    
+   /// Send a command to the DM by setting and querying each segment in turn.
+   /** The saturation map is set from the SDK's reachability of each segment.
+     * 
+     * \returns 0 on success 
+     * \returns -1 on error
+     */
+   int commandDMPerSegment(float * curr_src);
+
+   /// Send a command to the DM as one batch.
+   /** The command is clipped to the configured limits in one pass, which also sets the saturation map,
+     * and then the packed buffer is staged for the cached segment list and sent with a single MirrorCommand.
+     * 
+     * \returns 0 on success 
+     * \returns -1 on error
+     */
+   int commandDMBatched(float * curr_src);
+
    /// Release the DM, making it safe to turn off power.
    /** The application will be state READY at the conclusion of this.
      *  
@@ -181,8 +207,42 @@ protected:
    
    bool m_dmopen {false}; ///< Track whether the DM connection has been opened
    
+   std::vector<SegmentNumber> m_segments; ///< The segment numbers of the DM, found in initDM
+   
+   std::vector<float> m_limits; ///< The per-actuator command limits, from m_maxPiston and m_maxTilt
+   
+   std::vector<float> m_packed; ///< The clipped command, packed piston/tip/tilt by segment
+   
+   std::vector<uint8_t> m_packedSat; ///< The saturation flags of the packed command
+   
+   ///@}
+
+   /** \name Command Timing
+     * Accumulated in commandDM and reported once per second in appLogic when the hardware is disabled.
+     *@{
+     */
+   
+   std::mutex m_cmdTimeMutex; ///< Mutex for the timing, which is accumulated in the shmim thread and reported in appLogic
+
+   double m_cmdTimeSum {0}; ///< Sum of command times since the last report [s]
+   double m_cmdTimeMax {0}; ///< Maximum command time since the last report [s]
+   uint64_t m_cmdCount {0}; ///< Number of commands since the last report
+   
+   ///@}
+   
+   pcf::IndiProperty m_indiP_batched;
+   
+   /// Check whether the batched command path can be used.
+   /** The batched path does not query the SDK for reachability, so it only detects saturation with the
+     * limits set by dm.maxPiston and dm.maxTilt.
+     *
+     * \returns true if both limits are set
+     */
+   bool batchedAllowed();
+
 public:
    
+   INDI_NEWCALLBACK_DECL(irisaoCtrl, m_indiP_batched);
 };
 
 irisaoCtrl::irisaoCtrl() : MagAOXApp(MAGAOX_CURRENT_SHA1, MAGAOX_REPO_MODIFIED)
@@ -204,6 +264,9 @@ void irisaoCtrl::setupConfig()
    config.add("dm.dserialNumber", "", "dm.dserialNumber", argType::Required, "dm", "dserialNumber", false, "string", "The IrisAO DRIVER serial number used to find correct DM Profile.");
    config.add("dm.hardwareDisable", "", "dm.hardwareDisable", argType::Required, "dm", "hardwareDisable", false, "bool", "Set to true to disable hardware for testing purposes.");
    config.add("dm.calibRelDir", "", "dm.calibRelDir", argType::Required, "dm", "calibRelDir", false, "string", "Used to find the default config directory.");
+   config.add("dm.batched", "", "dm.batched", argType::Required, "dm", "batched", false, "bool", "Use the batched command path.  If false each segment is set and queried in turn.  Requires dm.maxPiston and dm.maxTilt.  Default is false.");
+   config.add("dm.maxPiston", "", "dm.maxPiston", argType::Required, "dm", "maxPiston", false, "float", "The maximum absolute piston command in the batched path.  Default is 0, which disables the batched path.");
+   config.add("dm.maxTilt", "", "dm.maxTilt", argType::Required, "dm", "maxTilt", false, "float", "The maximum absolute tip and tilt command in the batched path.  Default is 0, which disables the batched path.");
    dev::dm<irisaoCtrl,float>::setupConfig(config);
    
 }
@@ -214,6 +277,17 @@ int irisaoCtrl::loadConfigImpl( mx::app::appConfigurator & _config )
    config(m_mserialNumber, "dm.mserialNumber");
    config(m_dserialNumber, "dm.dserialNumber");
    config(m_hardwareDisable, "dm.hardwareDisable");
+   bool batched = m_batched;
+   config(batched, "dm.batched");
+   m_batched = batched;
+   config(m_maxPiston, "dm.maxPiston");
+   config(m_maxTilt, "dm.maxTilt");
+   
+   if(m_batched && !batchedAllowed())
+   {
+      log<text_log>("dm.batched requires dm.maxPiston and dm.maxTilt.  Using per-segment commands.", logPrio::LOG_WARNING);
+      m_batched = false;
+   }
          
    dev::dm<irisaoCtrl,float>::loadConfig(_config);
    
@@ -232,6 +306,14 @@ int irisaoCtrl::appStartup()
    dev::dm<irisaoCtrl,float>::appStartup();
    shmimMonitor<irisaoCtrl>::appStartup();
    
+   createStandardIndiToggleSw( m_indiP_batched, "batched", "Batched Commands", "DM");
+   if( registerIndiPropertyNew( m_indiP_batched, INDI_NEWCALLBACK(m_indiP_batched)) < 0)
+   {
+      log<software_error>({__FILE__,__LINE__});
+      return -1;
+   }
+   m_indiP_batched["toggle"] = m_batched ? pcf::IndiElement::On : pcf::IndiElement::Off;
+   
    return 0;
 }
 
@@ -251,10 +333,29 @@ int irisaoCtrl::appLogic()
    
    if(m_nsat > 0)
    {
-      log<text_log>("Saturated actuators in last second: " + std::to_string(m_nsat), logPrio::LOG_WARNING);
+      log<text_log>("Saturated segments in last second: " + std::to_string(m_nsat), logPrio::LOG_WARNING);
    }
    m_nsat = 0;
    
+   double cmdTimeSum, cmdTimeMax;
+   uint64_t cmdCount;
+   
+   {
+      std::lock_guard<std::mutex> lock(m_cmdTimeMutex);
+      cmdTimeSum = m_cmdTimeSum;
+      cmdTimeMax = m_cmdTimeMax;
+      cmdCount = m_cmdCount;
+      m_cmdTimeSum = 0;
+      m_cmdTimeMax = 0;
+      m_cmdCount = 0;
+   }
+   
+   if(m_hardwareDisable && cmdCount > 0)
+   {
+      log<text_log>(std::string(m_batched ? "batched" : "per-segment") + " commands in last second: " + std::to_string(cmdCount) 
+                       + ", mean " + std::to_string(cmdTimeSum/cmdCount*1e6) + " us, max " + std::to_string(cmdTimeMax*1e6) + " us");
+   }
+   
    return 0;
 }
 
@@ -331,12 +432,24 @@ int irisaoCtrl::initDM()
    // Get number of actuators
    // this is stupid, but I don't know how else to get this number
    SegmentNumber segment = 0; // don't know if this should start at 0 or 1
+   m_segments.clear();
    while (MirrorIterate(m_dm, segment)){
+      m_segments.push_back(segment);
       segment++;
    }
    m_nbAct = 3*segment; // 3*(segment+1)
    log<text_log>("Found " + std::to_string(segment) + " segments for IrisAO mirror " + mser, logPrio::LOG_NOTICE);
 
+   if(m_nbAct > (uint32_t) m_dmWidth*m_dmHeight)
+   {
+      log<text_log>("DM initialization failed.  dm.width x dm.height is smaller than 3 x number of segments.", logPrio::LOG_ERROR);
+      return -1;
+   }
+
+   irisaoSegmentLimits(m_limits, m_segments.size(), m_maxPiston, m_maxTilt);
+   m_packed.resize(m_nbAct);
+   m_packedSat.resize(m_nbAct);
+
    // cacao input -- FIX ME?
    if(m_dminputs) free(m_dminputs);
    m_dminputs = (double*) calloc( m_nbAct, sizeof( double ) );
@@ -379,6 +492,27 @@ int irisaoCtrl::zeroDM()
 }
 
 int irisaoCtrl::commandDM(void * curr_src)
+{
+   double t0 = 0;
+   if(m_hardwareDisable) t0 = mx::sys::get_curr_time();
+   
+   int rv;
+   if(m_batched) rv = commandDMBatched((float *) curr_src);
+   else rv = commandDMPerSegment((float *) curr_src);
+   
+   if(m_hardwareDisable)
+   {
+      double dt = mx::sys::get_curr_time() - t0;
+      std::lock_guard<std::mutex> lock(m_cmdTimeMutex);
+      m_cmdTimeSum += dt;
+      if(dt > m_cmdTimeMax) m_cmdTimeMax = dt;
+      ++m_cmdCount;
+   }
+   
+   return rv;
+}
+
+int irisaoCtrl::commandDMPerSegment(float * curr_src)
 {
    //Based on Alex Rodack's IrisAO script
    SegmentNumber segment = 0; // start at 0 or 1?
@@ -388,7 +522,7 @@ int irisaoCtrl::commandDM(void * curr_src)
 
       // need shmim array formatted in a way that's consistent with this loop
       idx = segment * 3; // may need (segment - 1) if they start counting segments at 1
-      SetMirrorPosition(m_dm, segment, ((float *)curr_src)[idx], ((float *)curr_src)[idx+1], ((float *)curr_src)[idx+2]); // z, xgrad, ygrad
+      SetMirrorPosition(m_dm, segment, curr_src[idx], curr_src[idx+1], curr_src[idx+2]); // z, xgrad, ygrad
    
       // check if the current segment was saturated
       // not sure you can do this here. might need to send the commands first (depends on what this is actually querying)
@@ -396,6 +530,7 @@ int irisaoCtrl::commandDM(void * curr_src)
       GetMirrorPosition(m_dm, segment, &position);
       if (!position.reachable)
       {
+         ++m_nsat;
          m_instSatMap.data()[idx] = 1;
          m_instSatMap.data()[idx+1] = 1;
          m_instSatMap.data()[idx+2] = 1;
@@ -416,6 +551,26 @@ int irisaoCtrl::commandDM(void * curr_src)
    return 0 ;
 }
 
+int irisaoCtrl::commandDMBatched(float * curr_src)
+{
+   const size_t nSeg = m_segments.size();
+   
+   m_nsat += irisaoClipSegments(m_packed.data(), m_packedSat.data(), curr_src, m_limits.data(), nSeg);
+   
+   memcpy(m_instSatMap.data(), m_packedSat.data(), m_nbAct);
+   
+   // The SDK has no multi-segment set, so stage each segment from the packed buffer and send them all at once
+   const float * cmd = m_packed.data();
+   for(size_t n = 0; n < nSeg; ++n)
+   {
+      SetMirrorPosition(m_dm, m_segments[n], cmd[3*n], cmd[3*n+1], cmd[3*n+2]); // z, xgrad, ygrad
+   }
+   
+   MirrorCommand(m_dm, MirrorSendSettings);
+   
+   return 0;
+}
+
 int irisaoCtrl::releaseDM()
 {
    // Safe DM shutdown on interrupt
@@ -452,6 +607,45 @@ int irisaoCtrl::releaseDM()
    return 0;
 }
 
+bool irisaoCtrl::batchedAllowed()
+{
+   return (m_maxPiston > 0 && m_maxTilt > 0);
+}
+
+INDI_NEWCALLBACK_DEFN(irisaoCtrl, m_indiP_batched)(const pcf::IndiProperty &ipRecv)
+{
+   if(ipRecv.getName() != m_indiP_batched.getName())
+   {
+      log<software_error>({__FILE__, __LINE__, "invalid indi property received"});
+      return -1;
+   }
+   
+   if(!ipRecv.find("toggle")) return 0;
+   
+   std::unique_lock<std::mutex> lock(m_indiMutex);
+   
+   if( ipRecv["toggle"].getSwitchState() == pcf::IndiElement::Off)
+   {
+      m_batched = false;
+      indi::updateSwitchIfChanged(m_indiP_batched, "toggle", pcf::IndiElement::Off, m_indiDriver, INDI_IDLE);
+   }
+   
+   if( ipRecv["toggle"].getSwitchState() == pcf::IndiElement::On)
+   {
+      if(!batchedAllowed())
+      {
+         log<text_log>("batched commands require dm.maxPiston and dm.maxTilt", logPrio::LOG_WARNING);
+         indi::updateSwitchIfChanged(m_indiP_batched, "toggle", pcf::IndiElement::Off, m_indiDriver, INDI_IDLE);
+         return 0;
+      }
+      
+      m_batched = true;
+      indi::updateSwitchIfChanged(m_indiP_batched, "toggle", pcf::IndiElement::On, m_indiDriver, INDI_OK);
+   }
+
+   return 0;
+}
+
 } //namespace app
 } //namespace MagAOX
 
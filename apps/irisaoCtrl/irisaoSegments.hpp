@@ -0,0 +1,86 @@
+/** \file irisaoSegments.hpp
+  * \brief Segment command packing and clipping for the IrisAO DM controller
+  *
+  * \ingroup irisaoCtrl_files
+  */
+
+#ifndef irisaoSegments_hpp
+#define irisaoSegments_hpp
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace MagAOX
+{
+namespace app
+{
+
+/// Fill the per-actuator limit vector for a segmented DM.
+/** The actuators are ordered piston, tip, tilt for each segment, matching the shmim layout.
+  * A limit of 0 or less disables clipping of that axis.
+  */
+inline
+void irisaoSegmentLimits( std::vector<float> & lim, ///< [out] the limits, resized to 3*nSeg
+                          size_t nSeg,              ///< [in] the number of segments
+                          float maxPiston,          ///< [in] the maximum absolute piston
+                          float maxTilt             ///< [in] the maximum absolute tip and tilt
+                        )
+{
+   const float big = 3.4e38; //Effectively no limit
+   float lp = (maxPiston > 0) ? maxPiston : big;
+   float lt = (maxTilt > 0) ? maxTilt : big;
+
+   lim.resize(3*nSeg);
+   for(size_t n = 0; n < nSeg; ++n)
+   {
+      lim[3*n] = lp;
+      lim[3*n+1] = lt;
+      lim[3*n+2] = lt;
+   }
+}
+
+/// Clip a packed piston/tip/tilt command and fill the saturation map.
+/** The clip is a single branch-free pass over all 3*nSeg values, which the compiler vectorizes.  A value
+  * which fails the comparison is set to the lower limit and flagged.  If any axis of a
+  * segment is saturated the whole segment is flagged, since the segment's reachable region couples the axes.
+  *
+  * \returns the number of saturated segments
+  */
+inline
+size_t irisaoClipSegments( float * dst,         ///< [out] the clipped command, 3*nSeg long
+                           uint8_t * sat,       ///< [out] the saturation map, 3*nSeg long, 1 if the segment was clipped
+                           const float * src,   ///< [in] the requested command, 3*nSeg long
+                           const float * lim,   ///< [in] the limits, 3*nSeg long, from irisaoSegmentLimits
+                           size_t nSeg          ///< [in] the number of segments
+                         )
+{
+   const size_t N = 3*nSeg;
+
+   for(size_t i = 0; i < N; ++i)
+   {
+      float c = src[i];
+      float l = lim[i];
+      float cl = (c >= -l) ? c : -l;
+      cl = (cl <= l) ? cl : l;
+      dst[i] = cl;
+      sat[i] = (cl != c);
+   }
+
+   size_t nsat = 0;
+   for(size_t n = 0; n < nSeg; ++n)
+   {
+      uint8_t s = sat[3*n] | sat[3*n+1] | sat[3*n+2];
+      sat[3*n] = s;
+      sat[3*n+1] = s;
+      sat[3*n+2] = s;
+      nsat += s;
+   }
+
+   return nsat;
+}
+
+} //namespace app
+} //namespace MagAOX
+
+#endif //irisaoSegments_hpp
@@ -0,0 +1,87 @@
+/** \file irisaoSegments_test.cpp
+  * \brief Catch2 tests for the segment command clipping in the irisaoCtrl app.
+  *
+  * History:
+  */
+#include "../../../tests/catch2/catch.hpp"
+
+#include "../irisaoSegments.hpp"
+
+using namespace MagAOX::app;
+
+namespace irisaoSegments_test 
+{
+
+SCENARIO( "Clipping segment commands", "[irisaoSegments]" )
+{
+   GIVEN("3 segments with piston and tilt limits")
+   {
+      std::vector<float> lim;
+      irisaoSegmentLimits(lim, 3, 1.0, 2.0);
+
+      REQUIRE(lim.size() == 9);
+      REQUIRE(lim[0] == 1.0f);
+      REQUIRE(lim[1] == 2.0f);
+      REQUIRE(lim[2] == 2.0f);
+      REQUIRE(lim[3] == 1.0f);
+
+      float dst[9];
+      uint8_t sat[9];
+
+      WHEN("No segment is beyond the limits")
+      {
+         float src[9] = {0.5, -1.5, 2.0, -1.0, 0, 0, 0.1, 0.2, -0.3};
+
+         size_t nsat = irisaoClipSegments(dst, sat, src, lim.data(), 3);
+
+         REQUIRE(nsat == 0);
+         for(int n = 0; n < 9; ++n)
+         {
+            REQUIRE(dst[n] == src[n]);
+            REQUIRE(sat[n] == 0);
+         }
+      }
+
+      WHEN("One axis of a segment is beyond the limits")
+      {
+         float src[9] = {0.5, -1.5, 2.0, -1.0, 0, -2.5, 1.1, 0.2, -0.3};
+
+         size_t nsat = irisaoClipSegments(dst, sat, src, lim.data(), 3);
+
+         REQUIRE(nsat == 2);
+
+         REQUIRE(dst[5] == -2.0f);
+         REQUIRE(dst[6] == 1.0f);
+         REQUIRE(dst[7] == src[7]);
+
+         //The whole segment is flagged
+         REQUIRE(sat[0] == 0);
+         REQUIRE(sat[3] == 1);
+         REQUIRE(sat[4] == 1);
+         REQUIRE(sat[5] == 1);
+         REQUIRE(sat[6] == 1);
+         REQUIRE(sat[8] == 1);
+      }
+   }
+
+   GIVEN("Limits of 0")
+   {
+      std::vector<float> lim;
+      irisaoSegmentLimits(lim, 1, 0, 0);
+
+      float src[3] = {1e6, -1e6, 3};
+      float dst[3];
+      uint8_t sat[3];
+
+      WHEN("Clipping")
+      {
+         size_t nsat = irisaoClipSegments(dst, sat, src, lim.data(), 1);
+
+         REQUIRE(nsat == 0);
+         REQUIRE(dst[0] == src[0]);
+         REQUIRE(dst[1] == src[1]);
+      }
+   }
+}
+
+} //namespace irisaoSegments_test 
@@ -16,11 +16,57 @@ using namespace mx::improc;
 #include "../../libMagAOX/libMagAOX.hpp" //Note this is included on command line to trigger pch
 #include "../../magaox_git_version.h"
 
+#include "slopeKernel.hpp"
+
 namespace MagAOX
 {
 namespace app
 {
 
+///Get the function pointer for the pwfsSlopes kernel for the data type, number of pupils, and normalization.
+template<typename realT, int imageStructDataT, int normMode>
+realT (*getSlopeKernel(int numPupils))(realT *, const void *, const realT *, const uint32_t *, size_t, size_t, size_t)
+{
+   typedef typename imageStructDataType<imageStructDataT>::type dataT;
+
+   if(numPupils == 3) return &pwfsSlopes<realT, dataT, 3, normMode>;
+   else return &pwfsSlopes<realT, dataT, 4, normMode>;
+}
+
+///Get the function pointer for the pwfsSlopes kernel for the data type, number of pupils, and normalization.
+/**
+  * \returns nullptr if the data type is not supported
+  */
+template<typename realT, int normMode>
+realT (*getSlopeKernel(int imageStructDataT, int numPupils))(realT *, const void *, const realT *, const uint32_t *, size_t, size_t, size_t)
+{
+   switch(imageStructDataT)
+   {
+      case IMAGESTRUCT_UINT8:
+         return getSlopeKernel<realT, IMAGESTRUCT_UINT8, normMode>(numPupils);
+      case IMAGESTRUCT_INT8:
+         return getSlopeKernel<realT, IMAGESTRUCT_INT8, normMode>(numPupils);
+      case IMAGESTRUCT_UINT16:
+         return getSlopeKernel<realT, IMAGESTRUCT_UINT16, normMode>(numPupils);
+      case IMAGESTRUCT_INT16:
+         return getSlopeKernel<realT, IMAGESTRUCT_INT16, normMode>(numPupils);
+      case IMAGESTRUCT_UINT32:
+         return getSlopeKernel<realT, IMAGESTRUCT_UINT32, normMode>(numPupils);
+      case IMAGESTRUCT_INT32:
+         return getSlopeKernel<realT, IMAGESTRUCT_INT32, normMode>(numPupils);
+      case IMAGESTRUCT_UINT64:
+         return getSlopeKernel<realT, IMAGESTRUCT_UINT64, normMode>(numPupils);
+      case IMAGESTRUCT_INT64:
+         return getSlopeKernel<realT, IMAGESTRUCT_INT64, normMode>(numPupils);
+      case IMAGESTRUCT_FLOAT:
+         return getSlopeKernel<realT, IMAGESTRUCT_FLOAT, normMode>(numPupils);
+      case IMAGESTRUCT_DOUBLE:
+         return getSlopeKernel<realT, IMAGESTRUCT_DOUBLE, normMode>(numPupils);
+      default:
+         return nullptr;
+   }
+}
+
 struct darkShmimT 
 {
    static std::string configSection()
@@ -110,6 +156,14 @@ protected:
    
    int m_pupil_buffer {1}; ///< the edge buffer for the pupils, just one applied to all pupils.  Default is 1.
    
+   int m_normMode {SLOPE_NORM_GLOBAL}; ///< The slope normalization, set with "global" or "local" in config.  Default is global.
+
+   int m_slopeThreads {1}; ///< The number of threads calculating slopes, including the framegrabber thread.  Default is 1.
+
+   int m_slopeThreadPrio {2}; ///< Priority of the slope worker threads.  Default is 2.
+
+   std::string m_slopeCpuset; ///< The cpuset to assign the slope worker threads to.  Ignored if empty (the default).
+
    ///@}
 
    sem_t m_smSemaphore; ///< Semaphore used to synchronize the fg thread and the sm thread.
@@ -136,6 +190,51 @@ protected:
    int m_pupil_sx_4; ///< the starting x-coordinate of pupil 4 quadrant, calculated from the pupil center, diameter, and buffer.
    int m_pupil_sy_4; ///< the starting y-coordinate of pupil 4 quadrant, calculated from the pupil center, diameter, and buffer.
    
+   /** \name Slope Calculation
+     * The slopes are calculated from a list of flattened pixel indices for each pupil, computed in configureAcquisition.  The
+     * subapertures can be split across a team of worker threads, with the framegrabber thread doing the first block.
+     * @{
+     */
+
+   std::vector<uint32_t> m_pupilIdx; ///< The pupil pixel indices, see pwfsPupilIndices
+
+   mx::improc::eigenImage<realT> m_zeroDark; ///< An all-zero dark used when no dark of the right size is available.
+
+   ///The slope kernel for the current data type, number of pupils, and normalization.
+   realT (*m_slopeKernel)(realT *, const void *, const realT *, const uint32_t *, size_t, size_t, size_t) {nullptr};
+
+   /// A slope worker thread
+   struct slopeWorker
+   {
+      pwfsSlopeCalc * m_app {nullptr}; ///< The parent app
+      size_t m_k0 {0}; ///< The first subaperture for this thread
+      size_t m_k1 {0}; ///< One past the last subaperture for this thread
+      realT * m_dest {nullptr}; ///< The slopes being calculated
+      const realT * m_dark {nullptr}; ///< The dark for the current frame
+      realT m_flux {0}; ///< The flux in this thread's subapertures, the result of the kernel
+      sem_t m_start; ///< Posted by the framegrabber thread to start a frame
+      bool m_init {true}; ///< Synchronizer for thread startup, to allow priority setting to finish.
+      pid_t m_tid {0}; ///< The thread PID.
+      pcf::IndiProperty m_prop; ///< The property to hold the thread details.
+      std::thread m_thread; ///< The thread
+   };
+
+   std::vector<slopeWorker> m_slopeWorkers; ///< The slope worker threads.  Sized once in appStartup, and never resized.
+
+   size_t m_k1Main {0}; ///< One past the last subaperture calculated by the framegrabber thread.
+
+   sem_t m_slopesDone; ///< Posted by each worker when its block is done.
+
+   size_t m_slopesOwed {0}; ///< Posts to m_slopesDone still owed by workers from a frame which timed out.  Only used by the framegrabber thread.
+
+   ///Thread starter, called by MagAOXApp::threadStart on thread construction.  Calls slopeWorkerExec.
+   static void slopeWorkerStart( slopeWorker * w /**< [in] the worker structure for this thread */);
+
+   /// Execute a slope worker thread
+   void slopeWorkerExec( slopeWorker & w /**< [in] the worker structure for this thread */);
+
+   ///@}
+
 public:
    /// Default c'tor.
    pwfsSlopeCalc();
@@ -278,6 +377,14 @@ void pwfsSlopeCalc::setupConfig()
 
    config.add("pupil.buffer", "", "pupil.buffer", argType::Required, "pupil", "buffer", false, "int", "The edge buffer for the pupils.  Default is 1.");
    
+   config.add("slopes.normMode", "", "slopes.normMode", argType::Required, "slopes", "normMode", false, "string", "The slope normalization.  global: normalize by the mean flux over the pupil.  local: normalize each subaperture by its own flux.  Default is global.");
+
+   config.add("slopes.threads", "", "slopes.threads", argType::Required, "slopes", "threads", false, "int", "The number of threads calculating slopes, including the framegrabber thread.  Default is 1.");
+
+   config.add("slopes.threadPrio", "", "slopes.threadPrio", argType::Required, "slopes", "threadPrio", false, "int", "The real-time priority of the slope worker threads.  Default is 2.");
+
+   config.add("slopes.cpuset", "", "slopes.cpuset", argType::Required, "slopes", "cpuset", false, "string", "The cpuset for the slope worker threads.");
+
    config.add("pupil.numPupils", "", "pupil.numPupils", argType::Required, "pupil", "numPupils", false, "int", "The number of pupils.  Default is 4.  3 is also supported.");
    
    
@@ -316,6 +423,23 @@ int pwfsSlopeCalc::loadConfigImpl( mx::app::appConfigurator & _config )
    config(m_pupil_cy_3, "pupil.cy_3");
    config(m_pupil_cx_4, "pupil.cx_4");
    config(m_pupil_cy_4, "pupil.cy_4");
+
+   std::string normMode = "global";
+   config(normMode, "slopes.normMode");
+   if(normMode == "global") m_normMode = SLOPE_NORM_GLOBAL;
+   else if(normMode == "local") m_normMode = SLOPE_NORM_LOCAL;
+   else
+   {
+      log<text_log>("invalid slopes.normMode (" + normMode + "), using global", logPrio::LOG_ERROR);
+      m_normMode = SLOPE_NORM_GLOBAL;
+   }
+
+   config(m_slopeThreads, "slopes.threads");
+   if(m_slopeThreads < 1) m_slopeThreads = 1;
+
+   config(m_slopeThreadPrio, "slopes.threadPrio");
+   config(m_slopeCpuset, "slopes.cpuset");
+
    return 0;
 }
 
@@ -334,6 +458,32 @@ int pwfsSlopeCalc::appStartup()
       return -1;
    }
    
+   if(sem_init(&m_slopesDone, 0,0) < 0)
+   {
+      log<software_critical>({__FILE__, __LINE__, errno,0, "Initializing slopes done semaphore"});
+      return -1;
+   }
+
+   //The framegrabber thread is one of the team
+   m_slopeWorkers.resize(m_slopeThreads-1);
+   for(size_t n = 0; n < m_slopeWorkers.size(); ++n)
+   {
+      m_slopeWorkers[n].m_app = this;
+
+      if(sem_init(&m_slopeWorkers[n].m_start, 0,0) < 0)
+      {
+         log<software_critical>({__FILE__, __LINE__, errno,0, "Initializing slope worker semaphore"});
+         return -1;
+      }
+
+      if(threadStart( m_slopeWorkers[n].m_thread, m_slopeWorkers[n].m_init, m_slopeWorkers[n].m_tid, m_slopeWorkers[n].m_prop, 
+                         m_slopeThreadPrio, m_slopeCpuset, "slopes" + std::to_string(n), &m_slopeWorkers[n], slopeWorkerStart) < 0)
+      {
+         log<software_error>({__FILE__, __LINE__});
+         return -1;
+      }
+   }
+
    if(shmimMonitorT::appStartup() < 0)
    {
       return log<software_error,-1>({__FILE__, __LINE__});
@@ -394,6 +544,14 @@ int pwfsSlopeCalc::appLogic()
       return log<software_error,-1>({__FILE__,__LINE__});
    }
 
+   for(size_t n = 0; n < m_slopeWorkers.size(); ++n)
+   {
+      if(pthread_tryjoin_np(m_slopeWorkers[n].m_thread.native_handle(),0) == 0)
+      {
+         return log<software_error,-1>({__FILE__, __LINE__, "slope worker thread " + std::to_string(m_slopeWorkers[n].m_tid) + " has exited"});
+      }
+   }
+
    std::unique_lock<std::mutex> lock(m_indiMutex);
    
    if(shmimMonitorT::updateINDI() < 0)
@@ -428,6 +586,20 @@ int pwfsSlopeCalc::appShutdown()
    
    telemeterT::appShutdown();
 
+   for(size_t n = 0; n < m_slopeWorkers.size(); ++n)
+   {
+      if(m_slopeWorkers[n].m_thread.joinable())
+      {
+         try
+         {
+            m_slopeWorkers[n].m_thread.join(); //this will throw if it was already joined
+         }
+         catch(...)
+         {
+         }
+      }
+   }
+
    return 0;
 }
 
@@ -444,6 +616,9 @@ int pwfsSlopeCalc::allocate(const dev::shmimT & dummy)
       m_darkSet = false;
    }
    
+   m_zeroDark.resize(shmimMonitorT::m_width,shmimMonitorT::m_height);
+   m_zeroDark.setZero();
+
    m_reconfig = true;
    
    return 0;
@@ -538,6 +713,48 @@ int pwfsSlopeCalc::configureAcquisition()
    m_pupil_sx_4 = m_pupil_cx_4 - 0.5*m_quadSize;
    m_pupil_sy_4 = m_pupil_cy_4 - 0.5*m_quadSize;
    
+   //The 3 pupil index order is I2, I3, I1 to match the original pupil numbering
+   int sx[4] = {m_pupil_sx_1, m_pupil_sx_2, m_pupil_sx_3, m_pupil_sx_4};
+   int sy[4] = {m_pupil_sy_1, m_pupil_sy_2, m_pupil_sy_3, m_pupil_sy_4};
+   
+   if(pwfsPupilIndices(m_pupilIdx, m_quadSize, sx, sy, m_numPupils, shmimMonitorT::m_width, shmimMonitorT::m_height) < 0)
+   {
+      log<software_error>({__FILE__, __LINE__, "pupils extend outside the image"});
+      lock.unlock();
+      sleep(1);
+      return -1;
+   }
+
+   if(m_normMode == SLOPE_NORM_LOCAL)
+   {
+      m_slopeKernel = getSlopeKernel<realT, SLOPE_NORM_LOCAL>(shmimMonitorT::m_dataType, m_numPupils);
+   }
+   else
+   {
+      m_slopeKernel = getSlopeKernel<realT, SLOPE_NORM_GLOBAL>(shmimMonitorT::m_dataType, m_numPupils);
+   }
+
+   if(m_slopeKernel == nullptr)
+   {
+      log<software_error>({__FILE__, __LINE__, "bad data type"});
+      lock.unlock();
+      sleep(1);
+      return -1;
+   }
+
+   //Split the subapertures into equal contiguous blocks, the framegrabber thread takes the first.
+   size_t nSub = m_quadSize*m_quadSize;
+   size_t nBlock = nSub / m_slopeThreads;
+   m_k1Main = nBlock;
+   for(size_t n = 0; n < m_slopeWorkers.size(); ++n)
+   {
+      m_slopeWorkers[n].m_k0 = (n+1)*nBlock;
+      if(n == m_slopeWorkers.size()-1) m_slopeWorkers[n].m_k1 = nSub;
+      else m_slopeWorkers[n].m_k1 = (n+2)*nBlock;
+   }
+   if(m_slopeWorkers.size() == 0) m_k1Main = nSub;
+
+
    //m_quadSize = shmimMonitorT::m_width/2;
    frameGrabberT::m_width = m_quadSize;
    frameGrabberT::m_height = 2*m_quadSize;
@@ -579,65 +796,126 @@ int pwfsSlopeCalc::acquireAndCheckValid()
 inline
 int pwfsSlopeCalc::loadImageIntoStream(void * dest)
 {
-   //Here is where we do it.
-   Eigen::Map<eigenImage<unsigned short>> pwfsIm( static_cast<unsigned short *>(m_curr_src), shmimMonitorT::m_width, shmimMonitorT::m_height );
-   Eigen::Map<eigenImage<float>> slopesIm(static_cast<float*>(dest), frameGrabberT::m_width, frameGrabberT::m_height );
-   
-   static float sqrt32 = sqrt(3.0)/2;
-   
-   float norm = 0;
-   int N = 0;
-   if(m_numPupils == 3)
+   realT * slopes = static_cast<realT*>(dest);
+   size_t nSub = m_quadSize*m_quadSize;
+
+   //Use the dark only if it matches the WFS image
+   const realT * dark = m_zeroDark.data();
+   if(m_darkSet && m_darkImage.rows() == m_zeroDark.rows() && m_darkImage.cols() == m_zeroDark.cols())
+   {
+      dark = m_darkImage.data();
+   }
+
+   //Collect the late posts from a frame which timed out, so they are not counted for this one.
+   //This also makes sure no worker is still writing the old frame.
+   while(m_slopesOwed > 0)
    {
-      for(int rr=0; rr< m_quadSize; ++rr)
+      timespec ts;
+      if(clock_gettime(CLOCK_REALTIME, &ts) < 0)
       {
-         for(int cc=0; cc< m_quadSize; ++cc)
-         {
-            float I2 = pwfsIm(rr+m_pupil_sx_1,cc+m_pupil_sy_1) - m_darkImage(rr+m_pupil_sx_1,cc+m_pupil_sy_1);
-            float I3 = pwfsIm(rr+m_pupil_sx_2,cc+m_pupil_sy_2) - m_darkImage(rr+m_pupil_sx_2,cc+m_pupil_sy_2);
-            float I1 = pwfsIm(rr+m_pupil_sx_3,cc+m_pupil_sy_3) - m_darkImage(rr+m_pupil_sx_3,cc+m_pupil_sy_3);
-           
-            norm += I1+I2+I3;
-            ++N;
-            
-            slopesIm(rr,cc) = sqrt32*(I2-I3);///norm;
-            slopesIm(rr,cc+m_quadSize) = (I1-0.5*(I2+I3));///norm;
-         }
+         return log<software_critical,-1>({__FILE__,__LINE__,errno,0,"clock_gettime"}); 
+      }
+      ts.tv_sec += 1;
+
+      if(sem_timedwait(&m_slopesDone, &ts) != 0)
+      {
+         return log<software_error,-1>({__FILE__, __LINE__, errno, "timed out waiting for slope workers from a previous frame"});
       }
+      --m_slopesOwed;
    }
-   else
+
+   for(size_t n = 0; n < m_slopeWorkers.size(); ++n)
    {
-   
-      for(int rr=0; rr< m_quadSize; ++rr)
+      m_slopeWorkers[n].m_dest = slopes;
+      m_slopeWorkers[n].m_dark = dark;
+      if(sem_post(&m_slopeWorkers[n].m_start) < 0)
       {
-         for(int cc=0; cc< m_quadSize; ++cc)
-         {
-            float I1 = pwfsIm(rr+m_pupil_sx_1,cc+m_pupil_sy_1) - m_darkImage(rr+m_pupil_sx_1,cc+m_pupil_sy_1);
-            float I2 = pwfsIm(rr+m_pupil_sx_2,cc+m_pupil_sy_2) - m_darkImage(rr+m_pupil_sx_2,cc+m_pupil_sy_2);
-            float I3 = pwfsIm(rr+m_pupil_sx_3,cc+m_pupil_sy_3) - m_darkImage(rr+m_pupil_sx_3,cc+m_pupil_sy_3);
-            float I4 = pwfsIm(rr+m_pupil_sx_4,cc+m_pupil_sy_4) - m_darkImage(rr+m_pupil_sx_4,cc+m_pupil_sy_4);
-         
-            norm += I1+I2+I3+I4;
-            ++N;
-            
-            slopesIm(rr,cc) = ((I1+I3) - (I2+I4));///norm;
-            slopesIm(rr,cc+m_quadSize) = ((I1+I2)-(I3+I4));///norm;
-         }
+         m_slopesOwed = n; //the workers already started will still post
+         return log<software_critical,-1>({__FILE__, __LINE__, errno, 0, "Error posting to semaphore"});
       }
    }
-    
-   norm /= N;
-   for(size_t ii=0; ii< frameGrabberT::m_height; ++ii)
+
+   realT flux = m_slopeKernel(slopes, m_curr_src, dark, m_pupilIdx.data(), nSub, 0, m_k1Main);
+
+   for(size_t n = 0; n < m_slopeWorkers.size(); ++n)
    {
-      for(size_t jj=0; jj < frameGrabberT::m_width; ++jj)
+      timespec ts;
+      if(clock_gettime(CLOCK_REALTIME, &ts) < 0)
       {
-         slopesIm(jj,ii)/=norm;
+         return log<software_critical,-1>({__FILE__,__LINE__,errno,0,"clock_gettime"}); 
       }
+      ts.tv_sec += 1;
+
+      if(sem_timedwait(&m_slopesDone, &ts) != 0)
+      {
+         m_slopesOwed = m_slopeWorkers.size() - n;
+         return log<software_error,-1>({__FILE__, __LINE__, errno, "timed out waiting for slope workers"});
+      }
+   }
+
+   for(size_t n = 0; n < m_slopeWorkers.size(); ++n)
+   {
+      flux += m_slopeWorkers[n].m_flux;
+   }
+
+   if(m_normMode == SLOPE_NORM_GLOBAL)
+   {
+      //Normalize by the mean flux per subaperture
+      pwfsScaleSlopes(slopes, nSub, static_cast<realT>(nSub)/flux);
    }
    
    return 0;
 }
 
+inline
+void pwfsSlopeCalc::slopeWorkerStart( slopeWorker * w )
+{
+   w->m_app->slopeWorkerExec(*w);
+}
+
+inline
+void pwfsSlopeCalc::slopeWorkerExec( slopeWorker & w )
+{
+   w.m_tid = syscall(SYS_gettid);
+   
+   //Wait for the thread starter to finish initializing this thread.
+   while(w.m_init == true && shutdown() == 0)
+   {
+      sleep(1);
+   }
+
+   while(shutdown() == 0)
+   {
+      timespec ts;
+         
+      if(clock_gettime(CLOCK_REALTIME, &ts) < 0)
+      {
+         log<software_critical>({__FILE__,__LINE__,errno,0,"clock_gettime"}); 
+         return;
+      }
+         
+      ts.tv_sec += 1;
+        
+      if(sem_timedwait(&w.m_start, &ts) != 0)
+      {
+         //ETIMEDOUT and EINTR just mean we check for shutdown and wait again.
+         if(errno != ETIMEDOUT && errno != EINTR)
+         {
+            log<software_error>({__FILE__, __LINE__,errno, "sem_timedwait"});
+         }
+         continue;
+      }
+
+      w.m_flux = m_slopeKernel(w.m_dest, m_curr_src, w.m_dark, m_pupilIdx.data(), m_quadSize*m_quadSize, w.m_k0, w.m_k1);
+
+      if(sem_post(&m_slopesDone) < 0)
+      {
+         log<software_critical>({__FILE__, __LINE__, errno, 0, "Error posting to semaphore"});
+         return;
+      }
+   }
+}
+
 inline
 int pwfsSlopeCalc::reconfig()
 {
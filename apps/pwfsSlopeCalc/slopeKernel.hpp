@@ -0,0 +1,165 @@
+/** \file slopeKernel.hpp
+  * \brief Slope calculation kernels for the PWFS Slope Calculator
+  *
+  * \ingroup pwfsSlopeCalc_files
+  */
+
+#ifndef slopeKernel_hpp
+#define slopeKernel_hpp
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+
+namespace MagAOX
+{
+namespace app
+{
+
+#define SLOPE_NORM_GLOBAL (0) ///< Normalize all slopes by the mean flux per subaperture over the pupil
+#define SLOPE_NORM_LOCAL (1)  ///< Normalize the slopes of each subaperture by its own flux
+
+/// Calculate the flattened image indices of each pupil pixel.
+/** The output is ordered by subaperture, with the pixels of the \p numPupils pupils for each
+  * subaperture adjacent, so the slope kernel reads one contiguous index stream.  Subapertures are
+  * in column-major (Eigen) order of the quadSize x quadSize slope image.
+  *
+  * \returns 0 on success
+  * \returns -1 if any pupil extends outside the image, in which case \p idx is not changed.
+  */
+inline
+int pwfsPupilIndices( std::vector<uint32_t> & idx, ///< [out] the pixel indices, resized to numPupils*quadSize*quadSize
+                      int quadSize,                ///< [in] the size of the pupil quadrant, in pixels
+                      const int * sx,              ///< [in] the starting x-coordinates of the pupils, numPupils long
+                      const int * sy,              ///< [in] the starting y-coordinates of the pupils, numPupils long
+                      int numPupils,               ///< [in] the number of pupils
+                      uint32_t width,              ///< [in] the width of the WFS image (the fast index)
+                      uint32_t height              ///< [in] the height of the WFS image
+                    )
+{
+   for(int p = 0; p < numPupils; ++p)
+   {
+      if(sx[p] < 0 || sy[p] < 0 || sx[p] + quadSize > (int) width || sy[p] + quadSize > (int) height) return -1;
+   }
+
+   idx.resize(numPupils*quadSize*quadSize);
+
+   size_t k = 0;
+   for(int cc = 0; cc < quadSize; ++cc)
+   {
+      for(int rr = 0; rr < quadSize; ++rr)
+      {
+         for(int p = 0; p < numPupils; ++p)
+         {
+            idx[k*numPupils + p] = (rr + sx[p]) + (cc + sy[p])*width;
+         }
+         ++k;
+      }
+   }
+
+   return 0;
+}
+
+/// Calculate PWFS slopes for a range of subapertures
+/** Dark subtraction, the slope combination, and for local normalization the division, are done in one pass
+  * through the pupil index list.  The x slopes are written to slopes[k] and the y slopes to slopes[k+nSub].
+  *
+  * For 4 pupils the pupil order is I1, I2, I3, I4.  For 3 pupils the index list holds I2, I3, I1, matching
+  * the order of the pupil center configuration.
+  *
+  * With global normalization the slopes are not normalized, and the returned flux is used by the caller
+  * to scale all slopes after the full set of subapertures is calculated.
+  *
+  * \returns the total dark-subtracted flux in subapertures [k0,k1)
+  *
+  * \tparam realT the floating point type of the calculation
+  * \tparam dataT the type of the image data
+  * \tparam numPupils the number of pupils, 3 or 4
+  * \tparam normMode either SLOPE_NORM_GLOBAL or SLOPE_NORM_LOCAL
+  */
+template<typename realT, typename dataT, int numPupils, int normMode>
+realT pwfsSlopes( realT * slopes,           ///< [out] the slopes, at least 2*nSub long
+                  const void * imdata,      ///< [in] the WFS image
+                  const realT * dark,       ///< [in] the dark image, same size as the WFS image
+                  const uint32_t * idx,     ///< [in] the pupil index list from pwfsPupilIndices
+                  size_t nSub,              ///< [in] the number of subapertures, which is the offset to the y slopes
+                  size_t k0,                ///< [in] the first subaperture to calculate
+                  size_t k1                 ///< [in] one past the last subaperture to calculate
+                )
+{
+   static_assert(numPupils == 3 || numPupils == 4, "pwfsSlopes: numPupils must be 3 or 4");
+
+   const dataT * im = static_cast<const dataT *>(imdata);
+
+   realT * sx = slopes;
+   realT * sy = slopes + nSub;
+
+   static const realT sqrt32 = sqrt(static_cast<realT>(3))/2;
+
+   realT flux = 0;
+
+   for(size_t k = k0; k < k1; ++k)
+   {
+      const uint32_t * i = idx + k*numPupils;
+
+      realT x, y, f;
+
+      if(numPupils == 3)
+      {
+         realT I2 = static_cast<realT>(im[i[0]]) - dark[i[0]];
+         realT I3 = static_cast<realT>(im[i[1]]) - dark[i[1]];
+         realT I1 = static_cast<realT>(im[i[2]]) - dark[i[2]];
+
+         f = I1 + I2 + I3;
+         x = sqrt32*(I2-I3);
+         y = I1 - static_cast<realT>(0.5)*(I2+I3);
+      }
+      else
+      {
+         realT I1 = static_cast<realT>(im[i[0]]) - dark[i[0]];
+         realT I2 = static_cast<realT>(im[i[1]]) - dark[i[1]];
+         realT I3 = static_cast<realT>(im[i[2]]) - dark[i[2]];
+         realT I4 = static_cast<realT>(im[i[3]]) - dark[i[3]];
+
+         f = I1 + I2 + I3 + I4;
+         x = (I1+I3) - (I2+I4);
+         y = (I1+I2) - (I3+I4);
+      }
+
+      flux += f;
+
+      if(normMode == SLOPE_NORM_LOCAL)
+      {
+         //Subapertures with no light are set to 0 rather than dividing by noise
+         realT norm = (f > 0) ? 1/f : 0;
+         x *= norm;
+         y *= norm;
+      }
+
+      sx[k] = x;
+      sy[k] = y;
+   }
+
+   return flux;
+}
+
+/// Scale a range of slopes in place.
+/** Used to apply the global normalization after all subapertures have been calculated.
+  */
+template<typename realT>
+void pwfsScaleSlopes( realT * slopes, ///< [in/out] the slopes
+                      size_t nSub,    ///< [in] the number of subapertures
+                      realT scale     ///< [in] the factor by which to multiply the slopes
+                    )
+{
+   for(size_t k = 0; k < 2*nSub; ++k)
+   {
+      slopes[k] *= scale;
+   }
+}
+
+} //namespace app
+} //namespace MagAOX
+
+#endif //slopeKernel_hpp
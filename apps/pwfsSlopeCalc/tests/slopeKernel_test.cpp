@@ -0,0 +1,91 @@
+/** \file slopeKernel_test.cpp
+  * \brief Catch2 tests for the slope kernels in the pwfsSlopeCalc app.
+  *
+  * History:
+  */
+#include "../../../tests/catch2/catch.hpp"
+
+#include "../slopeKernel.hpp"
+
+using namespace MagAOX::app;
+
+namespace slopeKernel_test 
+{
+
+SCENARIO( "Calculating pupil indices", "[slopeKernel]" )
+{
+   GIVEN("A 10x8 image with 4 2x2 pupils")
+   {
+      int sx[4] = {0, 5, 0, 5};
+      int sy[4] = {0, 0, 4, 4};
+      std::vector<uint32_t> idx;
+
+      WHEN("The pupils are inside the image")
+      {
+         int rv = pwfsPupilIndices(idx, 2, sx, sy, 4, 10, 8);
+
+         REQUIRE(rv == 0);
+         REQUIRE(idx.size() == 16);
+
+         //subaperture 1 is rr=1, cc=0
+         REQUIRE(idx[4*1 + 0] == 1);
+         REQUIRE(idx[4*1 + 1] == 6);
+         REQUIRE(idx[4*1 + 2] == 41);
+         REQUIRE(idx[4*1 + 3] == 46);
+
+         //subaperture 2 is rr=0, cc=1
+         REQUIRE(idx[4*2 + 0] == 10);
+         REQUIRE(idx[4*2 + 3] == 55);
+      }
+
+      WHEN("A pupil extends outside the image")
+      {
+         sx[3] = 9;
+         int rv = pwfsPupilIndices(idx, 2, sx, sy, 4, 10, 8);
+
+         REQUIRE(rv == -1);
+         REQUIRE(idx.size() == 0);
+      }
+   }
+}
+
+SCENARIO( "Calculating slopes", "[slopeKernel]" )
+{
+   GIVEN("A 4 pupil image with a dark")
+   {
+      int sx[4] = {0, 5, 0, 5};
+      int sy[4] = {0, 0, 4, 4};
+      std::vector<uint32_t> idx;
+      pwfsPupilIndices(idx, 2, sx, sy, 4, 10, 8);
+
+      std::vector<uint16_t> im(80);
+      std::vector<float> dark(80, 1.0);
+      for(size_t n = 0; n < im.size(); ++n) im[n] = 2 + n;
+
+      std::vector<float> slopes(8);
+
+      WHEN("Using global normalization, in two blocks")
+      {
+         float flux = pwfsSlopes<float, uint16_t, 4, SLOPE_NORM_GLOBAL>(slopes.data(), im.data(), dark.data(), idx.data(), 4, 0, 1);
+         flux += pwfsSlopes<float, uint16_t, 4, SLOPE_NORM_GLOBAL>(slopes.data(), im.data(), dark.data(), idx.data(), 4, 1, 4);
+
+         //Subaperture 1: I1 = 2, I2 = 7, I3 = 42, I4 = 47
+         REQUIRE(slopes[1] == (2.0f+42.0f) - (7.0f+47.0f));
+         REQUIRE(slopes[4+1] == (2.0f+7.0f) - (42.0f+47.0f));
+
+         float sum = 0;
+         for(size_t n = 0; n < idx.size(); ++n) sum += im[idx[n]] - dark[idx[n]];
+         REQUIRE(flux == sum);
+      }
+
+      WHEN("Using local normalization")
+      {
+         pwfsSlopes<float, uint16_t, 4, SLOPE_NORM_LOCAL>(slopes.data(), im.data(), dark.data(), idx.data(), 4, 0, 4);
+
+         REQUIRE(slopes[1] == Approx(-10.0/98.0));
+         REQUIRE(slopes[4+1] == Approx(-80.0/98.0));
+      }
+   }
+}
+
+} //namespace slopeKernel_test
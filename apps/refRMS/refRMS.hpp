@@ -96,14 +96,46 @@ protected:
 
    ///@}
  
-   mx::improc::eigenImage<realT> m_currRef;
+   uint32_t m_refWidth {0}; ///< The width of the reference images
+   uint32_t m_refHeight {0}; ///< The height of the reference images
+
    mx::improc::eigenImage<realT> m_mask;
    bool m_maskValid {false};
    realT m_maskSum {0};
 
-   mx::sigproc::circularBufferIndex<float, cbIndexT> m_rms;
-   
-   mx::sigproc::circularBufferIndex<float, cbIndexT> m_mean;
+   /** \name Masked Statistics
+     * The mask is converted to a compact list of the unmasked pixels, and their weights, when it is received.
+     * The mean and rms are then calculated in a single pass over those pixels directly from the shared memory.
+     * @{
+     */
+   std::mutex m_maskMutex; ///< Mutex protecting the mask pixel list, which is rebuilt in the mask thread.
+
+   std::vector<uint32_t> m_maskIdx; ///< The linear indices of the pixels with non-zero mask.
+   std::vector<realT> m_maskWeight; ///< The mask value of each pixel in m_maskIdx.
+   double m_maskSum2 {0}; ///< The sum of the squared mask weights.
+   ///@}
+
+   /** \name RMS Averaging
+     * The rms of each frame is stored in a ring buffer, and a running sum is kept for each averaging window.
+     * Each new frame is added to the sums and the frame leaving each window is subtracted, so the averages are O(1) per frame.
+     * @{
+     */
+   std::mutex m_rmsMutex; ///< Mutex protecting the rms ring buffer and window sums
+
+   std::vector<double> m_rmsHist; ///< Ring buffer of the rms of each frame
+   size_t m_rmsHead {0}; ///< The next entry to write in m_rmsHist
+   size_t m_rmsCount {0}; ///< The number of valid entries in m_rmsHist
+
+   static constexpr int c_nWindows = 4; ///< The number of averaging windows
+   const double m_windowSecs[c_nWindows] = {1, 2, 5, 10}; ///< The length of each averaging window in seconds.
+   size_t m_windowLen[c_nWindows] = {0,0,0,0}; ///< The length of each averaging window in frames.
+   double m_windowSum[c_nWindows] = {0,0,0,0}; ///< The running sum of rms in each window.
+
+   /// Recalculate the window sums from the ring buffer to remove accumulated rounding error.
+   /** Must be called with m_rmsMutex locked.
+     */
+   void resumWindows();
+   ///@}
 
    double m_rms_1sec;
    double m_rms_2sec;
@@ -164,6 +196,11 @@ protected:
                      const maskShmimT & dummy ///< [in] tag to differentiate shmimMonitor parents.
                    );
 
+   /// Build the list of unmasked pixels from m_mask.
+   /** Must be called with m_maskMutex locked.
+     */
+   void buildMaskIdx();
+
 
    pcf::IndiProperty m_indiP_refrms;
 
@@ -254,76 +291,23 @@ int refRMS::appLogic()
       return log<software_error,-1>({__FILE__,__LINE__});
    }
 
-   if( m_rms.size() > 0 )
-   {
-      if(m_rms.size() >= m_rms.maxEntries())
-      {
-         cbIndexT refEntry = m_rms.nextEntry();
-
-         m_rms_1sec = 0;
-         if(m_rms.size() > 1.0*m_fps)
-         {
-            int N = 0;
-            for(size_t n=0; n < 1.0*m_fps; ++n)
-            {
-               m_rms_1sec += m_rms[n];
-               ++N;
-            }
-            m_rms_1sec /= N;
-
-            std::cerr << m_rms_1sec << " ";
-
-         }
-
-         m_rms_2sec = 0;
-         if(m_rms.size() > 2.0*m_fps)
-         {
-            int N = 0;
-            for(size_t n=0; n < 2.0*m_fps; ++n)
-            {
-               m_rms_2sec += m_rms[n];
-               ++N;
-            }
-            m_rms_2sec /= N;
-
-            std::cerr << m_rms_2sec << " ";
-         }
-
-         m_rms_5sec = 0;
-         if(m_rms.size() > 5.0*m_fps)
-         {
-            int N = 0;
-            for(size_t n=0; n < 5.0*m_fps; ++n)
-            {
-               m_rms_5sec += m_rms[n];
-               ++N;
-            }
-            m_rms_5sec /= N;
-
-            std::cerr << m_rms_5sec << " ";
-         }
-
-         m_rms_10sec = 0;
-         if(m_rms.size() > 10.0*m_fps)
-         {
-            int N = 0;
-            for(size_t n=0; n < 10.0*m_fps; ++n)
-            {
-               m_rms_10sec += m_rms[n];
-               ++N;
-            }
-            m_rms_10sec /= N;
-
-            std::cerr << m_rms_10sec << " ";
-         }
-
-         std::cerr << "\n";
-
-         updateIfChanged(m_indiP_refrms, std::vector<std::string>({"one_sec","two_sec","five_sec","ten_sec"}), std::vector<double>({m_rms_1sec, m_rms_2sec, m_rms_5sec, m_rms_10sec}));
+   double avgs[c_nWindows];
 
+   {//scope for rms lock
+      std::lock_guard<std::mutex> rmsLock(m_rmsMutex);
+      for(int w = 0; w < c_nWindows; ++w)
+      {
+         if(m_windowLen[w] > 0 && m_rmsCount >= m_windowLen[w]) avgs[w] = m_windowSum[w]/m_windowLen[w];
+         else avgs[w] = 0;
       }
-   }     
+   }
+
+   m_rms_1sec = avgs[0];
+   m_rms_2sec = avgs[1];
+   m_rms_5sec = avgs[2];
+   m_rms_10sec = avgs[3];
 
+   updateIfChanged(m_indiP_refrms, std::vector<std::string>({"one_sec","two_sec","five_sec","ten_sec"}), std::vector<double>({m_rms_1sec, m_rms_2sec, m_rms_5sec, m_rms_10sec}));
 
    std::unique_lock<std::mutex> lock(m_indiMutex);
 
@@ -357,15 +341,20 @@ int refRMS::allocate(const refShmimT & dummy)
   
    std::unique_lock<std::mutex> lock(m_indiMutex);
      
-   m_currRef.resize(refShmimMonitorT::m_width, refShmimMonitorT::m_height);
+   m_refWidth = refShmimMonitorT::m_width;
+   m_refHeight = refShmimMonitorT::m_height;
 
    std::cerr << "got ref: " << refShmimMonitorT::m_width << " " << refShmimMonitorT::m_height << "\n";
 
-   if(m_mask.rows() != m_currRef.rows() || m_mask.cols() != m_currRef.cols())
-   {
-      m_maskValid = false;
-      m_mask.resize(m_currRef.rows(), m_currRef.cols());
-      m_mask.setConstant(1);
+   {//scope for mask lock
+      std::lock_guard<std::mutex> maskLock(m_maskMutex);
+      if(m_mask.rows() != m_refWidth || m_mask.cols() != m_refHeight)
+      {
+         m_maskValid = false;
+         m_mask.resize(m_refWidth, m_refHeight);
+         m_mask.setConstant(1);
+         buildMaskIdx();
+      }
    }
 
    while(m_fps == 0)
@@ -377,9 +366,18 @@ int refRMS::allocate(const refShmimT & dummy)
       }*/
    }
 
-   cbIndexT cbSz = 11 * m_fps;
-   m_mean.maxEntries(cbSz);
-   m_rms.maxEntries(cbSz);
+   std::lock_guard<std::mutex> rmsLock(m_rmsMutex);
+
+   for(int w = 0; w < c_nWindows; ++w)
+   {
+      m_windowLen[w] = m_windowSecs[w] * m_fps;
+      if(m_windowLen[w] < 1) m_windowLen[w] = 1;
+      m_windowSum[w] = 0;
+   }
+
+   m_rmsHist.resize(m_windowLen[c_nWindows-1]+1);
+   m_rmsHead = 0;
+   m_rmsCount = 0;
 
    std::cerr << "allocated\n";
 
@@ -393,30 +391,93 @@ int refRMS::processImage( void * curr_src,
 {
    static_cast<void>(dummy); //be unused
   
-   //Copy it out first so we can afford to be slow and skipping frames 
-   m_currRef = Eigen::Map<Eigen::Matrix<float,-1,-1>>((float *)curr_src,  refShmimMonitorT::m_width, refShmimMonitorT::m_height);//,1);
+   const float * ref = static_cast<const float *>(curr_src);
+
+   double sw = 0;   //sum of w*x
+   double sw2x = 0; //sum of w^2*x
+   double sw2x2 = 0; //sum of w^2*x^2
+   double maskSum; //copies of the mask sums, which change with the mask
+   double maskSum2;
+
+   {//scope for mask lock
+      std::lock_guard<std::mutex> maskLock(m_maskMutex);
+
+      //If mask has changed we skip
+      if(m_mask.rows() != m_refWidth || m_mask.cols() != m_refHeight || m_maskSum == 0)
+      {
+         return 0;
+      }
+
+      const uint32_t * idx = m_maskIdx.data();
+      const realT * wgt = m_maskWeight.data();
+      size_t N = m_maskIdx.size();
+
+      //Single gather pass over the unmasked pixels
+      for(size_t n = 0; n < N; ++n)
+      {
+         double x = ref[idx[n]];
+         double w = wgt[n];
+         double w2x = w*w*x;
+         sw += w*x;
+         sw2x += w2x;
+         sw2x2 += w2x*x;
+      }
+
+      maskSum = m_maskSum;
+      maskSum2 = m_maskSum2;
+   }
+
+   //Same as mean = sum(x*w)/sum(w) and rms = sqrt( sum( ((x-mean)*w)^2 )/sum(w) ), expanded so it takes one pass.
+   double mean = sw/maskSum;
+   double var = (sw2x2 - 2*mean*sw2x + mean*mean*maskSum2)/maskSum;
+   if(var < 0) var = 0;
+   double rms = sqrt(var);
+
+   std::lock_guard<std::mutex> rmsLock(m_rmsMutex);
 
-   //std::cerr << "pi\n";
+   size_t hsz = m_rmsHist.size();
+   if(hsz == 0) return 0;
 
-   //If mask has changed we skip
-   if(m_mask.rows() != m_currRef.rows() || m_mask.cols() != m_currRef.cols())
+   m_rmsHist[m_rmsHead] = rms;
+   if(m_rmsCount < hsz) ++m_rmsCount;
+
+   for(int w = 0; w < c_nWindows; ++w)
    {
-      std::cerr << m_mask.rows() << " " << m_mask.cols() << "\n";
-      std::cerr << m_currRef.rows() << " " << m_currRef.cols() << "\n";
+      m_windowSum[w] += rms;
 
-      return 0;
+      //Remove the entry which just left this window.  hsz is larger than the largest window.
+      if(m_rmsCount > m_windowLen[w])
+      {
+         m_windowSum[w] -= m_rmsHist[(m_rmsHead + hsz - m_windowLen[w]) % hsz];
+      }
    }
 
-   //mult by mask, etc.      
-   float mean = (m_currRef * m_mask).sum()/m_maskSum;
-   float rms = sqrt(((m_currRef - mean)*m_mask).square().sum()/m_maskSum);
+   ++m_rmsHead;
+   if(m_rmsHead >= hsz) 
+   {
+      m_rmsHead = 0;
+      resumWindows(); //Once per pass through the ring buffer
+   }
 
-   m_mean.nextEntry(mean);
-   m_rms.nextEntry(rms);
-   
    return 0;
 }
 
+inline
+void refRMS::resumWindows()
+{
+   size_t hsz = m_rmsHist.size();
+
+   for(int w = 0; w < c_nWindows; ++w)
+   {
+      m_windowSum[w] = 0;
+
+      size_t N = std::min(m_windowLen[w], m_rmsCount);
+      for(size_t n = 1; n <= N; ++n)
+      {
+         m_windowSum[w] += m_rmsHist[(m_rmsHead + hsz - n) % hsz];
+      }
+   }
+}
 
 inline
 int refRMS::allocate(const maskShmimT & dummy)
@@ -427,8 +488,14 @@ int refRMS::allocate(const maskShmimT & dummy)
      
    std::cerr << "got mask: " << maskShmimMonitorT::m_width << " " << maskShmimMonitorT::m_height << "\n";
 
+   std::lock_guard<std::mutex> maskLock(m_maskMutex);
+
    m_mask.resize(maskShmimMonitorT::m_width, maskShmimMonitorT::m_height);
 
+   //Mask values are not known until processImage, so nothing is unmasked yet.
+   m_mask.setZero();
+   buildMaskIdx();
+
    return 0;
 }
 
@@ -439,12 +506,14 @@ int refRMS::processImage( void * curr_src,
 {
    static_cast<void>(dummy); //be unused
   
+   std::lock_guard<std::mutex> maskLock(m_maskMutex);
+
    //copy curr_src to mask
    m_mask = Eigen::Map<Eigen::Matrix<float,-1,-1>>((float *)curr_src,  maskShmimMonitorT::m_width,maskShmimMonitorT::m_height);
 
-   m_maskSum = m_mask.sum();
+   buildMaskIdx();
 
-   if(m_mask.rows() == m_currRef.rows() || m_mask.cols() == m_currRef.cols())
+   if(m_mask.rows() == m_refWidth && m_mask.cols() == m_refHeight)
    {
       m_maskValid = true;
    }
@@ -452,6 +521,28 @@ int refRMS::processImage( void * curr_src,
    return 0;
 }
 
+inline
+void refRMS::buildMaskIdx()
+{
+   m_maskIdx.clear();
+   m_maskWeight.clear();
+
+   m_maskSum = 0;
+   m_maskSum2 = 0;
+
+   const realT * mask = m_mask.data();
+   for(size_t n = 0; n < (size_t) m_mask.size(); ++n)
+   {
+      if(mask[n] != 0)
+      {
+         m_maskIdx.push_back(n);
+         m_maskWeight.push_back(mask[n]);
+         m_maskSum += mask[n];
+         m_maskSum2 += mask[n]*mask[n];
+      }
+   }
+}
+
 INDI_SETCALLBACK_DEFN( refRMS, m_indiP_fpsSource )(const pcf::IndiProperty &ipRecv)
 {
    if( ipRecv.getName() != m_indiP_fpsSource.getName())
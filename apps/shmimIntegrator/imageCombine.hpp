@@ -0,0 +1,96 @@
+/** \file imageCombine.hpp
+  * \brief Pixel combination utilities for the shmimIntegrator
+  *
+  * \ingroup shmimIntegrator_files
+  */
+
+#ifndef imageCombine_hpp
+#define imageCombine_hpp
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+namespace MagAOX
+{
+namespace app
+{
+
+#define COMBINE_MEAN (0)       ///< Combine images with a simple mean
+#define COMBINE_MEDIAN (1)     ///< Combine images with the median of each pixel
+#define COMBINE_SIGMACLIP (2)  ///< Combine images with the sigma-clipped mean of each pixel
+
+/// Calculate the median of a vector, reordering it in place.
+/** Uses std::nth_element, so this is O(N) rather than a full sort.
+  * For an even number of values the two central values are averaged.
+  *
+  * \returns the median of the first \p n values of \p vals
+  */
+template<typename realT>
+realT medianInPlace( std::vector<realT> & vals, ///< [in/out] the values, are reordered on output
+                     size_t n                   ///< [in] the number of values to use, starting at 0.  Must be > 0 and <= vals.size().
+                   )
+{
+   size_t half = n/2;
+   std::nth_element(vals.begin(), vals.begin()+half, vals.begin()+n);
+
+   realT med = vals[half];
+
+   if(n % 2 == 0)
+   {
+      //nth_element leaves everything below half in the lower partition, so the other central value is its max
+      med = 0.5*(med + *std::max_element(vals.begin(), vals.begin()+half));
+   }
+
+   return med;
+}
+
+/// Calculate the sigma-clipped mean of a vector, reordering it in place.
+/** The center and scale are estimated robustly with the median and the median absolute deviation (MAD),
+  * and the mean is then calculated over the values within \p sigma robust standard deviations of the median.
+  * No iteration is performed.  Requires two selections and two passes through the values.
+  *
+  * \p work is used as scratch space, and is resized if needed.
+  *
+  * \returns the sigma-clipped mean of the first \p n values of \p vals
+  */
+template<typename realT>
+realT sigmaClipMeanInPlace( std::vector<realT> & vals, ///< [in/out] the values, are reordered on output
+                            std::vector<realT> & work, ///< [out] working memory for the absolute deviations
+                            size_t n,                  ///< [in] the number of values to use, starting at 0.  Must be > 0 and <= vals.size().
+                            realT sigma                ///< [in] the clipping threshold, in units of the robust standard deviation
+                          )
+{
+   realT med = medianInPlace(vals, n);
+
+   if(work.size() < n) work.resize(n);
+
+   for(size_t k=0; k < n; ++k)
+   {
+      work[k] = fabs(vals[k] - med);
+   }
+
+   //1.4826*MAD is the standard deviation for normally distributed data
+   realT thresh = sigma*static_cast<realT>(1.4826)*medianInPlace(work, n);
+
+   realT sum = 0;
+   size_t nsum = 0;
+   for(size_t k=0; k < n; ++k)
+   {
+      if( fabs(vals[k] - med) <= thresh )
+      {
+         sum += vals[k];
+         ++nsum;
+      }
+   }
+
+   //Can only happen for sigma < 1
+   if(nsum == 0) return med;
+
+   return sum/nsum;
+}
+
+} //namespace app
+} //namespace MagAOX
+
+#endif //imageCombine_hpp
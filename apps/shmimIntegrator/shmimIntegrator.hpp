@@ -8,13 +8,17 @@
 #define shmimIntegrator_hpp
 
 #include <limits>
+#include <deque>
 
 #include <mx/improc/eigenCube.hpp>
 #include <mx/improc/eigenImage.hpp>
+#include <mx/ioutils/fits/fitsFile.hpp>
 
 #include "../../libMagAOX/libMagAOX.hpp" //Note this is included on command line to trigger pch
 #include "../../magaox_git_version.h"
 
+#include "imageCombine.hpp"
+
 namespace MagAOX
 {
 namespace app
@@ -125,10 +129,32 @@ protected:
 
    bool m_fileSaver {false}; ///< Set to true in configuration to have this save and reload files automatically.
 
+   int m_combineMode {COMBINE_MEAN}; ///< The image combination method.  Set with "mean", "median", or "sigmaclip" in config.  Default is mean.
+
+   realT m_sigmaClip {3}; ///< The threshold, in robust standard deviations, for sigma-clipped combination.  Default 3.
+
+   unsigned m_resumInterval {1000}; ///< The number of frames between full re-sums of the running sum in moving-average mean mode, to bound accumulated rounding error.  Default 1000.
+
+   unsigned m_saveQueueSize {4}; ///< The maximum number of images waiting to be written to disk.  Further images are dropped.  Default 4.
+
+   unsigned m_saveThreads {1}; ///< The number of file writing threads, which allows several images to be written in parallel.  Default 1.
+
+   int m_saveThreadPrio {0}; ///< Priority of the file writing threads.  Default 0.
+
    ///@}
 
    mx::improc::eigenCube<realT> m_accumImages; ///< Cube used to accumulate images
    
+   mx::improc::eigenImage<double> m_runningSum; ///< The running sum of the images in m_accumImages, used for the moving average in mean mode.
+
+   size_t m_sinceResum {0}; ///< Frames added to m_runningSum since the last full re-sum.
+
+   int m_activeCombineMode {COMBINE_MEAN}; ///< The combination mode in use, set from m_combineMode in allocate so that it only changes on restart.
+
+   std::vector<realT> m_combineVals; ///< Working memory for the values of one pixel for median and sigma-clipped combination.
+
+   std::vector<realT> m_combineWork; ///< Working memory for sigma-clipped combination.
+   
    mx::improc::eigenImage<realT> m_avgImage; ///< The average image.
 
    unsigned m_nAverage {10};
@@ -165,7 +191,65 @@ protected:
    bool m_dark2Valid {false};
    realT (*dark2_pixget)(void *, size_t) {nullptr}; ///< Pointer to a function to extract the image data as our desired type realT.
    
-   
+   /** \name File Saving
+     * Images are written to disk by one or more file writing threads, so that slow disks do not
+     * stall the shmimMonitor thread.  The stream thread copies the average into a free buffer
+     * from a fixed pool and queues it.  If no buffer is free the image is dropped.
+     * @{
+     */
+
+   /// A pooled buffer holding an image and its metadata waiting to be written.
+   struct fileSaveSlot
+   {
+      mx::improc::eigenImage<realT> m_image; ///< The image to write
+      std::string m_fname;                   ///< The full path of the file to write
+      std::string m_stateString;             ///< The state string at the time of acquisition
+      unsigned m_nAverage {0};               ///< The number of frames averaged
+   };
+
+   std::vector<fileSaveSlot> m_saveSlots; ///< The pool of buffers, allocated in appStartup.
+
+   std::vector<size_t> m_saveFree; ///< Indices into m_saveSlots of the free buffers.
+
+   std::deque<size_t> m_savePending; ///< Indices into m_saveSlots of the buffers waiting to be written, in order.
+
+   std::mutex m_saveMutex; ///< Mutex for the free and pending lists and the counters.
+
+   sem_t m_saveSemaphore {0}; ///< Semaphore posted once for each queued image.
+
+   uint64_t m_savesQueued {0}; ///< The number of images queued for writing.
+   uint64_t m_savesWritten {0}; ///< The number of images written.
+   uint64_t m_savesDropped {0}; ///< The number of images dropped because the queue was full.
+   uint64_t m_savesFailed {0}; ///< The number of images which failed to write.
+
+   /// A file writing thread
+   struct fileSaveThread
+   {
+      shmimIntegrator * m_app {nullptr}; ///< The parent app
+      bool m_init {true}; ///< Synchronizer for thread startup, to allow priority setting to finish.
+      pid_t m_tid {0}; ///< The thread PID.
+      pcf::IndiProperty m_prop; ///< The property to hold the thread details.
+      std::thread m_thread; ///< The thread
+   };
+
+   std::vector<fileSaveThread> m_saveThreadPool; ///< The file writing threads.  Sized once in appStartup, and never resized.
+
+   ///Thread starter, called by MagAOXApp::threadStart on thread construction.  Calls fileSaveThreadExec.
+   static void fileSaveThreadStart( fileSaveThread * t /**< [in] the thread structure for this thread */);
+
+   /// Execute a file writing thread
+   void fileSaveThreadExec( fileSaveThread & t /**< [in] the thread structure for this thread */);
+
+   /// Queue the current average image to be written to disk.
+   /** Called from the shmimMonitor thread.  Never blocks on disk I/O.
+     *
+     * \returns 0 on success, including if the image was dropped because the queue was full
+     * \returns -1 on error
+     */
+   int queueFileSave( const std::string & fname /**< [in] the full path of the file to write*/);
+
+   ///@}
+
 public:
    /// Default c'tor.
    shmimIntegrator();
@@ -224,6 +308,16 @@ protected:
 
    int findMatchingDark();
 
+   /// Recalculate the running sum from scratch from the images in m_accumImages
+   /** Called periodically to prevent accumulation of rounding errors in the running sum.
+     */
+   void resumAccum();
+
+   /// Combine the first \p nPlanes images in m_accumImages into m_avgImage with the median or sigma-clipped mean.
+   /** The combination method is set by m_activeCombineMode, which should not be COMBINE_MEAN.
+     */
+   void combineAccum( size_t nPlanes /**< [in] the number of planes to combine*/);
+
 
    /** \name dev::frameGrabber interface
      *
@@ -284,10 +378,13 @@ protected:
    
    pcf::IndiProperty m_indiP_startAveraging;
    
+   pcf::IndiProperty m_indiP_combineMode;
+
    INDI_NEWCALLBACK_DECL(shmimIntegrator, m_indiP_nAverage);
    INDI_NEWCALLBACK_DECL(shmimIntegrator, m_indiP_avgTime);
    INDI_NEWCALLBACK_DECL(shmimIntegrator, m_indiP_nUpdate);
    INDI_NEWCALLBACK_DECL(shmimIntegrator, m_indiP_startAveraging);
+   INDI_NEWCALLBACK_DECL(shmimIntegrator, m_indiP_combineMode);
 
    pcf::IndiProperty m_indiP_fpsSource;
    INDI_SETCALLBACK_DECL(shmimIntegrator, m_indiP_fpsSource);
@@ -297,6 +394,8 @@ protected:
 
    pcf::IndiProperty m_indiP_imageValid;
 
+   pcf::IndiProperty m_indiP_fileSaves; ///< Counters for the file writing queue
+
    /** \name Telemeter Interface
      * 
      * @{
@@ -339,6 +438,13 @@ void shmimIntegrator::setupConfig()
    config.add("integrator.stateSource", "", "integrator.stateSource", argType::Required, "integrator", "stateSource", false, "string", "///< Device name for getting the state string for file management.  This device should have *.state_string.current.");
    config.add("integrator.fileSaver", "", "integrator.fileSaver", argType::Required, "integrator", "fileSaver", false, "bool", "Flag controlling whether this saves and reloads files automatically.  Default false.");
 
+   config.add("integrator.combineMode", "", "integrator.combineMode", argType::Required, "integrator", "combineMode", false, "string", "The image combination method: mean, median, or sigmaclip.  Default mean. Can be changed via INDI.");
+   config.add("integrator.sigmaClip", "", "integrator.sigmaClip", argType::Required, "integrator", "sigmaClip", false, "float", "The clipping threshold, in robust standard deviations, for sigmaclip combination.  Default 3.");
+   config.add("integrator.saveQueueSize", "", "integrator.saveQueueSize", argType::Required, "integrator", "saveQueueSize", false, "unsigned", "The maximum number of images waiting to be written to disk.  Default 4.");
+   config.add("integrator.saveThreads", "", "integrator.saveThreads", argType::Required, "integrator", "saveThreads", false, "unsigned", "The number of threads writing files, which allows several images to be written in parallel.  Default 1.");
+   config.add("integrator.saveThreadPrio", "", "integrator.saveThreadPrio", argType::Required, "integrator", "saveThreadPrio", false, "int", "The real-time priority of the file writing threads.  Default 0.");
+   config.add("integrator.resumInterval", "", "integrator.resumInterval", argType::Required, "integrator", "resumInterval", false, "unsigned", "Number of frames between full re-sums of the moving average running sum.  Default 1000.");
+
    
 }
 
@@ -366,6 +472,29 @@ int shmimIntegrator::loadConfigImpl( mx::app::appConfigurator & _config )
    _config(m_stateSource, "integrator.stateSource");
    _config(m_fileSaver, "integrator.fileSaver");
 
+   std::string combineMode = "mean";
+   _config(combineMode, "integrator.combineMode");
+   if(combineMode == "mean") m_combineMode = COMBINE_MEAN;
+   else if(combineMode == "median") m_combineMode = COMBINE_MEDIAN;
+   else if(combineMode == "sigmaclip") m_combineMode = COMBINE_SIGMACLIP;
+   else
+   {
+      log<text_log>("invalid combineMode (" + combineMode + "), using mean", logPrio::LOG_ERROR);
+      m_combineMode = COMBINE_MEAN;
+   }
+
+   _config(m_sigmaClip, "integrator.sigmaClip");
+   _config(m_resumInterval, "integrator.resumInterval");
+   if(m_resumInterval == 0) m_resumInterval = 1;
+
+   _config(m_saveQueueSize, "integrator.saveQueueSize");
+   if(m_saveQueueSize == 0) m_saveQueueSize = 1;
+
+   _config(m_saveThreads, "integrator.saveThreads");
+   if(m_saveThreads == 0) m_saveThreads = 1;
+
+   _config(m_saveThreadPrio, "integrator.saveThreadPrio");
+
    return 0;
 }
 
@@ -416,6 +545,17 @@ int shmimIntegrator::appStartup()
       return -1;
    }
    
+   createStandardIndiSelectionSw( m_indiP_combineMode, "combine_mode", {"mean", "median", "sigmaclip"}, "Combination Mode");
+   m_indiP_combineMode["mean"].set( m_combineMode == COMBINE_MEAN ? pcf::IndiElement::On : pcf::IndiElement::Off);
+   m_indiP_combineMode["median"].set( m_combineMode == COMBINE_MEDIAN ? pcf::IndiElement::On : pcf::IndiElement::Off);
+   m_indiP_combineMode["sigmaclip"].set( m_combineMode == COMBINE_SIGMACLIP ? pcf::IndiElement::On : pcf::IndiElement::Off);
+
+   if( registerIndiPropertyNew( m_indiP_combineMode, INDI_NEWCALLBACK(m_indiP_combineMode)) < 0)
+   {
+      log<software_error>({__FILE__,__LINE__});
+      return -1;
+   }
+
    if(m_fpsSource != "")
    {
       REG_INDI_SETPROP(m_indiP_fpsSource, m_fpsSource, std::string("fps"));
@@ -457,6 +597,45 @@ int shmimIntegrator::appStartup()
             return -1;
          }
       }
+
+      createROIndiNumber( m_indiP_fileSaves, "file_saves", "File Saves", "Image");
+      indi::addNumberElement<uint64_t>( m_indiP_fileSaves, "queued", 0, std::numeric_limits<uint64_t>::max(), 1, "%lu");
+      indi::addNumberElement<uint64_t>( m_indiP_fileSaves, "written", 0, std::numeric_limits<uint64_t>::max(), 1, "%lu");
+      indi::addNumberElement<uint64_t>( m_indiP_fileSaves, "dropped", 0, std::numeric_limits<uint64_t>::max(), 1, "%lu");
+      indi::addNumberElement<uint64_t>( m_indiP_fileSaves, "failed", 0, std::numeric_limits<uint64_t>::max(), 1, "%lu");
+      indi::addNumberElement<uint64_t>( m_indiP_fileSaves, "pending", 0, std::numeric_limits<uint64_t>::max(), 1, "%lu");
+
+      if( registerIndiPropertyReadOnly( m_indiP_fileSaves ) < 0)
+      {
+         log<software_error>({__FILE__,__LINE__});
+         return -1;
+      }
+
+      if(sem_init(&m_saveSemaphore, 0,0) < 0)
+      {
+         log<software_critical>({__FILE__, __LINE__, errno,0, "Initializing file save semaphore"});
+         return -1;
+      }
+
+      m_saveSlots.resize(m_saveQueueSize);
+      m_saveFree.clear();
+      for(size_t n = 0; n < m_saveSlots.size(); ++n)
+      {
+         m_saveFree.push_back(n);
+      }
+
+      m_saveThreadPool.resize(m_saveThreads);
+      for(size_t n = 0; n < m_saveThreadPool.size(); ++n)
+      {
+         m_saveThreadPool[n].m_app = this;
+
+         if(threadStart( m_saveThreadPool[n].m_thread, m_saveThreadPool[n].m_init, m_saveThreadPool[n].m_tid, m_saveThreadPool[n].m_prop, 
+                            m_saveThreadPrio, "", "filesave" + std::to_string(n), &m_saveThreadPool[n], fileSaveThreadStart) < 0)
+         {
+            log<software_error>({__FILE__, __LINE__});
+            return -1;
+         }
+      }
    }
 
 
@@ -546,6 +725,31 @@ int shmimIntegrator::appLogic()
       log<software_error>({__FILE__, __LINE__});
    }
 
+   if(m_saveThreadPool.size() > 0)
+   {
+      for(size_t n = 0; n < m_saveThreadPool.size(); ++n)
+      {
+         if(pthread_tryjoin_np(m_saveThreadPool[n].m_thread.native_handle(),0) == 0)
+         {
+            log<software_error>({__FILE__, __LINE__, "file save thread " + std::to_string(m_saveThreadPool[n].m_tid) + " has exited"});
+            return -1;
+         }
+      }
+
+      uint64_t queued, written, dropped, failed, pending;
+      
+      {//scope for save lock
+         std::lock_guard<std::mutex> saveLock(m_saveMutex);
+         queued = m_savesQueued;
+         written = m_savesWritten;
+         dropped = m_savesDropped;
+         failed = m_savesFailed;
+         pending = m_savePending.size();
+      }
+
+      updateIfChanged(m_indiP_fileSaves, {"queued", "written", "dropped", "failed", "pending"}, std::vector<uint64_t>({queued, written, dropped, failed, pending}));
+   }
+
    if(m_running == false)
    {
       state(stateCodes::READY);
@@ -586,6 +790,10 @@ int shmimIntegrator::appLogic()
    updateIfChanged(m_indiP_nUpdate, "current", m_nUpdate, INDI_IDLE);
    updateIfChanged(m_indiP_nUpdate, "target", m_nUpdate, INDI_IDLE);
    
+   updateSwitchIfChanged(m_indiP_combineMode, "mean", m_combineMode == COMBINE_MEAN ? pcf::IndiElement::On : pcf::IndiElement::Off, INDI_IDLE);
+   updateSwitchIfChanged(m_indiP_combineMode, "median", m_combineMode == COMBINE_MEDIAN ? pcf::IndiElement::On : pcf::IndiElement::Off, INDI_IDLE);
+   updateSwitchIfChanged(m_indiP_combineMode, "sigmaclip", m_combineMode == COMBINE_SIGMACLIP ? pcf::IndiElement::On : pcf::IndiElement::Off, INDI_IDLE);
+
    return 0;
 }
 
@@ -602,6 +810,20 @@ int shmimIntegrator::appShutdown()
    
    telemeterT::appShutdown();
 
+   for(size_t n = 0; n < m_saveThreadPool.size(); ++n)
+   {
+      if(m_saveThreadPool[n].m_thread.joinable())
+      {
+         try
+         {
+            m_saveThreadPool[n].m_thread.join(); //this will throw if it was already joined
+         }
+         catch(...)
+         {
+         }
+      }
+   }
+
    return 0;
 }
 
@@ -632,7 +854,10 @@ int shmimIntegrator::allocate(const dev::shmimT & dummy)
       }
    }
 
-   if(m_nUpdate > 0)
+   m_activeCombineMode = m_combineMode;
+
+   //The cube is needed for the moving average, and to hold the frames for median and sigma-clipped combination
+   if(m_nUpdate > 0 || m_activeCombineMode != COMBINE_MEAN)
    {
       m_accumImages.resize(shmimMonitorT::m_width, shmimMonitorT::m_height, m_nAverage);
       m_accumImages.setZero();
@@ -642,9 +867,26 @@ int shmimIntegrator::allocate(const dev::shmimT & dummy)
       m_accumImages.resize(1,1,1);
    }
    
+   if(m_nUpdate > 0 && m_activeCombineMode == COMBINE_MEAN)
+   {
+      m_runningSum.resize(shmimMonitorT::m_width, shmimMonitorT::m_height);
+      m_runningSum.setZero(); //matches the zeroed cube
+   }
+   else
+   {
+      m_runningSum.resize(1,1);
+   }
+
+   if(m_activeCombineMode != COMBINE_MEAN)
+   {
+      m_combineVals.resize(m_nAverage);
+      m_combineWork.resize(m_nAverage);
+   }
+
    m_nprocessed = 0;
    m_currImage = 0;
    m_sinceUpdate = 0;
+   m_sinceResum = 0;
    
    m_avgImage.resize(shmimMonitorT::m_width, shmimMonitorT::m_height);
    //m_avgImage.setZero();
@@ -703,18 +945,40 @@ int shmimIntegrator::processImage( void * curr_src,
    if(m_nUpdate == 0)
    {
       if(m_updated) return 0;
-      if(m_sinceUpdate == 0) m_avgImage.setZero();
       
-      realT * data = m_avgImage.data();
+      if(m_activeCombineMode == COMBINE_MEAN)
+      {
+         if(m_sinceUpdate == 0) m_avgImage.setZero();
+      
+         realT * data = m_avgImage.data();
       
-      for(unsigned nn=0; nn < shmimMonitorT::m_width*shmimMonitorT::m_height; ++nn)
+         for(unsigned nn=0; nn < shmimMonitorT::m_width*shmimMonitorT::m_height; ++nn)
+         {
+            data[nn] += pixget(curr_src, nn);
+         }
+      }
+      else
       {
-         data[nn] += pixget(curr_src, nn);
+         //Store the frame for combination at the end
+         realT * data = m_accumImages.image(m_sinceUpdate).data();
+      
+         for(unsigned nn=0; nn < shmimMonitorT::m_width*shmimMonitorT::m_height; ++nn)
+         {
+            data[nn] = pixget(curr_src, nn);
+         }
       }
+
       ++m_sinceUpdate;
       if(m_sinceUpdate >= m_nAverage)
       {
-         m_avgImage /= m_nAverage; ///\todo should this be /= m_sinceUpdate?
+         if(m_activeCombineMode == COMBINE_MEAN)
+         {
+            m_avgImage /= m_nAverage; ///\todo should this be /= m_sinceUpdate?
+         }
+         else
+         {
+            combineAccum(m_nAverage);
+         }
          
          if((m_darkSet && m_darkValid) && !(m_dark2Set && m_dark2Valid))
          {
@@ -757,8 +1021,7 @@ int shmimIntegrator::processImage( void * curr_src,
                   m_imageValid = true;
                   m_stateStringChanged=false;
 
-                  ///\todo this should happen in a different less-real-time thread.
-                  //Otherwise we save:
+                  //Otherwise we queue it for saving:
                   timespec fts;
                   clock_gettime(CLOCK_REALTIME, &fts);
          
@@ -782,9 +1045,10 @@ int shmimIntegrator::processImage( void * curr_src,
    
                   std::string fname = m_fileSaveDir + "/" + m_configName + "_" + m_stateString + "__T" + cts + ".fits";  
                   
-                  mx::fits::fitsFile<float> ff;
-                  ff.write(fname, m_avgImage);
-                  log<text_log>("Wrote " + fname);
+                  if(queueFileSave(fname) < 0)
+                  {
+                     log<software_error>({__FILE__, __LINE__});
+                  }
 
                }   
             }
@@ -795,10 +1059,29 @@ int shmimIntegrator::processImage( void * curr_src,
    {
       realT * data = m_accumImages.image(m_currImage).data();
       
-      for(unsigned nn=0; nn < shmimMonitorT::m_width*shmimMonitorT::m_height; ++nn)
+      if(m_activeCombineMode == COMBINE_MEAN)
       {
-         data[nn] = pixget(curr_src, nn);
+         //Replace the oldest frame in the running sum with the new one.  
+         //Until burned in the slot is still zero from allocate, so this is just an add.
+         double * sum = m_runningSum.data();
+
+         for(unsigned nn=0; nn < shmimMonitorT::m_width*shmimMonitorT::m_height; ++nn)
+         {
+            realT val = pixget(curr_src, nn);
+            sum[nn] += static_cast<double>(val) - data[nn];
+            data[nn] = val;
+         }
+
+         ++m_sinceResum;
+      }
+      else
+      {
+         for(unsigned nn=0; nn < shmimMonitorT::m_width*shmimMonitorT::m_height; ++nn)
+         {
+            data[nn] = pixget(curr_src, nn);
+         }
       }
+
       ++m_nprocessed;
       ++m_currImage;
       if(m_currImage >= m_nAverage) m_currImage = 0;
@@ -816,19 +1099,26 @@ int shmimIntegrator::processImage( void * curr_src,
          {
             return 0; //In case f.g. thread is behind, we skip and come back.
          }
-         //Don't use eigenCube functions to avoid any omp 
-         m_avgImage.setZero();
-         for(size_t n =0; n < m_nAverage; ++n)
+         if(m_activeCombineMode == COMBINE_MEAN)
          {
-            for(size_t ii=0; ii< shmimMonitorT::m_width; ++ii)
+            if(m_sinceResum >= m_resumInterval)
             {
-               for(size_t jj=0; jj< shmimMonitorT::m_height; ++jj)
-               {
-                  m_avgImage(ii,jj) += m_accumImages.image(n)(ii,jj);
-               }
+               resumAccum();
+            }
+
+            const double * sum = m_runningSum.data();
+            realT * avg = m_avgImage.data();
+            double norm = 1.0/m_nAverage;
+
+            for(unsigned nn=0; nn < shmimMonitorT::m_width*shmimMonitorT::m_height; ++nn)
+            {
+               avg[nn] = sum[nn]*norm;
             }
          }
-         m_avgImage /= m_nAverage;
+         else
+         {
+            combineAccum(m_nAverage);
+         }
          
          if(m_darkValid && m_darkSet)
          {
@@ -851,6 +1141,190 @@ int shmimIntegrator::processImage( void * curr_src,
    return 0;
 }
 
+inline
+int shmimIntegrator::queueFileSave( const std::string & fname )
+{
+   std::unique_lock<std::mutex> saveLock(m_saveMutex);
+
+   if(m_saveFree.size() == 0)
+   {
+      ++m_savesDropped;
+      saveLock.unlock();
+
+      log<text_log>("file save queue full, dropping " + fname, logPrio::LOG_WARNING);
+      return 0;
+   }
+
+   size_t idx = m_saveFree.back();
+   m_saveFree.pop_back();
+
+   //The slot is ours until it is pending, so copy without the lock.
+   saveLock.unlock();
+
+   m_saveSlots[idx].m_image = m_avgImage; //Only allocates if the size changed
+   m_saveSlots[idx].m_fname = fname;
+   m_saveSlots[idx].m_stateString = m_stateString;
+   m_saveSlots[idx].m_nAverage = m_nAverage;
+
+   saveLock.lock();
+   m_savePending.push_back(idx);
+   ++m_savesQueued;
+   saveLock.unlock();
+
+   if(sem_post(&m_saveSemaphore) < 0)
+   {
+      return log<software_critical,-1>({__FILE__, __LINE__, errno, 0, "Error posting to file save semaphore"});
+   }
+
+   return 0;
+}
+
+inline
+void shmimIntegrator::fileSaveThreadStart( fileSaveThread * t )
+{
+   t->m_app->fileSaveThreadExec(*t);
+}
+
+inline
+void shmimIntegrator::fileSaveThreadExec( fileSaveThread & t )
+{
+   t.m_tid = syscall(SYS_gettid);
+   
+   //Wait for the thread starter to finish initializing this thread.
+   while(t.m_init == true && shutdown() == 0)
+   {
+      sleep(1);
+   }
+
+   while(shutdown() == 0)
+   {
+      timespec ts;
+         
+      if(clock_gettime(CLOCK_REALTIME, &ts) < 0)
+      {
+         log<software_critical>({__FILE__,__LINE__,errno,0,"clock_gettime"}); 
+         return;
+      }
+         
+      ts.tv_sec += 1;
+        
+      if(sem_timedwait(&m_saveSemaphore, &ts) != 0)
+      {
+         //ETIMEDOUT and EINTR just mean we check for shutdown and wait again.
+         if(errno != ETIMEDOUT && errno != EINTR)
+         {
+            log<software_error>({__FILE__, __LINE__,errno, "sem_timedwait"});
+         }
+         continue;
+      }
+
+      size_t idx;
+
+      {//scope for save lock
+         std::lock_guard<std::mutex> saveLock(m_saveMutex);
+         if(m_savePending.size() == 0) continue;
+         idx = m_savePending.front();
+         m_savePending.pop_front();
+      }
+
+      fileSaveSlot & slot = m_saveSlots[idx];
+
+      mx::fits::fitsHeader head;
+      head.append("STATESTR", slot.m_stateString, "state string during acquisition");
+      head.append("NAVERAGE", slot.m_nAverage, "number of frames averaged");
+
+      //Write to a temporary name and rename, so findMatchingDark never sees a partial file.
+      std::string tmpName = slot.m_fname + ".tmp";
+
+      bool failed = false;
+      
+      try
+      {
+         mx::fits::fitsFile<float> ff;
+         if(ff.write(tmpName, slot.m_image, head) < 0)
+         {
+            log<software_error>({__FILE__, __LINE__, "fits write failed for " + tmpName});
+            failed = true;
+         }
+      }
+      catch(...)
+      {
+         failed = true;
+      }
+
+      if(failed) unlink(tmpName.c_str()); //don't leave a partial file behind
+
+      //rename also fails if the write did not produce a file
+      if(!failed && rename(tmpName.c_str(), slot.m_fname.c_str()) < 0)
+      {
+         log<software_error>({__FILE__, __LINE__, errno, "rename failed for " + slot.m_fname});
+         failed = true;
+      }
+
+      if(failed)
+      {
+         log<software_error>({__FILE__, __LINE__, "failed to write " + slot.m_fname});
+      }
+      else
+      {
+         log<text_log>("Wrote " + slot.m_fname);
+      }
+
+      std::lock_guard<std::mutex> saveLock(m_saveMutex);
+      m_saveFree.push_back(idx);
+      if(failed) ++m_savesFailed;
+      else ++m_savesWritten;
+   }
+}
+
+inline
+void shmimIntegrator::resumAccum()
+{
+   //Don't use eigenCube functions to avoid any omp 
+   size_t npix = shmimMonitorT::m_width*shmimMonitorT::m_height;
+   
+   double * sum = m_runningSum.data();
+   
+   for(size_t nn=0; nn < npix; ++nn) sum[nn] = 0;
+
+   for(size_t n =0; n < m_nAverage; ++n)
+   {
+      const realT * data = m_accumImages.image(n).data();
+      for(size_t nn=0; nn < npix; ++nn)
+      {
+         sum[nn] += data[nn];
+      }
+   }
+
+   m_sinceResum = 0;
+}
+
+inline
+void shmimIntegrator::combineAccum( size_t nPlanes )
+{
+   size_t npix = shmimMonitorT::m_width*shmimMonitorT::m_height;
+
+   const realT * cube = m_accumImages.data();
+   realT * avg = m_avgImage.data();
+
+   for(size_t nn=0; nn < npix; ++nn)
+   {
+      for(size_t n=0; n < nPlanes; ++n)
+      {
+         m_combineVals[n] = cube[n*npix + nn];
+      }
+
+      if(m_activeCombineMode == COMBINE_SIGMACLIP)
+      {
+         avg[nn] = sigmaClipMeanInPlace(m_combineVals, m_combineWork, nPlanes, m_sigmaClip);
+      }
+      else
+      {
+         avg[nn] = medianInPlace(m_combineVals, nPlanes);
+      }
+   }
+}
+
 inline
 int shmimIntegrator::allocate(const darkShmimT & dummy)
 {
@@ -1230,6 +1704,61 @@ INDI_NEWCALLBACK_DEFN(shmimIntegrator, m_indiP_startAveraging)(const pcf::IndiPr
    return 0;
 }
 
+INDI_NEWCALLBACK_DEFN(shmimIntegrator, m_indiP_combineMode)(const pcf::IndiProperty &ipRecv)
+{
+   if(ipRecv.getName() != m_indiP_combineMode.getName())
+   {
+      log<software_error>({__FILE__, __LINE__, "invalid indi property received"});
+      return -1;
+   }
+   
+   int combineMode = -1;
+   std::string modeName;
+
+   if(ipRecv.find("mean"))
+   {
+      if(ipRecv["mean"].getSwitchState() == pcf::IndiElement::On)
+      {
+         combineMode = COMBINE_MEAN;
+         modeName = "mean";
+      }
+   }
+
+   if(ipRecv.find("median"))
+   {
+      if(ipRecv["median"].getSwitchState() == pcf::IndiElement::On)
+      {
+         combineMode = COMBINE_MEDIAN;
+         modeName = "median";
+      }
+   }
+
+   if(ipRecv.find("sigmaclip"))
+   {
+      if(ipRecv["sigmaclip"].getSwitchState() == pcf::IndiElement::On)
+      {
+         combineMode = COMBINE_SIGMACLIP;
+         modeName = "sigmaclip";
+      }
+   }
+
+   if(combineMode < 0 || combineMode == m_combineMode) return 0;
+
+   std::unique_lock<std::mutex> lock(m_indiMutex);
+
+   m_combineMode = combineMode;
+
+   updateSwitchIfChanged(m_indiP_combineMode, "mean", m_combineMode == COMBINE_MEAN ? pcf::IndiElement::On : pcf::IndiElement::Off, INDI_IDLE);
+   updateSwitchIfChanged(m_indiP_combineMode, "median", m_combineMode == COMBINE_MEDIAN ? pcf::IndiElement::On : pcf::IndiElement::Off, INDI_IDLE);
+   updateSwitchIfChanged(m_indiP_combineMode, "sigmaclip", m_combineMode == COMBINE_SIGMACLIP ? pcf::IndiElement::On : pcf::IndiElement::Off, INDI_IDLE);
+
+   shmimMonitorT::m_restart = true;
+   
+   log<text_log>("set combineMode to " + modeName, logPrio::LOG_NOTICE);
+
+   return 0;
+}
+
 INDI_SETCALLBACK_DEFN( shmimIntegrator, m_indiP_fpsSource )(const pcf::IndiProperty &ipRecv)
 {
    if( ipRecv.getName() != m_indiP_fpsSource.getName())
@@ -0,0 +1,64 @@
+/** \file imageCombine_test.cpp
+  * \brief Catch2 tests for the imageCombine utilities in the shmimIntegrator app.
+  *
+  * History:
+  */
+#include "../../../tests/catch2/catch.hpp"
+
+#include "../imageCombine.hpp"
+
+using namespace MagAOX::app;
+
+namespace imageCombine_test 
+{
+
+SCENARIO( "Calculating the median with selection", "[imageCombine]" )
+{
+   GIVEN("A vector of values")
+   {
+      WHEN("Odd number of values")
+      {
+         std::vector<float> vals = {5, 1, 4, 2, 3};
+
+         REQUIRE(medianInPlace(vals, vals.size()) == 3.0f);
+      }
+
+      WHEN("Even number of values")
+      {
+         std::vector<float> vals = {6, 1, 4, 2, 3, 5};
+
+         REQUIRE(medianInPlace(vals, vals.size()) == 3.5f);
+      }
+
+      WHEN("Using only part of the vector")
+      {
+         std::vector<float> vals = {5, 1, 4, 100, 100};
+
+         REQUIRE(medianInPlace(vals, 3) == 4.0f);
+      }
+   }
+}
+
+SCENARIO( "Calculating the sigma-clipped mean", "[imageCombine]" )
+{
+   GIVEN("A vector of values with an outlier")
+   {
+      WHEN("The outlier is far from the median")
+      {
+         std::vector<float> vals = {10, 11, 9, 10, 11, 9, 1000};
+         std::vector<float> work;
+
+         REQUIRE(sigmaClipMeanInPlace(vals, work, vals.size(), 3.0f) == 10.0f);
+      }
+
+      WHEN("All values are equal")
+      {
+         std::vector<float> vals = {2, 2, 2, 2};
+         std::vector<float> work;
+
+         REQUIRE(sigmaClipMeanInPlace(vals, work, vals.size(), 3.0f) == 2.0f);
+      }
+   }
+}
+
+} //namespace imageCombine_test
@@ -0,0 +1,16 @@
+/** \file simDM.cpp
+  * \brief The MagAO-X simulated DM controller main program source file.
+  *
+  * \ingroup simDM_files
+  */
+
+#include "simDM.hpp"
+
+
+int main(int argc, char **argv)
+{
+   MagAOX::app::simDM xapp;
+
+   return xapp.main(argc, argv);
+
+}
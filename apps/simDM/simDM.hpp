@@ -0,0 +1,743 @@
+/** \file simDM.hpp
+  * \brief The MagAO-X simulated DM controller header file
+  *
+  * \ingroup simDM_files
+  */
+
+#ifndef simDM_hpp
+#define simDM_hpp
+
+#include <atomic>
+#include <fstream>
+
+#include "../../libMagAOX/libMagAOX.hpp" //Note this is included on command line to trigger pch
+#include "../../magaox_git_version.h"
+
+/** \defgroup simDM
+  * \brief The MagAO-X application to simulate a DM, for measuring the latency of the DM command path.
+  *
+  * <a href="../handbook/operating/software/apps/simDM.html">Application Documentation</a>
+  *
+  * \ingroup apps
+  *
+  */
+
+/** \defgroup simDM_files
+  * \ingroup simDM
+  */
+
+namespace MagAOX
+{
+namespace app
+{
+
+/// A latency histogram with fixed width bins and an overflow bin.
+/**
+  * \ingroup simDM
+  */
+struct latencyHistogram
+{
+   double m_binWidth {1e-6}; ///< The bin width, in seconds.
+   std::vector<uint64_t> m_bins; ///< The counts, the last bin is overflow.
+
+   uint64_t m_count {0}; ///< The number of samples.
+   double m_sum {0}; ///< The sum of the samples, in seconds.
+   double m_max {0}; ///< The maximum sample, in seconds.
+
+   /// Set the binning and clear the counts.
+   void setup( double binWidth, ///< [in] the bin width, in seconds
+               size_t nBins     ///< [in] the number of bins, not including the overflow bin
+             )
+   {
+      m_binWidth = binWidth;
+      m_bins.assign(nBins+1, 0);
+      reset();
+   }
+
+   /// Clear the counts.
+   void reset()
+   {
+      std::fill(m_bins.begin(), m_bins.end(), 0);
+      m_count = 0;
+      m_sum = 0;
+      m_max = 0;
+   }
+
+   /// Add a sample.
+   void add( double dt /**< [in] the sample, in seconds*/)
+   {
+      if(dt < 0) dt = 0;
+
+      size_t b = dt / m_binWidth;
+      if(b >= m_bins.size()) b = m_bins.size() - 1;
+
+      ++m_bins[b];
+      ++m_count;
+      m_sum += dt;
+      if(dt > m_max) m_max = dt;
+   }
+
+   /// Get the mean, in seconds.
+   double mean() const
+   {
+      if(m_count == 0) return 0;
+      return m_sum / m_count;
+   }
+
+   /// Get a percentile, in seconds, to the resolution of the bins.
+   /** Returns the upper edge of the bin containing the percentile, or the maximum if it is in the overflow bin.
+     */
+   double percentile( double p /**< [in] the percentile, 0 to 1*/) const
+   {
+      if(m_count == 0) return 0;
+
+      uint64_t tgt = std::ceil(p*m_count);
+      uint64_t acc = 0;
+      for(size_t b = 0; b < m_bins.size() - 1; ++b)
+      {
+         acc += m_bins[b];
+         if(acc >= tgt) return (b+1)*m_binWidth;
+      }
+
+      return m_max;
+   }
+};
+
+/// The MagAO-X simulated DM.
+/** Implements the dev::dm interface with no hardware.  commandDM converts the command with the same transform as
+  * the real drivers, then emulates the SDK call with a configurable delay.  Timestamps are taken at each stage
+  * so that the latency from the write of the DM shmim to the end of the emulated hardware call can be measured,
+  * along with the commands dropped because they were overwritten before being read, and the CPU time used by each
+  * stage.
+  *
+  * The stages are
+  * - wait: from the write of `<shmimName>` to the start of commandDM, which covers the semaphore wake-up in
+  *   shmimMonitor and dm::processImage.
+  * - convert: the command transform.
+  * - hardware: the emulated SDK call.
+  *
+  * With `dm.combine` the write time of `<shmimName>` is set after commandDM, so only the convert and hardware
+  * stages are measured here.  The end to end latency is in the dm `combine_latency` property in both cases.
+  *
+  * Use the simDMDriver utility to publish shapes at a fixed rate.
+  *
+  * \ingroup simDM
+  */
+class simDM : public MagAOXApp<true>, public dev::dm<simDM,float>, public dev::shmimMonitor<simDM>
+{
+
+   friend class dev::dm<simDM,float>;
+
+   friend class dev::shmimMonitor<simDM>;
+
+   typedef float realT;  ///< This defines the datatype used to signal the DM using the ImageStreamIO library.
+
+   typedef dev::shmimMonitor<simDM> shmimMonitorT;
+
+protected:
+
+   /** \name Configurable Parameters
+     *@{
+     */
+
+   std::atomic<double> m_hwDelay {0}; ///< The time taken by the emulated SDK call, in microseconds.  Set from INDI, read by the DM thread.
+
+   bool m_hwSpin {true}; ///< If true the emulated SDK call spins, like a polled bus write, otherwise it sleeps.
+
+   double m_histBinWidth {1}; ///< The width of the latency histogram bins, in microseconds.
+
+   int m_histBins {2000}; ///< The number of latency histogram bins.
+
+   std::string m_histFile; ///< The file to write the latency histograms to.  If empty, "<sysPath>/simDM_<name>_hist.txt" is used.
+
+   ///@}
+
+   std::vector<double> m_dminputs; ///< The converted command, as the SDK would receive it.
+
+   dev::dmTransform<double, dev::dmLinearTransfer> m_transform; ///< Converts shmim commands to m_dminputs.
+
+   bool m_dmInit {false}; ///< Whether the simulated DM is initialized.
+
+   /** \name Statistics
+     * Updated by commandDM, read by appLogic.
+     * @{
+     */
+   std::mutex m_statsMutex; ///< Protects the statistics.
+
+   latencyHistogram m_histWait; ///< The wait stage latency.
+   latencyHistogram m_histConvert; ///< The convert stage latency.
+   latencyHistogram m_histHardware; ///< The hardware stage latency.
+   latencyHistogram m_histTotal; ///< The total latency, from the shmim write to the end of the hardware stage.
+
+   uint64_t m_received {0}; ///< The number of commands received.
+   uint64_t m_dropped {0}; ///< The number of commands dropped, from gaps in the shmim cnt0.
+   uint64_t m_lastCnt0 {0}; ///< The cnt0 of the last command.
+   bool m_haveCnt0 {false}; ///< Whether m_lastCnt0 is valid.
+
+   double m_cpuWait {0}; ///< CPU time used by the shmim thread between commands, in seconds.
+   double m_cpuConvert {0}; ///< CPU time used by the convert stage, in seconds.
+   double m_cpuHardware {0}; ///< CPU time used by the hardware stage, in seconds.
+   timespec m_cpuLast {0,0}; ///< Thread CPU time at the end of the last command.
+
+   timespec m_cpuWall {0,0}; ///< Wall time at the start of the CPU usage interval.
+   ///@}
+
+public:
+   /// Default c'tor.
+   simDM();
+
+   /// D'tor.
+   ~simDM() noexcept;
+
+   /// Setup the configuration system.
+   virtual void setupConfig();
+
+   /// Implementation of loadConfig logic, separated for testing.
+   /** This is called by loadConfig().
+     */
+   int loadConfigImpl( mx::app::appConfigurator & _config /**< [in] an application configuration from which to load values*/);
+
+   /// Load the configuration
+   virtual void loadConfig();
+
+   /// Startup function
+   /** Sets up INDI, initializes the simulated DM, and starts the shmim thread.
+     *
+     */
+   virtual int appStartup();
+
+   /// Implementation of the FSM for simDM.
+   /**
+     * \returns 0 on no critical error
+     * \returns -1 on an error requiring shutdown
+     */
+   virtual int appLogic();
+
+   /// Shutdown the app.
+   /** Writes the latency histograms.
+     *
+     */
+   virtual int appShutdown();
+
+   /** \name DM Base Class Interface
+     *
+     *@{
+     */
+
+   /// Initialize the simulated DM and prepare for operation.
+   /** Application is in state OPERATING upon successful conclusion.
+     *
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int initDM();
+
+   /// Zero all commands on the simulated DM
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int zeroDM();
+
+   /// Send a command to the simulated DM
+   /** This is called by the shmim monitoring thread in response to a semaphore trigger.
+     *
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int commandDM(void * curr_src);
+
+   /// Release the simulated DM.
+   /** The application will be state READY at the conclusion of this.
+     *
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int releaseDM();
+
+   ///@}
+
+   /// Emulate the SDK call.
+   void hardwareCall();
+
+   /// Clear the statistics.
+   void resetStats();
+
+   /// Write the latency histograms to m_histFile.
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int writeHistograms();
+
+   /** \name INDI
+     *
+     *@{
+     */
+protected:
+
+   pcf::IndiProperty m_indiP_latency; ///< The latency of each stage, in microseconds.
+   pcf::IndiProperty m_indiP_cpu; ///< The CPU usage of each stage, in percent.
+   pcf::IndiProperty m_indiP_commands; ///< The number of commands received and dropped.
+   pcf::IndiProperty m_indiP_hwDelay; ///< The emulated SDK call time, in microseconds.
+   pcf::IndiProperty m_indiP_resetStats; ///< Request to clear the statistics.
+   pcf::IndiProperty m_indiP_writeHist; ///< Request to write the latency histograms.
+
+public:
+   INDI_NEWCALLBACK_DECL(simDM, m_indiP_hwDelay);
+   INDI_NEWCALLBACK_DECL(simDM, m_indiP_resetStats);
+   INDI_NEWCALLBACK_DECL(simDM, m_indiP_writeHist);
+
+   ///@}
+};
+
+inline
+simDM::simDM() : MagAOXApp(MAGAOX_CURRENT_SHA1, MAGAOX_REPO_MODIFIED)
+{
+   m_powerMgtEnabled = false;
+   return;
+}
+
+inline
+simDM::~simDM() noexcept
+{
+}
+
+inline
+void simDM::setupConfig()
+{
+   config.add("sim.hwDelay", "", "sim.hwDelay", argType::Required, "sim", "hwDelay", false, "float", "The time taken by the emulated SDK call, in microseconds.  Default is 0.");
+   config.add("sim.hwSpin", "", "sim.hwSpin", argType::Required, "sim", "hwSpin", false, "bool", "If true the emulated SDK call spins, otherwise it sleeps.  Default is true.");
+   config.add("sim.histBinWidth", "", "sim.histBinWidth", argType::Required, "sim", "histBinWidth", false, "float", "The width of the latency histogram bins, in microseconds.  Default is 1.");
+   config.add("sim.histBins", "", "sim.histBins", argType::Required, "sim", "histBins", false, "int", "The number of latency histogram bins.  Default is 2000.");
+   config.add("sim.histFile", "", "sim.histFile", argType::Required, "sim", "histFile", false, "string", "The file to write the latency histograms to.  Default is <sysPath>/simDM_<name>_hist.txt.");
+
+   dev::dm<simDM,float>::setupConfig(config);
+}
+
+inline
+int simDM::loadConfigImpl( mx::app::appConfigurator & _config )
+{
+   double hwDelay = m_hwDelay;
+   _config(hwDelay, "sim.hwDelay");
+   m_hwDelay = hwDelay;
+   _config(m_hwSpin, "sim.hwSpin");
+   _config(m_histBinWidth, "sim.histBinWidth");
+   _config(m_histBins, "sim.histBins");
+   _config(m_histFile, "sim.histFile");
+
+   if(m_histFile == "") m_histFile = sysPath + "/simDM_" + configName() + "_hist.txt";
+
+   m_calibRelDir = "dm/sim_" + configName();
+
+   dev::dm<simDM,float>::loadConfig(_config);
+
+   return 0;
+}
+
+inline
+void simDM::loadConfig()
+{
+   loadConfigImpl(config);
+}
+
+inline
+int simDM::appStartup()
+{
+   if(m_histBins < 1 || m_histBinWidth <= 0)
+   {
+      return log<software_critical, -1>({__FILE__, __LINE__, "invalid histogram binning"});
+   }
+
+   m_histWait.setup(m_histBinWidth*1e-6, m_histBins);
+   m_histConvert.setup(m_histBinWidth*1e-6, m_histBins);
+   m_histHardware.setup(m_histBinWidth*1e-6, m_histBins);
+   m_histTotal.setup(m_histBinWidth*1e-6, m_histBins);
+   resetStats();
+
+   createROIndiNumber( m_indiP_latency, "latency", "Command Latency [us]", "Simulated DM");
+   indi::addNumberElement<double>( m_indiP_latency, "wait_mean", 0, 1e9, 0, "%0.2f", "wait mean");
+   indi::addNumberElement<double>( m_indiP_latency, "convert_mean", 0, 1e9, 0, "%0.2f", "convert mean");
+   indi::addNumberElement<double>( m_indiP_latency, "hardware_mean", 0, 1e9, 0, "%0.2f", "hardware mean");
+   indi::addNumberElement<double>( m_indiP_latency, "total_mean", 0, 1e9, 0, "%0.2f", "total mean");
+   indi::addNumberElement<double>( m_indiP_latency, "total_p50", 0, 1e9, 0, "%0.2f", "total median");
+   indi::addNumberElement<double>( m_indiP_latency, "total_p99", 0, 1e9, 0, "%0.2f", "total 99%");
+   indi::addNumberElement<double>( m_indiP_latency, "total_max", 0, 1e9, 0, "%0.2f", "total max");
+   if( registerIndiPropertyReadOnly( m_indiP_latency ) < 0)
+   {
+      return log<software_critical,-1>({__FILE__,__LINE__});
+   }
+
+   createROIndiNumber( m_indiP_cpu, "cpu", "CPU Usage [%]", "Simulated DM");
+   indi::addNumberElement<double>( m_indiP_cpu, "wait", 0, 100, 0, "%0.2f", "wait");
+   indi::addNumberElement<double>( m_indiP_cpu, "convert", 0, 100, 0, "%0.2f", "convert");
+   indi::addNumberElement<double>( m_indiP_cpu, "hardware", 0, 100, 0, "%0.2f", "hardware");
+   if( registerIndiPropertyReadOnly( m_indiP_cpu ) < 0)
+   {
+      return log<software_critical,-1>({__FILE__,__LINE__});
+   }
+
+   createROIndiNumber( m_indiP_commands, "commands", "Commands", "Simulated DM");
+   indi::addNumberElement<uint64_t>( m_indiP_commands, "received", 0, std::numeric_limits<uint64_t>::max(), 0, "%d", "received");
+   indi::addNumberElement<uint64_t>( m_indiP_commands, "dropped", 0, std::numeric_limits<uint64_t>::max(), 0, "%d", "dropped");
+   if( registerIndiPropertyReadOnly( m_indiP_commands ) < 0)
+   {
+      return log<software_critical,-1>({__FILE__,__LINE__});
+   }
+
+   createStandardIndiNumber<double>( m_indiP_hwDelay, "hwDelay", 0, 1e6, 0, "%0.1f", "SDK Call Time [us]", "Simulated DM");
+   m_indiP_hwDelay["current"] = m_hwDelay.load();
+   m_indiP_hwDelay["target"] = m_hwDelay.load();
+   if( registerIndiPropertyNew( m_indiP_hwDelay, INDI_NEWCALLBACK(m_indiP_hwDelay)) < 0)
+   {
+      return log<software_critical,-1>({__FILE__,__LINE__});
+   }
+
+   createStandardIndiRequestSw( m_indiP_resetStats, "reset_stats", "Reset Statistics", "Simulated DM");
+   if( registerIndiPropertyNew( m_indiP_resetStats, INDI_NEWCALLBACK(m_indiP_resetStats)) < 0)
+   {
+      return log<software_critical,-1>({__FILE__,__LINE__});
+   }
+
+   createStandardIndiRequestSw( m_indiP_writeHist, "write_hist", "Write Histograms", "Simulated DM");
+   if( registerIndiPropertyNew( m_indiP_writeHist, INDI_NEWCALLBACK(m_indiP_writeHist)) < 0)
+   {
+      return log<software_critical,-1>({__FILE__,__LINE__});
+   }
+
+   if(dev::dm<simDM,float>::appStartup() < 0)
+   {
+      return log<software_critical,-1>({__FILE__,__LINE__});
+   }
+
+   if(shmimMonitor<simDM>::appStartup() < 0)
+   {
+      return log<software_critical,-1>({__FILE__,__LINE__});
+   }
+
+   return initDM();
+}
+
+inline
+int simDM::appLogic()
+{
+   dev::dm<simDM,float>::appLogic();
+   shmimMonitor<simDM>::appLogic();
+
+   std::unique_lock<std::mutex> lock(m_statsMutex);
+
+   timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   double wall = (now.tv_sec - m_cpuWall.tv_sec) + (now.tv_nsec - m_cpuWall.tv_nsec)/1e9;
+
+   std::vector<double> lat = { m_histWait.mean()*1e6,
+                               m_histConvert.mean()*1e6,
+                               m_histHardware.mean()*1e6,
+                               m_histTotal.mean()*1e6,
+                               m_histTotal.percentile(0.5)*1e6,
+                               m_histTotal.percentile(0.99)*1e6,
+                               m_histTotal.m_max*1e6 };
+
+   std::vector<double> cpu = { 0, 0, 0 };
+   if(wall > 0) cpu = { 100*m_cpuWait/wall, 100*m_cpuConvert/wall, 100*m_cpuHardware/wall };
+
+   std::vector<uint64_t> cmds = { m_received, m_dropped };
+
+   //The CPU usage is per interval, the latency and command counts are since the last reset
+   m_cpuWait = 0;
+   m_cpuConvert = 0;
+   m_cpuHardware = 0;
+   m_cpuWall = now;
+
+   lock.unlock();
+
+   updateIfChanged(m_indiP_latency, std::vector<std::string>({"wait_mean", "convert_mean", "hardware_mean", "total_mean", "total_p50", "total_p99", "total_max"}), lat);
+   updateIfChanged(m_indiP_cpu, std::vector<std::string>({"wait", "convert", "hardware"}), cpu);
+   updateIfChanged(m_indiP_commands, std::vector<std::string>({"received", "dropped"}), cmds);
+   updateIfChanged(m_indiP_hwDelay, "current", m_hwDelay.load());
+
+   return 0;
+}
+
+inline
+int simDM::appShutdown()
+{
+   writeHistograms();
+
+   if(m_dmInit) releaseDM();
+
+   dev::dm<simDM,float>::appShutdown();
+   shmimMonitor<simDM>::appShutdown();
+
+   return 0;
+}
+
+inline
+int simDM::initDM()
+{
+   if(m_dmInit)
+   {
+      log<text_log>("DM is already initialized.  Release first.", logPrio::LOG_ERROR);
+      return -1;
+   }
+
+   if(m_dmWidth == 0 || m_dmHeight == 0)
+   {
+      return log<software_error, -1>({__FILE__, __LINE__, "DM initialization failed.  dm.width and dm.height must be set."});
+   }
+
+   size_t nAct = m_dmWidth * m_dmHeight;
+
+   std::vector<int> mapping(nAct);
+   for(size_t n = 0; n < nAct; ++n) mapping[n] = n;
+
+   m_dminputs.assign(nAct, 0);
+
+   if(m_transform.setup(mapping.data(), nAct, 1.0) < 0)
+   {
+      return log<software_error, -1>({__FILE__, __LINE__, "DM initialization failed.  Failed to set up command transform."});
+   }
+
+   m_dmInit = true;
+
+   log<text_log>("simulated DM " + std::to_string(m_dmWidth) + "x" + std::to_string(m_dmHeight) + " initialized", logPrio::LOG_NOTICE);
+
+   state(stateCodes::OPERATING);
+
+   return 0;
+}
+
+inline
+int simDM::zeroDM()
+{
+   if(!m_dmInit)
+   {
+      return log<software_error, -1>({__FILE__, __LINE__, "DM not initialized"});
+   }
+
+   std::fill(m_dminputs.begin(), m_dminputs.end(), 0);
+   hardwareCall();
+
+   log<text_log>("DM zeroed");
+   return 0;
+}
+
+inline
+void simDM::hardwareCall()
+{
+   double hwDelay = m_hwDelay;
+   if(hwDelay <= 0) return;
+
+   timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   long ns = ts.tv_nsec + static_cast<long>(hwDelay*1000);
+   ts.tv_sec += ns / 1000000000;
+   ts.tv_nsec = ns % 1000000000;
+
+   if(m_hwSpin)
+   {
+      timespec now;
+      do
+      {
+         clock_gettime(CLOCK_MONOTONIC, &now);
+      } while(now.tv_sec < ts.tv_sec || (now.tv_sec == ts.tv_sec && now.tv_nsec < ts.tv_nsec));
+   }
+   else
+   {
+      while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR);
+   }
+}
+
+inline
+int simDM::commandDM(void * curr_src)
+{
+   timespec t0, t1, t2, c0, c1, c2;
+
+   clock_gettime(CLOCK_REALTIME, &t0);
+   clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c0);
+
+   m_transform.apply(m_dminputs.data(), (realT *) curr_src, m_instSatMap.data());
+
+   clock_gettime(CLOCK_REALTIME, &t1);
+   clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c1);
+
+   hardwareCall();
+
+   clock_gettime(CLOCK_REALTIME, &t2);
+   clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c2);
+
+   std::lock_guard<std::mutex> lock(m_statsMutex);
+
+   ++m_received;
+
+   if(!m_combine)
+   {
+      //In the external path <shmimName> is written before the semaphore is posted
+      const timespec & wt = shmimMonitorT::m_imageStream.md[0].writetime;
+      uint64_t cnt0 = shmimMonitorT::m_imageStream.md[0].cnt0;
+
+      m_histWait.add( (t0.tv_sec - wt.tv_sec) + (t0.tv_nsec - wt.tv_nsec)/1e9 );
+      m_histTotal.add( (t2.tv_sec - wt.tv_sec) + (t2.tv_nsec - wt.tv_nsec)/1e9 );
+
+      if(m_haveCnt0 && cnt0 > m_lastCnt0 + 1) m_dropped += cnt0 - m_lastCnt0 - 1;
+      m_lastCnt0 = cnt0;
+      m_haveCnt0 = true;
+   }
+
+   m_histConvert.add( (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec)/1e9 );
+   m_histHardware.add( (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec)/1e9 );
+
+   if(m_cpuLast.tv_sec != 0 || m_cpuLast.tv_nsec != 0)
+   {
+      m_cpuWait += (c0.tv_sec - m_cpuLast.tv_sec) + (c0.tv_nsec - m_cpuLast.tv_nsec)/1e9;
+   }
+   m_cpuConvert += (c1.tv_sec - c0.tv_sec) + (c1.tv_nsec - c0.tv_nsec)/1e9;
+   m_cpuHardware += (c2.tv_sec - c1.tv_sec) + (c2.tv_nsec - c1.tv_nsec)/1e9;
+   m_cpuLast = c2;
+
+   return 0;
+}
+
+inline
+int simDM::releaseDM()
+{
+   if(!m_dmInit)
+   {
+      return log<software_error, -1>({__FILE__, __LINE__, "dm is not initialized"});
+   }
+
+   state(stateCodes::READY);
+
+   if(!shutdown())
+   {
+      pthread_kill(m_smThread.native_handle(), SIGUSR1);
+   }
+
+   m_dmInit = false;
+
+   log<text_log>("simulated DM released", logPrio::LOG_NOTICE);
+
+   return 0;
+}
+
+inline
+void simDM::resetStats()
+{
+   std::lock_guard<std::mutex> lock(m_statsMutex);
+
+   m_histWait.reset();
+   m_histConvert.reset();
+   m_histHardware.reset();
+   m_histTotal.reset();
+
+   m_received = 0;
+   m_dropped = 0;
+   m_haveCnt0 = false;
+
+   m_cpuWait = 0;
+   m_cpuConvert = 0;
+   m_cpuHardware = 0;
+   m_cpuLast = {0,0};
+   clock_gettime(CLOCK_MONOTONIC, &m_cpuWall);
+}
+
+inline
+int simDM::writeHistograms()
+{
+   std::lock_guard<std::mutex> lock(m_statsMutex);
+
+   std::ofstream fout(m_histFile);
+   if(!fout.good())
+   {
+      return log<software_error, -1>({__FILE__, __LINE__, errno, 0, "error opening " + m_histFile});
+   }
+
+   fout << "# simDM " << configName() << " latency histograms\n";
+   fout << "# received: " << m_received << " dropped: " << m_dropped << " hwDelay: " << m_hwDelay.load() << " us\n";
+   fout << "# bin_us wait convert hardware total\n";
+
+   for(size_t b = 0; b < m_histTotal.m_bins.size(); ++b)
+   {
+      if(m_histWait.m_bins[b] == 0 && m_histConvert.m_bins[b] == 0 && m_histHardware.m_bins[b] == 0 && m_histTotal.m_bins[b] == 0) continue;
+
+      if(b == m_histTotal.m_bins.size() - 1) fout << "overflow";
+      else fout << b*m_histBinWidth;
+
+      fout << " " << m_histWait.m_bins[b] << " " << m_histConvert.m_bins[b] << " " << m_histHardware.m_bins[b] << " " << m_histTotal.m_bins[b] << "\n";
+   }
+
+   fout.close();
+
+   log<text_log>("wrote latency histograms to " + m_histFile + ": total mean " + std::to_string(m_histTotal.mean()*1e6) +
+                    " us, p99 " + std::to_string(m_histTotal.percentile(0.99)*1e6) + " us, max " + std::to_string(m_histTotal.m_max*1e6) +
+                       " us, " + std::to_string(m_dropped) + " of " + std::to_string(m_received + m_dropped) + " dropped");
+
+   return 0;
+}
+
+INDI_NEWCALLBACK_DEFN(simDM, m_indiP_hwDelay)(const pcf::IndiProperty &ipRecv)
+{
+   if(ipRecv.getName() != m_indiP_hwDelay.getName())
+   {
+      log<software_error>({__FILE__, __LINE__, "invalid indi property received"});
+      return -1;
+   }
+
+   double target;
+
+   if( indiTargetUpdate( m_indiP_hwDelay, target, ipRecv, true) < 0)
+   {
+      log<software_error>({__FILE__,__LINE__});
+      return -1;
+   }
+
+   if(target < 0) target = 0;
+
+   m_hwDelay = target;
+
+   log<text_log>("set SDK call time to " + std::to_string(target) + " us", logPrio::LOG_NOTICE);
+
+   return 0;
+}
+
+INDI_NEWCALLBACK_DEFN(simDM, m_indiP_resetStats)(const pcf::IndiProperty &ipRecv)
+{
+   if(ipRecv.getName() != m_indiP_resetStats.getName())
+   {
+      log<software_error>({__FILE__, __LINE__, "invalid indi property received"});
+      return -1;
+   }
+
+   if(!ipRecv.find("request")) return 0;
+
+   if( ipRecv["request"].getSwitchState() == pcf::IndiElement::On)
+   {
+      resetStats();
+   }
+
+   return 0;
+}
+
+INDI_NEWCALLBACK_DEFN(simDM, m_indiP_writeHist)(const pcf::IndiProperty &ipRecv)
+{
+   if(ipRecv.getName() != m_indiP_writeHist.getName())
+   {
+      log<software_error>({__FILE__, __LINE__, "invalid indi property received"});
+      return -1;
+   }
+
+   if(!ipRecv.find("request")) return 0;
+
+   if( ipRecv["request"].getSwitchState() == pcf::IndiElement::On)
+   {
+      return writeHistograms();
+   }
+
+   return 0;
+}
+
+} //namespace app
+} //namespace MagAOX
+
+#endif //simDM_hpp
@@ -84,8 +84,6 @@ protected:
    mx::improc::eigenImage<realT> m_twRespM;
    mx::improc::eigenImage<realT> m_tweeter;
    mx::improc::eigenImage<realT> m_woofer;
-   mx::improc::eigenImage<realT> m_wooferDelta;
-   mx::improc::eigenImage<realT> m_modeAmps;
 
 
    mx::improc::eigenImage<realT> m_tweeterMask;
@@ -94,6 +92,10 @@ protected:
 
    mx::improc::eigenCube<float> m_wModes;
 
+   dev::modalOffload<realT> m_offload; ///< The combined tweeter to woofer offload matrix
+
+   int m_offloadModes {-1}; ///< The number of modes m_offload was built with, 0 for actuator offloading, -1 if it needs to be built.
+
    float m_fps {0}; ///< Current FPS from the FPS source.
    int m_navg {0}; ///< Current navg from the averager
 
@@ -160,6 +162,15 @@ public:
    
    int prepareModes();
 
+   /// Build the offload matrix for the current number of modes.
+   /** In modal offloading this is the product of the woofer modes and the masked tweeter modes, otherwise it is the
+     * response matrix.
+     *
+     * \returns 0 on success
+     * \returns -1 on error, which is logged.
+     */
+   int buildOffload();
+
 protected:
 
   
@@ -442,9 +453,8 @@ int t2wOffloader::allocate(const dev::shmimT & dummy)
       m_woofer.setZero();
    }
    
-   m_modeAmps.resize(1,  m_tModesOrtho.planes());
-
-   ///\todo size checks here.
+   //Force a rebuild, which checks the sizes
+   m_offloadModes = -1;
    
    //state(stateCodes::OPERATING);
    
@@ -460,39 +470,18 @@ int t2wOffloader::processImage( void * curr_src,
    
    if(!m_offloading) return 0;
    
-   if(m_numModes == 0)
+   if(m_numModes != m_offloadModes)
    {
-      m_wooferDelta = m_twRespM.matrix() * Eigen::Map<Eigen::Matrix<float,-1,-1>>((float *)curr_src,  m_width*m_height,1);
-   }
-   else
-   {
-      m_modeAmps = Eigen::Map<Eigen::Matrix<float,-1,-1>>((float *) curr_src, 1, m_width*m_height) * Eigen::Map<Eigen::Matrix<float,-1,-1>>(m_tModesOrtho.data(), m_tModesOrtho.rows()*m_tModesOrtho.cols(), m_tModesOrtho.planes()); 
-
-      m_wooferDelta = m_modeAmps(0,0) * m_wModes.image(0);
-      for(int p=1; p < m_numModes && p < m_maxModes; ++p)
+      if(buildOffload() < 0)
       {
-         m_wooferDelta += m_modeAmps(0,p)*m_wModes.image(p);
+         m_offloading = false; //the error is logged, stop until the problem is fixed
+         return 0;
       }
-
-      
    }
    
    while(m_dmStream.md[0].write == 1); //Check if zero() is running
    
-   
-   m_woofer = m_gain* Eigen::Map<Eigen::Array<float,-1,-1>>( m_wooferDelta.data(), m_dmWidth, m_dmHeight) + (1.0-m_leak)*m_woofer;
-      
-   for(int ii = 0; ii < m_woofer.rows(); ++ii)
-   {
-      for(int jj = 0; jj < m_woofer.cols(); ++jj)
-      {
-         if( fabs(m_woofer(ii,jj)) > m_actLim)
-         {
-            if(m_woofer(ii,jj) > 0) m_woofer(ii,jj) = m_actLim;
-            else m_woofer(ii,jj) = -m_actLim;
-         }
-      }
-   }
+   m_offload.integrate(m_woofer.data(), (float *) curr_src, m_gain, m_leak, m_actLim);
    
    m_dmStream.md[0].write = 1;
    
@@ -578,10 +567,58 @@ int t2wOffloader::prepareModes()
 
    ff.write("/tmp/wModes.fits", m_wModes);
 
+   m_offloadModes = -1;
+
    return 0;
 
 }
 
+inline
+int t2wOffloader::buildOffload()
+{
+   int numModes = m_numModes;
+
+   Eigen::Index nAct = m_woofer.rows()*m_woofer.cols();
+   Eigen::Index nPix = shmimMonitorT::m_width*shmimMonitorT::m_height;
+
+   int rv;
+
+   if(numModes == 0)
+   {
+      if(m_twRespM.rows() != nAct || m_twRespM.cols() != nPix)
+      {
+         return log<software_error,-1>({__FILE__, __LINE__, "response matrix does not match woofer and tweeter sizes"});
+      }
+
+      rv = m_offload.setMatrix(m_twRespM.matrix());
+   }
+   else
+   {
+      int nm = std::min(numModes, std::min(m_maxModes, (int) m_tModesOrtho.planes()));
+
+      if(m_wModes.rows()*m_wModes.cols() != nAct || m_tModesOrtho.rows()*m_tModesOrtho.cols() != nPix)
+      {
+         return log<software_error,-1>({__FILE__, __LINE__, "modes do not match woofer and tweeter sizes"});
+      }
+
+      Eigen::Map<Eigen::Matrix<float,-1,-1>> W(m_wModes.data(), nAct, m_wModes.planes());
+      Eigen::Map<Eigen::Matrix<float,-1,-1>> T(m_tModesOrtho.data(), nPix, m_tModesOrtho.planes());
+
+      rv = m_offload.setMatrix(W.leftCols(nm), T.leftCols(nm).transpose());
+   }
+
+   if(rv < 0)
+   {
+      return log<software_error,-1>({__FILE__, __LINE__, "empty offload matrix"});
+   }
+
+   m_offloadModes = numModes;
+
+   log<text_log>("built offload matrix for " + std::to_string(numModes) + " modes using " + std::to_string(m_offload.nUsed()) + " tweeter pixels");
+
+   return 0;
+}
+
 INDI_NEWCALLBACK_DEFN(t2wOffloader, m_indiP_gain)(const pcf::IndiProperty &ipRecv)
 {
    if(ipRecv.getName() != m_indiP_gain.getName())
@@ -0,0 +1,118 @@
+/** \file modeBlocks.hpp
+  * \brief Incremental mode block aggregates for the user gain controller
+  *
+  * \ingroup userGainCtrl_files
+  */
+
+#ifndef userGainCtrl_modeBlocks_hpp
+#define userGainCtrl_modeBlocks_hpp
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace MagAOX
+{
+namespace app
+{
+
+/// Copy a new frame into the current values, and update the mean and constant flag of each block whose values changed.
+/** Each block is compared and copied in one pass over its range.  Only blocks with at least one changed value have
+  * their aggregates recalculated, so a change to one block costs one pass over that block rather than over all blocks.
+  * Blocks which are recalculated are flagged in \p dirty, which is only ever set here and is cleared by the caller
+  * once the new values have been published.
+  *
+  * Values before the first block, between blocks, and after the last block are copied but belong to no block.
+  * Blocks are expected in ascending order.  A block which starts before the end of an earlier one is always
+  * recalculated, since some of its values may already have been copied.
+  *
+  * \returns the number of blocks recalculated
+  *
+  * \tparam realT the type of the current values
+  */
+template<typename realT>
+size_t updateModeBlocks( realT * curr,                          ///< [in/out] the current values, N long
+                         void * src,                            ///< [in] the new frame
+                         realT (*pixget)(void *, size_t),       ///< [in] function to get element n of \p src as realT
+                         size_t N,                              ///< [in] the number of values in the frame
+                         const std::vector<int> & blockStart,   ///< [in] the first mode of each block
+                         const std::vector<int> & blockN,       ///< [in] the number of modes in each block
+                         std::vector<float> & blockMean,        ///< [in/out] the mean of each block
+                         std::vector<uint8_t> & blockConstant,  ///< [in/out] whether all values in each block are equal
+                         std::vector<uint8_t> & dirty,          ///< [in/out] set to 1 for each block recalculated
+                         bool force                             ///< [in] if true, recalculate all blocks
+                       )
+{
+   size_t nChanged = 0;
+   size_t end = 0;
+
+   for(size_t n = 0; n < blockStart.size(); ++n)
+   {
+      size_t st = blockStart[n];
+      size_t en = st + blockN[n];
+      if(en > N) en = N;
+
+      bool changed = force;
+
+      if(st >= end)
+      {
+         //Copy the gap since the previous block
+         for(size_t m = end; m < st && m < N; ++m)
+         {
+            curr[m] = pixget(src, m);
+         }
+      }
+      else
+      {
+         changed = true;
+      }
+
+      if(en > end) end = en;
+
+      for(size_t m = st; m < en; ++m)
+      {
+         realT v = pixget(src, m);
+         if(v != curr[m])
+         {
+            curr[m] = v;
+            changed = true;
+         }
+      }
+
+      if(!changed) continue;
+
+      double mng = 0;
+      for(size_t m = st; m < en; ++m)
+      {
+         mng += curr[m];
+      }
+
+      blockMean[n] = (en > st) ? mng / (en - st) : 0;
+
+      bool constant = true;
+      for(size_t m = st; m < en; ++m)
+      {
+         if(curr[m] != blockMean[n])
+         {
+            constant = false;
+            break;
+         }
+      }
+
+      blockConstant[n] = constant;
+      dirty[n] = 1;
+      ++nChanged;
+   }
+
+   for(size_t m = end; m < N; ++m)
+   {
+      curr[m] = pixget(src, m);
+   }
+
+   return nChanged;
+}
+
+} //namespace app
+} //namespace MagAOX
+
+#endif //userGainCtrl_modeBlocks_hpp
@@ -0,0 +1,142 @@
+/** \file modeBlocks_test.cpp
+  * \brief Catch2 tests for the mode block aggregates in the userGainCtrl app.
+  *
+  * History:
+  */
+#include "../../../tests/catch2/catch.hpp"
+
+#include "../modeBlocks.hpp"
+
+using namespace MagAOX::app;
+
+namespace modeBlocks_test 
+{
+
+float getFloat( void * src, size_t n )
+{
+   return static_cast<float *>(src)[n];
+}
+
+SCENARIO( "Updating mode block aggregates", "[modeBlocks]" )
+{
+   GIVEN("3 blocks of 2, 3, and 4 modes in a 10 mode frame")
+   {
+      std::vector<int> start({0, 2, 5});
+      std::vector<int> N({2, 3, 4});
+
+      std::vector<float> mean(3, -1);
+      std::vector<uint8_t> constant(3, 0);
+      std::vector<uint8_t> dirty(3, 0);
+
+      float curr[10];
+      float frame[10] = {1, 1, 2, 2, 2, 0.5, 0.5, 0.5, 0.5, 7};
+
+      size_t nc = updateModeBlocks<float>(curr, frame, getFloat, 10, start, N, mean, constant, dirty, true);
+
+      REQUIRE(nc == 3);
+      REQUIRE(curr[9] == 7);
+      REQUIRE(mean[0] == 1.0f);
+      REQUIRE(mean[1] == 2.0f);
+      REQUIRE(mean[2] == 0.5f);
+      REQUIRE(constant[0] == 1);
+      REQUIRE(constant[1] == 1);
+      REQUIRE(constant[2] == 1);
+      REQUIRE(dirty[0] == 1);
+      REQUIRE(dirty[1] == 1);
+      REQUIRE(dirty[2] == 1);
+
+      dirty.assign(3,0);
+
+      WHEN("The same frame is processed again")
+      {
+         nc = updateModeBlocks<float>(curr, frame, getFloat, 10, start, N, mean, constant, dirty, false);
+
+         REQUIRE(nc == 0);
+         REQUIRE(dirty[0] == 0);
+         REQUIRE(dirty[1] == 0);
+         REQUIRE(dirty[2] == 0);
+      }
+
+      WHEN("One mode in the middle block changes")
+      {
+         frame[3] = 5;
+         mean[0] = -1; //to detect a recalculation
+
+         nc = updateModeBlocks<float>(curr, frame, getFloat, 10, start, N, mean, constant, dirty, false);
+
+         REQUIRE(nc == 1);
+         REQUIRE(curr[3] == 5);
+         REQUIRE(mean[0] == -1.0f);
+         REQUIRE(mean[1] == 3.0f);
+         REQUIRE(constant[1] == 0);
+         REQUIRE(dirty[0] == 0);
+         REQUIRE(dirty[1] == 1);
+         REQUIRE(dirty[2] == 0);
+      }
+
+      WHEN("Only a mode outside the blocks changes")
+      {
+         frame[9] = 8;
+
+         nc = updateModeBlocks<float>(curr, frame, getFloat, 10, start, N, mean, constant, dirty, false);
+
+         REQUIRE(nc == 0);
+         REQUIRE(curr[9] == 8);
+      }
+   }
+
+   GIVEN("2 blocks with unblocked modes before, between, and after them")
+   {
+      std::vector<int> start({1, 5});
+      std::vector<int> N({2, 3});
+
+      std::vector<float> mean(2, -1);
+      std::vector<uint8_t> constant(2, 0);
+      std::vector<uint8_t> dirty(2, 0);
+
+      float curr[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+      float frame[10] = {9, 1, 1, 8, 8, 2, 2, 2, 7, 7};
+
+      size_t nc = updateModeBlocks<float>(curr, frame, getFloat, 10, start, N, mean, constant, dirty, true);
+
+      REQUIRE(nc == 2);
+      for(int n = 0; n < 10; ++n) REQUIRE(curr[n] == frame[n]);
+      REQUIRE(mean[0] == 1.0f);
+      REQUIRE(mean[1] == 2.0f);
+
+      dirty.assign(2,0);
+
+      WHEN("Only modes before and between the blocks change")
+      {
+         frame[0] = 3;
+         frame[4] = 4;
+
+         nc = updateModeBlocks<float>(curr, frame, getFloat, 10, start, N, mean, constant, dirty, false);
+
+         REQUIRE(nc == 0);
+         REQUIRE(curr[0] == 3);
+         REQUIRE(curr[4] == 4);
+         REQUIRE(dirty[0] == 0);
+         REQUIRE(dirty[1] == 0);
+      }
+
+      WHEN("The blocks are given out of order")
+      {
+         std::vector<int> rstart({5, 1});
+         std::vector<int> rN({3, 2});
+
+         frame[0] = 3;
+         frame[2] = 5;
+
+         nc = updateModeBlocks<float>(curr, frame, getFloat, 10, rstart, rN, mean, constant, dirty, false);
+
+         //The second block starts before the first, so is recalculated, and sees the change
+         REQUIRE(nc == 1);
+         REQUIRE(dirty[1] == 1);
+         REQUIRE(mean[1] == 3.0f);
+         for(int n = 0; n < 10; ++n) REQUIRE(curr[n] == frame[n]);
+      }
+   }
+}
+
+} //namespace modeBlocks_test 
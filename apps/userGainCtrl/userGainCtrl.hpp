@@ -16,6 +16,8 @@
 #include "../../libMagAOX/libMagAOX.hpp" //Note this is included on command line to trigger pch
 #include "../../magaox_git_version.h"
 
+#include "modeBlocks.hpp"
+
 namespace MagAOX
 {
 namespace app
@@ -147,6 +149,14 @@ protected:
    std::vector<float> m_modeBlockLims;
    std::vector<uint8_t> m_modeBlockLimsConstant;
 
+   std::vector<uint8_t> m_modeBlockGainsDirty; ///< Blocks whose gain changed since last published to INDI
+   std::vector<uint8_t> m_modeBlockMCsDirty; ///< Blocks whose mult. coeff. changed since last published to INDI
+   std::vector<uint8_t> m_modeBlockLimsDirty; ///< Blocks whose limit changed since last published to INDI
+
+   bool m_gainBlocksStale {true}; ///< If true the next gain frame recalculates all blocks
+   bool m_mcBlocksStale {true}; ///< If true the next mult. coeff. frame recalculates all blocks
+   bool m_limitBlocksStale {true}; ///< If true the next limit frame recalculates all blocks
+
    std::mutex m_modeBlockMutex;
 
    mx::fits::fitsFile<float> m_ff;
@@ -515,21 +525,32 @@ int userGainCtrl::appLogic()
       log<software_error>({__FILE__, __LINE__});
    }
    
-   for(size_t n=0; n < m_indiP_blockGains.size(); ++n)
+   //Only publish the blocks which changed since the last pass
+   std::unique_lock<std::mutex> blockLock(m_modeBlockMutex);
+
+   for(size_t n=0; n < m_indiP_blockGains.size() && n < m_modeBlockGainsDirty.size(); ++n)
    {
+      if(!m_modeBlockGainsDirty[n]) continue;
       updateIfChanged(m_indiP_blockGains[n], "current", m_modeBlockGains[n]);
+      m_modeBlockGainsDirty[n] = 0;
    }
 
-   for(size_t n=0; n < m_indiP_blockMCs.size(); ++n)
+   for(size_t n=0; n < m_indiP_blockMCs.size() && n < m_modeBlockMCsDirty.size(); ++n)
    {
+      if(!m_modeBlockMCsDirty[n]) continue;
       updateIfChanged(m_indiP_blockMCs[n], "current", m_modeBlockMCs[n]);
+      m_modeBlockMCsDirty[n] = 0;
    }
 
-   for(size_t n=0; n < m_indiP_blockLimits.size(); ++n)
+   for(size_t n=0; n < m_indiP_blockLimits.size() && n < m_modeBlockLimsDirty.size(); ++n)
    {
+      if(!m_modeBlockLimsDirty[n]) continue;
       updateIfChanged(m_indiP_blockLimits[n], "current", m_modeBlockLims[n]);
+      m_modeBlockLimsDirty[n] = 0;
    }
 
+   blockLock.unlock();
+
    updateSingles();
 
    return 0;
@@ -786,6 +807,14 @@ int userGainCtrl::getModeBlocks()
       m_modeBlockLims.resize(Nb);
       m_modeBlockLimsConstant.resize(Nb);
 
+      //Publish every block of the new structure
+      m_modeBlockGainsDirty.assign(Nb, 1);
+      m_modeBlockMCsDirty.assign(Nb, 1);
+      m_modeBlockLimsDirty.assign(Nb, 1);
+      m_gainBlocksStale = true;
+      m_mcBlocksStale = true;
+      m_limitBlocksStale = true;
+
       for(size_t n=0; n < Nb; ++n)
       {
          m_modeBlockStart[n] = modeBlockStart[n];
@@ -888,6 +917,9 @@ int userGainCtrl::allocate(const gainShmimT & dummy)
    
    pixget = getPixPointer<realT>(shmimMonitorT::m_dataType);
 
+   std::unique_lock<std::mutex> blockLock(m_modeBlockMutex);
+   m_gainBlocksStale = true;
+
    return 0;
 }
 
@@ -902,51 +934,12 @@ int userGainCtrl::processImage( void * curr_src,
 
    std::unique_lock<std::mutex> lock(m_modeBlockMutex);
 
-   realT * data = m_gainsCurrent.data();
-      
-   for(unsigned nn=0; nn < shmimMonitorT::m_width*shmimMonitorT::m_height; ++nn)
-   {
-      data[nn] = pixget(curr_src, nn);
-   }
-   
-   //update blocks here.
-   std::cerr << "gains updated\n";
-
-   for(int cc =0; cc < m_gainsCurrent.cols(); ++cc)
-      for(int rr=0; rr < m_gainsCurrent.rows(); ++rr)
-         std::cout << m_gainsCurrent(rr,cc) << " ";
-   std::cout << "\n";
-
-   for(size_t n =0; n < m_modeBlockStart.size(); ++n)
-   {
-      double mng = 0;
-
-      int NN = 0;
-      
-      for(int m =0; m < m_modeBlockN[n]; ++m)
-      {
-         if(m_modeBlockStart[n] + m >= m_gainsCurrent.rows()) break;
-         mng += m_gainsCurrent(m_modeBlockStart[n] + m,0);
-         ++NN;
-      }
-
-      m_modeBlockGains[n] = mng / NN; 
-
-      bool constant = true;
-      
-      for(int m =0; m < m_modeBlockN[n]; ++m)
-      {
-         if(m_modeBlockStart[n] + m >= m_gainsCurrent.rows()) break;
-         if(m_gainsCurrent(m_modeBlockStart[n] + m,0) != m_modeBlockGains[n])
-         {
-            constant = false;
-            break;
-         }
-      }
-
-      m_modeBlockGainsConstant[n] = constant;
+   if(m_modeBlockGainsDirty.size() != m_modeBlockGains.size()) m_modeBlockGainsDirty.assign(m_modeBlockGains.size(), 1);
 
-   }
+   //Copy the new values, recalculating only the blocks which changed
+   updateModeBlocks(m_gainsCurrent.data(), curr_src, pixget, shmimMonitorT::m_width*shmimMonitorT::m_height, m_modeBlockStart, m_modeBlockN,
+                    m_modeBlockGains, m_modeBlockGainsConstant, m_modeBlockGainsDirty, m_gainBlocksStale);
+   m_gainBlocksStale = false;
 
    lock.unlock();
 
@@ -1015,6 +1008,9 @@ int userGainCtrl::allocate(const multcoeffShmimT & dummy)
    
    mc_pixget = getPixPointer<realT>(mcShmimMonitorT::m_dataType);
 
+   std::unique_lock<std::mutex> blockLock(m_modeBlockMutex);
+   m_mcBlocksStale = true;
+
    return 0;
 }
 
@@ -1029,51 +1025,12 @@ int userGainCtrl::processImage( void * curr_src,
 
    std::unique_lock<std::mutex> lock(m_modeBlockMutex);
 
-   realT * data = m_mcsCurrent.data();
-      
-   for(unsigned nn=0; nn < mcShmimMonitorT::m_width*mcShmimMonitorT::m_height; ++nn)
-   {
-      data[nn] = mc_pixget(curr_src, nn);
-   }
-   
-   //update blocks here.
-   std::cerr << "multcoeff updated\n";
-
-   for(int cc =0; cc < m_mcsCurrent.cols(); ++cc)
-      for(int rr=0; rr < m_mcsCurrent.rows(); ++rr)
-         std::cout << m_mcsCurrent(rr,cc) << " ";
-   std::cout << "\n";
+   if(m_modeBlockMCsDirty.size() != m_modeBlockMCs.size()) m_modeBlockMCsDirty.assign(m_modeBlockMCs.size(), 1);
 
-
-   for(size_t n =0; n < m_modeBlockStart.size(); ++n)
-   {
-      double mng = 0;
-
-      int NN = 0;
-      for(int m =0; m < m_modeBlockN[n]; ++m)
-      {
-         if(m_modeBlockStart[n] + m >= m_mcsCurrent.rows()) break;
-         mng += m_mcsCurrent(m_modeBlockStart[n] + m,0);
-         ++NN;
-      }
-
-      m_modeBlockMCs[n] = mng / NN; 
-   
-
-      bool constant = true;
-      
-      for(int m =0; m < m_modeBlockN[n]; ++m)
-      {
-         if(m_modeBlockStart[n] + m >= m_mcsCurrent.rows()) break;
-         if(m_mcsCurrent(m_modeBlockStart[n] + m,0) != m_modeBlockMCs[n])
-         {
-            constant = false;
-            break;
-         }
-      }
-
-      m_modeBlockMCsConstant[n] = constant;
-   }
+   //Copy the new values, recalculating only the blocks which changed
+   updateModeBlocks(m_mcsCurrent.data(), curr_src, mc_pixget, mcShmimMonitorT::m_width*mcShmimMonitorT::m_height, m_modeBlockStart, m_modeBlockN,
+                    m_modeBlockMCs, m_modeBlockMCsConstant, m_modeBlockMCsDirty, m_mcBlocksStale);
+   m_mcBlocksStale = false;
 
    lock.unlock();
 
@@ -1142,6 +1099,9 @@ int userGainCtrl::allocate(const limitShmimT & dummy)
    
    limit_pixget = getPixPointer<realT>(limitShmimMonitorT::m_dataType);
 
+   std::unique_lock<std::mutex> blockLock(m_modeBlockMutex);
+   m_limitBlocksStale = true;
+
    return 0;
 }
 
@@ -1156,50 +1116,12 @@ int userGainCtrl::processImage( void * curr_src,
 
    std::unique_lock<std::mutex> lock(m_modeBlockMutex);
 
-   realT * data = m_limitsCurrent.data();
-      
-   for(unsigned nn=0; nn < limitShmimMonitorT::m_width*limitShmimMonitorT::m_height; ++nn)
-   {
-      data[nn] = limit_pixget(curr_src, nn);
-   }
-   
-   //update blocks here.
-   std::cerr << "limits updated\n";
-
-   for(int cc =0; cc < m_limitsCurrent.cols(); ++cc)
-      for(int rr=0; rr < m_limitsCurrent.rows(); ++rr)
-         std::cout << m_limitsCurrent(rr,cc) << " ";
-   std::cout << "\n";
-
-
-   for(size_t n =0; n < m_modeBlockStart.size(); ++n)
-   {
-      double mng = 0;
-
-      int NN = 0;
-      for(int m =0; m < m_modeBlockN[n]; ++m)
-      {
-         if(m_modeBlockStart[n] + m >= m_limitsCurrent.rows()) break;
-         mng += m_limitsCurrent(m_modeBlockStart[n] + m,0);
-         ++NN;
-      }
-
-      m_modeBlockLims[n] = mng / NN; 
+   if(m_modeBlockLimsDirty.size() != m_modeBlockLims.size()) m_modeBlockLimsDirty.assign(m_modeBlockLims.size(), 1);
 
-      bool constant = true;
-      
-      for(int m =0; m < m_modeBlockN[n]; ++m)
-      {
-         if(m_modeBlockStart[n] + m >= m_limitsCurrent.rows()) break;
-         if(m_limitsCurrent(m_modeBlockStart[n] + m,0) != m_modeBlockLims[n])
-         {
-            constant = false;
-            break;
-         }
-      }
-
-      m_modeBlockLimsConstant[n] = constant;
-   }
+   //Copy the new values, recalculating only the blocks which changed
+   updateModeBlocks(m_limitsCurrent.data(), curr_src, limit_pixget, limitShmimMonitorT::m_width*limitShmimMonitorT::m_height, m_modeBlockStart, m_modeBlockN,
+                    m_modeBlockLims, m_modeBlockLimsConstant, m_modeBlockLimsDirty, m_limitBlocksStale);
+   m_limitBlocksStale = false;
 
    lock.unlock();
 
@@ -71,6 +71,12 @@ protected:
    mx::improc::eigenCube<realT> m_wZModes;
    mx::improc::eigenImage<realT> m_woofer;
    mx::improc::eigenImage<realT> m_wMask;
+
+   dev::modalOffload<realT> m_projection; ///< The masked and normalized Zernike projection matrix
+
+   int m_projModes {-1}; ///< The number of modes m_projection was built with, -1 if it needs to be built.
+
+   bool m_projValid {false}; ///< Whether m_projection could be built for m_projModes.
    
 public:
    /// Default c'tor.
@@ -116,6 +122,15 @@ public:
    int processImage( void * curr_src,          ///< [in] pointer to start of current frame.
                      const dev::shmimT & dummy ///< [in] tag to differentiate shmimMonitor parents.
                    );
+
+   /// Build the projection matrix for the current number of modes.
+   /** Each row is a Zernike mode multiplied by the mask and divided by the normalization, so only the masked
+     * pixels are used.
+     *
+     * \returns 0 on success
+     * \returns -1 on error, which is logged.
+     */
+   int buildProjection();
    
 
 protected:
@@ -275,6 +290,9 @@ int w2tcsOffloader::allocate(const dev::shmimT & dummy)
       
    m_woofer.resize(shmimMonitorT::m_width, shmimMonitorT::m_height);
 
+   //Force a rebuild, which checks the sizes
+   m_projModes = -1;
+
    //state(stateCodes::OPERATING);
    
    return 0;
@@ -287,35 +305,65 @@ int w2tcsOffloader::processImage( void * curr_src,
 {
    static_cast<void>(dummy); //be unused (what is this?)
    
-   // Replace this:
-   // project zernikes onto avg image
-   // update INDI properties with coeffs
+   if(m_nModes != m_projModes)
+   {
+      m_projModes = m_nModes;
+      m_projValid = (buildProjection() == 0);
+   }
+
+   if(!m_projValid) return 0;
+
+   //project zernikes onto avg image, modes which shouldn't be offloaded (but might have been previously set) are zeroed
+   const dev::modalOffload<realT>::vectorT & coeffs = m_projection.apply((float *) curr_src);
 
    for(size_t i=0; i < m_zCoeffs.size(); ++i)
    {
-    /* update requested nModes and explicitly zero out any
-    modes that shouldn't be offloaded (but might have been
-    previously set)
-    */
-    if(i < m_nModes)
-    {
-       float coeff;
-       coeff = ( Eigen::Map<mx::improc::eigenImage<realT>>((float *)curr_src, shmimMonitorT::m_width, shmimMonitorT::m_height) * m_wZModes.image(i) * m_wMask).sum() / m_norm;
-       m_indiP_zCoeffs[m_elNames[i]] = m_gain * coeff;
-    }
-    else
-    {
-      m_indiP_zCoeffs[m_elNames[i]] = 0.;
-    }
+      if(i < (size_t) coeffs.size())
+      {
+         m_indiP_zCoeffs[m_elNames[i]] = m_gain * coeffs(i);
+      }
+      else
+      {
+         m_indiP_zCoeffs[m_elNames[i]] = 0.;
+      }
    }
 
    m_indiP_zCoeffs.setState (pcf::IndiProperty::Ok);
    m_indiDriver->sendSetProperty (m_indiP_zCoeffs);
 
+   return 0;
+}
+
+inline
+int w2tcsOffloader::buildProjection()
+{
+   int nm = std::min( (int) m_nModes, (int) m_wZModes.planes());
+
+   if(nm < 1)
+   {
+      return log<software_error,-1>({__FILE__, __LINE__, "no modes to offload"});
+   }
+
+   if(m_wZModes.rows() != m_wMask.rows() || m_wZModes.cols() != m_wMask.cols() || 
+          m_wZModes.rows()*m_wZModes.cols() != (Eigen::Index) shmimMonitorT::m_width*shmimMonitorT::m_height)
+   {
+      return log<software_error,-1>({__FILE__, __LINE__, "mode, mask, and woofer sizes do not match"});
+   }
+
+   dev::modalOffload<realT>::matrixT M(nm, m_wZModes.rows()*m_wZModes.cols());
+
+   for(int i = 0; i < nm; ++i)
+   {
+      mx::improc::eigenImage<realT> mm = m_wZModes.image(i) * m_wMask / m_norm;
+      M.row(i) = Eigen::Map<Eigen::Matrix<realT,1,-1>>(mm.data(), 1, mm.rows()*mm.cols());
+   }
 
-   // loop over something like this
-   //z0 = (im * basis.image(0)*mask).sum()/norm;
+   if(m_projection.setMatrix(M) < 0)
+   {
+      return log<software_error,-1>({__FILE__, __LINE__, "empty projection matrix"});
+   }
 
+   log<text_log>("built projection for " + std::to_string(nm) + " modes using " + std::to_string(m_projection.nUsed()) + " woofer pixels");
 
    return 0;
 }
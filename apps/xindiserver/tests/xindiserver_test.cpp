@@ -17,6 +17,8 @@ struct xindiserver_test
    void indiserver_p( xindiserver & xi, const int &p) {xi.indiserver_p = p;}
    void indiserver_v( xindiserver & xi, const int &v) {xi.indiserver_v = v;}
    void indiserver_x( xindiserver & xi, const bool &x) {xi.indiserver_x = x;}
+   void indiserver_e( xindiserver & xi, const bool &e) {xi.indiserver_e = e;}
+   void indiserver_c( xindiserver & xi, const float &c) {xi.indiserver_c = c;}
    void m_local(xindiserver & xi, const std::vector<std::string> & ml) {xi.m_local = ml;}
    void m_remote(xindiserver & xi, const std::vector<std::string> & mr) {xi.m_remote = mr;}
    
@@ -146,6 +148,31 @@ SCENARIO( "xindiserver constructs inserver options", "[xindiserver]" )
          REQUIRE(clargs[1] == "-x");
       }
       
+      WHEN("Option e provided")
+      {
+         std::vector<std::string> clargs;
+         xi_test.indiserver_e(xi, true);
+         
+         rv = xi.constructIndiserverCommand(clargs);
+         REQUIRE(rv == 0);
+         REQUIRE(clargs.size() == 2);
+         REQUIRE(clargs[0] == "indiserver");
+         REQUIRE(clargs[1] == "-e");
+      }
+      
+      WHEN("Option c provided with argument")
+      {
+         std::vector<std::string> clargs;
+         xi_test.indiserver_c(xi, 0.5);
+         
+         rv = xi.constructIndiserverCommand(clargs);
+         REQUIRE(rv == 0);
+         REQUIRE(clargs.size() == 3);
+         REQUIRE(clargs[0] == "indiserver");
+         REQUIRE(clargs[1] == "-c");
+         REQUIRE(clargs[2] == "0.5");
+      }
+      
       WHEN("All options provided")
       {
          std::vector<std::string> clargs;
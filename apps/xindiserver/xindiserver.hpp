@@ -126,6 +126,8 @@ protected:
    int indiserver_p {-1}; ///< The indiserver port (passed to indiserver)
    int indiserver_v {-1}; ///< The indiserver verbosity (passed to indiserver)
    bool indiserver_x {false}; ///< The indiserver terminate after last exit flag (passed to indiserver)
+   bool indiserver_e {false}; ///< The indiserver epoll event loop flag (passed to indiserver)
+   float indiserver_c {-1}; ///< The indiserver MB behind before coalescing sets (passed to indiserver)
    
    std::string m_driverPath; ///< The path to the local drivers
    std::vector<std::string> m_local; ///< List of local drivers passed in by config
@@ -247,6 +249,8 @@ void xindiserver::setupConfig()
    config.add("indiserver.p", "p", "", argType::Required, "indiserver", "p", false,  "int", "indiserver: alternate IP port, default 7624");
    config.add("indiserver.v", "v", "", argType::True, "indiserver", "v", false,  "int", "indiserver: log verbosity, -v, -vv or -vvv");
    config.add("indiserver.x", "x", "", argType::True, "indiserver", "x", false,  "bool", "exit after last client disconnects -- FOR PROFILING ONLY");
+   config.add("indiserver.c", "c", "", argType::Required, "indiserver", "c", false,  "float", "indiserver: coalesce sets to a client more than this many MB behind, 0 never, default 1");
+   config.add("indiserver.e", "e", "", argType::True, "indiserver", "e", false,  "bool", "indiserver: handle clients and drivers from one epoll event loop instead of per-connection threads");
    
    config.add("local.drivers","L", "local.drivers" , argType::Required, "local", "drivers", false,  "vector string", "List of local drivers to start.");
    config.add("remote.drivers","R", "remote.drivers" , argType::Required, "remote", "drivers", false,  "vector string", "List of remote drivers to start, in the form of name@tunnel, where tunnel is the name of a tunnel specified in sshTunnels.conf.");
@@ -268,6 +272,8 @@ void xindiserver::loadConfig()
    indiserver_v = config.verbosity("indiserver.v");
    
    config(indiserver_x, "indiserver.x");
+   config(indiserver_e, "indiserver.e");
+   config(indiserver_c, "indiserver.c");
    
    config(m_local, "local.drivers");
    config(m_remote, "remote.drivers");
@@ -304,6 +310,14 @@ int xindiserver::constructIndiserverCommand( std::vector<std::string> & indiserv
       if(indiserver_v >= 3) indiserverCommand.push_back("-vvv");
       
       if(indiserver_x == true) indiserverCommand.push_back("-x");
+      
+      if(indiserver_e == true) indiserverCommand.push_back("-e");
+      
+      if(indiserver_c >= 0) 
+      {
+         indiserverCommand.push_back("-c");
+         indiserverCommand.push_back(mx::ioutils::convertToString(indiserver_c));
+      }
    }
    catch(...)
    {
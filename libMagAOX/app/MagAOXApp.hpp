@@ -534,7 +534,6 @@ protected:
    {
       pcf::IndiProperty * property {0}; ///< A pointer to an INDI property.
       int (*callBack)( void *, const pcf::IndiProperty &) {0}; ///< The function to call for a new or set property.
-      bool m_defReceived {false}; ///< Flag indicating that a DefProperty has been received after a GetProperty.
    };
 
 
@@ -555,15 +554,30 @@ protected:
      */
    std::unordered_map< std::string, indiCallBack> m_indiNewCallBacks;
 
-   ///Map to hold the SetProperty indiCallBacks for this App, with fast lookup by property name.
+   ///The SetProperty indiCallBacks for this App, indexed by the id assigned at registration.
+   std::vector<indiCallBack> m_indiSetCallBacks;
+
+   ///Map from the key of each SetProperty to its id in m_indiSetCallBacks.
    /** The key for these is device.name
      */
-   std::unordered_map< std::string, indiCallBack> m_indiSetCallBacks;
+   std::unordered_map< std::string, size_t> m_indiSetIds;
+
+   ///Reusable key for looking up SetProperty ids, so each message does not allocate one.  Only used by the INDI driver thread.
+   std::string m_indiSetKey;
 
 protected:
    ///Flag indicating that all registered Set properties have been updated since last Get.
    bool m_allDefsReceived {false};
 
+   ///One bit per SetProperty id, set while a DefProperty has not been received since the last GetProperty.
+   std::vector<uint64_t> m_indiSetDefPending;
+
+   ///The number of bits set in m_indiSetDefPending.
+   size_t m_indiSetNDefPending {0};
+
+   ///Mutex for m_indiSetDefPending, which is set by the main loop and cleared by the INDI driver thread.
+   std::mutex m_indiSetDefMutex;
+
    ///Full path name of the INDI driver input FIFO.
    std::string m_driverInName;
 
@@ -575,6 +589,24 @@ protected:
      */
    std::string m_driverCtrlName;
 
+   ///Flag controlling whether set properties are sent to indiserver as binary frames.
+   /** Only works if the FIFOs are read by an indiserver which understands the frames (see indibin.h),
+     * which converts them back to XML for its clients.  Default is false.  Config with indi.binary=true.
+     */
+   bool m_indiBinary {false};
+
+   ///The maximum rate, in Hz, of set property messages for each property.  0 is no limit.
+   /** A property updated faster than this has its latest value sent once the interval has passed, by
+     * the INDI publisher thread.  Default is 0.  Config with indi.maxRate=X.
+     */
+   double m_indiMaxRate {0};
+
+   ///Names of the properties with their own maximum rate.  Config with indi.maxRateNames=name1,name2.
+   std::vector<std::string> m_indiMaxRateNames;
+
+   ///The maximum rates, in Hz, of the properties in m_indiMaxRateNames.  Config with indi.maxRates=X1,X2.
+   std::vector<double> m_indiMaxRates;
+
 public:
 
    /// Create a standard R/W INDI Text property with target and current elements.
@@ -813,7 +845,7 @@ protected:
      * compared to the stored value, or if the property state has changed.  
      * 
      * This comparison is done in the true
-     * type of the value.
+     * type of the value.  Numbers are compared as raw values, and a change no larger than the deadband is not sent.
      * 
      * For a property with multiple elements, you should use the vector version to minimize network traffic.
      */
@@ -821,7 +853,8 @@ protected:
    void updateIfChanged( pcf::IndiProperty & p, ///< [in/out] The property containing the element to possibly update
                          const std::string & el, ///< [in] The element name
                          const T & newVal, ///< [in] the new value
-                         pcf::IndiProperty::PropertyStateType ipState = pcf::IndiProperty::Ok
+                         pcf::IndiProperty::PropertyStateType ipState = pcf::IndiProperty::Ok, ///< [in] [optional] the new state
+                         double deadband = 0 ///< [in] [optional] the largest change in a number which is not sent
                       );
 
    /// Update an INDI property element value if it has changed.
@@ -869,7 +902,8 @@ protected:
    void updateIfChanged( pcf::IndiProperty & p, ///< [in/out] The property containing the element to possibly update
                          const std::string & el, ///< [in] Beginning of each element name
                          const std::vector<T> & newVals, ///< [in] the new values
-                         pcf::IndiProperty::PropertyStateType ipState = pcf::IndiProperty::Ok ///< [in] [optional] the new state
+                         pcf::IndiProperty::PropertyStateType ipState = pcf::IndiProperty::Ok, ///< [in] [optional] the new state
+                         double deadband = 0 ///< [in] [optional] the largest change in a number which is not sent
                       );
 
   /// Update an INDI property if values have changed.
@@ -885,7 +919,9 @@ protected:
    template<typename T>
    void updateIfChanged( pcf::IndiProperty & p, ///< [in/out] The property containing the element to possibly update
                          const std::vector<std::string> & els, ///< [in] String vector of element names
-                         const std::vector<T> & newVals ///< [in] the new values
+                         const std::vector<T> & newVals, ///< [in] the new values
+                         pcf::IndiProperty::PropertyStateType ipState = pcf::IndiProperty::Ok, ///< [in] [optional] the new state
+                         double deadband = 0 ///< [in] [optional] the largest change in a number which is not sent
                       );
 
    /// Get the target element value from an new property 
@@ -1235,6 +1271,14 @@ void MagAOXApp<_useINDI>::setupBasicConfig() //virtual
       config.add("power.targetElement", "", "power.targetElement", argType::Required, "power", "targetElement", false, "string", "INDI power target element name.  Default is \"target\", only need to specify if different.");
       config.add("power.powerOnWait", "", "power.powerOnWait", argType::Required, "power", "powerOnWait", false, "int", "Time after power-on to wait before continuing [sec].  Default is 0 sec, max is 3600 sec.");
    }
+
+   if(_useINDI)
+   {
+      config.add("indi.binary", "", "indi.binary", argType::Required, "indi", "binary", false, "bool", "Send set properties to indiserver as binary frames.  Requires an indiserver which accepts them.  Default is false.");
+      config.add("indi.maxRate", "", "indi.maxRate", argType::Required, "indi", "maxRate", false, "double", "The maximum rate [Hz] of updates of each INDI property.  The latest value is always sent.  Default is 0, no limit.");
+      config.add("indi.maxRateNames", "", "indi.maxRateNames", argType::Required, "indi", "maxRateNames", false, "vector<string>", "Names of INDI properties with their own maximum rate, given in indi.maxRates.");
+      config.add("indi.maxRates", "", "indi.maxRates", argType::Required, "indi", "maxRates", false, "vector<double>", "The maximum rates [Hz] of the properties in indi.maxRateNames.  0 is no limit.");
+   }
 }
 
 template<bool _useINDI>
@@ -1280,6 +1324,22 @@ void MagAOXApp<_useINDI>::loadBasicConfig() //virtual
          log<text_log>("powerOnWait longer than 1 hour.  Setting to 0.", logPrio::LOG_ERROR);
       }
    }
+
+   //-------- INDI --------//
+   if(_useINDI)
+   {
+      config(m_indiBinary, "indi.binary");
+      config(m_indiMaxRate, "indi.maxRate");
+      config(m_indiMaxRateNames, "indi.maxRateNames");
+      config(m_indiMaxRates, "indi.maxRates");
+
+      if(m_indiMaxRateNames.size() != m_indiMaxRates.size())
+      {
+         log<text_log>("indi.maxRateNames and indi.maxRates are not the same size.  Ignoring them.", logPrio::LOG_ERROR);
+         m_indiMaxRateNames.clear();
+         m_indiMaxRates.clear();
+      }
+   }
 }
 
 template<bool _useINDI>
@@ -2516,14 +2576,23 @@ int MagAOXApp<_useINDI>::registerIndiPropertySet( pcf::IndiProperty & prop,
    prop.setDevice(devName);
    prop.setName(propName);
 
-   callBackInsertResult result =  m_indiSetCallBacks.insert(callBackValueType( prop.createUniqueKey(), {&prop, callBack}));
-
    try 
    {
-      if(!result.second)
+      //The id is the index into m_indiSetCallBacks, and the bit in m_indiSetDefPending.
+      size_t id = m_indiSetCallBacks.size();
+
+      if(!m_indiSetIds.insert(std::make_pair(prop.createUniqueKey(), id)).second)
       {
          return log<software_error,-1>({__FILE__, __LINE__, "failed to insert INDI property: " + prop.createUniqueKey()});
       }
+
+      m_indiSetCallBacks.push_back({&prop, callBack});
+
+      std::lock_guard<std::mutex> lock(m_indiSetDefMutex);
+      m_indiSetDefPending.resize( id/64 + 1, 0);
+      m_indiSetDefPending[id/64] |= (uint64_t(1) << (id % 64));
+      ++m_indiSetNDefPending;
+      m_allDefsReceived = false;
    }
    catch( std::exception & e)
    {
@@ -2648,6 +2717,14 @@ int MagAOXApp<_useINDI>::startINDI()
       return -1;
    }
 
+   m_indiDriver->enableBinaryMode(m_indiBinary);
+
+   m_indiDriver->maxRate(m_indiMaxRate);
+   for(size_t n = 0; n < m_indiMaxRateNames.size(); ++n)
+   {
+      m_indiDriver->maxRate(m_indiMaxRateNames[n], m_indiMaxRates[n]);
+   }
+
    //======= Now we start talkin'
    m_indiDriver->activate();
    log<indidriver_start>();
@@ -2663,26 +2740,45 @@ void MagAOXApp<_useINDI>::sendGetPropertySetList(bool all)
    //Unless forced by all, we only do anything if allDefs are not received yet
    if(!all && m_allDefsReceived) return;
 
-   callBackIterator it = m_indiSetCallBacks.begin();
+   std::vector<uint64_t> pending;
 
-   int nowFalse = 0;
-   while(it != m_indiSetCallBacks.end() )
    {
-      if(all || it->second.m_defReceived == false)
+      std::lock_guard<std::mutex> lock(m_indiSetDefMutex);
+
+      if(all)
       {
-         if( it->second.property )
-         {
-            m_indiDriver->sendGetProperties( *(it->second.property) );
-         }
+         //Mark every property as waiting for its Def again
+         for(size_t n = 0; n < m_indiSetDefPending.size(); ++n) m_indiSetDefPending[n] = ~uint64_t(0);
 
-         it->second.m_defReceived = false;
-         ++nowFalse;
+         size_t nExtra = m_indiSetDefPending.size()*64 - m_indiSetCallBacks.size();
+         if(nExtra > 0) m_indiSetDefPending.back() >>= nExtra;
 
+         m_indiSetNDefPending = m_indiSetCallBacks.size();
+      }
+
+      m_allDefsReceived = (m_indiSetNDefPending == 0);
+      if(m_allDefsReceived) return;
+
+      //Copy so the driver thread is not held up while we send.
+      pending = m_indiSetDefPending;
+   }
+
+   //Walk only the bits which are set, so this is cheap once most Defs are in.
+   for(size_t n = 0; n < pending.size(); ++n)
+   {
+      uint64_t bits = pending[n];
+
+      while(bits)
+      {
+         size_t id = n*64 + __builtin_ctzll(bits);
+         bits &= bits - 1;
+
+         if( m_indiSetCallBacks[id].property )
+         {
+            m_indiDriver->sendGetProperties( *(m_indiSetCallBacks[id].property) );
+         }
       }
-      ++it;
    }
-   if(nowFalse != 0) m_allDefsReceived = false;
-   if(nowFalse == 0) m_allDefsReceived = true;
 }
 
 template<bool _useINDI>
@@ -2724,15 +2820,16 @@ void MagAOXApp<_useINDI>::handleGetProperties( const pcf::IndiProperty &ipRecv )
    }
 
    //Check if we actually have this.
-   if( m_indiNewCallBacks.count(ipRecv.getName()) == 0)
+   callBackIterator it = m_indiNewCallBacks.find(ipRecv.getName());
+   if( it == m_indiNewCallBacks.end())
    {
       return;
    }
 
    //Otherwise send just the requested property, if property is not null
-   if(m_indiNewCallBacks[ ipRecv.getName() ].property)
+   if(it->second.property)
    {
-      m_indiDriver->sendDefProperty( *(m_indiNewCallBacks[ ipRecv.getName() ].property) );
+      m_indiDriver->sendDefProperty( *(it->second.property) );
    }
    return;
 }
@@ -2744,13 +2841,14 @@ void MagAOXApp<_useINDI>::handleNewProperty( const pcf::IndiProperty &ipRecv )
    if(m_indiDriver == nullptr) return;
 
    //Check if this is a valid name for us.
-   if( m_indiNewCallBacks.count(ipRecv.getName()) == 0 )
+   callBackIterator it = m_indiNewCallBacks.find(ipRecv.getName());
+   if( it == m_indiNewCallBacks.end() )
    {
       ///\todo log invalid NewProperty request, though it probably can't get this far.
       return;
    }
 
-   int (*callBack)(void *, const pcf::IndiProperty &) = m_indiNewCallBacks[ ipRecv.getName() ].callBack;
+   int (*callBack)(void *, const pcf::IndiProperty &) = it->second.callBack;
 
    if(callBack) callBack( this, ipRecv);
 
@@ -2765,15 +2863,30 @@ void MagAOXApp<_useINDI>::handleSetProperty( const pcf::IndiProperty &ipRecv )
    if(!m_useINDI) return;
    if(m_indiDriver == nullptr) return;
 
-   std::string key = ipRecv.getDevice() + "." + ipRecv.getName();
+   //Build the key in place, so it only allocates when it grows.
+   m_indiSetKey.assign(ipRecv.getDevice());
+   m_indiSetKey += '.';
+   m_indiSetKey += ipRecv.getName();
 
    //Check if this is valid
-   if( m_indiSetCallBacks.count(key) > 0 )
+   std::unordered_map<std::string, size_t>::const_iterator it = m_indiSetIds.find(m_indiSetKey);
+   if( it != m_indiSetIds.end() )
    {
-      m_indiSetCallBacks[ key ].m_defReceived = true; //record that we got this Def/Set
+      size_t id = it->second;
+      uint64_t bit = uint64_t(1) << (id % 64);
+
+      //record that we got this Def/Set
+      {
+         std::lock_guard<std::mutex> lock(m_indiSetDefMutex);
+         if(m_indiSetDefPending[id/64] & bit)
+         {
+            m_indiSetDefPending[id/64] &= ~bit;
+            --m_indiSetNDefPending;
+         }
+      }
 
       //And call the callback
-      int (*callBack)(void *, const pcf::IndiProperty &) = m_indiSetCallBacks[ key ].callBack;
+      int (*callBack)(void *, const pcf::IndiProperty &) = m_indiSetCallBacks[id].callBack;
       if(callBack) callBack( this, ipRecv);
 
       ///\todo log an error here because callBack should not be null
@@ -2791,14 +2904,15 @@ template<typename T>
 void MagAOXApp<_useINDI>::updateIfChanged( pcf::IndiProperty & p,
                                            const std::string & el,
                                            const T & newVal, 
-                                           pcf::IndiProperty::PropertyStateType ipState
+                                           pcf::IndiProperty::PropertyStateType ipState,
+                                           double deadband
                                          )
 {
    if(!_useINDI) return;
 
    if(!m_indiDriver) return;
 
-   indi::updateIfChanged( p, el, newVal, m_indiDriver, ipState);
+   indi::updateIfChanged( p, el, newVal, m_indiDriver, ipState, deadband);
 }
 
 template<bool _useINDI>
@@ -2830,7 +2944,8 @@ template<typename T>
 void MagAOXApp<_useINDI>::updateIfChanged( pcf::IndiProperty & p,
                                            const std::string & el,
                                            const std::vector<T> & newVals,
-                                           pcf::IndiProperty::PropertyStateType ipState
+                                           pcf::IndiProperty::PropertyStateType ipState,
+                                           double deadband
                                          )
 {
    if(!_useINDI) return;
@@ -2842,21 +2957,23 @@ void MagAOXApp<_useINDI>::updateIfChanged( pcf::IndiProperty & p,
    {
       descriptors[index] += std::to_string(index);
    }
-   indi::updateIfChanged(p, descriptors, newVals, m_indiDriver);
+   indi::updateIfChanged(p, descriptors, newVals, m_indiDriver, ipState, deadband);
 }
 
 template<bool _useINDI>
 template<typename T>
 void MagAOXApp<_useINDI>::updateIfChanged( pcf::IndiProperty & p,
                                            const std::vector<std::string> & els,
-                                           const std::vector<T> & newVals
+                                           const std::vector<T> & newVals,
+                                           pcf::IndiProperty::PropertyStateType ipState,
+                                           double deadband
                                          )
 {
    if(!_useINDI) return;
 
    if(!m_indiDriver) return;
 
-   indi::updateIfChanged(p, els, newVals, m_indiDriver);
+   indi::updateIfChanged(p, els, newVals, m_indiDriver, ipState, deadband);
 }
 
 
@@ -13,11 +13,16 @@
  \todo test that restarting fpsCtrl doesn't scram this
  */
 
+#include <atomic>
+#include <mutex>
+
 #include <mx/improc/eigenImage.hpp>
 #include <mx/ioutils/fits/fitsFile.hpp>
 
 #include "../../ImageStreamIO/ImageStruct.hpp"
 
+#include "dmTransform.hpp"
+
 namespace MagAOX
 {
 namespace app
@@ -60,6 +65,12 @@ constexpr uint8_t ImageStreamTypeCode<double>()
   * Calls to this class's `setupConfig`, `loadConfig`, `appStartup`, `appLogic`, `appShutdown`, and `udpdateINDI`
   * functions must be placed in the derived class's functions of the same name.
   *
+  * Normally the channels `<shmimName>NN` are summed into `<shmimName>` by an external cacao dmcomb process, and this
+  * class commands the DM when `<shmimName>` is updated.  If `dm.combine` is true the channels are instead combined
+  * in this process: a thread per channel waits on its semaphore, updates the running sum with the change in that
+  * channel, and calls `commandDM` directly.  The combined command is still written to `<shmimName>` for other
+  * readers.  dmcomb must not be running for this DM in that case.
+  *
   * \ingroup appdev
   */
 template<class derivedT, typename realT>
@@ -101,6 +112,9 @@ protected:
    std::vector<std::string> m_satTriggerDevice;
    std::vector<std::string> m_satTriggerProperty;
 
+   bool m_combine {false}; ///< If true, the channels are combined in this process rather than by an external dmcomb.
+   int m_combChannels {0}; ///< The number of channels to combine if m_combine is true.
+
    ///@}
    
    
@@ -316,6 +330,30 @@ protected:
    
    mx::improc::eigenImage<uint8_t> m_instSatMap; ///< The instantaneous saturation map, 0/1, set by the commandDM() function of the derived class.
    mx::improc::eigenImage<uint16_t> m_accumSatMap; ///< The accumulated saturation map, which acccumulates for m_satAvgInt then is publised as a 0/1 image. 
+   
+   /** \name Saturation Handoff
+     * After each command the instantaneous saturation map is packed into a bitset and handed to the saturation thread
+     * through a lock-free triple buffer.  The DM thread owns the back buffer and the saturation thread owns the front
+     * buffer, and they swap with the middle buffer using an atomic exchange.  So the saturation thread never reads
+     * a map while it is being written.  If the saturation thread falls behind, it skips to the latest map.
+     * @{
+     */
+   static constexpr int m_satDirty = 4; ///< Flag set in m_satMiddle when the middle buffer holds a map not yet read.
+   
+   std::vector<uint64_t> m_satBits[3]; ///< The saturation bitsets, 1 bit per actuator.
+   int m_satBack {0}; ///< The buffer being written by the DM thread.
+   std::atomic<int> m_satMiddle {1}; ///< The buffer last published, with m_satDirty set if it has not been read.
+   int m_satFront {2}; ///< The buffer being read by the saturation thread.
+   
+   /// Pack m_instSatMap into the back buffer and publish it.  Called after each command.
+   void packSatMap();
+   
+   /// Add the front buffer to m_accumSatMap.
+   /** 
+     * \returns the number of saturated actuators in the map
+     */
+   int accumSatBits();
+   ///@}
    mx::improc::eigenImage<float> m_satPercMap; ///< Map of the percentage of time each actator was saturated during the avg. interval.
    
    IMAGE m_satImageStream; ///< The ImageStreamIO shared memory buffer for the sat map.
@@ -378,6 +416,90 @@ protected:
 
    ///@}
    
+   /** \name Channel Combiner
+     * Used when m_combine is true.
+     * @{
+     */
+   
+   /// A channel of the in-process combiner, with its thread.
+   struct combChannel
+   {
+      dm * m_dm {nullptr}; ///< The parent dm instance.
+      int m_chan {0}; ///< The channel number.
+      
+      mx::improc::eigenImage<realT> m_last; ///< The last content of this channel, which is subtracted from the sum when it changes.
+      
+      bool m_thInit {true}; ///< Synchronizer for thread startup, to allow priority setting to finish.
+      pid_t m_thID {0}; ///< The channel thread PID.
+      pcf::IndiProperty m_thProp; ///< The property to hold the channel thread details.
+      std::thread m_thread; ///< The channel thread.
+   };
+   
+   std::vector<combChannel> m_combChans; ///< The channels, sized in appStartup.
+   
+   std::mutex m_combMutex; ///< Serializes updates of the sum and calls to commandDM from the channel threads.
+   
+   mx::improc::eigenImage<double> m_combSum; ///< The running sum of the channels.
+   mx::improc::eigenImage<realT> m_combCmd; ///< The combined command sent to commandDM.
+   
+   uint64_t m_combUpdates {0}; ///< Number of channel updates since the last full re-sum.
+   
+   static constexpr uint64_t m_combResumInterval {10000}; ///< The sum is recalculated from all channels after this many updates, to limit rounding drift.
+   
+   IMAGE m_combImageStream; ///< The ImageStreamIO buffer for publishing the combined command to <shmimName>.
+   bool m_combOpened {false}; ///< Whether m_combImageStream is open.
+   
+   /// Open, or create if needed, the combined command stream.
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int combOpen();
+   
+   /// Seed the sum and each channel's last content from the current content of the channel streams.
+   /** Channels which do not exist yet, or do not match the DM, are left at zero.  They are added when their
+     * thread opens them.  Must be called with m_combMutex locked, after m_combSum and the m_last are sized.
+     */
+   void combSeed();
+
+   /// Update the sum with new content of one channel, command the DM, and publish the combined command.
+   /** Must be called with m_combMutex locked.
+     */
+   void combUpdate( combChannel & ch,  ///< [in] the channel
+                    const realT * src, ///< [in] the channel's new content
+                    const timespec & wt ///< [in] the write time of the channel's new content, for latency telemetry
+                  );
+   
+   ///Thread starter, called by MagAOXApp::threadStart on thread construction.  Calls combThreadExec.
+   static void combThreadStart( combChannel * c /**< [in] the channel to run */);
+   
+   /// Execute a channel thread
+   void combThreadExec( combChannel & ch /**< [in] the channel to run */);
+   
+   ///@}
+   
+   /** \name Command Latency
+     * The time from the latest channel write to the completion of commandDM, for both the internal and external
+     * combine paths.  In the external path the channels are mapped only to read their write times.
+     * @{
+     */
+   std::vector<IMAGE> m_latChannels; ///< The channels, mapped for their write times in the external path.
+   
+   std::mutex m_latMutex; ///< Protects the latency accumulators.
+   double m_latSum {0}; ///< Sum of latencies, in seconds, since the last update.
+   double m_latMax {0}; ///< Maximum latency, in seconds, since the last update.
+   uint64_t m_latN {0}; ///< Number of latencies since the last update.
+   
+   /// Record a command latency
+   void recordLatency( const timespec & wt /**< [in] the channel write time*/);
+   
+   /// Open the channels to read their write times for the external path.
+   void openLatChannels();
+   
+   /// Close the channels opened by openLatChannels.
+   void closeLatChannels();
+   ///@}
+   
 protected:
    
     /** \name INDI 
@@ -387,6 +509,8 @@ protected:
 protected:
    //declare our properties
    
+   pcf::IndiProperty m_indiP_combLatency; ///< Reports the command latency statistics, in microseconds.
+   
    pcf::IndiProperty m_indiP_flat; ///< Property used to set and report the current flat
    
    pcf::IndiProperty m_indiP_init;
@@ -602,6 +726,9 @@ void dm<derivedT,realT>::setupConfig(mx::app::appConfigurator & config)
    config.add("dm.satTriggerDevice", "", "dm.satTriggerDevice", argType::Required, "dm", "satTriggerDevice", false, "vector<string>", "Device(s) with a toggle switch to toggle on saturation trigger.");
    config.add("dm.satTriggerProperty", "", "dm.satTriggerProperty", argType::Required, "dm", "satTriggerProperty", false, "vector<string>", "Property with a toggle switch to toggle on saturation trigger, one per entry in satTriggerDevice.");
 
+   config.add("dm.combine", "", "dm.combine", argType::Required, "dm", "combine", false, "bool", "If true, combine the DM channels in this process instead of using an external dmcomb.  Default is false.");
+   config.add("dm.combineChannels", "", "dm.combineChannels", argType::Required, "dm", "combineChannels", false, "int", "The number of channels to combine if combine is true.  Channels are shmimName with NN appended.");
+
 }
 
 template<class derivedT, typename realT>
@@ -674,6 +801,9 @@ void dm<derivedT,realT>::loadConfig(mx::app::appConfigurator & config)
    config(m_intervalSatCountThreshold, "dm.intervalSatCountThreshold"); 
    config(m_satTriggerDevice, "dm.satTriggerDevice");
    config(m_satTriggerProperty, "dm.satTriggerProperty");
+   
+   config(m_combine, "dm.combine");
+   config(m_combChannels, "dm.combineChannels");
 }
    
 
@@ -805,6 +935,55 @@ int dm<derivedT,realT>::appStartup()
       return -1;
    }
    
+   derived().createROIndiNumber( m_indiP_combLatency, "combine_latency", "Command Latency [us]", "DM");
+   indi::addNumberElement<int>( m_indiP_combLatency, "internal", 0, 1, 1, "%d");
+   indi::addNumberElement<double>( m_indiP_combLatency, "mean", 0, std::numeric_limits<double>::max(), 0, "%0.1f");
+   indi::addNumberElement<double>( m_indiP_combLatency, "max", 0, std::numeric_limits<double>::max(), 0, "%0.1f");
+   indi::addNumberElement<double>( m_indiP_combLatency, "count", 0, std::numeric_limits<double>::max(), 1, "%0.0f");
+   m_indiP_combLatency["internal"] = (int) m_combine;
+   
+   if( derived().registerIndiPropertyReadOnly( m_indiP_combLatency ) < 0)
+   {
+      #ifndef DM_TEST_NOLOG
+      derivedT::template log<software_error>({__FILE__,__LINE__});
+      #endif
+      return -1;
+   }
+   
+   if(m_combine)
+   {
+      if(m_combChannels <= 0)
+      {
+         derivedT::template log<software_critical>({__FILE__,__LINE__, "dm.combineChannels must be > 0 if dm.combine is true"});
+         return -1;
+      }
+      
+      //Create the combined stream if dmcomb has never run, so the shmimMonitor can allocate
+      if(combOpen() < 0)
+      {
+         derivedT::template log<software_error>({__FILE__, __LINE__});
+         return -1;
+      }
+      
+      m_combChans = std::vector<combChannel>(m_combChannels);
+      
+      for(int n = 0; n < m_combChannels; ++n)
+      {
+         m_combChans[n].m_dm = this;
+         m_combChans[n].m_chan = n;
+         
+         char nstr[16];
+         snprintf(nstr, sizeof(nstr), "comb%02d", n);
+         
+         if(derived().threadStart( m_combChans[n].m_thread, m_combChans[n].m_thInit, m_combChans[n].m_thID, m_combChans[n].m_thProp, derived().m_smThreadPrio, 
+                                        derived().m_smCpuset, nstr, &m_combChans[n], combThreadStart) < 0)
+         {
+            derivedT::template log<software_error, -1>({__FILE__, __LINE__});
+            return -1;
+         }
+      }
+   }
+   
    return 0;
 
 }
@@ -829,6 +1008,29 @@ int dm<derivedT,realT>::appLogic()
       m_intervalSatTrip = false;
    }
    
+   for(size_t n = 0; n < m_combChans.size(); ++n)
+   {
+      if(pthread_tryjoin_np(m_combChans[n].m_thread.native_handle(),0) == 0)
+      {
+         derivedT::template log<software_error>({__FILE__, __LINE__, "combiner thread " + std::to_string(n) + " has exited"});
+         return -1;
+      }
+   }
+   
+   double latMean = 0, latMax = 0;
+   uint64_t latN;
+   {
+      std::lock_guard<std::mutex> lock(m_latMutex);
+      latN = m_latN;
+      if(m_latN > 0) latMean = m_latSum/m_latN;
+      latMax = m_latMax;
+      m_latSum = 0;
+      m_latMax = 0;
+      m_latN = 0;
+   }
+   
+   derived().updateIfChanged(m_indiP_combLatency, std::vector<std::string>({"mean", "max", "count"}), std::vector<double>({latMean*1e6, latMax*1e6, (double) latN}));
+   
    return 0;
 
 }
@@ -849,6 +1051,29 @@ int dm<derivedT,realT>::appShutdown()
       }
    }
    
+   for(size_t n = 0; n < m_combChans.size(); ++n)
+   {
+      if(m_combChans[n].m_thread.joinable())
+      {
+         pthread_kill(m_combChans[n].m_thread.native_handle(), SIGUSR1);
+         try
+         {
+            m_combChans[n].m_thread.join(); //this will throw if it was already joined
+         }
+         catch(...)
+         {
+         }
+      }
+   }
+   
+   if(m_combOpened)
+   {
+      ImageStreamIO_closeIm(&m_combImageStream);
+      m_combOpened = false;
+   }
+   
+   closeLatChannels();
+   
    return 0;
 }
 
@@ -930,8 +1155,18 @@ int dm<derivedT,realT>::allocate( const dev::shmimT & sp)
    
    if(err) return -1;
    
-   m_instSatMap.resize(m_dmWidth,m_dmHeight);
-   m_instSatMap.setZero();
+   {
+      //The channel threads may be in commandDM and packSatMap, which they call with m_combMutex locked
+      std::lock_guard<std::mutex> lock(m_combMutex);
+      
+      m_instSatMap.resize(m_dmWidth,m_dmHeight);
+      m_instSatMap.setZero();
+   
+      for(int n = 0; n < 3; ++n)
+      {
+         m_satBits[n].assign( (m_dmWidth*m_dmHeight + 63)/64, 0);
+      }
+   }
    
    m_accumSatMap.resize(m_dmWidth,m_dmHeight);
    m_accumSatMap.setZero();
@@ -946,6 +1181,29 @@ int dm<derivedT,realT>::allocate( const dev::shmimT & sp)
       return -1;
    }
    
+   if(m_combine)
+   {
+      std::lock_guard<std::mutex> lock(m_combMutex);
+      
+      //The channel threads wait for these to be sized before opening their channels
+      m_combSum.resize(m_dmWidth, m_dmHeight);
+      m_combSum.setZero();
+      m_combCmd.resize(m_dmWidth, m_dmHeight);
+      m_combCmd.setZero();
+      for(size_t n = 0; n < m_combChans.size(); ++n)
+      {
+         m_combChans[n].m_last.resize(m_dmWidth, m_dmHeight);
+         m_combChans[n].m_last.setZero();
+      }
+
+      //Threads already waiting on their channels only see the next write, so start from what is there now
+      combSeed();
+   }
+   else
+   {
+      openLatChannels();
+   }
+   
    return 0;
 }
 
@@ -956,6 +1214,9 @@ int dm<derivedT,realT>::processImage( void * curr_src,
 {
    static_cast<void>(sp); //be unused
    
+   //The channel threads command the DM, and the update of <shmimName> is our own.
+   if(m_combine) return 0;
+   
    int rv = derived().commandDM( curr_src );
    
    if(rv < 0)
@@ -963,6 +1224,20 @@ int dm<derivedT,realT>::processImage( void * curr_src,
       derivedT::template log<software_critical>({__FILE__, __LINE__, errno, rv, "Error from commandDM"});
       return rv;
    }
+   
+   packSatMap();
+   
+   if(m_latChannels.size() > 0)
+   {
+      timespec wt = m_latChannels[0].md[0].writetime;
+      for(size_t n = 1; n < m_latChannels.size(); ++n)
+      {
+         const timespec & cwt = m_latChannels[n].md[0].writetime;
+         if(cwt.tv_sec > wt.tv_sec || (cwt.tv_sec == wt.tv_sec && cwt.tv_nsec > wt.tv_nsec)) wt = cwt;
+      }
+      recordLatency(wt);
+   }
+   
    //Tell the sat thread to get going
    if(sem_post(&m_satSemaphore) < 0)
    {
@@ -1692,6 +1967,377 @@ int dm<derivedT,realT>::clearSat()
    return 0;
 }
 
+template<class derivedT, typename realT>
+int dm<derivedT,realT>::combOpen()
+{
+   if(m_combOpened) return 0;
+   
+   char SM_fname[200];
+   ImageStreamIO_filename(SM_fname, sizeof(SM_fname), derived().m_shmimName.c_str());
+   
+   int SM_fd = open(SM_fname, O_RDWR);
+   if(SM_fd == -1)
+   {
+      //Nobody has created it, so we do
+      uint32_t imsize[3] = {m_dmWidth, m_dmHeight, 1};
+      if(ImageStreamIO_createIm_gpu(&m_combImageStream, derived().m_shmimName.c_str(), 3, imsize, m_dmDataType, -1, 1, IMAGE_NB_SEMAPHORE, 0, CIRCULAR_BUFFER | ZAXIS_TEMPORAL, 0) != 0)
+      {
+         return derivedT::template log<software_error, -1>({__FILE__,__LINE__, "could not create " + derived().m_shmimName});
+      }
+   }
+   else
+   {
+      close(SM_fd);
+      if(ImageStreamIO_openIm(&m_combImageStream, derived().m_shmimName.c_str()) != 0)
+      {
+         return derivedT::template log<software_error, -1>({__FILE__,__LINE__, "could not open " + derived().m_shmimName});
+      }
+   }
+   
+   m_combOpened = true;
+   
+   return 0;
+}
+
+template<class derivedT, typename realT>
+void dm<derivedT,realT>::combSeed()
+{
+   const size_t N = m_dmWidth*m_dmHeight;
+
+   double * sum = m_combSum.data();
+
+   for(size_t c = 0; c < m_combChans.size(); ++c)
+   {
+      char nstr[16];
+      snprintf(nstr, sizeof(nstr), "%02d", m_combChans[c].m_chan);
+      std::string chName = derived().m_shmimName + nstr;
+
+      char SM_fname[200];
+      ImageStreamIO_filename(SM_fname, sizeof(SM_fname), chName.c_str());
+
+      int SM_fd = open(SM_fname, O_RDWR);
+      if(SM_fd == -1) continue;
+      close(SM_fd);
+
+      IMAGE chImage;
+      if(ImageStreamIO_openIm(&chImage, chName.c_str()) != 0) continue;
+
+      if(chImage.md[0].size[0] == m_dmWidth && chImage.md[0].size[1] == m_dmHeight && chImage.md[0].datatype == m_dmDataType)
+      {
+         const realT * src = (realT *) chImage.array.raw;
+         realT * last = m_combChans[c].m_last.data();
+         for(size_t n = 0; n < N; ++n)
+         {
+            last[n] = src[n];
+            sum[n] += src[n];
+         }
+      }
+
+      ImageStreamIO_closeIm(&chImage);
+   }
+
+   realT * cmd = m_combCmd.data();
+   for(size_t n = 0; n < N; ++n) cmd[n] = sum[n];
+
+   m_combUpdates = 0;
+}
+
+template<class derivedT, typename realT>
+void dm<derivedT,realT>::combUpdate( combChannel & ch,
+                                     const realT * src,
+                                     const timespec & wt
+                                   )
+{
+   const size_t N = m_dmWidth*m_dmHeight;
+   
+   double * sum = m_combSum.data();
+   realT * last = ch.m_last.data();
+   realT * cmd = m_combCmd.data();
+   
+   if(++m_combUpdates >= m_combResumInterval)
+   {
+      memcpy(last, src, N*sizeof(realT));
+      
+      m_combSum.setZero();
+      for(size_t c = 0; c < m_combChans.size(); ++c)
+      {
+         const realT * cl = m_combChans[c].m_last.data();
+         for(size_t n = 0; n < N; ++n) sum[n] += cl[n];
+      }
+      m_combUpdates = 0;
+      
+      for(size_t n = 0; n < N; ++n) cmd[n] = sum[n];
+   }
+   else
+   {
+      //Subtract the old content of this channel and add the new
+      #pragma omp simd
+      for(size_t n = 0; n < N; ++n)
+      {
+         sum[n] += static_cast<double>(src[n]) - last[n];
+         last[n] = src[n];
+         cmd[n] = sum[n];
+      }
+   }
+   
+   int rv = derived().commandDM( cmd );
+   
+   if(rv < 0)
+   {
+      derivedT::template log<software_critical>({__FILE__, __LINE__, errno, rv, "Error from commandDM"});
+      return;
+   }
+   
+   packSatMap();
+   
+   recordLatency(wt);
+   
+   if(sem_post(&m_satSemaphore) < 0)
+   {
+      derivedT::template log<software_critical>({__FILE__, __LINE__, errno, 0, "Error posting to semaphore"});
+   }
+   
+   //Publish the combined command for compatibility with dmcomb.
+   if(combOpen() < 0) return;
+   
+   m_combImageStream.md->write=1;
+   memcpy(m_combImageStream.array.raw, cmd, N*sizeof(realT));
+   clock_gettime(CLOCK_REALTIME, &m_combImageStream.md->writetime);
+   m_combImageStream.md->atime = wt;
+   m_combImageStream.md->cnt0++;
+   m_combImageStream.md->write=0;
+   ImageStreamIO_sempost(&m_combImageStream,-1);
+}
+
+template<class derivedT, typename realT>
+void dm<derivedT,realT>::combThreadStart( combChannel * c )
+{
+   c->m_dm->combThreadExec(*c);
+}
+
+template<class derivedT, typename realT>
+void dm<derivedT,realT>::combThreadExec( combChannel & ch )
+{
+   ch.m_thID = syscall(SYS_gettid);
+   
+   //Wait for the thread starter to finish initializing this thread.
+   while(ch.m_thInit == true && derived().shutdown() == 0)
+   {
+      sleep(1);
+   }
+   
+   char nstr[16];
+   snprintf(nstr, sizeof(nstr), "%02d", ch.m_chan);
+   std::string chName = derived().m_shmimName + nstr;
+   
+   char SM_fname[200];
+   ImageStreamIO_filename(SM_fname, sizeof(SM_fname), chName.c_str());
+   
+   int semNum = 5;
+   
+   while(!derived().shutdown())
+   {
+      //Wait for allocation, and for the channel to exist
+      if(derived().state() != stateCodes::OPERATING || (uint32_t) ch.m_last.rows() != m_dmWidth || (uint32_t) ch.m_last.cols() != m_dmHeight)
+      {
+         sleep(1);
+         continue;
+      }
+      
+      int SM_fd = open(SM_fname, O_RDWR);
+      if(SM_fd == -1)
+      {
+         sleep(1);
+         continue;
+      }
+      close(SM_fd);
+      
+      IMAGE chImage;
+      if(ImageStreamIO_openIm(&chImage, chName.c_str()) != 0)
+      {
+         sleep(1);
+         continue;
+      }
+      
+      if(chImage.md[0].size[0] != m_dmWidth || chImage.md[0].size[1] != m_dmHeight || chImage.md[0].datatype != m_dmDataType || chImage.md[0].sem <= semNum)
+      {
+         ImageStreamIO_closeIm(&chImage);
+         derivedT::template log<software_error>({__FILE__,__LINE__, chName + " does not match the DM, or is not ready"});
+         sleep(1);
+         continue;
+      }
+      
+      semNum = ImageStreamIO_getsemwaitindex(&chImage, semNum);
+      if(semNum < 0)
+      {
+         ImageStreamIO_closeIm(&chImage);
+         derivedT::template log<software_critical>({__FILE__,__LINE__, "No valid semaphore found for " + chName + ". Source process will need to be restarted."});
+         return;
+      }
+      
+      ImageStreamIO_semflush(&chImage, semNum);
+      
+      //Pick up the current content
+      {
+         std::lock_guard<std::mutex> lock(m_combMutex);
+         combUpdate(ch, (realT *) chImage.array.raw, chImage.md[0].writetime);
+      }
+      
+      while(!derived().shutdown() && derived().state() == stateCodes::OPERATING)
+      {
+         timespec ts;
+         if(clock_gettime(CLOCK_REALTIME, &ts) < 0)
+         {
+            derivedT::template log<software_critical>({__FILE__,__LINE__,errno,0,"clock_gettime"}); 
+            break;
+         }
+         ts.tv_sec += 1;
+         
+         if(sem_timedwait(chImage.semptr[semNum], &ts) == 0)
+         {
+            std::lock_guard<std::mutex> lock(m_combMutex);
+            if((uint32_t) ch.m_last.rows() != m_dmWidth || (uint32_t) ch.m_last.cols() != m_dmHeight) break; //reallocated
+            combUpdate(ch, (realT *) chImage.array.raw, chImage.md[0].writetime);
+         }
+         else
+         {
+            if(chImage.md[0].sem <= 0) break; //Indicates that the server has cleaned up.
+            
+            if(errno == EINTR) continue; //check for shutdown
+            
+            if(errno != ETIMEDOUT)
+            {
+               derivedT::template log<software_error>({__FILE__, __LINE__,errno, "sem_timedwait"});
+               break;
+            }
+         }
+      }
+      
+      chImage.semReadPID[semNum] = 0; //release semaphore
+      ImageStreamIO_closeIm(&chImage);
+   }
+}
+
+template<class derivedT, typename realT>
+void dm<derivedT,realT>::recordLatency( const timespec & wt )
+{
+   timespec now;
+   clock_gettime(CLOCK_REALTIME, &now);
+   
+   double lat = (now.tv_sec - wt.tv_sec) + (now.tv_nsec - wt.tv_nsec)/1e9;
+   
+   if(lat < 0) return; //in the external path a channel can be written after the command it triggered
+   
+   std::lock_guard<std::mutex> lock(m_latMutex);
+   m_latSum += lat;
+   if(lat > m_latMax) m_latMax = lat;
+   ++m_latN;
+}
+
+template<class derivedT, typename realT>
+void dm<derivedT,realT>::openLatChannels()
+{
+   closeLatChannels();
+   
+   for(int n = 0; n < m_channels; ++n)
+   {
+      char nstr[16];
+      snprintf(nstr, sizeof(nstr), "%02d", n);
+      std::string chName = derived().m_shmimName + nstr;
+      
+      IMAGE chImage;
+      if(ImageStreamIO_openIm(&chImage, chName.c_str()) != 0) continue; //we just skip it, this is only telemetry
+      
+      m_latChannels.push_back(chImage);
+   }
+}
+
+template<class derivedT, typename realT>
+void dm<derivedT,realT>::closeLatChannels()
+{
+   for(size_t n = 0; n < m_latChannels.size(); ++n)
+   {
+      ImageStreamIO_closeIm(&m_latChannels[n]);
+   }
+   m_latChannels.clear();
+}
+
+template<class derivedT, typename realT>
+void dm<derivedT,realT>::packSatMap()
+{
+   const size_t N = m_instSatMap.rows()*m_instSatMap.cols();
+   const size_t nwords = m_satBits[m_satBack].size();
+   
+   if(nwords*64 < N) return; //not allocated yet
+   
+   const uint8_t * sat = m_instSatMap.data();
+   uint64_t * bits = m_satBits[m_satBack].data();
+   
+   for(size_t w = 0; w < nwords; ++w)
+   {
+      size_t n0 = w*64;
+      size_t nb = (N - n0 < 64) ? N - n0 : 64;
+      
+      uint64_t word = 0;
+      #pragma omp simd reduction(|:word)
+      for(size_t b = 0; b < nb; ++b)
+      {
+         word |= static_cast<uint64_t>(sat[n0+b] != 0) << b;
+      }
+      bits[w] = word;
+   }
+   
+   //Publish, and take the previous middle buffer as the new back buffer
+   m_satBack = m_satMiddle.exchange(m_satBack | m_satDirty, std::memory_order_acq_rel) & ~m_satDirty;
+}
+
+template<class derivedT, typename realT>
+int dm<derivedT,realT>::accumSatBits()
+{
+   const size_t N = m_accumSatMap.rows()*m_accumSatMap.cols();
+   const size_t nwords = m_satBits[m_satFront].size();
+   
+   if(nwords*64 < N) return 0;
+   
+   const uint64_t * bits = m_satBits[m_satFront].data();
+   uint16_t * accum = m_accumSatMap.data();
+   
+   int nsat = 0;
+   
+   for(size_t w = 0; w < nwords; ++w)
+   {
+      uint64_t word = bits[w];
+      if(word == 0) continue;
+      
+      int nw = __builtin_popcountll(word);
+      nsat += nw;
+      
+      uint16_t * acc = accum + w*64;
+      
+      if(nw > 8)
+      {
+         //Dense: add every bit in a vectorized pass.  The padding bits of the last word are always 0.
+         size_t nb = (N - w*64 < 64) ? N - w*64 : 64;
+         #pragma omp simd
+         for(size_t b = 0; b < nb; ++b)
+         {
+            acc[b] += (word >> b) & 1;
+         }
+      }
+      else
+      {
+         //Sparse: visit only the set bits
+         while(word)
+         {
+            ++acc[__builtin_ctzll(word)];
+            word &= word - 1;
+         }
+      }
+   }
+   
+   return nsat;
+}
+
 template<class derivedT, typename realT>
 void dm<derivedT,realT>::satThreadStart(dm *d)
 {
@@ -1753,14 +2399,12 @@ void dm<derivedT,realT>::satThreadExec()
       //Wait on semaphore
       if(sem_timedwait(&m_satSemaphore, &ts) == 0)
       {
-         //not a timeout -->accumulate
-         for(int rr=0; rr < m_instSatMap.rows(); ++rr)
-         {
-            for(int cc=0; cc< m_instSatMap.cols(); ++cc)
-            {
-               m_accumSatMap(rr,cc) += m_instSatMap(rr,cc);
-            }
-         }
+         //not a timeout --> take the latest map if there is a new one, and accumulate
+         if( !(m_satMiddle.load(std::memory_order_acquire) & m_satDirty) ) continue;
+         
+         m_satFront = m_satMiddle.exchange(m_satFront, std::memory_order_acq_rel) & ~m_satDirty;
+         
+         accumSatBits();
          ++naccum;
 
          // If less than avg int --> go back and wait again
@@ -1775,7 +2419,7 @@ void dm<derivedT,realT>::satThreadExec()
          {
             for(int cc=0; cc< m_instSatMap.cols(); ++cc)
             {
-               m_satPercMap(rr,cc) = m_accumSatMap(rr,cc)/naccum;  
+               m_satPercMap(rr,cc) = static_cast<float>(m_accumSatMap(rr,cc))/naccum;  
                if(m_satPercMap(rr,cc) >= m_percThreshold) ++m_overSatAct;         
                satmap(rr,cc) = (m_accumSatMap(rr,cc) > 0); //it's  1/0 map
             }
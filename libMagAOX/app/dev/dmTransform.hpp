@@ -0,0 +1,216 @@
+/** \file dmTransform.hpp
+  * \brief Conversion of DM shmim commands to driver command vectors.
+  *
+  * \ingroup app_files
+  */
+
+#ifndef dmTransform_hpp
+#define dmTransform_hpp
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+namespace MagAOX
+{
+namespace app
+{
+namespace dev
+{
+
+/// Transfer function for DMs commanded with a signed fractional stroke, e.g. ALPAO.
+/** The mean is removed, and the command is clipped to [-1,1] and passed through unchanged.
+  *
+  * A transfer policy for dmTransform must provide the members shown here.
+  *
+  * \ingroup appdev
+  */
+struct dmLinearTransfer
+{
+   static constexpr bool removeMean = true; ///< Whether the mean of the scaled command is subtracted before clipping.
+
+   /// The minimum command, below which an actuator is saturated.
+   template<typename T>
+   static constexpr T minVal()
+   {
+      return -1;
+   }
+
+   /// The maximum command, above which an actuator is saturated.
+   template<typename T>
+   static constexpr T maxVal()
+   {
+      return 1;
+   }
+
+   /// Apply the transfer function to a clipped command.
+   template<typename T>
+   static T apply(T x)
+   {
+      return x;
+   }
+};
+
+/// Transfer function for electrostatic DMs commanded with a fractional voltage, e.g. BMC.
+/** The scaled command is the squared fractional voltage, so it is clipped to [0,1] and the square root is taken
+  * to approximate the voltage-displacement curve.
+  *
+  * \ingroup appdev
+  */
+struct dmSqrtTransfer
+{
+   static constexpr bool removeMean = false; ///< Whether the mean of the scaled command is subtracted before clipping.
+
+   /// The minimum command, below which an actuator is saturated.
+   template<typename T>
+   static constexpr T minVal()
+   {
+      return 0;
+   }
+
+   /// The maximum command, above which an actuator is saturated.
+   template<typename T>
+   static constexpr T maxVal()
+   {
+      return 1;
+   }
+
+   /// Apply the transfer function to a clipped command.
+   template<typename T>
+   static T apply(T x)
+   {
+      return sqrt(x);
+   }
+};
+
+/// Converts a DM shmim command to the driver's command vector.
+/** The actuator mapping is compiled once into gather indices for the addressable actuators.  Each frame is then
+  * converted in one pass which gathers, scales, biases, clips, applies the transfer function, counts saturation, and
+  * writes the instantaneous saturation map.  If the transfer policy removes the mean, one more gather pass is needed
+  * first to calculate it.  The loop body is branchless and marked `omp simd` so that it vectorizes, using hardware
+  * gather and scatter where available.
+  *
+  * Actuators with mapping -1 are addressable but ignored, and are always commanded to 0.
+  *
+  * \tparam outT the type of the driver's command vector
+  * \tparam transferT the transfer policy, e.g. dmLinearTransfer or dmSqrtTransfer
+  *
+  * \ingroup appdev
+  */
+template<typename outT, class transferT>
+class dmTransform
+{
+protected:
+   std::vector<uint32_t> m_src; ///< The shmim (and saturation map) index of each addressable actuator.
+   std::vector<uint32_t> m_dst; ///< The command vector index of each addressable actuator.
+   std::vector<uint32_t> m_ignored; ///< The command vector indices of the ignored actuators.
+
+   size_t m_nAct {0}; ///< The total number of actuators in the command vector.
+
+   outT m_scale {1}; ///< The scale applied to the shmim command.
+   outT m_bias {0}; ///< The bias added after scaling and mean removal.
+
+public:
+
+   /// Compile the actuator mapping.
+   /**
+     * \returns 0 on success
+     * \returns -1 if \p mapping is null.
+     */
+   int setup( const int * mapping, ///< [in] the shmim index of each actuator in the command vector, -1 if ignored
+              size_t nAct,         ///< [in] the number of actuators in the command vector
+              outT scale,          ///< [in] the scale applied to the shmim command
+              outT bias = 0        ///< [in] [optional] the bias added after scaling and mean removal
+            )
+   {
+      if(mapping == nullptr) return -1;
+
+      m_src.clear();
+      m_dst.clear();
+      m_ignored.clear();
+
+      for(size_t n = 0; n < nAct; ++n)
+      {
+         if(mapping[n] < 0)
+         {
+            m_ignored.push_back(n);
+         }
+         else
+         {
+            m_src.push_back(mapping[n]);
+            m_dst.push_back(n);
+         }
+      }
+
+      m_nAct = nAct;
+      m_scale = scale;
+      m_bias = bias;
+
+      return 0;
+   }
+
+   /// Get the number of actuators in the command vector.
+   size_t nAct()
+   {
+      return m_nAct;
+   }
+
+   /// Convert a shmim command.
+   /**
+     * \returns the number of actuators saturated in this command.
+     */
+   template<typename inT>
+   unsigned apply( outT * out,         ///< [out] the command vector, nAct long
+                   const inT * src,    ///< [in] the shmim command
+                   uint8_t * satMap    ///< [out] the instantaneous saturation map, same size as the shmim.  Only addressable actuators are written.
+                 )
+   {
+      const size_t N = m_src.size();
+      const uint32_t * __restrict__ si = m_src.data();
+      const uint32_t * __restrict__ di = m_dst.data();
+
+      for(size_t n = 0; n < m_ignored.size(); ++n)
+      {
+         out[m_ignored[n]] = 0;
+      }
+
+      outT offset = m_bias;
+
+      if(transferT::removeMean && m_nAct > 0)
+      {
+         outT mean = 0;
+         #pragma omp simd reduction(+:mean)
+         for(size_t n = 0; n < N; ++n)
+         {
+            mean += static_cast<outT>(src[si[n]]);
+         }
+         offset -= mean * m_scale / m_nAct;
+      }
+
+      const outT lo = transferT::template minVal<outT>();
+      const outT hi = transferT::template maxVal<outT>();
+
+      unsigned nsat = 0;
+
+      //The gather and scatter indices are unique, so there are no dependencies between iterations
+      #pragma omp simd reduction(+:nsat)
+      for(size_t n = 0; n < N; ++n)
+      {
+         outT v = static_cast<outT>(src[si[n]]) * m_scale + offset;
+
+         nsat += (v > hi) | (v < lo);
+         satMap[si[n]] = (v >= hi) | (v <= lo);
+
+         out[di[n]] = transferT::apply(std::min(std::max(v, lo), hi));
+      }
+
+      return nsat;
+   }
+};
+
+} //namespace dev
+} //namespace app
+} //namespace MagAOX
+
+#endif //dmTransform_hpp
@@ -0,0 +1,216 @@
+/** \file modalOffload.hpp
+  * \brief Masked projection and reconstruction kernels for offloading between DMs and the TCS.
+  *
+  * \ingroup app_files
+  */
+
+#ifndef modalOffload_hpp
+#define modalOffload_hpp
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include <Eigen/Dense>
+
+namespace MagAOX
+{
+namespace app
+{
+namespace dev
+{
+
+/// Applies a precomputed offload matrix to a frame, using only the pixels the matrix depends on.
+/** The offload matrix combines projection onto a set of modes and reconstruction of the result, e.g. tweeter
+  * modes to woofer actuators.  When the matrix is set the columns which are entirely zero, such as those outside
+  * a pupil mask, are dropped, and the remaining pixels are gathered from each frame before the product.
+  *
+  * If the matrix is given as a reconstruction and a projection, it is combined into one matrix when that is
+  * cheaper to apply, and otherwise kept as the two factors so each update is two small GEMVs.
+  *
+  * The matrix should be rebuilt, outside the frame loop, whenever the modes or number of modes change.
+  *
+  * \tparam realT the floating point type of the frames and the matrix
+  *
+  * \ingroup appdev
+  */
+template<typename realT>
+class modalOffload
+{
+public:
+   typedef Eigen::Matrix<realT, Eigen::Dynamic, Eigen::Dynamic> matrixT;
+   typedef Eigen::Matrix<realT, Eigen::Dynamic, 1> vectorT;
+
+protected:
+   matrixT m_Pt; ///< The transpose of the projection, or of the combined matrix, with the unused columns removed.  Stored transposed so each output is a contiguous dot product.
+
+   matrixT m_R; ///< The reconstruction, empty if m_Pt is the combined matrix.
+
+   std::vector<uint32_t> m_pixIdx; ///< The frame index of each used column.
+
+   vectorT m_pix; ///< Working memory for the gathered pixels.
+
+   vectorT m_mid; ///< Working memory for the projection.
+
+   vectorT m_out; ///< Working memory for the product.
+
+   size_t m_nPix {0}; ///< The number of pixels in a full frame.
+
+public:
+
+   /// Set the offload matrix.
+   /**
+     * \returns 0 on success
+     * \returns -1 if \p M is empty
+     */
+   int setMatrix( const matrixT & M /**< [in] the full offload matrix, nOut x nPix*/)
+   {
+      if(M.rows() == 0 || M.cols() == 0) return -1;
+
+      compress(m_Pt, M);
+      m_R.resize(0,0);
+
+      m_out.resize(M.rows());
+      m_out.setZero();
+
+      return 0;
+   }
+
+   /// Set the offload matrix as the product of a reconstruction and a projection, R*P.
+   /**
+     * \returns 0 on success
+     * \returns -1 if a matrix is empty or the sizes do not match
+     */
+   int setMatrix( const matrixT & R, ///< [in] the reconstruction, nOut x nModes
+                  const matrixT & P  ///< [in] the projection, nModes x nPix
+                )
+   {
+      if(R.rows() == 0 || P.rows() == 0 || P.cols() == 0 || R.cols() != P.rows()) return -1;
+
+      compress(m_Pt, P);
+
+      //Multiply-adds per frame with and without combining
+      size_t nUsed = m_pixIdx.size();
+      if( ((size_t) R.rows())*nUsed <= ((size_t) P.rows())*(nUsed + R.rows()) )
+      {
+         m_Pt = (m_Pt*R.transpose()).eval();
+         m_R.resize(0,0);
+      }
+      else
+      {
+         m_R = R;
+         m_mid.resize(P.rows());
+      }
+
+      m_out.resize(R.rows());
+      m_out.setZero();
+
+      return 0;
+   }
+
+   /// Get the number of outputs, the rows of the offload matrix.
+   size_t nOut()
+   {
+      return m_out.size();
+   }
+
+   /// Get the number of pixels in a full frame, the columns of the offload matrix.
+   size_t nPix()
+   {
+      return m_nPix;
+   }
+
+   /// Get the number of pixels used.
+   size_t nUsed()
+   {
+      return m_pixIdx.size();
+   }
+
+   /// Whether the matrix is applied as two factors.
+   bool factored()
+   {
+      return (m_R.size() > 0);
+   }
+
+   /// Apply the offload matrix to a frame.
+   /**
+     * \returns the product, nOut long, valid until the next call.
+     */
+   const vectorT & apply( const realT * src /**< [in] the frame, nPix long*/)
+   {
+      const size_t N = m_pixIdx.size();
+      const uint32_t * __restrict__ pi = m_pixIdx.data();
+      realT * __restrict__ pix = m_pix.data();
+
+      #pragma omp simd
+      for(size_t n = 0; n < N; ++n)
+      {
+         pix[n] = src[pi[n]];
+      }
+
+      if(m_R.size() > 0)
+      {
+         m_mid.noalias() = m_Pt.transpose() * m_pix;
+         m_out.noalias() = m_R * m_mid;
+      }
+      else
+      {
+         m_out.noalias() = m_Pt.transpose() * m_pix;
+      }
+
+      return m_out;
+   }
+
+   /// Apply the offload matrix to a frame and integrate the result with a leaky integrator.
+   /** Computes `state = clip( gain*M*src + (1-leak)*state, -lim, lim)` with the gain, leak and clip applied in one pass.
+     */
+   void integrate( realT * state,     ///< [in.out] the integrator state, nOut long
+                   const realT * src, ///< [in] the frame, nPix long
+                   realT gain,        ///< [in] the integrator gain
+                   realT leak,        ///< [in] the integrator leak
+                   realT lim          ///< [in] the limit on the absolute value of the state
+                 )
+   {
+      apply(src);
+
+      const size_t N = m_out.size();
+      const realT * __restrict__ d = m_out.data();
+      const realT keep = 1.0 - leak;
+
+      #pragma omp simd
+      for(size_t n = 0; n < N; ++n)
+      {
+         state[n] = std::min(std::max(gain*d[n] + keep*state[n], -lim), lim);
+      }
+   }
+
+protected:
+
+   /// Copy the non-zero columns of a matrix, transposed, and record their indices.
+   void compress( matrixT & Ct,      ///< [out] the transpose of the used columns of M
+                  const matrixT & M  ///< [in] the full matrix
+                )
+   {
+      m_pixIdx.clear();
+      for(int c = 0; c < M.cols(); ++c)
+      {
+         if( (M.col(c).array() != 0).any() ) m_pixIdx.push_back(c);
+      }
+
+      Ct.resize(m_pixIdx.size(), M.rows());
+      for(size_t n = 0; n < m_pixIdx.size(); ++n)
+      {
+         Ct.row(n) = M.col(m_pixIdx[n]).transpose();
+      }
+
+      m_pix.resize(m_pixIdx.size());
+
+      m_nPix = M.cols();
+   }
+};
+
+} //namespace dev
+} //namespace app
+} //namespace MagAOX
+
+#endif //modalOffload_hpp
@@ -0,0 +1,330 @@
+/** \file shmimHub.hpp
+  * \brief In-process fan-out of ImageStreamIO new-frame notifications.
+  *
+  * \ingroup app_files
+  */
+
+#ifndef shmimHub_hpp
+#define shmimHub_hpp
+
+#include <atomic>
+#include <climits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <linux/futex.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include <ImageStreamIO/ImageStruct.h>
+#include <ImageStreamIO/ImageStreamIO.h>
+
+namespace MagAOX
+{
+namespace app
+{
+namespace dev
+{
+
+/// A single ImageStreamIO stream shared by all the shmimMonitors in a process.
+/** One waiter thread holds one semaphore of the stream.  Each time the semaphore is posted the waiter
+  * increments a frame sequence number and wakes all consumers with one futex call.  Each consumer keeps its own
+  * cursor, the last sequence number it processed, so consumers never block each other and a slow consumer
+  * just skips to the latest frame.
+  *
+  * Consumers still map the stream themselves to read the image data and metadata; only the semaphore wait is shared.
+  *
+  * \tparam derivedT the MagAOXApp derived class, used for logging and shutdown.
+  *
+  * \ingroup appdev
+  */
+template<class derivedT>
+class shmimHubStream
+{
+public:
+   std::string m_shmimName; ///< The name of the shared memory image.
+
+   derivedT * m_derived {nullptr}; ///< The app.
+
+   std::atomic<uint64_t> m_seq {0}; ///< The number of new-frame notifications received.
+
+   std::atomic<uint32_t> m_futexWord {0}; ///< Incremented with m_seq, used as the futex the consumers wait on.
+
+   std::atomic<uint64_t> m_generation {0}; ///< Incremented each time the waiter (re)opens the stream.  Consumers reopen their own mapping when this changes.
+
+   std::atomic<bool> m_reopen {false}; ///< Set by a consumer to ask the waiter to reopen the stream, only when the consumer finds the stream has gone away.
+
+   std::atomic<bool> m_exited {false}; ///< Set when the waiter thread exits, so consumers can detect that they will not be woken.
+
+   int m_semaphoreNumber {5}; ///< The semaphore index held by the waiter.
+
+   /** \name Waiter Thread
+     * Started with MagAOXApp::threadStart by the first consumer to attach.
+     * @{
+     */
+   bool m_thInit {true}; ///< Synchronizer for thread startup, to allow priority setting to finish.
+   pid_t m_thID {0}; ///< The waiter thread PID.
+   pcf::IndiProperty m_thProp; ///< The property to hold the waiter thread details.
+   std::thread m_thread; ///< The waiter thread.
+   ///@}
+
+   /// Get the current frame sequence number.
+   uint64_t sequence()
+   {
+      return m_seq.load(std::memory_order_acquire);
+   }
+
+   /// Wait for a frame newer than the consumer's cursor.
+   /**
+     * \returns 0 if a new frame is available, in which case the consumer should update its cursor with sequence().
+     * \returns ETIMEDOUT if the absolute timeout passed.
+     * \returns EINTR if interrupted by a signal.
+     */
+   int wait( uint64_t cursor,        ///< [in] the last sequence number processed by the consumer
+             const timespec & absTs  ///< [in] the absolute timeout, on CLOCK_REALTIME
+           )
+   {
+      while(1)
+      {
+         //Read the futex word before checking the sequence so a post in between makes the futex return immediately.
+         uint32_t word = m_futexWord.load(std::memory_order_acquire);
+
+         if(m_seq.load(std::memory_order_acquire) > cursor) return 0;
+
+         errno = 0;
+         long rv = syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_futexWord), FUTEX_WAIT_BITSET_PRIVATE | FUTEX_CLOCK_REALTIME,
+                                   word, &absTs, nullptr, FUTEX_BITSET_MATCH_ANY);
+
+         if(rv < 0)
+         {
+            if(errno == EAGAIN) continue; //the word changed before we slept
+            return errno; //ETIMEDOUT, EINTR, or an error
+         }
+      }
+   }
+
+   ///Thread starter, called by MagAOXApp::threadStart on thread construction.  Calls waiterExec.
+   static void waiterStart( shmimHubStream * s /**< [in] the stream */)
+   {
+      s->waiterExec();
+      s->m_exited = true;
+   }
+
+   /// Execute the waiter thread.
+   void waiterExec();
+
+protected:
+
+   /// Wake all consumers.
+   void post()
+   {
+      m_seq.fetch_add(1, std::memory_order_acq_rel);
+      m_futexWord.fetch_add(1, std::memory_order_acq_rel);
+      syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_futexWord), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+   }
+};
+
+template<class derivedT>
+void shmimHubStream<derivedT>::waiterExec()
+{
+   m_thID = syscall(SYS_gettid);
+
+   //Wait for the thread starter to finish initializing this thread.
+   while( m_thInit == true && m_derived->shutdown() == 0)
+   {
+      sleep(1);
+   }
+
+   IMAGE imageStream;
+   bool opened = false;
+   ino_t inode = 0;
+
+   char SM_fname[200];
+   ImageStreamIO_filename(SM_fname, sizeof(SM_fname), m_shmimName.c_str());
+
+   while(m_derived->shutdown() == 0)
+   {
+      if(opened && m_reopen)
+      {
+         if(m_semaphoreNumber >= 0) imageStream.semReadPID[m_semaphoreNumber] = 0; //release semaphore
+         ImageStreamIO_closeIm(&imageStream);
+         opened = false;
+      }
+
+      m_reopen = false;
+
+      if(!opened)
+      {
+         struct stat st;
+         if(stat(SM_fname, &st) < 0)
+         {
+            sleep(1);
+            continue;
+         }
+
+         if(ImageStreamIO_openIm(&imageStream, m_shmimName.c_str()) != 0)
+         {
+            sleep(1);
+            continue;
+         }
+
+         if(imageStream.md[0].sem <= m_semaphoreNumber)
+         {
+            //Server is still starting up
+            ImageStreamIO_closeIm(&imageStream);
+            sleep(1);
+            continue;
+         }
+
+         inode = st.st_ino;
+
+         m_semaphoreNumber = ImageStreamIO_getsemwaitindex(&imageStream, m_semaphoreNumber);
+
+         if(m_semaphoreNumber < 0)
+         {
+            derivedT::template log<software_critical>({__FILE__,__LINE__, "No valid semaphore found for " + m_shmimName + ". Source process will need to be restarted."});
+            ImageStreamIO_closeIm(&imageStream);
+            return;
+         }
+
+         derivedT::template log<software_info>({__FILE__,__LINE__, "hub got semaphore index " + std::to_string(m_semaphoreNumber) + " for " + m_shmimName });
+
+         ImageStreamIO_semflush(&imageStream, m_semaphoreNumber);
+
+         opened = true;
+
+         m_generation.fetch_add(1, std::memory_order_acq_rel);
+
+         //Wake consumers so they pick up the (possibly new) stream
+         post();
+      }
+
+      timespec ts;
+
+      if(clock_gettime(CLOCK_REALTIME, &ts) < 0)
+      {
+         derivedT::template log<software_critical>({__FILE__,__LINE__,errno,0,"clock_gettime"});
+         break;
+      }
+
+      ts.tv_sec += 1;
+
+      if(sem_timedwait(imageStream.semptr[m_semaphoreNumber], &ts) == 0)
+      {
+         post();
+      }
+      else
+      {
+         if(errno == EINTR) continue; //check for shutdown
+
+         if(errno != ETIMEDOUT)
+         {
+            derivedT::template log<software_error>({__FILE__, __LINE__,errno, "sem_timedwait"});
+            m_reopen = true;
+            continue;
+         }
+
+         //On timeout, check whether the server has cleaned up or recreated the stream.
+         struct stat st;
+         if(imageStream.md[0].sem <= 0 || stat(SM_fname, &st) < 0 || st.st_ino != inode)
+         {
+            m_reopen = true;
+         }
+      }
+   }
+
+   if(opened)
+   {
+      if(m_semaphoreNumber >= 0) imageStream.semReadPID[m_semaphoreNumber] = 0; //release semaphore
+      ImageStreamIO_closeIm(&imageStream);
+   }
+}
+
+/// Registry of the shared streams in this process.
+/**
+  * \tparam derivedT the MagAOXApp derived class
+  *
+  * \ingroup appdev
+  */
+template<class derivedT>
+class shmimHub
+{
+public:
+
+   typedef shmimHubStream<derivedT> streamT;
+
+   /// Get the shared stream for a shmim name, creating it and starting its waiter thread if needed.
+   /** The waiter thread is started with the priority and cpuset of the first consumer to attach.
+     *
+     * \returns a pointer to the stream on success
+     * \returns nullptr on error, which is logged.
+     */
+   static std::shared_ptr<streamT> attach( derivedT & derived,           ///< [in] the app
+                                           const std::string & shmimName, ///< [in] the stream name
+                                           int thrdPrio,                  ///< [in] the priority for the waiter thread
+                                           const std::string & cpuset     ///< [in] the cpuset for the waiter thread
+                                         )
+   {
+      std::lock_guard<std::mutex> lock(mutex());
+
+      auto it = streams().find(shmimName);
+      if(it != streams().end()) return it->second;
+
+      std::shared_ptr<streamT> s = std::make_shared<streamT>();
+      s->m_shmimName = shmimName;
+      s->m_derived = &derived;
+
+      if(derived.threadStart( s->m_thread, s->m_thInit, s->m_thID, s->m_thProp, thrdPrio, cpuset, "hub-" + shmimName, s.get(), streamT::waiterStart) < 0)
+      {
+         derivedT::template log<software_error>({__FILE__, __LINE__});
+         return nullptr;
+      }
+
+      streams().insert({shmimName, s});
+
+      return s;
+   }
+
+   /// Join all the waiter threads.  Call after shutdown has been set.
+   static void shutdown()
+   {
+      std::lock_guard<std::mutex> lock(mutex());
+
+      for(auto it = streams().begin(); it != streams().end(); ++it)
+      {
+         if(it->second->m_thread.joinable())
+         {
+            pthread_kill(it->second->m_thread.native_handle(), SIGUSR1);
+            try
+            {
+               it->second->m_thread.join(); //this will throw if it was already joined
+            }
+            catch(...)
+            {
+            }
+         }
+      }
+   }
+
+protected:
+
+   static std::mutex & mutex()
+   {
+      static std::mutex m;
+      return m;
+   }
+
+   static std::map<std::string, std::shared_ptr<streamT>> & streams()
+   {
+      static std::map<std::string, std::shared_ptr<streamT>> s;
+      return s;
+   }
+};
+
+} //namespace dev
+} //namespace app
+} //namespace MagAOX
+
+#endif //shmimHub_hpp
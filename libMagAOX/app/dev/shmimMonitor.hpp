@@ -15,6 +15,8 @@
 
 #include "../../libMagAOX/common/paths.hpp"
 
+#include "shmimHub.hpp"
+
 
 namespace MagAOX
 {
@@ -70,6 +72,12 @@ struct shmimT
   \endcode
   * which returns the string to prefix to INDI properties.  The default `shmimT` uses "sm".
   * 
+  * If `<configSection>.shared` is true, this monitor does not take its own semaphore.  Instead it attaches to a
+  * per-process shmimHub stream, which holds one semaphore and wakes all of the shared monitors of that stream.  This
+  * allows several monitors in one app (with different `specificT`) to watch the same stream without each using a
+  * semaphore and a kernel wake-up.  Each monitor processes the latest frame when it wakes, so a slow monitor skips
+  * frames without delaying the others.
+  * 
   * \todo move requirement for sigsegv handling to derived class -- it should set m_restart on all shmimMonitors it inherited.
   *
   * \ingroup appdev
@@ -88,6 +96,8 @@ protected:
 
    std::string m_smCpuset; ///< The cpuset to assign the shmimMonitor thread to.  Ignored if empty (the default).
    
+   bool m_shared {false}; ///< If true, wait on the per-process shmimHub for this stream rather than taking a semaphore.
+
    ///@}
    
    bool m_getExistingFirst {false}; ///< If set to true by derivedT, any existing image will be grabbed and sent to processImage before waiting on the semaphore.
@@ -102,6 +112,8 @@ protected:
 
    IMAGE m_imageStream; ///< The ImageStreamIO shared memory buffer.
 
+   std::shared_ptr<shmimHubStream<derivedT>> m_hub; ///< The shared stream, if m_shared is true.
+
 public:
 
    /// Setup the configuration system
@@ -261,6 +273,8 @@ void shmimMonitor<derivedT, specificT>::setupConfig(mx::app::appConfigurator & c
    
    config.add(specificT::configSection()+".shmimName", "", specificT::configSection()+".shmimName", argType::Required, specificT::configSection(), "shmimName", false, "string", "The name of the ImageStreamIO shared memory image. Will be used as /tmp/<shmimName>.im.shm.");
    
+   config.add(specificT::configSection()+".shared", "", specificT::configSection()+".shared", argType::Required, specificT::configSection(), "shared", false, "bool", "If true, share one semaphore with the other shared monitors of this stream in this process.  Default is false.");
+   
    //Set this here to allow derived classes to set their own default before calling loadConfig
    m_shmimName = derived().configName();
          
@@ -272,6 +286,7 @@ void shmimMonitor<derivedT, specificT>::loadConfig(mx::app::appConfigurator & co
    config(m_smThreadPrio, specificT::configSection() + ".threadPrio");
    config(m_smCpuset, specificT::configSection() + ".cpuset");
    config(m_shmimName, specificT::configSection() + ".shmimName");
+   config(m_shared, specificT::configSection() + ".shared");
   
 }
    
@@ -342,6 +357,18 @@ int shmimMonitor<derivedT, specificT>::appStartup()
       return -1;
    }
    
+   if(m_shared)
+   {
+      //The hub waiter thread runs at the priority of the first monitor to attach.
+      m_hub = shmimHub<derivedT>::attach(derived(), m_shmimName, m_smThreadPrio, m_smCpuset);
+      
+      if(!m_hub)
+      {
+         derivedT::template log<software_error>({__FILE__, __LINE__});
+         return -1;
+      }
+   }
+   
    if(derived().threadStart( m_smThread, m_smThreadInit, m_smThreadID, m_smThreadProp, m_smThreadPrio, m_smCpuset, specificT::configSection(), this, smThreadStart) < 0)
    {
       derivedT::template log<software_error>({__FILE__, __LINE__});
@@ -363,6 +390,14 @@ int shmimMonitor<derivedT, specificT>::appLogic()
       return -1;
    }
    
+   //The hub waiter is shared, so it can't be joined here.  Check its flag instead.
+   if(m_hub && m_hub->m_exited && derived().shutdown() == 0)
+   {
+      derivedT::template log<software_error>({__FILE__, __LINE__, "shmimHub thread " + std::to_string(m_hub->m_thID) + " for " + m_shmimName + " has exited"});
+      
+      return -1;
+   }
+   
    return 0;
 
 }
@@ -382,6 +417,11 @@ int shmimMonitor<derivedT, specificT>::appShutdown()
       }
    }
 
+   if(m_hub)
+   {
+      shmimHub<derivedT>::shutdown();
+   }
+   
    return 0;
 }
 
@@ -522,7 +562,10 @@ void shmimMonitor<derivedT, specificT>::smThreadExec()
          }
       }
       
-      if(m_restart) continue; //this is kinda dumb.  we just go around on restart, so why test in the while loop at all?
+      if(m_restart) 
+      {
+         continue; //this is kinda dumb.  we just go around on restart, so why test in the while loop at all?
+      }
 
       if(derived().state() != stateCodes::OPERATING) continue;
 
@@ -534,19 +577,33 @@ void shmimMonitor<derivedT, specificT>::smThreadExec()
          return;
       }
 
-      m_semaphoreNumber = ImageStreamIO_getsemwaitindex(&m_imageStream, m_semaphoreNumber); //ask for semaphore we had before
+      sem_t * sem = nullptr; ///< The semaphore to monitor for new image data
+      uint64_t cursor = 0; ///< The last hub sequence number processed, if shared
+      uint64_t generation = 0; ///< The hub generation when we opened, if shared
 
-      if(m_semaphoreNumber < 0)
+      if(m_hub)
       {
-         derivedT::template log<software_critical>({__FILE__,__LINE__, "No valid semaphore found for " + m_shmimName + ". Source process will need to be restarted."});
-         return;
+         //The hub holds the semaphore, we only need the mapping.
+         m_semaphoreNumber = -1;
+         generation = m_hub->m_generation.load(std::memory_order_acquire);
+         cursor = m_hub->sequence();
       }
+      else
+      {
+         m_semaphoreNumber = ImageStreamIO_getsemwaitindex(&m_imageStream, m_semaphoreNumber); //ask for semaphore we had before
 
-      derivedT::template log<software_info>({__FILE__,__LINE__, "got semaphore index " + std::to_string(m_semaphoreNumber) + " for " + m_shmimName });
-      
-      ImageStreamIO_semflush(&m_imageStream, m_semaphoreNumber);
-      
-      sem_t * sem = m_imageStream.semptr[m_semaphoreNumber]; ///< The semaphore to monitor for new image data
+         if(m_semaphoreNumber < 0)
+         {
+            derivedT::template log<software_critical>({__FILE__,__LINE__, "No valid semaphore found for " + m_shmimName + ". Source process will need to be restarted."});
+            return;
+         }
+
+         derivedT::template log<software_info>({__FILE__,__LINE__, "got semaphore index " + std::to_string(m_semaphoreNumber) + " for " + m_shmimName });
+         
+         ImageStreamIO_semflush(&m_imageStream, m_semaphoreNumber);
+         
+         sem = m_imageStream.semptr[m_semaphoreNumber];
+      }
       
       m_dataType = m_imageStream.md[0].datatype;
       m_typeSize = ImageStreamIO_typesize(m_dataType);
@@ -564,6 +621,10 @@ void shmimMonitor<derivedT, specificT>::smThreadExec()
       size_t snx, sny, snz;
       uint64_t curr_image; //The current cnt1 index
       
+      //Set if the stream was cleaned up or recreated by the server, as opposed to a local restart.
+      //Only then is the hub asked to reopen, since that affects every monitor sharing it.
+      bool streamGone = false;
+      
       if(m_getExistingFirst && !m_restart) //If true, we always get the existing image without waiting on the semaphore.
       {
          if(m_imageStream.md[0].size[2] > 0) ///\todo change to naxis?
@@ -579,6 +640,7 @@ void shmimMonitor<derivedT, specificT>::smThreadExec()
          
          if( atype!= m_dataType || snx != m_width || sny != m_height || snz != length )
          {
+            streamGone = true;
             break; //exit the nearest while loop and get the new image setup.
          }
          
@@ -604,7 +666,25 @@ void shmimMonitor<derivedT, specificT>::smThreadExec()
          
          ts.tv_sec += 1;
          
-         if(sem_timedwait(sem, &ts) == 0)
+         int rv;
+         if(m_hub)
+         {
+            rv = m_hub->wait(cursor, ts);
+            
+            //Skip to the latest notification, the frame read below is always the latest.
+            cursor = m_hub->sequence();
+            
+            //The hub reopened the stream, so our mapping may be stale.
+            if(m_hub->m_generation.load(std::memory_order_acquire) != generation) break;
+            
+            errno = rv;
+         }
+         else
+         {
+            rv = sem_timedwait(sem, &ts);
+         }
+         
+         if(rv == 0)
          {
             if(m_imageStream.md[0].size[2] > 0) ///\todo change to naxis?
             {
@@ -619,6 +699,7 @@ void shmimMonitor<derivedT, specificT>::smThreadExec()
          
             if( atype!= m_dataType || snx != m_width || sny != m_height || snz != length )
             {
+               streamGone = true;
                break; //exit the nearest while loop and get the new image setup.
             }
          
@@ -633,7 +714,11 @@ void shmimMonitor<derivedT, specificT>::smThreadExec()
          }
          else
          {
-            if(m_imageStream.md[0].sem <= 0) break; //Indicates that the server has cleaned up.
+            if(m_imageStream.md[0].sem <= 0) //Indicates that the server has cleaned up.
+            {
+               streamGone = true;
+               break;
+            }
             
             //Check for why we timed out
             if(errno == EINTR) break; //This indicates signal interrupted us, time to restart or shutdown, loop will exit normally if flags set.
@@ -654,6 +739,8 @@ void shmimMonitor<derivedT, specificT>::smThreadExec()
       // call derived().cleanup()
       //*******
       
+      if(m_hub && streamGone) m_hub->m_reopen = true;
+      
       //opened == true if we can get to this 
       if(m_semaphoreNumber >= 0) m_imageStream.semReadPID[m_semaphoreNumber] = 0; //release semaphore
       ImageStreamIO_closeIm(&m_imageStream);
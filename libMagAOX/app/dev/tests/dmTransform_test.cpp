@@ -0,0 +1,196 @@
+/** \file dmTransform_test.cpp
+  * \brief Catch2 tests for the DM command transform.
+  *
+  * The benchmark is hidden, run it with `dmTransform_test "[.benchmark]"`.
+  *
+  * History:
+  */
+#include "../../../../tests/catch2/catch.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#include "../dmTransform.hpp"
+
+using namespace MagAOX::app::dev;
+
+namespace dmTransform_tests
+{
+
+/// A fake driver with the original scalar commandDM loops, used as the reference.
+struct fakeDM
+{
+   uint32_t m_nbAct {0};
+   std::vector<int> m_actuator_mapping;
+   std::vector<double> m_dminputs;
+   std::vector<uint8_t> m_instSatMap;
+   double m_scale {1};
+   unsigned m_nsat {0};
+
+   fakeDM( uint32_t width,
+           uint32_t nbAct,
+           double scale
+         ) : m_nbAct{nbAct}, m_scale{scale}
+   {
+      m_actuator_mapping.resize(nbAct);
+      m_dminputs.resize(nbAct);
+      m_instSatMap.resize(width*width, 0);
+
+      //Map the actuators to the grid with a stride, and ignore every 7th
+      for(uint32_t n = 0; n < nbAct; ++n)
+      {
+         m_actuator_mapping[n] = (n % 7 == 6) ? -1 : (n*3) % (width*width);
+      }
+   }
+
+   //The BMC loops
+   void commandSqrt(const float * src)
+   {
+      for(uint32_t idx = 0; idx < m_nbAct; ++idx)
+      {
+         int address = m_actuator_mapping[idx];
+         if(address == -1) m_dminputs[idx] = 0.;
+         else m_dminputs[idx] = ((double) src[address]) * m_scale;
+      }
+
+      for(uint32_t idx = 0 ; idx < m_nbAct ; ++idx)
+      {
+         if (m_dminputs[idx] > 1)
+         {
+            ++m_nsat;
+            m_dminputs[idx] = 1;
+         } else if (m_dminputs[idx] < 0)
+         {
+            ++m_nsat;
+            m_dminputs[idx] = 0;
+         }
+         m_dminputs[idx] = sqrt(m_dminputs[idx]);
+      }
+
+      for(uint32_t idx = 0; idx < m_nbAct; ++idx)
+      {
+         int address = m_actuator_mapping[idx];
+         if(address == -1) continue;
+         m_instSatMap[address] = (m_dminputs[idx] >= 1 || m_dminputs[idx] <= 0);
+      }
+   }
+
+   //The ALPAO loops, for a mapping with no ignored actuators
+   void commandLinear(const float * src)
+   {
+      double mean = 0;
+      for(uint32_t idx = 0; idx < m_nbAct; ++idx)
+      {
+         m_dminputs[idx] = ((double) src[m_actuator_mapping[idx]]) * m_scale;
+         mean += m_dminputs[idx];
+      }
+      mean /= m_nbAct;
+
+      for(uint32_t idx = 0 ; idx < m_nbAct ; ++idx)
+      {
+         m_dminputs[idx] -= mean;
+         if (m_dminputs[idx] > 1)
+         {
+            ++m_nsat;
+            m_dminputs[idx] = 1;
+         } else if (m_dminputs[idx] < -1)
+         {
+            ++m_nsat;
+            m_dminputs[idx] = - 1;
+         }
+      }
+
+      for(uint32_t idx = 0; idx < m_nbAct; ++idx)
+      {
+         m_instSatMap[m_actuator_mapping[idx]] = (m_dminputs[idx] >= 1 || m_dminputs[idx] <= -1);
+      }
+   }
+};
+
+void fillCommand( std::vector<float> & cmd, unsigned seed )
+{
+   std::mt19937 gen(seed);
+   std::uniform_real_distribution<float> dist(-0.5, 1.5);
+   for(size_t n = 0; n < cmd.size(); ++n) cmd[n] = dist(gen);
+}
+
+SCENARIO( "Transforming DM commands", "[dmTransform]" )
+{
+   GIVEN("A 50x50 DM with 2040 actuators")
+   {
+      fakeDM ref(50, 2040, 0.8);
+      std::vector<float> cmd(50*50);
+      fillCommand(cmd, 1);
+
+      std::vector<double> out(ref.m_nbAct);
+      std::vector<uint8_t> satMap(50*50, 0);
+
+      WHEN("Using the sqrt transfer function with ignored actuators")
+      {
+         dmTransform<double, dmSqrtTransfer> tf;
+         REQUIRE(tf.setup(ref.m_actuator_mapping.data(), ref.m_nbAct, 0.8) == 0);
+
+         ref.commandSqrt(cmd.data());
+         unsigned nsat = tf.apply(out.data(), cmd.data(), satMap.data());
+
+         REQUIRE(nsat == ref.m_nsat);
+         REQUIRE(nsat > 0);
+         for(size_t n = 0; n < out.size(); ++n) REQUIRE(out[n] == Approx(ref.m_dminputs[n]));
+         REQUIRE(satMap == ref.m_instSatMap);
+      }
+
+      WHEN("Using the linear transfer function with mean removal")
+      {
+         for(size_t n = 0; n < ref.m_actuator_mapping.size(); ++n) ref.m_actuator_mapping[n] = n;
+         fillCommand(cmd, 2);
+         for(size_t n = 0; n < cmd.size(); ++n) cmd[n] *= 1.5;
+
+         dmTransform<double, dmLinearTransfer> tf;
+         REQUIRE(tf.setup(ref.m_actuator_mapping.data(), ref.m_nbAct, 0.8) == 0);
+
+         ref.commandLinear(cmd.data());
+         unsigned nsat = tf.apply(out.data(), cmd.data(), satMap.data());
+
+         REQUIRE(nsat == ref.m_nsat);
+         REQUIRE(nsat > 0);
+         for(size_t n = 0; n < out.size(); ++n) REQUIRE(out[n] == Approx(ref.m_dminputs[n]));
+         REQUIRE(satMap == ref.m_instSatMap);
+      }
+   }
+}
+
+SCENARIO( "Benchmarking DM command transforms", "[.benchmark]" )
+{
+   GIVEN("A 50x50 DM with 2040 actuators")
+   {
+      fakeDM ref(50, 2040, 0.8);
+      std::vector<float> cmd(50*50);
+      fillCommand(cmd, 3);
+
+      std::vector<double> out(ref.m_nbAct);
+      std::vector<uint8_t> satMap(50*50, 0);
+
+      dmTransform<double, dmSqrtTransfer> tf;
+      tf.setup(ref.m_actuator_mapping.data(), ref.m_nbAct, 0.8);
+
+      const int N = 20000;
+
+      auto t0 = std::chrono::steady_clock::now();
+      for(int n = 0; n < N; ++n) ref.commandSqrt(cmd.data());
+      auto t1 = std::chrono::steady_clock::now();
+
+      unsigned nsat = 0;
+      for(int n = 0; n < N; ++n) nsat += tf.apply(out.data(), cmd.data(), satMap.data());
+      auto t2 = std::chrono::steady_clock::now();
+
+      double tref = std::chrono::duration<double, std::micro>(t1-t0).count()/N;
+      double ttf = std::chrono::duration<double, std::micro>(t2-t1).count()/N;
+
+      std::cout << "dmTransform benchmark (2040 actuators): reference " << tref << " us/frame, transform " << ttf << " us/frame\n";
+
+      REQUIRE(nsat == ref.m_nsat);
+   }
+}
+
+} //namespace dmTransform_tests
@@ -0,0 +1,198 @@
+/** \file modalOffload_test.cpp
+  * \brief Catch2 tests for the modal offload kernels.
+  *
+  * The benchmark is hidden, run it with `modalOffload_test "[.benchmark]"`.
+  *
+  * History:
+  */
+#include "../../../../tests/catch2/catch.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#include "../modalOffload.hpp"
+
+using namespace MagAOX::app::dev;
+
+namespace modalOffload_tests
+{
+
+typedef Eigen::Matrix<float,-1,-1> matT;
+typedef Eigen::Array<float,-1,-1> arrT;
+
+/// The t2wOffloader and w2tcsOffloader sizes, with masked random modes.
+struct offloadSetup
+{
+   int m_tw {50}; ///< tweeter width
+   int m_ww {11}; ///< woofer width
+   int m_nModes {50};
+
+   arrT m_mask;
+   matT m_T; ///< tweeter modes, one per column
+   matT m_W; ///< woofer modes, one per column
+
+   std::vector<float> m_frame;
+
+   offloadSetup()
+   {
+      std::mt19937 gen(1);
+      std::uniform_real_distribution<float> dist(-1, 1);
+
+      m_mask.resize(m_tw, m_tw);
+      for(int cc = 0; cc < m_tw; ++cc)
+      {
+         for(int rr = 0; rr < m_tw; ++rr)
+         {
+            float x = rr - 0.5*(m_tw-1);
+            float y = cc - 0.5*(m_tw-1);
+            m_mask(rr,cc) = (x*x + y*y <= 0.25*m_tw*m_tw);
+         }
+      }
+
+      m_T.resize(m_tw*m_tw, m_nModes);
+      m_W.resize(m_ww*m_ww, m_nModes);
+      for(int p = 0; p < m_nModes; ++p)
+      {
+         for(int n = 0; n < m_tw*m_tw; ++n) m_T(n,p) = dist(gen)*m_mask(n);
+         for(int n = 0; n < m_ww*m_ww; ++n) m_W(n,p) = dist(gen);
+      }
+
+      m_frame.resize(m_tw*m_tw);
+      for(size_t n = 0; n < m_frame.size(); ++n) m_frame[n] = dist(gen);
+   }
+
+   /// The original t2wOffloader::processImage modal calculation.
+   void t2wReference( arrT & woofer,
+                      int numModes,
+                      float gain,
+                      float leak,
+                      float actLim
+                    )
+   {
+      matT modeAmps = Eigen::Map<matT>(m_frame.data(), 1, m_tw*m_tw) * m_T;
+
+      matT wooferDelta = modeAmps(0,0) * m_W.col(0);
+      for(int p=1; p < numModes; ++p)
+      {
+         wooferDelta += modeAmps(0,p)*m_W.col(p);
+      }
+
+      woofer = gain * Eigen::Map<arrT>(wooferDelta.data(), m_ww, m_ww) + (1.0-leak)*woofer;
+
+      for(int ii = 0; ii < woofer.rows(); ++ii)
+      {
+         for(int jj = 0; jj < woofer.cols(); ++jj)
+         {
+            if( fabs(woofer(ii,jj)) > actLim)
+            {
+               if(woofer(ii,jj) > 0) woofer(ii,jj) = actLim;
+               else woofer(ii,jj) = -actLim;
+            }
+         }
+      }
+   }
+};
+
+SCENARIO( "Offloading with precomputed masked matrices", "[modalOffload]" )
+{
+   GIVEN("A 50x50 tweeter with a circular mask and an 11x11 woofer")
+   {
+      offloadSetup os;
+
+      WHEN("Offloading tweeter modes to the woofer")
+      {
+         for(int nm : {1, 10, 50})
+         {
+            modalOffload<float> mo;
+            REQUIRE(mo.setMatrix(os.m_W.leftCols(nm), os.m_T.leftCols(nm).transpose()) == 0);
+
+            REQUIRE(mo.nOut() == 121);
+            REQUIRE(mo.nPix() == 2500);
+            REQUIRE(mo.nUsed() == (size_t) os.m_mask.sum());
+
+            arrT ref(11,11), woofer(11,11);
+            ref.setConstant(0.5);
+            woofer.setConstant(0.5);
+
+            for(int n = 0; n < 3; ++n)
+            {
+               os.t2wReference(ref, nm, 0.1, 0.05, 2.0);
+               mo.integrate(woofer.data(), os.m_frame.data(), 0.1, 0.05, 2.0);
+            }
+
+            REQUIRE((ref.abs() >= 2.0).any());
+            for(int n = 0; n < 121; ++n) REQUIRE(woofer(n) == Approx(ref(n)).margin(1e-4));
+         }
+      }
+
+      WHEN("Projecting masked modes")
+      {
+         float norm = os.m_mask.sum();
+
+         matT P(5, 2500);
+         for(int i = 0; i < 5; ++i)
+         {
+            P.row(i) = (os.m_T.col(i).array() * Eigen::Map<arrT>(os.m_mask.data(), 2500, 1) / norm).matrix().transpose();
+         }
+
+         modalOffload<float> mo;
+         REQUIRE(mo.setMatrix(P) == 0);
+         REQUIRE(mo.factored() == false);
+
+         const modalOffload<float>::vectorT & c = mo.apply(os.m_frame.data());
+
+         REQUIRE(c.size() == 5);
+         for(int i = 0; i < 5; ++i)
+         {
+            //The original w2tcsOffloader calculation
+            float coeff = (Eigen::Map<arrT>(os.m_frame.data(), 50, 50) * Eigen::Map<arrT>(os.m_T.col(i).data(), 50, 50) * os.m_mask).sum() / norm;
+            REQUIRE(c(i) == Approx(coeff).margin(1e-5));
+         }
+      }
+
+      WHEN("The matrices are empty")
+      {
+         modalOffload<float> mo;
+         REQUIRE(mo.setMatrix(matT()) == -1);
+         REQUIRE(mo.setMatrix(os.m_W.leftCols(2), os.m_T.leftCols(3).transpose()) == -1);
+      }
+   }
+}
+
+SCENARIO( "Benchmarking modal offload", "[.benchmark]" )
+{
+   GIVEN("A 50x50 tweeter with a circular mask and an 11x11 woofer")
+   {
+      offloadSetup os;
+
+      for(int nm : {10, 50})
+      {
+         modalOffload<float> mo;
+         mo.setMatrix(os.m_W.leftCols(nm), os.m_T.leftCols(nm).transpose());
+
+         arrT ref(11,11), woofer(11,11);
+         ref.setZero();
+         woofer.setZero();
+
+         const int N = 20000;
+
+         auto t0 = std::chrono::steady_clock::now();
+         for(int n = 0; n < N; ++n) os.t2wReference(ref, nm, 0.1, 0.01, 7.0);
+         auto t1 = std::chrono::steady_clock::now();
+
+         for(int n = 0; n < N; ++n) mo.integrate(woofer.data(), os.m_frame.data(), 0.1, 0.01, 7.0);
+         auto t2 = std::chrono::steady_clock::now();
+
+         double tref = std::chrono::duration<double, std::micro>(t1-t0).count()/N;
+         double tmo = std::chrono::duration<double, std::micro>(t2-t1).count()/N;
+
+         std::cout << "modalOffload benchmark (" << nm << " modes, " << mo.nUsed() << " of 2500 pixels, "
+                   << (mo.factored() ? "factored" : "combined") << "): reference " << tref << " us/frame, kernel " << tmo << " us/frame\n";
+
+         REQUIRE(woofer(0) == Approx(ref(0)).margin(1e-3));
+      }
+   }
+}
+
+} //namespace modalOffload_tests
@@ -0,0 +1,429 @@
+/** \file waveformPlayer.hpp
+  * \brief Scheduled playback of a cube of shapes to a DM channel.
+  *
+  * \ingroup app_files
+  */
+
+#ifndef waveformPlayer_hpp
+#define waveformPlayer_hpp
+
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+
+#include <time.h>
+#include <semaphore.h>
+
+#include <mx/improc/eigenCube.hpp>
+
+#include <ImageStreamIO/ImageStruct.h>
+#include <ImageStreamIO/ImageStreamIO.h>
+
+namespace MagAOX
+{
+namespace app
+{
+namespace dev
+{
+
+/// Plays the planes of an eigenCube to an ImageStreamIO stream, one plane per period.
+/** In free-running mode the writes are scheduled with `clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME)` against
+  * deadlines calculated from the start time and an integer plane count, so the period does not drift and the
+  * wake-up latency of one write does not accumulate into the next.  If a deadline is missed by more than a period
+  * the missed planes are skipped, so the plane written always corresponds to the current time.
+  *
+  * In trigger mode the next plane is written each time the trigger stream's semaphore is posted.
+  *
+  * New planes (e.g. after an amplitude change) are loaded into an inactive buffer with setPlanes, and are swapped
+  * in at the start of the next cycle so that a cycle is never played with a mix of old and new planes.  A change
+  * in frequency re-bases the schedule at the next deadline.
+  *
+  * The period and latency of the writes are accumulated, and can be read (and reset) with stats for telemetry.
+  * In free-running mode the latency is measured from the scheduled deadline, and in trigger mode from the
+  * trigger stream's writetime.
+  *
+  * \tparam realT the data type of the stream
+  *
+  * \ingroup appdev
+  */
+template<typename realT>
+class waveformPlayer
+{
+public:
+
+   /// Timing statistics accumulated since the last call to stats().
+   struct timingStats
+   {
+      double period {0}; ///< The mean time between writes [s]
+      double periodJitter {0}; ///< The standard deviation of the time between writes [s]
+      double latency {0}; ///< The mean latency of the writes [s]
+      double latencyMax {0}; ///< The maximum latency of the writes [s]
+      uint64_t skipped {0}; ///< The number of planes skipped due to missed deadlines
+      uint64_t writes {0}; ///< The number of writes
+   };
+
+protected:
+
+   IMAGE * m_stream {nullptr}; ///< The stream to write to.
+
+   mx::improc::eigenCube<realT> m_planes[2]; ///< The double-buffered planes.
+
+   std::atomic<int> m_active {0}; ///< The index of the buffer being played.
+
+   std::atomic<bool> m_pending {false}; ///< True if the inactive buffer has new planes to swap in.
+
+   std::mutex m_planeMutex; ///< Protects the inactive buffer while it is loaded.
+
+   std::atomic<double> m_frequency {0}; ///< The plane rate in free-running mode [Hz]
+
+   size_t m_idx {0}; ///< The index of the next plane to write.
+
+   /** \name Timing Statistics
+     * @{
+     */
+   std::mutex m_statsMutex; ///< Protects the accumulators.
+
+   uint64_t m_nPeriod {0};
+   double m_sumPeriod {0};
+   double m_sumPeriod2 {0};
+   uint64_t m_nLatency {0};
+   double m_sumLatency {0};
+   double m_maxLatency {0};
+   uint64_t m_skipped {0};
+   ///@}
+
+public:
+
+   /// Set the stream to write to.
+   void stream( IMAGE * im /**< [in] the opened stream */)
+   {
+      m_stream = im;
+   }
+
+   /// Load new planes.
+   /** The planes are copied to the inactive buffer, and played starting with the next cycle.  If the player is
+     * not playing they are swapped in at the start of the next call to play.  The stream must be set first, and
+     * the planes must be the same size as it.
+     *
+     * \returns 0 on success
+     * \returns -1 if the stream is not set, the planes do not match its size, or there are no planes.
+     */
+   int setPlanes( const mx::improc::eigenCube<realT> & planes /**< [in] the new planes */)
+   {
+      if(m_stream == nullptr) return -1;
+
+      if(planes.planes() == 0 || (size_t) planes.rows() != m_stream->md->size[0] || (size_t) planes.cols() != m_stream->md->size[1]) return -1;
+
+      std::lock_guard<std::mutex> lock(m_planeMutex);
+
+      m_planes[1-m_active.load(std::memory_order_acquire)] = planes;
+
+      m_pending.store(true, std::memory_order_release);
+
+      return 0;
+   }
+
+   /// Set the plane rate used in free-running mode.
+   void frequency( double freq /**< [in] the plane rate [Hz] */)
+   {
+      m_frequency.store(freq, std::memory_order_release);
+   }
+
+   /// Get the plane rate used in free-running mode.
+   double frequency()
+   {
+      return m_frequency.load(std::memory_order_acquire);
+   }
+
+   /// Get the timing statistics accumulated since the last call, and reset them.
+   timingStats stats()
+   {
+      timingStats ts;
+
+      std::lock_guard<std::mutex> lock(m_statsMutex);
+
+      if(m_nPeriod > 0)
+      {
+         ts.period = m_sumPeriod / m_nPeriod;
+         double var = m_sumPeriod2 / m_nPeriod - ts.period*ts.period;
+         ts.periodJitter = (var > 0) ? sqrt(var) : 0;
+      }
+
+      if(m_nLatency > 0)
+      {
+         ts.latency = m_sumLatency / m_nLatency;
+         ts.latencyMax = m_maxLatency;
+      }
+
+      ts.skipped = m_skipped;
+      ts.writes = m_nLatency;
+
+      m_nPeriod = 0;
+      m_sumPeriod = 0;
+      m_sumPeriod2 = 0;
+      m_nLatency = 0;
+      m_sumLatency = 0;
+      m_maxLatency = 0;
+      m_skipped = 0;
+
+      return ts;
+   }
+
+   /// Play the planes until told to stop.
+   /** If \p trigger is null the planes are played free-running at the frequency, otherwise one plane is written
+     * each time the trigger semaphore is posted.
+     *
+     * \returns 0 when \p keepGoing returns false or a signal interrupts the trigger wait
+     * \returns -1 if there is no stream or the planes do not match its size
+     * \returns errno on a semaphore or clock error
+     */
+   template<class keepGoingT>
+   int play( keepGoingT && keepGoing,    ///< [in] called before each write, playing stops when it returns false
+             IMAGE * trigger = nullptr,  ///< [in] [optional] the trigger stream
+             int triggerSem = 0          ///< [in] [optional] the semaphore of the trigger stream to wait on
+           );
+
+   /// Write zeros to the stream.
+   void zero( bool incCnt0 /**< [in] whether cnt0 is incremented */)
+   {
+      if(m_stream == nullptr) return;
+
+      m_stream->md->write = 1;
+
+      memset(m_stream->array.raw, 0, nPixels()*sizeof(realT));
+
+      stampAndPost(incCnt0);
+   }
+
+protected:
+
+   /// The number of pixels in the stream.
+   size_t nPixels()
+   {
+      return ((size_t) m_stream->md->size[0])*m_stream->md->size[1];
+   }
+
+   /// Swap in the pending planes if the loader is not busy with them.
+   void swapPlanes()
+   {
+      if(!m_pending.load(std::memory_order_acquire)) return;
+
+      //Don't block the writer, if setPlanes is running we pick up the new planes at the next cycle.
+      if(!m_planeMutex.try_lock()) return;
+
+      m_active.store(1-m_active.load(std::memory_order_relaxed), std::memory_order_release);
+      m_pending.store(false, std::memory_order_release);
+
+      m_planeMutex.unlock();
+   }
+
+   /// Write plane m_idx of the active buffer.
+   void writePlane( bool incCnt0 /**< [in] whether cnt0 is incremented */)
+   {
+      const mx::improc::eigenCube<realT> & planes = m_planes[m_active.load(std::memory_order_relaxed)];
+
+      m_stream->md->write = 1;
+
+      memcpy(m_stream->array.raw, planes.image(m_idx).data(), nPixels()*sizeof(realT));
+
+      stampAndPost(incCnt0);
+   }
+
+   /// Timestamp the write, and post the semaphores.
+   void stampAndPost( bool incCnt0 /**< [in] whether cnt0 is incremented */)
+   {
+      timespec currtime;
+      clock_gettime(CLOCK_REALTIME, &currtime);
+
+      m_stream->md->atime = currtime;
+      m_stream->md->writetime = currtime;
+
+      if(incCnt0) m_stream->md->cnt0++;
+
+      m_stream->md->write = 0;
+      ImageStreamIO_sempost(m_stream, -1);
+   }
+
+   /// Advance the plane index, swapping in new planes at the start of a cycle.
+   void advance( uint64_t n /**< [in] the number of planes to advance*/)
+   {
+      m_idx += n;
+
+      if(m_idx >= (size_t) m_planes[m_active.load(std::memory_order_relaxed)].planes())
+      {
+         swapPlanes();
+         m_idx %= m_planes[m_active.load(std::memory_order_relaxed)].planes();
+      }
+   }
+
+   /// Accumulate the timing of one write.
+   void accumulate( double period,   ///< [in] the time since the last write, < 0 if this is the first [s]
+                    double latency,  ///< [in] the latency of this write [s]
+                    uint64_t skipped ///< [in] the planes skipped before this write
+                  )
+   {
+      std::lock_guard<std::mutex> lock(m_statsMutex);
+
+      if(period >= 0)
+      {
+         ++m_nPeriod;
+         m_sumPeriod += period;
+         m_sumPeriod2 += period*period;
+      }
+
+      ++m_nLatency;
+      m_sumLatency += latency;
+      if(latency > m_maxLatency) m_maxLatency = latency;
+
+      m_skipped += skipped;
+   }
+
+   /// Add nanoseconds to a timespec.
+   static timespec tsAdd( const timespec & ts,
+                          int64_t nsec
+                        )
+   {
+      timespec r;
+      r.tv_sec = ts.tv_sec + nsec / 1000000000;
+      r.tv_nsec = ts.tv_nsec + nsec % 1000000000;
+      if(r.tv_nsec >= 1000000000)
+      {
+         r.tv_nsec -= 1000000000;
+         r.tv_sec += 1;
+      }
+      return r;
+   }
+
+   /// Nanoseconds from \p t0 to \p t1.
+   static int64_t tsDiff( const timespec & t1,
+                          const timespec & t0
+                        )
+   {
+      return ((int64_t) (t1.tv_sec - t0.tv_sec))*1000000000 + (t1.tv_nsec - t0.tv_nsec);
+   }
+};
+
+template<typename realT>
+template<class keepGoingT>
+int waveformPlayer<realT>::play( keepGoingT && keepGoing,
+                                 IMAGE * trigger,
+                                 int triggerSem
+                               )
+{
+   if(m_stream == nullptr) return -1;
+
+   m_idx = 0;
+   swapPlanes();
+
+   const mx::improc::eigenCube<realT> & planes = m_planes[m_active.load(std::memory_order_relaxed)];
+   if(planes.planes() == 0 || (size_t) (planes.rows()*planes.cols()) != nPixels()) return -1;
+
+   if(trigger)
+   {
+      ImageStreamIO_semflush(trigger, triggerSem);
+      sem_t * sem = trigger->semptr[triggerSem];
+
+      timespec last {0,0};
+
+      while(keepGoing())
+      {
+         timespec ts;
+
+         if(clock_gettime(CLOCK_REALTIME, &ts) < 0) return errno;
+
+         ts.tv_sec += 1;
+
+         if(sem_timedwait(sem, &ts) != 0)
+         {
+            if(errno == EINTR) return 0; //a signal interrupted us, time to restart or shutdown
+            if(errno == ETIMEDOUT) continue;
+            return errno;
+         }
+
+         writePlane(false);
+
+         clock_gettime(CLOCK_REALTIME, &ts);
+         double lat = tsDiff(ts, trigger->md->writetime)/1e9;
+         double per = (last.tv_sec == 0) ? -1 : tsDiff(ts, last)/1e9;
+         last = ts;
+
+         accumulate(per, lat, 0);
+
+         advance(1);
+      }
+
+      return 0;
+   }
+
+   double freq = m_frequency.load(std::memory_order_acquire);
+   double periodNs = (freq > 0) ? 1e9/freq : 0;
+
+   timespec t0;
+   clock_gettime(CLOCK_MONOTONIC, &t0);
+
+   uint64_t n = 0; //the number of periods since t0
+   int64_t lastNs = -1; //the time of the last write since t0
+
+   while(keepGoing())
+   {
+      double f = m_frequency.load(std::memory_order_acquire);
+      if(f != freq)
+      {
+         //Re-base at the next deadline so the phase is continuous
+         t0 = tsAdd(t0, llround(n*periodNs));
+         if(lastNs >= 0) lastNs -= llround(n*periodNs);
+         n = 0;
+         freq = f;
+         periodNs = (freq > 0) ? 1e9/freq : 0;
+      }
+
+      if(periodNs <= 0)
+      {
+         //Paused by a zero frequency
+         timespec ts {0, 100000000};
+         nanosleep(&ts, nullptr);
+         clock_gettime(CLOCK_MONOTONIC, &t0);
+         lastNs = -1;
+         continue;
+      }
+
+      int64_t dlNs = llround(n*periodNs);
+      timespec deadline = tsAdd(t0, dlNs);
+
+      int rv = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr);
+      if(rv == EINTR) continue; //check keepGoing
+      if(rv != 0) return rv;
+
+      timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      int64_t nowNs = tsDiff(now, t0);
+
+      //If we missed whole periods, skip to the plane for the current time
+      uint64_t skip = 0;
+      if(nowNs - dlNs >= periodNs)
+      {
+         skip = (nowNs - dlNs)/periodNs;
+         n += skip;
+         dlNs = llround(n*periodNs);
+         advance(skip);
+      }
+
+      writePlane(true);
+
+      accumulate( (lastNs < 0) ? -1 : (nowNs - lastNs)/1e9, (nowNs - dlNs)/1e9, skip);
+      lastNs = nowNs;
+
+      ++n;
+      advance(1);
+   }
+
+   return 0;
+}
+
+} //namespace dev
+} //namespace app
+} //namespace MagAOX
+
+#endif //waveformPlayer_hpp
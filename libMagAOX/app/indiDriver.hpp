@@ -11,6 +11,14 @@
 #ifndef app_indiDriver_hpp
 #define app_indiDriver_hpp
 
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
 #include "../../INDI/libcommon/IndiDriver.hpp"
 #include "../../INDI/libcommon/IndiElement.hpp"
 
@@ -75,6 +83,40 @@ private:
    /// Flag to hold the status of this connection.
    bool m_good {true};
 
+   ///The rate limiting state of one property.
+   struct rateLimit
+   {
+      std::chrono::steady_clock::duration minInterval {0}; ///< The minimum time between set property messages.  0 is no limit.
+      std::chrono::steady_clock::time_point lastSent; ///< When the last message was sent.
+      bool pending {false}; ///< True if latest is waiting to be sent by the publisher.
+      bool sending {false}; ///< True while the publisher is sending this property, so a newer value must wait for it.
+      pcf::IndiProperty latest; ///< The latest value, if pending.
+   };
+
+   ///Flag indicating that a rate limit has been set, so sendSetProperty must check it.
+   bool m_rateLimited {false};
+
+   ///The minimum interval for properties without their own limit.
+   std::chrono::steady_clock::duration m_minInterval {0};
+
+   ///The rate limits, keyed by property name.  Entries are added the first time a property is sent.
+   mutable std::unordered_map<std::string, rateLimit> m_rateLimits;
+
+   ///Mutex protecting m_rateLimits and m_publisherQuit.  This is never held while sending.
+   mutable std::mutex m_rateMutex;
+
+   ///Wakes the publisher thread when a property becomes pending, or on shutdown.
+   mutable std::condition_variable m_rateCond;
+
+   ///The thread which sends pending properties once their interval has passed.
+   std::thread m_publisher;
+
+   ///Flag telling the publisher thread to exit.
+   bool m_publisherQuit {false};
+
+   ///The properties sent in one batch by the publisher.  Only used by the publisher thread.
+   std::vector<pcf::IndiProperty> m_batch;
+
 public:
 
    /// Public c'tor
@@ -120,6 +162,33 @@ public:
      */
    virtual int sendNewProperty( const pcf::IndiProperty &ipRecv );
 
+   /// Set the maximum rate of set property messages for each property.
+   /** Applies to every property which does not have its own limit, see maxRate(const std::string &, double).
+     * Should be called before the driver is activated.
+     */
+   void maxRate( double hz /**< [in] the maximum rate in Hz. 0 or less is no limit.*/ );
+
+   /// Set the maximum rate of set property messages for one property.
+   /** Should be called before the driver is activated.
+     */
+   void maxRate( const std::string & name, ///< [in] the property name
+                 double hz ///< [in] the maximum rate in Hz. 0 or less is no limit, even if there is a global limit.
+               );
+
+   /// Send a set property message, subject to the rate limits.
+   /** If the property was sent less than its minimum interval ago, a copy is kept and the publisher thread sends
+     * the latest value once the interval has passed.  So the last value is always delivered, with the time
+     * it was set.  This hides pcf::IndiDriver::sendSetProperty, so it is used by the indi::updateIfChanged family.
+     */
+   void sendSetProperty( const pcf::IndiProperty &ipSend ) const;
+
+protected:
+   /// The publisher thread, which sends pending properties in one batch as they come due.
+   void publisher();
+
+   /// Convert a rate in Hz to the minimum interval between messages.
+   static std::chrono::steady_clock::duration rateInterval( double hz );
+
 };
 
 template<class parentT>
@@ -179,6 +248,16 @@ indiDriver<parentT>::indiDriver ( parentT * parent,
 template<class parentT>
 indiDriver<parentT>::~indiDriver()
 {
+   if(m_publisher.joinable())
+   {
+      {
+         std::lock_guard<std::mutex> lock(m_rateMutex);
+         m_publisherQuit = true;
+      }
+      m_rateCond.notify_all();
+      m_publisher.join();
+   }
+
    if(m_outGoing) delete m_outGoing;
 
 }
@@ -287,6 +366,139 @@ int  indiDriver<parentT>::sendNewProperty( const pcf::IndiProperty &ipRecv )
    return -1;
 }
 
+template<class parentT>
+void indiDriver<parentT>::maxRate( double hz )
+{
+   std::lock_guard<std::mutex> lock(m_rateMutex);
+
+   m_minInterval = rateInterval(hz);
+   if(m_minInterval.count() > 0) m_rateLimited = true;
+
+   if(m_rateLimited && !m_publisher.joinable()) m_publisher = std::thread( &indiDriver<parentT>::publisher, this);
+}
+
+template<class parentT>
+void indiDriver<parentT>::maxRate( const std::string & name,
+                                   double hz
+                                 )
+{
+   std::lock_guard<std::mutex> lock(m_rateMutex);
+
+   m_rateLimits[name].minInterval = rateInterval(hz);
+   m_rateLimited = true;
+
+   if(!m_publisher.joinable()) m_publisher = std::thread( &indiDriver<parentT>::publisher, this);
+}
+
+template<class parentT>
+void indiDriver<parentT>::sendSetProperty( const pcf::IndiProperty &ipSend ) const
+{
+   if(!m_rateLimited)
+   {
+      pcf::IndiDriver::sendSetProperty(ipSend);
+      return;
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(m_rateMutex);
+
+      auto it = m_rateLimits.find(ipSend.getName());
+      if(it == m_rateLimits.end())
+      {
+         it = m_rateLimits.emplace(ipSend.getName(), rateLimit()).first;
+         it->second.minInterval = m_minInterval;
+      }
+
+      rateLimit & rl = it->second;
+
+      std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+      //Send now if the interval has passed and nothing is waiting or being sent, which keeps the order of the messages.
+      if(rl.minInterval.count() > 0 && (rl.pending || rl.sending || now - rl.lastSent < rl.minInterval))
+      {
+         rl.latest = ipSend;
+         rl.latest.setTimeStamp(pcf::TimeStamp::now());
+         if(!rl.pending)
+         {
+            rl.pending = true;
+            m_rateCond.notify_one();
+         }
+         return;
+      }
+
+      rl.lastSent = now;
+   }
+
+   pcf::IndiDriver::sendSetProperty(ipSend);
+}
+
+template<class parentT>
+void indiDriver<parentT>::publisher()
+{
+   std::unique_lock<std::mutex> lock(m_rateMutex);
+
+   while(!m_publisherQuit)
+   {
+      std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+      std::chrono::steady_clock::time_point next = std::chrono::steady_clock::time_point::max();
+
+      m_batch.clear();
+      for(auto it = m_rateLimits.begin(); it != m_rateLimits.end(); ++it)
+      {
+         rateLimit & rl = it->second;
+         if(!rl.pending) continue;
+
+         std::chrono::steady_clock::time_point due = rl.lastSent + rl.minInterval;
+         if(due <= now)
+         {
+            m_batch.push_back(rl.latest);
+            rl.pending = false;
+            rl.sending = true;
+         }
+         else if(due < next)
+         {
+            next = due;
+         }
+      }
+
+      if(m_batch.size() > 0)
+      {
+         //The app threads can keep updating while the batch is sent.
+         lock.unlock();
+         try
+         {
+            sendSetProperties(m_batch);
+         }
+         catch(...)
+         {
+            std::cerr << "INDI Exception at " << __FILE__ << " " << __LINE__ << "\n";
+         }
+         lock.lock();
+
+         //The interval starts when the batch has gone out, and updates made meanwhile are now due after it.
+         now = std::chrono::steady_clock::now();
+         for(size_t n = 0; n < m_batch.size(); ++n)
+         {
+            rateLimit & rl = m_rateLimits[m_batch[n].getName()];
+            rl.sending = false;
+            rl.lastSent = now;
+         }
+         continue;
+      }
+
+      if(next == std::chrono::steady_clock::time_point::max()) m_rateCond.wait(lock);
+      else m_rateCond.wait_until(lock, next);
+   }
+}
+
+template<class parentT>
+std::chrono::steady_clock::duration indiDriver<parentT>::rateInterval( double hz )
+{
+   if(hz <= 0) return std::chrono::steady_clock::duration(0);
+
+   return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0/hz));
+}
+
 } //namespace app
 } //namespace MagAOX
 
@@ -12,6 +12,9 @@
 #define app_indiUtils_hpp
 
 #include <limits>
+#include <iostream>
+#include <cmath>
+#include <type_traits>
 
 #include "../../INDI/libcommon/IndiProperty.hpp"
 #include "../../INDI/libcommon/IndiElement.hpp"
@@ -83,9 +86,69 @@ int addNumberElement( pcf::IndiProperty & prop, ///< [out] the property to which
    return 0;
 }
 
+/// Check if a new value is different from the current value of an INDI element, comparing in string space.
+/** This is used for types which IndiElement does not store as numbers, and for elements which have not yet been set from one.
+  */
+template<typename T>
+bool elementChanged( const pcf::IndiElement & e, ///< [in] The element
+                     const T & newVal,           ///< [in] the new value
+                     double deadband,            ///< [in] unused
+                     std::false_type
+                   )
+{
+   static_cast<void>(deadband);
+
+   //This is same code in IndiElement
+   std::stringstream ssValue;
+   ssValue.precision( 15 );
+   ssValue << std::boolalpha << newVal;
+
+   return (e.getValue() != ssValue.str());
+}
+
+/// Check if a new value is different from the current value of an INDI element, comparing raw numbers.
+/** The value stored by IndiElement when it was last set is used, so there is no formatting or parsing.
+  * The value has changed if it differs by more than the deadband, or if exactly one of the values is NaN.
+  */
+template<typename T>
+bool elementChanged( const pcf::IndiElement & e, ///< [in] The element
+                     const T & newVal,           ///< [in] the new value
+                     double deadband,            ///< [in] the largest change which is not reported
+                     std::true_type
+                   )
+{
+   double oldVal;
+   if(!e.getNumber(oldVal)) return elementChanged(e, newVal, deadband, std::false_type());
+
+   double nv = newVal;
+
+   if(std::isnan(nv) || std::isnan(oldVal)) return !(std::isnan(nv) && std::isnan(oldVal));
+
+   if(deadband <= 0) return (nv != oldVal);
+
+   return (std::fabs(nv - oldVal) > deadband);
+}
+
+/// Check if a new value is different from the current value of an INDI element.
+/** Numbers are compared as raw values, with an optional deadband.  Other types are compared in string space.
+  *
+  * \returns true if the value has changed
+  */
+template<typename T>
+bool elementChanged( const pcf::IndiElement & e, ///< [in] The element
+                     const T & newVal,           ///< [in] the new value
+                     double deadband = 0         ///< [in] [optional] the largest change in a number which is not reported
+                   )
+{
+   return elementChanged(e, newVal, deadband, std::integral_constant<bool, pcf::IndiElement::IsNumber<T>::value>());
+}
+
 /// Update the value of the INDI element, but only if it has changed.
 /** Only sends the set property message if the new value is different.
   * For properties with more than one element that may have changed, you should use the vector version below.
+  *
+  * Numbers are compared as raw values, and a deadband can be given so that changes smaller than it are not sent.
+  * Note that the deadband is relative to the last value sent, so a slow drift is sent once it exceeds the deadband.
   * 
   * \todo this needs a const char specialization to std::string
   * 
@@ -95,22 +158,17 @@ void updateIfChanged( pcf::IndiProperty & p,   ///< [in/out] The property contai
                       const std::string & el,  ///< [in] The element name
                       const T & newVal,        ///< [in] the new value
                       indiDriverT * indiDriver, ///< [in] the MagAOX INDI driver to use
-                      pcf::IndiProperty::PropertyStateType newState = pcf::IndiProperty::Ok
+                      pcf::IndiProperty::PropertyStateType newState = pcf::IndiProperty::Ok,
+                      double deadband = 0      ///< [in] [optional] changes in a number no larger than this are not sent
                     )
 {
    if( !indiDriver ) return;
    
    try
    {
-      //This is same code in IndiElement
-      std::stringstream ssValue;
-      ssValue.precision( 15 );
-      ssValue << std::boolalpha << newVal;
-      
       pcf::IndiProperty::PropertyStateType oldState = p.getState();
    
-      //Do comparison in string space, not raw value
-      if(p[el].getValue() != ssValue.str()|| oldState != newState)
+      if(oldState != newState || elementChanged(p[el], newVal, deadband))
       {
          p[el].set(newVal);
          p.setState (newState);
@@ -133,6 +191,8 @@ void updateIfChanged( pcf::IndiProperty & p,   ///< [in/out] The property contai
 
 /// Update the elements of an INDI propery, but only if there has been a change in at least one.
 /** Only sends the set property message if at least one of the new values is different, or if the state has changed.
+  *
+  * Numbers are compared as raw values, with an optional deadband as for the single element version.
   *
   * \todo this needs a const char specialization to std::string
   * 
@@ -142,7 +202,8 @@ void updateIfChanged( pcf::IndiProperty & p,   ///< [in/out] The property contai
                       const std::vector<std::string> & els,  ///< [in] The element names
                       const std::vector<T> & newVals,        ///< [in] the new values
                       indiDriverT * indiDriver, ///< [in] the MagAOX INDI driver to use
-                      pcf::IndiProperty::PropertyStateType newState = pcf::IndiProperty::Ok
+                      pcf::IndiProperty::PropertyStateType newState = pcf::IndiProperty::Ok,
+                      double deadband = 0      ///< [in] [optional] changes in a number no larger than this are not sent
                     )
 {
    if( !indiDriver ) return;
@@ -158,13 +219,7 @@ void updateIfChanged( pcf::IndiProperty & p,   ///< [in/out] The property contai
       
       for(n=0; n< els.size() && changed != true; ++n)
       {
-         //This is same code in IndiElement
-         std::stringstream ssValue;
-         ssValue.precision( 15 );
-         ssValue << std::boolalpha << newVals[n];
-
-         //compare in string space
-         if(p[els[n]].getValue() != ssValue.str()) changed = true;
+         if(elementChanged(p[els[n]], newVals[n], deadband)) changed = true;
       }
       
       //and if there are changes, we send an update
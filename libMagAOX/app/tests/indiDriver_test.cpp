@@ -0,0 +1,236 @@
+/** \file indiDriver_test.cpp
+  * \brief Catch2 tests for the set property rate limits in indiDriver.
+  *
+  * The driver writes to regular files in place of the FIFOs, and the messages are read back from the output file.
+  *
+  * History:
+  */
+#include "../../../tests/catch2/catch.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <unistd.h>
+
+#include "../indiDriver.hpp"
+
+namespace indiDriver_tests
+{
+
+/// A parent with just what indiDriver uses, with the FIFOs replaced by files.
+struct indiDriverTestParent
+{
+   std::string m_base;
+
+   indiDriverTestParent()
+   {
+      m_base = "/tmp/indiDriver_test_" + std::to_string(getpid());
+
+      //Create or truncate the files, so each test starts with an empty output.
+      std::ofstream fout;
+      fout.open(driverInName());
+      fout.close();
+      fout.open(driverOutName());
+      fout.close();
+      fout.open(driverCtrlName());
+      fout.close();
+   }
+
+   ~indiDriverTestParent()
+   {
+      unlink(driverInName().c_str());
+      unlink(driverOutName().c_str());
+      unlink(driverCtrlName().c_str());
+   }
+
+   template<typename logT>
+   static int log( const typename logT::messageT & msg )
+   {
+      static_cast<void>(msg);
+      return 0;
+   }
+
+   std::string driverInName() { return m_base + ".in"; }
+   std::string driverOutName() { return m_base + ".out"; }
+   std::string driverCtrlName() { return m_base + ".ctrl"; }
+   std::string configName() { return "indiDriver_test"; }
+
+   void handleDefProperty( const pcf::IndiProperty & ) {}
+   void handleGetProperties( const pcf::IndiProperty & ) {}
+   void handleNewProperty( const pcf::IndiProperty & ) {}
+   void handleSetProperty( const pcf::IndiProperty & ) {}
+};
+
+typedef MagAOX::app::indiDriver<indiDriverTestParent> driverT;
+
+/// Send `num` updates of property `name` with the values 1 to num, pausing `pause` between them.
+void sendUpdates( driverT & driver,
+                  const std::string & name,
+                  int num,
+                  std::chrono::microseconds pause = std::chrono::microseconds(0)
+                )
+{
+   pcf::IndiProperty ip(pcf::IndiProperty::Number, "test", name);
+   ip.add(pcf::IndiElement("value", 0));
+
+   for(int n = 1; n <= num; ++n)
+   {
+      ip["value"].set(n);
+      driver.sendSetProperty(ip);
+      if(pause.count() > 0) std::this_thread::sleep_for(pause);
+   }
+}
+
+/// Get the values sent for property `name`, in the order they were written to the output file.
+std::vector<int> sentValues( indiDriverTestParent & parent,
+                             const std::string & name
+                           )
+{
+   std::ifstream fin(parent.driverOutName());
+   std::stringstream ss;
+   ss << fin.rdbuf();
+   std::string out = ss.str();
+
+   std::vector<int> values;
+
+   std::string key = "name=\"" + name + "\"";
+   size_t pos = 0;
+   while((pos = out.find("<setNumberVector", pos)) != std::string::npos)
+   {
+      size_t end = out.find("</setNumberVector>", pos);
+      if(end == std::string::npos) break;
+
+      std::string msg = out.substr(pos, end - pos);
+      pos = end;
+
+      if(msg.find(key) == std::string::npos) continue;
+
+      size_t vpos = msg.find("<oneNumber");
+      if(vpos == std::string::npos) continue;
+      vpos = msg.find('>', vpos);
+      if(vpos == std::string::npos) continue;
+
+      values.push_back(std::stoi(msg.substr(vpos+1)));
+   }
+
+   return values;
+}
+
+SCENARIO( "Rate limiting set property messages", "[indiDriver]" )
+{
+   GIVEN("a driver with a 10 Hz limit for all properties")
+   {
+      indiDriverTestParent parent;
+      std::vector<int> slow, fast;
+
+      WHEN("a property is updated 20 times at once")
+      {
+         {
+            driverT driver(&parent, "test", "0", "0");
+            REQUIRE(driver.good());
+            driver.enableResponseMode(true);
+            driver.maxRate(10);
+
+            sendUpdates(driver, "slow", 20);
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+         }
+
+         slow = sentValues(parent, "slow");
+
+         //The first is sent right away, and the publisher sends the latest one after 0.1 s.
+         REQUIRE(slow.size() == 2);
+         REQUIRE(slow[0] == 1);
+         REQUIRE(slow[1] == 20);
+      }
+      WHEN("a property is updated every millisecond for 0.5 s")
+      {
+         {
+            driverT driver(&parent, "test", "0", "0");
+            REQUIRE(driver.good());
+            driver.enableResponseMode(true);
+            driver.maxRate(10);
+
+            sendUpdates(driver, "slow", 500, std::chrono::microseconds(1000));
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+         }
+
+         slow = sentValues(parent, "slow");
+
+         //About 5 at 10 Hz, allowing for the sleeps running long.
+         REQUIRE(slow.size() >= 4);
+         REQUIRE(slow.size() <= 8);
+
+         for(size_t n = 1; n < slow.size(); ++n) REQUIRE(slow[n] > slow[n-1]);
+
+         REQUIRE(slow.back() == 500);
+      }
+      WHEN("one property is exempted with a limit of 0")
+      {
+         {
+            driverT driver(&parent, "test", "0", "0");
+            REQUIRE(driver.good());
+            driver.enableResponseMode(true);
+            driver.maxRate(10);
+            driver.maxRate("fast", 0);
+
+            sendUpdates(driver, "slow", 20);
+            sendUpdates(driver, "fast", 20);
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+         }
+
+         slow = sentValues(parent, "slow");
+         fast = sentValues(parent, "fast");
+
+         REQUIRE(slow.size() == 2);
+         REQUIRE(slow.back() == 20);
+
+         REQUIRE(fast.size() == 20);
+         for(size_t n = 0; n < fast.size(); ++n) REQUIRE(fast[n] == (int) n + 1);
+      }
+   }
+   GIVEN("a driver with no global limit")
+   {
+      indiDriverTestParent parent;
+      std::vector<int> slow, fast;
+
+      WHEN("one property has its own 10 Hz limit")
+      {
+         {
+            driverT driver(&parent, "test", "0", "0");
+            REQUIRE(driver.good());
+            driver.enableResponseMode(true);
+            driver.maxRate("slow", 10);
+
+            sendUpdates(driver, "slow", 20);
+            sendUpdates(driver, "fast", 20);
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+         }
+
+         slow = sentValues(parent, "slow");
+         fast = sentValues(parent, "fast");
+
+         REQUIRE(slow.size() == 2);
+         REQUIRE(slow[0] == 1);
+         REQUIRE(slow[1] == 20);
+
+         REQUIRE(fast.size() == 20);
+      }
+      WHEN("no limit is set")
+      {
+         {
+            driverT driver(&parent, "test", "0", "0");
+            REQUIRE(driver.good());
+            driver.enableResponseMode(true);
+
+            sendUpdates(driver, "slow", 20);
+         }
+
+         slow = sentValues(parent, "slow");
+
+         REQUIRE(slow.size() == 20);
+      }
+   }
+}
+
+} //namespace indiDriver_tests
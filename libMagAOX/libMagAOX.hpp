@@ -22,6 +22,8 @@
 #include "app/dev/dssShutter.hpp"
 #include "app/dev/shmimMonitor.hpp"
 #include "app/dev/dm.hpp"
+#include "app/dev/waveformPlayer.hpp"
+#include "app/dev/modalOffload.hpp"
 #include "app/dev/telemeter.hpp"
 
 #include "sys/runCommand.hpp"
@@ -41,6 +41,7 @@ timespec telem_telsee::lastRecord = {0,0};
 timespec telem_telvane::lastRecord = {0,0};
 timespec telem_temps::lastRecord = {0,0};
 timespec telem_usage::lastRecord = {0,0};
+timespec telem_waveform::lastRecord = {0,0};
 timespec telem_zaber::lastRecord = {0,0};
 
 } //namespace logger
@@ -0,0 +1,146 @@
+/** \file telem_waveform.hpp
+  * \brief The MagAO-X logger telem_waveform log type.
+  *
+  * \ingroup logger_types_files
+  *
+  * History:
+  * - 2026-10-18 created
+  */
+#ifndef logger_types_telem_waveform_hpp
+#define logger_types_telem_waveform_hpp
+
+#include "generated/telem_waveform_generated.h"
+#include "flatbuffer_log.hpp"
+
+namespace MagAOX
+{
+namespace logger
+{
+
+
+/// Log entry recording the timing of a DM waveform player.
+/** \ingroup logger_types
+  */
+struct telem_waveform : public flatbuffer_log
+{
+   ///The event code
+   static const flatlogs::eventCodeT eventCode = eventCodes::TELEM_WAVEFORM;
+
+   ///The default level
+   static const flatlogs::logPrioT defaultLevel = flatlogs::logPrio::LOG_TELEM;
+
+   static timespec lastRecord; ///< The timestamp of the last time this log was recorded.  Used by the telemetry system.
+
+   ///The type of the input message
+   struct messageT : public fbMessage
+   {
+      ///Construct from components
+      messageT( const double & period,        ///< [in] mean time between writes
+                const double & period_jitter, ///< [in] standard deviation of the time between writes
+                const double & latency,       ///< [in] mean latency of the writes
+                const double & latency_max,   ///< [in] maximum latency of the writes
+                const uint32_t & skipped      ///< [in] number of planes skipped due to missed deadlines
+              )
+      {
+         auto fp = CreateTelem_waveform_fb(builder, period, period_jitter, latency, latency_max, skipped);
+         builder.Finish(fp);
+      }
+
+   };
+
+
+   ///Get the message formatte for human consumption.
+   static std::string msgString( void * msgBuffer,  /**< [in] Buffer containing the flatbuffer serialized message.*/
+                                 flatlogs::msgLenT len  /**< [in] [unused] length of msgBuffer.*/
+                               )
+   {
+      static_cast<void>(len);
+
+      char buf[64];
+
+      auto fbs = GetTelem_waveform_fb(msgBuffer);
+
+      std::string msg = "[waveform]";
+
+      msg += " per: ";
+
+      snprintf(buf, sizeof(buf), "%0.10e", fbs->period());
+      msg += buf;
+      msg += " +/- ";
+      snprintf(buf, sizeof(buf), "%0.5e", fbs->period_jitter());
+      msg += buf;
+
+      msg += " lat: ";
+
+      snprintf(buf, sizeof(buf), "%0.5e", fbs->latency());
+      msg += buf;
+      msg += " max: ";
+      snprintf(buf, sizeof(buf), "%0.5e", fbs->latency_max());
+      msg += buf;
+
+      msg += " skipped: ";
+      msg += std::to_string(fbs->skipped());
+
+      return msg;
+
+   }
+
+   static double period( void * msgBuffer )
+   {
+      auto fbs = GetTelem_waveform_fb(msgBuffer);
+      return fbs->period();
+   }
+
+   static double period_jitter( void * msgBuffer )
+   {
+      auto fbs = GetTelem_waveform_fb(msgBuffer);
+      return fbs->period_jitter();
+   }
+
+   static double latency( void * msgBuffer )
+   {
+      auto fbs = GetTelem_waveform_fb(msgBuffer);
+      return fbs->latency();
+   }
+
+   static double latency_max( void * msgBuffer )
+   {
+      auto fbs = GetTelem_waveform_fb(msgBuffer);
+      return fbs->latency_max();
+   }
+
+   static uint32_t skipped( void * msgBuffer )
+   {
+      auto fbs = GetTelem_waveform_fb(msgBuffer);
+      return fbs->skipped();
+   }
+
+   /// Get pointer to the accessor for a member by name
+   /**
+     * \returns the function pointer cast to void*
+     * \returns -1 for an unknown member
+     */
+   static logMetaDetail getAccessor( const std::string & member /**< [in] the name of the member */ )
+   {
+      if(member == "period") return logMetaDetail({"PERIOD", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, (void *) &period});
+      else if(member == "period_jitter") return logMetaDetail({"PERIOD JITTER", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, (void *) &period_jitter});
+      else if(member == "latency") return logMetaDetail({"LATENCY", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, (void *) &latency});
+      else if(member == "latency_max") return logMetaDetail({"MAX LATENCY", logMeta::valTypes::Double, logMeta::metaTypes::Continuous, (void *) &latency_max});
+      else if(member == "skipped") return logMetaDetail({"SKIPPED", logMeta::valTypes::UInt, logMeta::metaTypes::Continuous, (void *) &skipped});
+
+      else
+      {
+         std::cerr << "No string member " << member << " in telem_waveform\n";
+         return logMetaDetail();
+      }
+   }
+
+}; //telem_waveform
+
+
+
+} //namespace logger
+} //namespace MagAOX
+
+#endif //logger_types_telem_waveform_hpp
+
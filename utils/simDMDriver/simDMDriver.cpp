@@ -0,0 +1,17 @@
+/** \file simDMDriver.cpp
+  * \brief The simDMDriver main program.
+  *
+  * \ingroup simDMDriver_files
+  */
+
+#include "simDMDriver.hpp"
+
+
+
+int main(int argc, char **argv)
+{
+   simDMDriver sd;
+
+   return sd.main(argc, argv);
+
+}
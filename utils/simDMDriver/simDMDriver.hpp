@@ -0,0 +1,344 @@
+/** \file simDMDriver.hpp
+  * \brief The simDMDriver class declaration and definition.
+  *
+  * \ingroup simDMDriver_files
+  */
+
+#ifndef simDMDriver_hpp
+#define simDMDriver_hpp
+
+#include <random>
+
+#include <ImageStreamIO/ImageStruct.h>
+#include <ImageStreamIO/ImageStreamIO.h>
+
+#include <mx/improc/eigenCube.hpp>
+#include <mx/ioutils/fits/fitsFile.hpp>
+
+#include "../../libMagAOX/libMagAOX.hpp"
+
+/** \defgroup simDMDriver simDMDriver: DM Shape Publisher
+  * \brief Publish DM shapes to shared memory at a fixed rate, for measuring the latency of the DM command path.
+  *
+  * <a href="../handbook/utils/simDMDriver.html">Utility Documentation</a>
+  *
+  * \ingroup utils
+  *
+  */
+
+/** \defgroup simDMDriver_files simDMDriver Files
+  * \ingroup simDMDriver
+  */
+
+bool g_timeToDie = false;
+
+void sigTermHandler( int signum,
+                     siginfo_t *siginf,
+                     void *ucont
+                    )
+{
+   //Suppress those warnings . . .
+   static_cast<void>(signum);
+   static_cast<void>(siginf);
+   static_cast<void>(ucont);
+
+   std::cerr << "\n"; //clear out the ^C char
+
+   g_timeToDie = true;
+}
+
+/// A utility to publish DM shapes to an ImageStreamIO stream at a fixed rate.
+/** Shapes are read from a FITS cube, or generated as random uniform shapes, and written in turn to the stream.
+  * Each write sets the stream's writetime and increments cnt0, so a simDM monitoring the stream can measure the
+  * latency from the write and count dropped commands.  Writes are scheduled on absolute deadlines, and writes
+  * which can not be made on time are skipped and counted as late.
+  *
+  * \ingroup simDMDriver
+  */
+class simDMDriver : public mx::app::application
+{
+protected:
+   /** \name Configurable Parameters
+     * @{
+     */
+
+   std::string m_shmimName; ///< The name of the shared memory buffer to write to, e.g. a DM channel.
+
+   std::string m_shapeFile; ///< FITS cube of shapes to publish.  If empty, random shapes are generated.
+
+   uint32_t m_width {0}; ///< The width of the shapes, used to create the stream if it does not exist.
+   uint32_t m_height {0}; ///< The height of the shapes, used to create the stream if it does not exist.
+
+   int m_nShapes {10}; ///< The number of random shapes to generate.
+
+   float m_amp {0.1}; ///< The amplitude of the random shapes.
+
+   double m_rate {1000}; ///< The rate, in Hz, at which to publish shapes.
+
+   double m_duration {10}; ///< How long to run, in seconds.  If 0, runs until killed.
+
+   ///@}
+
+   mx::improc::eigenCube<float> m_shapes; ///< The shapes to publish.
+
+   IMAGE m_imageStream; ///< The ImageStreamIO shared memory buffer.
+
+   bool m_opened {false}; ///< Whether m_imageStream is open.
+
+public:
+
+   ~simDMDriver();
+
+   virtual void setupConfig();
+
+   virtual void loadConfig();
+
+   virtual int execute();
+
+protected:
+
+   /// Load or generate the shapes.
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int loadShapes();
+
+   /// Open the stream, creating it if needed.
+   /**
+     * \returns 0 on success
+     * \returns -1 on error
+     */
+   int openStream();
+};
+
+inline
+simDMDriver::~simDMDriver()
+{
+   if(m_opened)
+   {
+      ImageStreamIO_closeIm(&m_imageStream);
+   }
+}
+
+inline
+void simDMDriver::setupConfig()
+{
+   config.add("shmimName","n", "shmimName" , argType::Required, "", "shmimName", false,  "string", "The name of the shared memory buffer to write to, e.g. a DM channel.");
+   config.add("shapeFile","f", "shapeFile" , argType::Required, "", "shapeFile", false,  "string", "FITS cube of shapes to publish.  If not set, random shapes are generated.");
+   config.add("width","W", "width" , argType::Required, "", "width", false,  "int", "The width of the shapes, used to create the stream if it does not exist.");
+   config.add("height","H", "height" , argType::Required, "", "height", false,  "int", "The height of the shapes, used to create the stream if it does not exist.");
+   config.add("nShapes","N", "nShapes" , argType::Required, "", "nShapes", false,  "int", "The number of random shapes to generate.  Default is 10.");
+   config.add("amp","a", "amp" , argType::Required, "", "amp", false,  "float", "The amplitude of the random shapes.  Default is 0.1.");
+   config.add("rate","r", "rate" , argType::Required, "", "rate", false,  "float", "The rate, in Hz, at which to publish shapes.  Default is 1000.");
+   config.add("duration","d", "duration" , argType::Required, "", "duration", false,  "float", "How long to run, in seconds.  If 0, runs until killed.  Default is 10.");
+}
+
+inline
+void simDMDriver::loadConfig()
+{
+   config(m_shmimName, "shmimName");
+   config(m_shapeFile, "shapeFile");
+   config(m_width, "width");
+   config(m_height, "height");
+   config(m_nShapes, "nShapes");
+   config(m_amp, "amp");
+   config(m_rate, "rate");
+   config(m_duration, "duration");
+}
+
+inline
+int simDMDriver::loadShapes()
+{
+   if(m_shapeFile != "")
+   {
+      mx::fits::fitsFile<float> ff;
+      if(ff.read(m_shapes, m_shapeFile) < 0)
+      {
+         std::cerr << " (" << invokedName << "): error reading " << m_shapeFile << "\n";
+         return -1;
+      }
+
+      return 0;
+   }
+
+   if(m_width == 0 || m_height == 0 || m_nShapes < 1)
+   {
+      std::cerr << " (" << invokedName << "): width, height and nShapes are needed to generate shapes\n";
+      return -1;
+   }
+
+   std::mt19937 gen(1);
+   std::uniform_real_distribution<float> dist(-m_amp, m_amp);
+
+   m_shapes.resize(m_width, m_height, m_nShapes);
+   for(int p = 0; p < m_shapes.planes(); ++p)
+   {
+      for(int n = 0; n < m_shapes.rows()*m_shapes.cols(); ++n)
+      {
+         m_shapes.image(p).data()[n] = dist(gen);
+      }
+   }
+
+   return 0;
+}
+
+inline
+int simDMDriver::openStream()
+{
+   if( ImageStreamIO_openIm(&m_imageStream, m_shmimName.c_str()) == 0)
+   {
+      m_opened = true;
+
+      if(m_imageStream.md[0].datatype != _DATATYPE_FLOAT)
+      {
+         std::cerr << " (" << invokedName << "): " << m_shmimName << " is not float\n";
+         return -1;
+      }
+
+      if(m_imageStream.md[0].size[0] != m_shapes.rows() || m_imageStream.md[0].size[1] != m_shapes.cols())
+      {
+         std::cerr << " (" << invokedName << "): " << m_shmimName << " is " << m_imageStream.md[0].size[0] << "x" << m_imageStream.md[0].size[1];
+         std::cerr << " but the shapes are " << m_shapes.rows() << "x" << m_shapes.cols() << "\n";
+         return -1;
+      }
+
+      return 0;
+   }
+
+   uint32_t imsize[3];
+   imsize[0] = m_shapes.rows();
+   imsize[1] = m_shapes.cols();
+   imsize[2] = 1;
+
+   if(ImageStreamIO_createIm_gpu(&m_imageStream, m_shmimName.c_str(), 3, imsize, _DATATYPE_FLOAT, -1, 1, IMAGE_NB_SEMAPHORE, 0, CIRCULAR_BUFFER | ZAXIS_TEMPORAL, 0) != IMAGESTREAMIO_SUCCESS)
+   {
+      std::cerr << " (" << invokedName << "): error creating " << m_shmimName << "\n";
+      return -1;
+   }
+
+   m_opened = true;
+
+   return 0;
+}
+
+inline
+int simDMDriver::execute()
+{
+   //Install signal handling
+   struct sigaction act;
+   sigset_t set;
+
+   act.sa_sigaction = sigTermHandler;
+   act.sa_flags = SA_SIGINFO;
+   sigemptyset(&set);
+   act.sa_mask = set;
+
+   errno = 0;
+   if( sigaction(SIGTERM, &act, 0) < 0 )
+   {
+      std::cerr << " (" << invokedName << "): error setting SIGTERM handler: " << strerror(errno) << "\n";
+      return -1;
+   }
+
+   errno = 0;
+   if( sigaction(SIGQUIT, &act, 0) < 0 )
+   {
+      std::cerr << " (" << invokedName << "): error setting SIGQUIT handler: " << strerror(errno) << "\n";
+      return -1;
+   }
+
+   errno = 0;
+   if( sigaction(SIGINT, &act, 0) < 0 )
+   {
+      std::cerr << " (" << invokedName << "): error setting SIGINT handler: " << strerror(errno) << "\n";
+      return -1;
+   }
+
+   if(m_shmimName == "")
+   {
+      std::cerr << " (" << invokedName << "): shmimName is required\n";
+      return -1;
+   }
+
+   if(m_rate <= 0)
+   {
+      std::cerr << " (" << invokedName << "): rate must be > 0\n";
+      return -1;
+   }
+
+   if(loadShapes() < 0) return -1;
+
+   if(openStream() < 0) return -1;
+
+   const size_t nbytes = m_shapes.rows()*m_shapes.cols()*sizeof(float);
+   const double periodNs = 1e9/m_rate;
+   const uint64_t nTotal = (m_duration > 0) ? static_cast<uint64_t>(m_duration*m_rate) : 0;
+
+   uint64_t written = 0;
+   uint64_t late = 0;
+
+   double lagSum = 0; //Time from the deadline to the write, in seconds
+   double lagMax = 0;
+
+   timespec t0;
+   clock_gettime(CLOCK_MONOTONIC, &t0);
+
+   uint64_t n = 0;
+   while(!g_timeToDie && (nTotal == 0 || n < nTotal))
+   {
+      long long dl = t0.tv_nsec + llround(n*periodNs);
+      timespec deadline;
+      deadline.tv_sec = t0.tv_sec + dl / 1000000000;
+      deadline.tv_nsec = dl % 1000000000;
+
+      while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR && !g_timeToDie);
+
+      timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      double lag = (now.tv_sec - deadline.tv_sec) + (now.tv_nsec - deadline.tv_nsec)/1e9;
+
+      //Skip writes that are a full period or more late
+      if(lag*1e9 >= periodNs)
+      {
+         uint64_t skip = lag*1e9/periodNs;
+         late += skip;
+         n += skip;
+         continue;
+      }
+
+      m_imageStream.md[0].write = 1;
+
+      memcpy(m_imageStream.array.raw, m_shapes.image(written % m_shapes.planes()).data(), nbytes);
+
+      m_imageStream.md[0].cnt0++;
+      m_imageStream.md[0].cnt1 = 0;
+
+      clock_gettime(CLOCK_REALTIME, &m_imageStream.md[0].writetime);
+      m_imageStream.md[0].atime = m_imageStream.md[0].writetime;
+
+      m_imageStream.md[0].write = 0;
+      ImageStreamIO_sempost(&m_imageStream,-1);
+
+      ++written;
+      ++n;
+
+      lagSum += lag;
+      if(lag > lagMax) lagMax = lag;
+   }
+
+   timespec t1;
+   clock_gettime(CLOCK_MONOTONIC, &t1);
+   double elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec)/1e9;
+
+   std::cout << "simDMDriver: wrote " << written << " shapes to " << m_shmimName << " in " << elapsed << " s (" << written/elapsed << " Hz)\n";
+   std::cout << "simDMDriver: " << late << " writes skipped as late\n";
+   if(written > 0)
+   {
+      std::cout << "simDMDriver: wake-up lag mean " << lagSum/written*1e6 << " us, max " << lagMax*1e6 << " us\n";
+   }
+
+   return 0;
+}
+
+#endif //simDMDriver_hpp